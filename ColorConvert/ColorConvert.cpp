@@ -3,17 +3,49 @@
 //
 // Sample demonstrating use of APDFLs Color Conversion functions with callbacks.
 //
+// With -all and -threads <n>, the pages are converted on n threads, each with its own copy
+// of the document, scheduled by their estimated cost, most costly first, with idle threads
+// taking pages from busy ones (see RenderPageToImage/WorkScheduler.h). Each thread saves
+// its copy to a temporary file, and the converted pages are copied back from those into
+// the output. -schedbench first converts the pages split round-robin between the threads,
+// without stealing, and compares the time.
+//
+// With -window <n>, the pages are converted n at a time, so that what the conversion changes
+// is not all held at once: the input is copied to the output, which is opened once, and never
+// alongside the input, and converted in place, with an incremental save after each window
+// writing out what it changed. A full save at the end drops the objects the windows replaced.
+// -streambench reports the resident size after each window, then converts the whole document
+// in one opening, as without -window, and compares the peaks. StressCorpus makes documents
+// of any number of pages to try it on.
+//
+// -prefork <n> <jobfile>, given first, runs each line of <jobfile> as the arguments of a run
+// of the sample, in n processes forked from this one once the library is initialized;
+// -warmprofiles makes the profiles looked through below before forking. See
+// Shared/PreforkPool.h.
+//
+// With the DL_MEMTRACK environment variable set, the memory allocated while opening,
+// converting and saving is counted, and reported at exit. See Shared/MemTrack.h.
+//
 
 #include <sstream>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <iterator>
+#include <mutex>
+#include <thread>
 
 #include "APDFLDoc.h"
 #include "InitializeLibrary.h"
 #include "AcroColorCalls.h"
+#include "ConvertParams.h"
+#include "PermMatrix.h"
+#include "WorkScheduler.h"
+#include "PreforkPool.h"
+#include "MemTrack.h"
 
 #include "PERCalls.h"
 #include "PagePDECntCalls.h"
@@ -23,22 +55,6 @@
 #define DEF_INPUT "ducky.pdf"
 #define DEF_OUTPUT "ColorConvert-out.pdf"
 
-std::vector<char> ReadFromFile(const char* path)
-{
-    std::vector<char> ret;
-
-    if (path && strlen(path))
-    {
-        std::ifstream file(path, std::ios::binary);
-        if (file.is_open())
-        {
-            ret.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-            file.close();
-        }
-    }
-    return ret;
-}
-
 struct myPMClientDataRec {
     ASDuration duration, currValue;
     ASUTF16Val* utf8text;
@@ -162,16 +178,222 @@ void myPDColorConvertReportProc(PDColorConvertObjectAttributes objectType,
     std::cout << std::endl;
 }
 
-int main(int argc, char** argv) {
+// The pages of a document, converted on several threads.
+struct ConvertJob
+{
+    std::string inputFile;
+    std::string tempName;           // Each worker's copy is saved as this, with the worker number added.
+    std::vector<char> profileData;  // Each worker makes its own profile from this.
+    ConvertOptions options;
+    bool keepResults;               // Save the copies, to take the converted pages from.
+    std::vector<int> converter;     // For each page, the worker that converted it, or -1.
+    std::mutex reportLock;
+};
+
+std::string WorkerTempName(const ConvertJob& job, int worker)
+{
+    return job.tempName + "." + std::to_string(worker) + ".tmp";
+}
+
+void ConvertWorker(ConvertJob* job, WorkScheduler* scheduler, int worker)
+{
+    // Each thread needs its own initialization of the library, and its own copy of the document.
+    APDFLib workerLib;
+    if (workerLib.isValid() == false)
+    {
+        std::lock_guard<std::mutex> guard(job->reportLock);
+        std::cout << "Worker initialization failed with code " << workerLib.getInitError() << std::endl;
+        return;
+    }
+
+    AC_Profile iccProfile = NULL;
+    ACMakeBufferProfile(&iccProfile, &job->profileData[0], static_cast<ASUns32>(job->profileData.size()));
+    PDColorConvertParamsRecEx convParmsEx;
+    SetUpConvertParams(convParmsEx, iccProfile, job->options);
+
+    std::vector<int> converted;     // The pages this worker converted.
     ASErrorCode errCode = 0;
+    DURING
+        MemTrackStage(kMemStageOpen);
+        APDFLDoc workerDoc(job->inputFile.c_str(), true);
+        MemTrackStage(kMemStageEdit);
+        WorkItem item;
+        while (scheduler->Next(worker, item))
+        {
+            ASBool bPageChanged = FALSE;
+            ASErrorCode pageErr = 0;
+            DURING
+                PDDocColorConvertPageEx(workerDoc.getPDDoc(), &convParmsEx, item.pageNum, NULL, NULL, NULL, NULL, &bPageChanged);
+            HANDLER
+                pageErr = ERRORCODE;
+            END_HANDLER
+
+            if (pageErr != 0)
+            {
+                std::lock_guard<std::mutex> guard(job->reportLock);
+                std::cout << "Converting page " << item.pageNum << " failed with code " << pageErr << std::endl;
+                continue;
+            }
+            job->converter[item.pageNum] = worker;
+            converted.push_back(item.pageNum);
+        }
 
-    // Initialize the Adobe PDF Library.
-    APDFLib lib;
-    if (lib.isValid() == false) {
-        errCode = lib.getInitError();
-        std::cout << "Initialization failed with code " << errCode << std::endl;
-        return errCode;
+        MemTrackStage(kMemStageSave);
+        if (!converted.empty() && job->keepResults)
+            workerDoc.saveDoc(WorkerTempName(*job, worker).c_str());
+    HANDLER
+        errCode = ERRORCODE;
+    END_HANDLER
+
+    ACUnReferenceProfile(iccProfile);
+    ASfree(convParmsEx.mActions);
+
+    // Without its saved copy, the pages this worker converted are lost.
+    if (errCode != 0)
+    {
+        std::lock_guard<std::mutex> guard(job->reportLock);
+        std::cout << "Worker " << worker << " failed with code " << errCode << std::endl;
+        for (size_t i = 0; i < converted.size(); i++)
+        {
+            std::cout << "Converting page " << converted[i] << " failed with worker " << worker << std::endl;
+            job->converter[converted[i]] = -1;
+        }
     }
+}
+
+// Convert the pages on numThreads threads, with or without stealing.
+void ConvertPagesScheduled(ConvertJob& job, const std::vector<WorkItem>& pages, int numThreads, bool steal)
+{
+    std::fill(job.converter.begin(), job.converter.end(), -1);
+    WorkScheduler scheduler(numThreads, steal);
+    scheduler.Deal(pages);
+    scheduler.Run([&job, &scheduler](int worker) { ConvertWorker(&job, &scheduler, worker); });
+    scheduler.Report(steal ? "Scheduled by cost, with work stealing" : "Round-robin split");
+}
+
+static void ReportResident(const char* what)
+{
+    long currentKB = 0, peakKB = 0;
+    MemTrackResident(currentKB, peakKB);
+    std::cout << "  " << what << ": resident " << currentKB / 1024 << " MB, peak " << peakKB / 1024 << " MB" << std::endl;
+}
+
+// Convert the pages of doc windowSize at a time, in place, saving incrementally after each
+// window so that the objects it changed are written out and need not be kept. The conversion
+// acquires and releases each page itself. A full save at the end leaves out what the windows
+// replaced. Returns the number of pages changed.
+int ConvertPagesStreamed(PDDoc doc, PDColorConvertParamsRecEx* convParmsEx, int windowSize, bool bReport)
+{
+    int numPages = PDDocGetNumPages(doc);
+    int numChanged = 0;
+    for (int first = 0; first < numPages; first += windowSize)
+    {
+        int last = std::min(first + windowSize, numPages) - 1;
+
+        MemTrackStage(kMemStageEdit);
+        for (int i = first; i <= last; i++)
+        {
+            ASBool bPageChanged = FALSE;
+            PDDocColorConvertPageEx(doc, convParmsEx, i, NULL, NULL, NULL, NULL, &bPageChanged);
+            if (bPageChanged)
+                ++numChanged;
+        }
+
+        MemTrackStage(kMemStageSave);
+        PDDocSave(doc, PDSaveIncremental, NULL, NULL, NULL, NULL);
+
+        if (bReport)
+        {
+            std::string what = "pages " + std::to_string(first + 1) + "-" + std::to_string(last + 1);
+            ReportResident(what.c_str());
+        }
+    }
+
+    MemTrackStage(kMemStageSave);
+    PDDocSave(doc, PDSaveFull | PDSaveCollectGarbage, NULL, NULL, NULL, NULL);
+    MemTrackStage(kMemStageOther);
+    return numChanged;
+}
+
+// -window: convert a copy of inputFile, as outputFile, windowSize pages at a time. The input is
+// never opened, so that the whole document is not held alongside the window being converted.
+static void StreamDocument(const std::string& inputFile, const std::string& outputFile, AC_Profile iccProfile,
+    const ConvertOptions& options, PermCache* permCache, int windowSize, bool bBench)
+{
+    // The output is converted in place, from a copy of the input, so they cannot be the same file.
+    if (outputFile == inputFile)
+    {
+        std::cout << "-window needs an output file other than the input." << std::endl;
+        ASRaise(genErrBadParm);
+    }
+    {
+        std::ifstream in(inputFile.c_str(), std::ios::binary);
+        std::ofstream out(outputFile.c_str(), std::ios::binary | std::ios::trunc);
+        if (in && out)
+            out << in.rdbuf();
+        out.flush();
+        if (!in || !out)
+        {
+            std::cout << "Unable to copy " << inputFile.c_str() << " to " << outputFile.c_str() << std::endl;
+            ASRaise(genErrGeneral);
+        }
+    }
+
+    PDColorConvertParamsRecEx convParmsEx;
+    SetUpConvertParams(convParmsEx, iccProfile, options);
+
+    ASErrorCode errCode = 0;
+    DURING
+        int numPages = 0;
+        int numChanged = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        {
+            MemTrackStage(kMemStageOpen);
+            APDFLDoc outDoc(outputFile.c_str(), true);
+            if (permCache != NULL && PermGateCheck(permCache, inputFile.c_str(), outDoc.getPDDoc(), PDPermReqObjDoc, PDPermReqOprModify) == kPermDenied)
+                ASRaise(pdErrOpNotPermitted);
+            numPages = PDDocGetNumPages(outDoc.getPDDoc());
+            numChanged = ConvertPagesStreamed(outDoc.getPDDoc(), &convParmsEx, windowSize, bBench);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Converted " << numPages << " pages, " << windowSize << " at a time, in " << seconds
+            << " s; " << numChanged << " changed." << std::endl;
+
+        // The peak only ever grows, so the whole document is converted second.
+        if (bBench)
+        {
+            ReportResident("streamed");
+            std::string wholeName = outputFile + ".whole.tmp";
+            start = std::chrono::steady_clock::now();
+            {
+                APDFLDoc wholeDoc(inputFile.c_str(), true);
+                for (int i = 0; i < numPages; i++)
+                {
+                    ASBool bPageChanged = FALSE;
+                    PDDocColorConvertPageEx(wholeDoc.getPDDoc(), &convParmsEx, i, NULL, NULL, NULL, NULL, &bPageChanged);
+                }
+                wholeDoc.saveDoc(wholeName.c_str(), PDSaveFull);
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            remove(wholeName.c_str());
+            std::cout << "Converted " << numPages << " pages in one opening in " << seconds << " s." << std::endl;
+            ReportResident("whole document");
+        }
+    HANDLER
+        errCode = ERRORCODE;
+    END_HANDLER
+
+    ASfree(convParmsEx.mActions);
+    if (errCode != 0)
+    {
+        remove(outputFile.c_str());
+        ASRaise(errCode);
+    }
+}
+
+// One run of the sample, on its own command line or as a -prefork job.
+static int convertDocument(APDFLib& lib, int argc, char** argv) {
+    ASErrorCode errCode = 0;
 
     int curArg = 1;
     int pageNum = 0;
@@ -180,11 +402,16 @@ int main(int argc, char** argv) {
     ASBool bPreserveBlack = FALSE;
     ASBool bPreserveCMYKPrimaries = FALSE;
     ASBool bGrayToK = FALSE;
+    int numThreads = 1;
+    ASBool bSchedBench = FALSE;
+    int windowSize = 0;
+    ASBool bStreamBench = FALSE;
     AC_RenderIntent ri = AC_AbsColorimetric;
 
     char* defaultDescr = "SWOP";
     char* profilePath = NULL;
     char* profileDescrKey = defaultDescr;
+    PermCache* permCache = NULL;
     while (argc > curArg)
     {
         if (strcmp(argv[curArg], "-all") == 0)
@@ -220,6 +447,30 @@ int main(int argc, char** argv) {
         {
             bGrayToK = TRUE;
         }
+        else if (strcmp(argv[curArg], "-threads") == 0)
+        {
+            numThreads = atoi(argv[++curArg]);
+        }
+        else if (strcmp(argv[curArg], "-schedbench") == 0)
+        {
+            bSchedBench = TRUE;
+        }
+        else if (strcmp(argv[curArg], "-window") == 0)
+        {
+            bAllPages = TRUE;
+            windowSize = atoi(argv[++curArg]);
+        }
+        else if (strcmp(argv[curArg], "-streambench") == 0)
+        {
+            bStreamBench = TRUE;
+        }
+        else if (strcmp(argv[curArg], "-permcache") == 0)
+        {
+            // Refuse documents whose permissions do not allow modification, using (and adding to)
+            // the permission matrices stored in this file. See PermCheck/PermMatrix.h.
+            delete permCache;
+            permCache = new PermCache(argv[++curArg]);
+        }
         else
             break;
         ++curArg;
@@ -229,81 +480,55 @@ int main(int argc, char** argv) {
     ++curArg;
     std::string csOutputFileName(argc > curArg ? argv[curArg] : DEF_OUTPUT);
 
-    AC_Profile iccProfile = NULL;
-    char profileDescr[128] = "";
-    AC_String profACString;
-    AC_Error ret;
-
-    if (profilePath != NULL)
+    // A document already known to forbid this can be skipped before loading any profiles.
+    if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), NULL, PDPermReqObjDoc, PDPermReqOprModify) == kPermDenied)
     {
-        std::vector<char> targetBuffer = ReadFromFile(profilePath);
-
-        ACMakeBufferProfile(&iccProfile, &targetBuffer[0], targetBuffer.size());
-        ASUns32 profCount, bufUsed;
-        AC_ColorSpace acCS;
-
-        ACProfileColorSpace(iccProfile, &acCS);
-        ret = ACProfileDescription(iccProfile, &profACString);
-        ret = ACStringASCII(profACString, profileDescr, &bufUsed, sizeof(profileDescr));
-        ACUnReferenceString(profACString);
+        errCode = pdErrOpNotPermitted;
+        lib.displayError(errCode);
+        delete permCache;
+        return errCode;
     }
-    else {
-        AC_SelectorCode selCodes[] =
-        {
-            AC_Selector_CMYK_StandardOutput,
-            AC_Selector_CMYK_OtherOutputCapable,
-            AC_Selector_RGB_Standard,
-            AC_Selector_RGB_OtherOutputCapable,
-            AC_Selector_Gray_Standard,
-            AC_Selector_DotGain_Standard,
-            AC_Selector_DotGain_Other,
-            AC_Selector_MaxEnum
-        };
-
-        int curSel = 0;
-        AC_ProfileList profList;
-        ASUTF16Val utf16Buf[1024];
-        ASUns32 profCount, bufUsed;
-        ASBool bFound = FALSE;
-
-        while (!bFound && selCodes[curSel] != AC_Selector_MaxEnum)
-        {
-            AC_SelectorCode curCode = selCodes[curSel];
 
-            ret = ACMakeProfileList(&profList, curCode);
-            ret = ACProfileListCount(profList, &profCount);
-            int candidate = 0;
+    char profileDescr[128] = "";
+    AC_Profile iccProfile = FindTargetProfile(profilePath, profileDescrKey, profileDescr, sizeof(profileDescr));
+    if (iccProfile == NULL)
+    {
+        std::cout << "No target profile: " << (profilePath != NULL ? profilePath : profileDescrKey) << std::endl;
+        delete permCache;
+        return genErrBadParm;
+    }
 
-            while (candidate < profCount) {
-                ret = ACProfileListItemDescription(profList, candidate, &profACString);
-                ret = ACProfileFromDescription(&iccProfile, profACString);
-                ret = ACStringASCII(profACString, profileDescr, &bufUsed, sizeof(profileDescr));
-                ACUnReferenceString(profACString);
-                std::string csCandidate(profileDescr);
+    std::cout << "setting " << profileDescr << " as OutputIntent for " << csInputFileName.c_str()
+        << " and write output to " << csOutputFileName.c_str() << std::endl;
 
-                if (csCandidate.find(profileDescrKey) != std::string::npos)
-                {
-                    bFound = TRUE;
-                    break;
-                }
+    ConvertOptions options = { bEmbed, bPreserveBlack, bPreserveCMYKPrimaries, bGrayToK };
 
-                candidate++;
-                ACUnReferenceProfile(iccProfile);
-                memset(&profileDescr, 0x0, sizeof(profileDescr));
-            }
-            ACUnReferenceProfileList(profList);
-            curSel++;
-        }
+    // -window does not open the document here: it is never held whole.
+    if (bAllPages && windowSize > 0)
+    {
+        DURING
+            StreamDocument(csInputFileName, csOutputFileName, iccProfile, options, permCache, windowSize, bStreamBench == TRUE);
+        HANDLER
+            errCode = ERRORCODE;
+        lib.displayError(errCode);
+        END_HANDLER
+
+        ACUnReferenceProfile(iccProfile);
+        delete permCache;
+        return errCode;
     }
 
-
-    std::cout << "setting " << profileDescr << " as OutputIntent for " << csInputFileName.c_str()
-        << " and write output to " << csOutputFileName.c_str() << std::endl;
+    PDColorConvertParamsRecEx convParmsEx;
+    SetUpConvertParams(convParmsEx, iccProfile, options);
 
     DURING
 
+        MemTrackStage(kMemStageOpen);
         APDFLDoc APDoc(csInputFileName.c_str(), true);
     PDDoc doc = APDoc.getPDDoc();
+    if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), doc, PDPermReqObjDoc, PDPermReqOprModify) == kPermDenied)
+        ASRaise(pdErrOpNotPermitted);
+    MemTrackStage(kMemStageEdit);
 
     ASProgressMonitorRec myPM;
     myPM.size = sizeof(myPM);
@@ -321,28 +546,89 @@ int main(int argc, char** argv) {
     ASBool bChanged = FALSE;
     ASBool result = FALSE;
 
-    PDColorConvertParamsRecEx convParmsEx;
-    memset(&convParmsEx, 0x0, sizeof(PDColorConvertParamsRecEx));
-    convParmsEx.mSize = sizeof(PDColorConvertParamsRecEx);
-    convParmsEx.mNumActions = 1;
-    convParmsEx.intentGray = convParmsEx.intentRGB = convParmsEx.intentCMYK = AC_UseProfileIntent;
-
-    convParmsEx.mActions = reinterpret_cast<PDColorConvertActionEx>(ASmalloc(sizeof(PDColorConvertActionRecEx) * convParmsEx.mNumActions));
-    memset(convParmsEx.mActions, 0x0, sizeof(PDColorConvertActionRecEx) * convParmsEx.mNumActions);
-    convParmsEx.mActions[0].mSize = sizeof(PDColorConvertActionRec);
-    convParmsEx.mActions[0].mMatchAttributesAny = kColorConvObj_AnyObject;
-    convParmsEx.mActions[0].mMatchSpaceTypeAny = kColorConvAnySpace;
-    convParmsEx.mActions[0].mMatchIntent = AC_UseProfileIntent;
-    convParmsEx.mActions[0].mConvertIntent = AC_AbsColorimetric;
-    convParmsEx.mActions[0].mAction = kColorConvConvert;
-    convParmsEx.mActions[0].mEmbed = bEmbed;
-    convParmsEx.mActions[0].mConvertProfile = iccProfile;
-    convParmsEx.mActions[0].mPreserveBlack = bPreserveBlack;
-    convParmsEx.mActions[0].mPreserveCMYKPrimaries = bPreserveCMYKPrimaries;
-    convParmsEx.mActions[0].mPromoteGrayToCMYK = bGrayToK;
-
     if (!bAllPages)
         result = PDDocColorConvertPageEx(doc, &convParmsEx, pageNum, &myPM, &myPMclientData, myPDColorConvertReportProc, NULL, &bChanged);
+    else if (numThreads > 1)
+    {
+        ConvertJob job;
+        job.inputFile = csInputFileName;
+        job.tempName = csOutputFileName;
+        job.options = options;
+        ASUns32 profileSize = 0;
+        ACProfileSize(iccProfile, &profileSize);
+        job.profileData.resize(profileSize);
+        ACProfileData(iccProfile, &job.profileData[0]);
+
+        // The pages, most costly first.
+        int numPages = PDDocGetNumPages(doc);
+        std::vector<WorkItem> pages(numPages);
+        for (int i = 0; i < numPages; i++)
+        {
+            PDPage pdPage = PDDocAcquirePage(doc, i);
+            WorkItem page = { i, -1, 1, EstimatePageCost(pdPage) };
+            pages[i] = page;
+            PDPageRelease(pdPage);
+        }
+        job.converter.resize(numPages);
+
+        if (bSchedBench)
+        {
+            job.keepResults = false;
+            ConvertPagesScheduled(job, pages, numThreads, false);
+        }
+        job.keepResults = true;
+        ConvertPagesScheduled(job, pages, numThreads, true);
+
+        // Copy the converted pages back from each worker's copy, each run of pages in one call,
+        // so that the resources they share are copied once for the run rather than once a page.
+        // A copy that cannot be read loses the pages not yet taken from it, which are reported;
+        // the others are kept.
+        for (int worker = 0; worker < numThreads; worker++)
+        {
+            std::string tempName = WorkerTempName(job, worker);
+            if (std::find(job.converter.begin(), job.converter.end(), worker) == job.converter.end())
+                continue;
+            volatile int copying = 0;
+            ASErrorCode copyErr = 0;
+            DURING
+                APDFLDoc workerDoc(tempName.c_str(), true);
+                while (copying < numPages)
+                {
+                    if (job.converter[copying] != worker)
+                    {
+                        ++copying;
+                        continue;
+                    }
+                    int runEnd = copying + 1;
+                    while (runEnd < numPages && job.converter[runEnd] == worker)
+                        ++runEnd;
+                    PDDocReplacePages(doc, copying, workerDoc.getPDDoc(), copying, runEnd - copying, FALSE, NULL, NULL, NULL, NULL);
+                    copying = runEnd;
+                }
+            HANDLER
+                copyErr = ERRORCODE;
+            END_HANDLER
+
+            if (copyErr != 0)
+            {
+                std::cout << "Copying back from worker " << worker << " failed with code " << copyErr << std::endl;
+                for (int i = copying; i < numPages; i++)
+                {
+                    if (job.converter[i] == worker)
+                    {
+                        std::cout << "Converting page " << i << " failed with worker " << worker << std::endl;
+                        job.converter[i] = -1;
+                    }
+                }
+            }
+        }
+        for (int worker = 0; worker < numThreads; worker++)
+            remove(WorkerTempName(job, worker).c_str());
+
+        int numConverted = static_cast<int>(numPages - std::count(job.converter.begin(), job.converter.end(), -1));
+        std::cout << "Converted " << numConverted << " of " << numPages << " pages on " << numThreads << " threads." << std::endl;
+        result = bChanged = (numConverted > 0);
+    }
     else
     {
         int numPages = PDDocGetNumPages(doc);
@@ -354,15 +640,30 @@ int main(int argc, char** argv) {
         }
     }
 
-    ACUnReferenceProfile(iccProfile);
-    ASfree(convParmsEx.mActions);
-
     // if (bChanged)
+    MemTrackStage(kMemStageSave);
     APDoc.saveDoc(csOutputFileName.c_str());
     HANDLER
         errCode = ERRORCODE;
     lib.displayError(errCode);
     END_HANDLER
 
+        ACUnReferenceProfile(iccProfile);
+        ASfree(convParmsEx.mActions);
+        delete permCache;
+        return errCode;
+};
+
+int main(int argc, char** argv) {
+    MemTrackStart("ColorConvert");
+
+    // Initialize the Adobe PDF Library.
+    APDFLib lib;
+    if (lib.isValid() == false) {
+        ASErrorCode errCode = lib.getInitError();
+        std::cout << "Initialization failed with code " << errCode << std::endl;
         return errCode;
-};
\ No newline at end of file
+    }
+
+    return RunSampleJobs(argc, argv, [&lib](int jobArgc, char** jobArgv) { return convertDocument(lib, jobArgc, jobArgv); });
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2017-2024, Datalogics, Inc. All rights reserved.
+//
+// Setting up a color conversion. See ConvertParams.h.
+//
+
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "ASCalls.h"
+
+#include "ConvertParams.h"
+
+void SetUpConvertParams(PDColorConvertParamsRecEx& convParmsEx, AC_Profile iccProfile, const ConvertOptions& options)
+{
+    memset(&convParmsEx, 0x0, sizeof(PDColorConvertParamsRecEx));
+    convParmsEx.mSize = sizeof(PDColorConvertParamsRecEx);
+    convParmsEx.mNumActions = 1;
+    convParmsEx.intentGray = convParmsEx.intentRGB = convParmsEx.intentCMYK = AC_UseProfileIntent;
+
+    convParmsEx.mActions = reinterpret_cast<PDColorConvertActionEx>(ASmalloc(sizeof(PDColorConvertActionRecEx) * convParmsEx.mNumActions));
+    memset(convParmsEx.mActions, 0x0, sizeof(PDColorConvertActionRecEx) * convParmsEx.mNumActions);
+    convParmsEx.mActions[0].mSize = sizeof(PDColorConvertActionRec);
+    convParmsEx.mActions[0].mMatchAttributesAny = kColorConvObj_AnyObject;
+    convParmsEx.mActions[0].mMatchSpaceTypeAny = kColorConvAnySpace;
+    convParmsEx.mActions[0].mMatchIntent = AC_UseProfileIntent;
+    convParmsEx.mActions[0].mConvertIntent = AC_AbsColorimetric;
+    convParmsEx.mActions[0].mAction = kColorConvConvert;
+    convParmsEx.mActions[0].mEmbed = options.bEmbed;
+    convParmsEx.mActions[0].mConvertProfile = iccProfile;
+    convParmsEx.mActions[0].mPreserveBlack = options.bPreserveBlack;
+    convParmsEx.mActions[0].mPreserveCMYKPrimaries = options.bPreserveCMYKPrimaries;
+    convParmsEx.mActions[0].mPromoteGrayToCMYK = options.bGrayToK;
+}
+
+static std::vector<char> readFromFile(const char* path)
+{
+    std::vector<char> ret;
+
+    if (path && strlen(path))
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (file.is_open())
+        {
+            ret.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            file.close();
+        }
+    }
+    return ret;
+}
+
+AC_Profile FindTargetProfile(const char* profilePath, const char* descrKey, char* descr, ASUns32 descrSize)
+{
+    AC_Profile iccProfile = NULL;
+    AC_String profACString;
+    ASUns32 bufUsed;
+    memset(descr, 0x0, descrSize);
+
+    if (profilePath != NULL)
+    {
+        std::vector<char> targetBuffer = readFromFile(profilePath);
+        if (targetBuffer.empty() || ACMakeBufferProfile(&iccProfile, &targetBuffer[0], static_cast<ASUns32>(targetBuffer.size())) != 0)
+            return NULL;
+
+        if (ACProfileDescription(iccProfile, &profACString) == 0)
+        {
+            ACStringASCII(profACString, descr, &bufUsed, descrSize);
+            ACUnReferenceString(profACString);
+        }
+        return iccProfile;
+    }
+
+    AC_SelectorCode selCodes[] =
+    {
+        AC_Selector_CMYK_StandardOutput,
+        AC_Selector_CMYK_OtherOutputCapable,
+        AC_Selector_RGB_Standard,
+        AC_Selector_RGB_OtherOutputCapable,
+        AC_Selector_Gray_Standard,
+        AC_Selector_DotGain_Standard,
+        AC_Selector_DotGain_Other,
+        AC_Selector_MaxEnum
+    };
+
+    for (int curSel = 0; selCodes[curSel] != AC_Selector_MaxEnum; curSel++)
+    {
+        AC_ProfileList profList;
+        ASUns32 profCount = 0;
+        ACMakeProfileList(&profList, selCodes[curSel]);
+        ACProfileListCount(profList, &profCount);
+
+        for (ASUns32 candidate = 0; candidate < profCount; candidate++)
+        {
+            ACProfileListItemDescription(profList, candidate, &profACString);
+            ACProfileFromDescription(&iccProfile, profACString);
+            ACStringASCII(profACString, descr, &bufUsed, descrSize);
+            ACUnReferenceString(profACString);
+
+            if (std::string(descr).find(descrKey) != std::string::npos)
+            {
+                ACUnReferenceProfileList(profList);
+                return iccProfile;
+            }
+
+            ACUnReferenceProfile(iccProfile);
+            memset(descr, 0x0, descrSize);
+        }
+        ACUnReferenceProfileList(profList);
+    }
+    return NULL;
+}
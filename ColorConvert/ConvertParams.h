@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017-2024, Datalogics, Inc. All rights reserved.
+//
+// Setting up a color conversion: finding the target profile and filling in the
+// PDColorConvertParamsRecEx for PDDocColorConvertPageEx(). Used by ColorConvert, and by the
+// Pipeline sample to convert a document it already has open.
+//
+
+#ifndef CONVERTPARAMS_H
+#define CONVERTPARAMS_H
+
+#include "AcroColorCalls.h"
+#include "PERCalls.h"
+
+struct ConvertOptions
+{
+    ASBool bEmbed;
+    ASBool bPreserveBlack;
+    ASBool bPreserveCMYKPrimaries;
+    ASBool bGrayToK;
+};
+
+// Fill in convParmsEx to convert everything to iccProfile. The actions are allocated here,
+// and freed by the caller with ASfree.
+void SetUpConvertParams(PDColorConvertParamsRecEx& convParmsEx, AC_Profile iccProfile, const ConvertOptions& options);
+
+// The profile in the ICC file at profilePath or, when that is NULL, the first output, RGB,
+// gray or dot gain profile known to the color engine whose description contains descrKey.
+// Its description is copied to descr. Returns NULL if there is none; otherwise the caller
+// releases the profile with ACUnReferenceProfile.
+AC_Profile FindTargetProfile(const char* profilePath, const char* descrKey, char* descr, ASUns32 descrSize);
+
+#endif // CONVERTPARAMS_H
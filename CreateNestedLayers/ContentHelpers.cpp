@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2017,2024 Datalogics, Inc. All rights reserved.
+//
+// Helpers for building page content, shared by CreateNestedLayers and StressCorpus.
+// See ContentHelpers.h.
+//
+
+#include <string.h>
+
+#include "PSFCalls.h"
+#include "PERCalls.h"
+#include "PEWCalls.h"
+#include "PagePDECntCalls.h"
+#include "CosCalls.h"
+
+#include "ContentHelpers.h"
+
+PDEFont fontMaker(const char* fontName, const char* fontType, PDEFontCreateFlags flags, ResourceCache* cache)
+{
+	//With a cache, the font is only located and created the first time it is asked for.
+	if (cache != NULL)
+		return cache->GetFont(fontName, fontType, flags);
+
+	PDEFontAttrs fontAttrs;
+	memset(&fontAttrs, 0, sizeof(fontAttrs));
+	fontAttrs.name = ASAtomFromString(fontName);
+	fontAttrs.type = ASAtomFromString(fontType);
+
+	//Locate the system font that corresponds to the PDEFontAttrs struct we just set.
+	PDSysFont sysFont = PDFindSysFont(&fontAttrs, sizeof(fontAttrs), 0);
+
+	//Create the CourierStd Type1 font with embed flag set.       
+	PDEFont font = PDEFontCreateFromSysFont(sysFont, flags); //kPDEFontCreateEmbedded
+
+	return font;
+}
+
+PDEContainer makeOCMDContainer(PDEContent content, PDOCMD ocmd)
+{
+	//Create an empty container for the text.
+	PDEContainer container = PDEContainerCreate(ASAtomFromString("OC"), NULL, true);
+
+	// Place them into this container
+	PDEContainerSetContent(container, content);
+
+	//Set the container's membership dictionary to the text layer.
+	PDEElementSetOCMD((PDEElement)container, ocmd);
+	return container;
+}
+
+PDEContainer makeOCGContainer(PDEContent content, PDOCG ocg)
+{
+	//Create an empty container for the text.
+	PDEContainer container = PDEContainerCreate(ASAtomFromString("OC"), NULL, true);
+
+	// Place them into this container
+	PDEContainerSetContent(container, content);
+
+	//Set the OCG's dictionary to the container .
+	CosObj ocgObj = PDOCGGetCosObj(ocg);
+	PDEContainerSetDict(container, &ocgObj , false);
+
+	return container;
+}
+
+
+// Helper function to create a PDEText object
+PDEText textMakerEx(std::string displayText, PDEFont font, ASDoubleMatrix* textMatrix, PDEGraphicState* gs, PDETextState* ts)
+{
+	// Create a new text run
+	PDEText textObj = PDETextCreate();
+
+	//Adding the text run to the PDE text object.
+	PDETextAddEx(
+		textObj,                                  // Text container to add to. 
+		kPDETextRun,                              // kPDETextRun or kPDETextChar as appropriate
+		0,                                        // The index after which to add the text run.
+		(Uns8 *)displayText.c_str(),              // Text to add.    
+		displayText.length(),                     // Length of text. 
+		font,                              // Font to apply to text. 
+		gs, sizeof(PDEGraphicState),                  // PDEGraphicState and its size.
+		ts, sizeof(PDETextState),                               // Text state and its size.
+		textMatrix,                              // Matrix containing size and location for the text.
+		NULL);                                    // Stroke matrix for the line width when stroking text.  
+
+
+	return textObj;
+}
+
+void setGstateRGBFillColor(PDEGraphicState* gState, unsigned char red, unsigned char green, unsigned char blue, ResourceCache* cache)
+{
+	if (cache != NULL)
+	{
+		cache->SetRGBFillColor(gState, red, green, blue);
+		return;
+	}
+
+	//Release the fill color space before modifiying it.
+	PDERelease(reinterpret_cast<PDEObject>(gState->fillColorSpec.space));
+
+	//We are using the RGB color space in this case. Default value is "DeviceGray".     
+	gState->fillColorSpec.space = PDEColorSpaceCreateFromName(ASAtomFromString("DeviceRGB"));
+
+	gState->fillColorSpec.value.color[0] = ASFloatToFixed(red * 1.0f / 255.0f);      //Initially value = 0 (Black.)
+	gState->fillColorSpec.value.color[1] = ASFloatToFixed(green * 1.0f / 255.0f);    //In this case the object will be painted purple.
+	gState->fillColorSpec.value.color[2] = ASFloatToFixed(blue * 1.0f / 255.0f);
+}
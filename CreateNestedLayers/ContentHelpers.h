@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2017,2024 Datalogics, Inc. All rights reserved.
+//
+// Helpers for building page content: fonts, text runs, fill colors and optional content
+// containers. Used by CreateNestedLayers, and by StressCorpus to generate test documents.
+//
+
+#ifndef CONTENTHELPERS_H
+#define CONTENTHELPERS_H
+
+#include <string>
+
+#include "PagePDECntCalls.h"
+
+#include "ResourceCache.h"
+
+// Find a system font and create a PDEFont from it. With a cache, the font is created once
+// and shared. Either way the caller releases the font returned.
+PDEFont fontMaker(const char* fontName, const char* fontType, PDEFontCreateFlags flags, ResourceCache* cache = NULL);
+
+// Wrap content in a marked content container belonging to a membership dictionary.
+PDEContainer makeOCMDContainer(PDEContent content, PDOCMD ocmd);
+
+// Wrap content in a marked content container belonging to a single optional content group.
+PDEContainer makeOCGContainer(PDEContent content, PDOCG ocg);
+
+// Create a text run for displayText.
+PDEText textMakerEx(std::string displayText, PDEFont font, ASDoubleMatrix* textMatrix, PDEGraphicState* gs, PDETextState* ts);
+
+// Set the fill color of gState to an RGB value, releasing the previous fill color space.
+void setGstateRGBFillColor(PDEGraphicState* gState, unsigned char red, unsigned char green, unsigned char blue, ResourceCache* cache = NULL);
+
+#endif // CONTENTHELPERS_H
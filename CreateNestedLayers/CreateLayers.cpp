@@ -4,9 +4,22 @@
 // The CreateNestedLayers sample program demonstrates how to programmatically add nested layers to a PDF
 // document.
 //
-// Command-line:  <output-file>   <number-of-pages>    (Both optional)
+// Command-line:  [options] <output-file>   <number-of-pages>    (Both optional)
+//
+// The layered content is written once, as a Form XObject, and drawn on each of the pages,
+// so that the size of the output grows only by a page dictionary and a short content stream
+// for each page added.
+//
+//   -spec <file>   Build the layer tree described in <file> (see LayerTree.h) instead of the
+//                  fixed example, with one label per layer.
+//   -bench         Time building and saving synthetic layer trees of 1k, 10k and 50k layers,
+//                  with and without the font and color space cache (see ResourceCache.h).
+//
+// With the DL_MEMTRACK environment variable set, the memory allocated while building and
+// saving the document is counted, and reported at exit. See Shared/MemTrack.h.
 //
 
+#include <chrono>
 #include <iostream>
 
 #include "InitializeLibrary.h"
@@ -18,93 +31,121 @@
 #include "PagePDECntCalls.h"
 #include "CosCalls.h"
 
-#define DEF_OUTPUT "CreateLayers-out.pdf"
-
-
-PDEFont fontMaker(const char* fontName, const char* fontType, PDEFontCreateFlags flags)
-{
-	PDEFontAttrs fontAttrs;
-	memset(&fontAttrs, 0, sizeof(fontAttrs));
-	fontAttrs.name = ASAtomFromString(fontName);
-	fontAttrs.type = ASAtomFromString(fontType);
-
-	//Locate the system font that corresponds to the PDEFontAttrs struct we just set.
-	PDSysFont sysFont = PDFindSysFont(&fontAttrs, sizeof(fontAttrs), 0);
-
-	//Create the CourierStd Type1 font with embed flag set.       
-	PDEFont font = PDEFontCreateFromSysFont(sysFont, flags); //kPDEFontCreateEmbedded
-
-	return font;
-}
-
-PDEContainer makeOCMDContainer(PDEContent content, PDOCMD ocmd)
-{
-	//Create an empty container for the text.
-	PDEContainer container = PDEContainerCreate(ASAtomFromString("OC"), NULL, true);
-
-	// Place them into this container
-	PDEContainerSetContent(container, content);
+#include "ContentHelpers.h"
+#include "LayerTree.h"
+#include "ResourceCache.h"
+#include "MemTrack.h"
 
-	//Set the container's membership dictionary to the text layer.
-	PDEElementSetOCMD((PDEElement)container, ocmd);
-	return container;
-}
+#define DEF_OUTPUT "CreateLayers-out.pdf"
 
-PDEContainer makeOCGContainer(PDEContent content, PDOCG ocg)
+// Lay out one label for each node of the tree, in columns, adding pages as they fill.
+// Each label sits in a container marked with its node's membership dictionary, and is
+// colored by its depth. Without a cache, each page gets its own font and each label its
+// own color space, as a straightforward generator would do.
+void placeLayerLabels(APDFLDoc& doc, const LayerTree& tree, ResourceCache* cache)
 {
-	//Create an empty container for the text.
-	PDEContainer container = PDEContainerCreate(ASAtomFromString("OC"), NULL, true);
-
-	// Place them into this container
-	PDEContainerSetContent(container, content);
+	static const unsigned char kDepthColors[][3] = { { 0x00, 0x00, 0x00 }, { 0x94, 0x00, 0xd3 }, { 0x55, 0x6b, 0x2f }, { 0x8b, 0x45, 0x13 } };
+	static const int kNumDepthColors = sizeof(kDepthColors) / sizeof(kDepthColors[0]);
 
-	//Set the OCG's dictionary to the container .
-	CosObj ocgObj = PDOCGGetCosObj(ocg);
-	PDEContainerSetDict(container, &ocgObj , false);
+	const double kTop = 756, kBottom = 36, kLineHeight = 10, kColumnWidth = 180, kIndent = 8;
+	const int kLinesPerColumn = static_cast<int>((kTop - kBottom) / kLineHeight);
+	const int kColumnsPerPage = 3;
 
-	return container;
-}
+	PDEGraphicState gState;
+	PDEDefaultGState(&gState, sizeof(PDEGraphicState));
+	PDETextState tState;
+	memset(&tState, 0x0, sizeof(PDETextState));
+	tState.fontSize = FloatToASFixed(8.0);
 
+	PDPage page = NULL;
+	PDEContent pageContent = NULL;
+	PDEFont font = NULL;
+	for (int i = 0; i < tree.NumNodes(); i++)
+	{
+		int line = i % kLinesPerColumn;
+		int column = (i / kLinesPerColumn) % kColumnsPerPage;
+		if (line == 0 && column == 0)
+		{
+			if (page != NULL)
+			{
+				PDPageSetPDEContentCanRaise(page, NULL);
+				PDPageReleasePDEContent(page, NULL);
+				PDPageRelease(page);
+				PDERelease(reinterpret_cast<PDEObject>(font));
+			}
+			int numPages = PDDocGetNumPages(doc.getPDDoc());
+			doc.insertPage(ASFloatToFixed(8.5 * 72), ASFloatToFixed(11 * 72), numPages - 1);
+			page = doc.getPage(numPages);
+			pageContent = PDPageAcquirePDEContent(page, NULL);
+			font = fontMaker("MyriadPro-Regular", "TrueType", kPDEFontCreateEmbedOpenType, cache);
+		}
+
+		const LayerTree::Node& node = tree.GetNode(i);
+		const unsigned char* color = kDepthColors[node.depth % kNumDepthColors];
+		setGstateRGBFillColor(&gState, color[0], color[1], color[2], cache);
+		ASDoubleMatrix textMatrix = { 1, 0, 0, 1, 36 + (column * kColumnWidth) + (node.depth * kIndent), kTop - (line * kLineHeight) };
+		PDEText text = textMakerEx(node.name, font, &textMatrix, &gState, &tState);
+
+		PDEContent labelContent = PDEContentCreate();
+		PDEContentAddElem(labelContent, kPDEAfterLast, reinterpret_cast<PDEElement>(text));
+		PDEContainer container = makeOCMDContainer(labelContent, node.ocmd);
+		PDEContentAddElem(pageContent, kPDEAfterLast, reinterpret_cast<PDEElement>(container));
+
+		PDERelease(reinterpret_cast<PDEObject>(container));
+		PDERelease(reinterpret_cast<PDEObject>(labelContent));
+		PDERelease(reinterpret_cast<PDEObject>(text));
+	}
 
-// Helper function to create a PDEText object
-PDEText textMakerEx(std::string displayText, PDEFont font, ASDoubleMatrix* textMatrix, PDEGraphicState* gs, PDETextState* ts)
-{
-	// Create a new text run
-	PDEText textObj = PDETextCreate();
-
-	//Adding the text run to the PDE text object.
-	PDETextAddEx(
-		textObj,                                  // Text container to add to. 
-		kPDETextRun,                              // kPDETextRun or kPDETextChar as appropriate
-		0,                                        // The index after which to add the text run.
-		(Uns8 *)displayText.c_str(),              // Text to add.    
-		displayText.length(),                     // Length of text. 
-		font,                              // Font to apply to text. 
-		gs, sizeof(PDEGraphicState),                  // PDEGraphicState and its size.
-		ts, sizeof(PDETextState),                               // Text state and its size.
-		textMatrix,                              // Matrix containing size and location for the text.
-		NULL);                                    // Stroke matrix for the line width when stroking text.  
-
-
-	return textObj;
+	if (page != NULL)
+	{
+		PDPageSetPDEContentCanRaise(page, NULL);
+		PDPageReleasePDEContent(page, NULL);
+		PDPageRelease(page);
+		PDERelease(reinterpret_cast<PDEObject>(font));
+	}
+	PDERelease(reinterpret_cast<PDEObject>(gState.fillColorSpec.space));
 }
 
-void setGstateRGBFillColor(PDEGraphicState* gState, unsigned char red, unsigned char green, unsigned char blue)
+// Create a document holding the layers of tree, with a label for each, and save it.
+void saveLayerTree(LayerTree& tree, const char* outputFileName, bool showTimes, bool useCache)
 {
-	//Release the fill color space before modifiying it.
-	PDERelease(reinterpret_cast<PDEObject>(gState->fillColorSpec.space));
-
-	//We are using the RGB color space in this case. Default value is "DeviceGray".     
-	gState->fillColorSpec.space = PDEColorSpaceCreateFromName(ASAtomFromString("DeviceRGB"));
-
-	gState->fillColorSpec.value.color[0] = ASFloatToFixed(red * 1.0f / 255.0f);      //Initially value = 0 (Black.)
-	gState->fillColorSpec.value.color[1] = ASFloatToFixed(green * 1.0f / 255.0f);    //In this case the object will be painted purple.
-	gState->fillColorSpec.value.color[2] = ASFloatToFixed(blue * 1.0f / 255.0f);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	MemTrackStage(kMemStageEdit);
+	APDFLDoc doc;
+	tree.Build(doc.getPDDoc());
+	std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+
+	// The cache has to be released before the document is closed.
+	ResourceCache* cache = useCache ? new ResourceCache : NULL;
+	placeLayerLabels(doc, tree, cache);
+	std::chrono::steady_clock::time_point placed = std::chrono::steady_clock::now();
+
+	MemTrackStage(kMemStageSave);
+	doc.saveDoc(outputFileName, PDSaveFull | PDSaveLinearized);
+	MemTrackStage(kMemStageOther);
+	std::chrono::steady_clock::time_point saved = std::chrono::steady_clock::now();
+
+	std::cout << tree.NumNodes() << " layers (" << tree.NumGroups() << " groups, " << tree.NumMemberships()
+		<< " membership dictionaries) written to " << outputFileName << std::endl;
+	if (showTimes)
+	{
+		double labelTime = std::chrono::duration<double>(placed - built).count();
+		std::cout << "    " << (useCache ? "cached" : "uncached") << ": build " << std::chrono::duration<double>(built - start).count()
+			<< " s, labels " << labelTime << " s (" << (labelTime > 0 ? tree.NumNodes() / labelTime : 0.0)
+			<< " labels/s), save " << std::chrono::duration<double>(saved - placed).count() << " s" << std::endl;
+		if (useCache)
+		{
+			std::cout << "    fonts: " << cache->FontMisses() << " created, " << cache->FontHits() << " reused; color spaces: "
+				<< cache->ColorSpaceMisses() << " created, " << cache->ColorSpaceHits() << " reused" << std::endl;
+		}
+	}
+	delete cache;
 }
 
-
 int main(int argc, char** argv)
 {
+    MemTrackStart("CreateNestedLayers");
     APDFLib libInit;
     ASErrorCode errCode = 0;
     if (libInit.isValid() == false)
@@ -114,20 +155,73 @@ int main(int argc, char** argv)
         return libInit.getInitError();
     }
 
-    std::string csOutputFileName ( argc > 1 ? argv[1] : DEF_OUTPUT );
+    int curArg = 1;
+    const char* specFileName = NULL;
+    bool bBench = false;
+    while (argc > curArg)
+    {
+        if (strcmp(argv[curArg], "-spec") == 0)
+        {
+            specFileName = argv[++curArg];
+        }
+        else if (strcmp(argv[curArg], "-bench") == 0)
+        {
+            bBench = true;
+        }
+        else
+            break;
+        ++curArg;
+    }
+
+    std::string csOutputFileName ( argc > curArg ? argv[curArg] : DEF_OUTPUT );
+    int numPages = argc > curArg + 1 ? atoi(argv[curArg + 1]) : 1;
+    if (numPages < 1)
+        numPages = 1;
+
+    if (bBench || specFileName != NULL)
+    {
+DURING
+        if (specFileName != NULL)
+        {
+            LayerTree tree;
+            std::string error;
+            if (!tree.LoadSpec(specFileName, error))
+            {
+                std::cout << error.c_str() << std::endl;
+                E_RETURN(-1);
+            }
+            saveLayerTree(tree, csOutputFileName.c_str(), bBench, true);
+        }
+        else
+        {
+            const int sizes[] = { 1000, 10000, 50000 };
+            for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            {
+                LayerTree tree;
+                tree.MakeSynthetic(sizes[i], 10);
+                std::string benchName = "CreateLayers-bench-" + std::to_string(sizes[i]) + ".pdf";
+                saveLayerTree(tree, benchName.c_str(), true, false);
+                saveLayerTree(tree, benchName.c_str(), true, true);
+            }
+        }
+HANDLER
+        errCode = ERRORCODE;
+        libInit.displayError(errCode);
+END_HANDLER
+        return errCode;
+    }
+
     std::cout << "Creating new document " << csOutputFileName.c_str() <<
-                 " and inserting 2 layers..." << std::endl;
+                 " and inserting 2 layers on " << numPages << " page(s)..." << std::endl;
 
 DURING
 
-// Step 1) Create a pdf document and obtain a reference to it's first page, and its' content
+// Step 1) Create a pdf document. The pages are added in step 4.
 
+    MemTrackStage(kMemStageEdit);
     APDFLDoc doc;
-
-    //Insert a standard 8.5 inch x 11 inch page into the document.
-    doc.insertPage ( ASFloatToFixed ( 8.5 * 72 ), ASFloatToFixed ( 11 * 72 ), PDBeforeFirstPage );
-    PDPage page = doc.getPage(0);
-    PDEContent pageContent = PDPageAcquirePDEContent(page, NULL);
+    //Fonts and color spaces used on the pages; released before doc is closed.
+    ResourceCache resources;
 
 // Step 2) Set up the optional content groups, commonly referred to as layers.
 
@@ -182,17 +276,17 @@ DURING
 
 
 // Step 3) Add text to the page and set what layer they belong to.
-	PDEFont myfont = fontMaker("MyriadPro-Regular", "TrueType", kPDEFontCreateEmbedOpenType);
+	PDEFont myfont = fontMaker("MyriadPro-Regular", "TrueType", kPDEFontCreateEmbedOpenType, &resources);
 	PDEGraphicState darkvioletGS, darkolivegreenGS, saddlebrownGS;
 
 	PDEDefaultGState(&darkvioletGS, sizeof(PDEGraphicState));
-	setGstateRGBFillColor(&darkvioletGS, 0x94, 0x00, 0xd3);
+	setGstateRGBFillColor(&darkvioletGS, 0x94, 0x00, 0xd3, &resources);
 
 	PDEDefaultGState(&darkolivegreenGS, sizeof(PDEGraphicState));
-	setGstateRGBFillColor(&darkolivegreenGS, 0x55, 0x6b, 0x2f); //556b2f
+	setGstateRGBFillColor(&darkolivegreenGS, 0x55, 0x6b, 0x2f, &resources); //556b2f
 
 	PDEDefaultGState(&saddlebrownGS, sizeof(PDEGraphicState));
-	setGstateRGBFillColor(&saddlebrownGS, 0x8b, 0x45, 0x13); //8b4513
+	setGstateRGBFillColor(&saddlebrownGS, 0x8b, 0x45, 0x13, &resources); //8b4513
 
 	PDETextState tState;
 	memset(&tState, 0x0, sizeof(PDETextState));
@@ -245,23 +339,74 @@ DURING
 	PDERelease(reinterpret_cast<PDEObject>(subcontent3));
 	}
 
-    //Add the nested container to the page's content
-    PDEContentAddElem(pageContent, kPDEAfterLast, reinterpret_cast<PDEElement>(container0));                   
-
-    //Set the content back into the page.
-    PDPageSetPDEContentCanRaise(page, NULL);                                                    
+// Step 4) Write the layered content once, as a Form XObject, and draw it on each page.
+
+    //Convert the nested container into a form. Its resources refer to the same layers.
+    PDEContent layerContent = PDEContentCreate();
+    PDEContentAddElem(layerContent, kPDEAfterLast, reinterpret_cast<PDEElement>(container0));
+
+    PDEContentAttrs formAttrs;
+    memset(&formAttrs, 0, sizeof(formAttrs));
+    formAttrs.bbox.left = 0;
+    formAttrs.bbox.bottom = 0;
+    formAttrs.bbox.right = ASFloatToFixed(8.5 * 72);
+    formAttrs.bbox.top = ASFloatToFixed(11 * 72);
+    formAttrs.matrix.a = fixedOne;
+    formAttrs.matrix.d = fixedOne;
+
+    CosObj formObj, formResources;
+    PDEContentToCosObj(layerContent, kPDEContentToForm, &formAttrs, sizeof(formAttrs), PDDocGetCosDoc(doc.pdDoc),
+                       NULL, &formObj, &formResources);
+    PDERelease(reinterpret_cast<PDEObject>(layerContent));
+    PDERelease(reinterpret_cast<PDEObject>(container0));
+
+    PDEGraphicState pageNumberGS;
+    PDEDefaultGState(&pageNumberGS, sizeof(PDEGraphicState));
+    PDETextState pageNumberTS;
+    memset(&pageNumberTS, 0x0, sizeof(PDETextState));
+    pageNumberTS.fontSize = FloatToASFixed(10.0);
+    ASFixedMatrix formMatrix = { fixedOne, 0, 0, fixedOne, 0, 0 };
+
+    //Pages are made and finished one at a time, so only one page's content is in memory at once.
+    for (int pageNum = 0; pageNum < numPages; pageNum++)
+    {
+        //Insert a standard 8.5 inch x 11 inch page at the end of the document.
+        doc.insertPage ( ASFloatToFixed ( 8.5 * 72 ), ASFloatToFixed ( 11 * 72 ), pageNum - 1 );
+        PDPage page = doc.getPage(pageNum);
+        PDEContent pageContent = PDPageAcquirePDEContent(page, NULL);
+
+        //Each page refers to the same form; nothing in it is copied.
+        PDEForm form = PDEFormCreateFromCosObj(&formObj, &formResources, &formMatrix);
+        PDEContentAddElem(pageContent, kPDEAfterLast, reinterpret_cast<PDEElement>(form));
+        PDERelease(reinterpret_cast<PDEObject>(form));
+
+        //The page number is the only content that differs from page to page.
+        std::string pageNumber = "Page " + std::to_string(pageNum + 1) + " of " + std::to_string(numPages);
+        ASDoubleMatrix pageNumberMatrix = { 1, 0, 0, 1, 72, 36 };
+        PDEText pageNumberText = textMakerEx(pageNumber, myfont, &pageNumberMatrix, &pageNumberGS, &pageNumberTS);
+        PDEContentAddElem(pageContent, kPDEAfterLast, reinterpret_cast<PDEElement>(pageNumberText));
+        PDERelease(reinterpret_cast<PDEObject>(pageNumberText));
+
+        //Set the content back into the page, and release it.
+        PDPageSetPDEContentCanRaise(page, NULL);
+        PDPageReleasePDEContent(page, NULL);
+        PDPageRelease(page);
+
+        if ((pageNum + 1) % 10000 == 0)
+            std::cout << "    " << (pageNum + 1) << " pages" << std::endl;
+    }
 
 // Step 5) Save the output document and exit.
 
     //Release objects no longer in use
-    PDPageReleasePDEContent(page, NULL);
-    PDPageRelease(page);
 	PDERelease(reinterpret_cast<PDEObject>(myfont));
+	PDERelease(reinterpret_cast<PDEObject>(pageNumberGS.fillColorSpec.space));
 	PDERelease(reinterpret_cast<PDEObject>(darkvioletGS.fillColorSpec.space));
 	PDERelease(reinterpret_cast<PDEObject>(darkolivegreenGS.fillColorSpec.space));
 	PDERelease(reinterpret_cast<PDEObject>(saddlebrownGS.fillColorSpec.space));
 
 
+    MemTrackStage(kMemStageSave);
     doc.saveDoc ( csOutputFileName.c_str(), PDSaveFull | PDSaveLinearized);
 
 HANDLER
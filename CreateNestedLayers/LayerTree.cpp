@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// A tree of optional content groups, read from a text spec. See LayerTree.h.
+//
+
+#include <stdio.h>
+
+#include <fstream>
+
+#include "ASCalls.h"
+#include "CosCalls.h"
+#include "PDCalls.h"
+
+#include "LayerTree.h"
+
+LayerTree::LayerTree()
+{
+}
+
+int LayerTree::AddNode(int parent, const std::string& name)
+{
+	Node node;
+	node.name = name;
+	node.parent = parent;
+	node.depth = (parent < 0) ? 0 : nodes[parent].depth + 1;
+	node.ocmd = NULL;
+
+	std::map<std::string, int>::const_iterator known = groupIndex.find(name);
+	if (known != groupIndex.end())
+		node.group = known->second;
+	else
+	{
+		node.group = static_cast<int>(groupNames.size());
+		groupIndex[name] = node.group;
+		groupNames.push_back(name);
+	}
+
+	int index = static_cast<int>(nodes.size());
+	nodes.push_back(node);
+	if (parent < 0)
+		roots.push_back(index);
+	else
+		nodes[parent].children.push_back(index);
+	return index;
+}
+
+bool LayerTree::LoadSpec(const char* path, std::string& error)
+{
+	std::ifstream spec(path);
+	if (!spec.is_open())
+	{
+		error = std::string("Unable to open layer spec ") + path;
+		return false;
+	}
+
+	// The open nodes above the current line, with their indentation.
+	std::vector<std::pair<int, int> > open;
+	std::string line;
+	int lineNum = 0;
+	while (std::getline(spec, line))
+	{
+		++lineNum;
+		size_t end = line.find_last_not_of(" \t\r");
+		if (end == std::string::npos)
+			continue;
+		line.erase(end + 1);
+
+		int indent = 0;
+		size_t start = 0;
+		while (start < line.size() && (line[start] == ' ' || line[start] == '\t'))
+		{
+			indent += (line[start] == '\t') ? 4 : 1;
+			++start;
+		}
+		if (line[start] == '#')
+			continue;
+
+		while (!open.empty() && open.back().first >= indent)
+			open.pop_back();
+
+		int parent = open.empty() ? -1 : open.back().second;
+		open.push_back(std::make_pair(indent, AddNode(parent, line.substr(start))));
+	}
+
+	if (nodes.empty())
+	{
+		error = std::string("No layers in ") + path;
+		return false;
+	}
+	return true;
+}
+
+void LayerTree::MakeSynthetic(int numLayers, int fanout)
+{
+	char name[32];
+	for (int i = 0; i < numLayers; i++)
+	{
+		sprintf(name, "Layer %d", i + 1);
+		AddNode(i == 0 ? -1 : (i - 1) / fanout, name);
+	}
+}
+
+// One array of the order being built, and how far it has been filled.
+struct OrderLevel
+{
+	OrderLevel(CosDoc cosDoc, const std::vector<LayerTree::Node>& nodes, const std::vector<int>& kids)
+		: siblings(&kids), pos(0), next(0)
+	{
+		ASInt32 numElems = 0;
+		for (size_t i = 0; i < kids.size(); i++)
+			numElems += nodes[kids[i]].children.empty() ? 1 : 2;
+		order = CosNewArray(cosDoc, false, numElems);
+	}
+
+	const std::vector<int>* siblings;
+	CosObj order;
+	ASInt32 pos;                    // Where the next element goes in order.
+	size_t next;                    // The next sibling to add.
+};
+
+// Build the order array for a list of sibling nodes. Each node with children is followed
+// by a nested array holding the order of its children. The array is sized once and filled
+// in place, rather than grown an element at a time.
+//
+// The tree is walked with a stack of its own rather than by recursion, since a spec can
+// nest deeper than the thread's stack would allow.
+CosObj LayerTree::BuildOrder(CosDoc cosDoc, const std::vector<int>& siblings)
+{
+	std::vector<OrderLevel> levels;
+	levels.push_back(OrderLevel(cosDoc, nodes, siblings));
+	for (;;)
+	{
+		OrderLevel& level = levels.back();
+		if (level.next == level.siblings->size())
+		{
+			CosObj done = level.order;
+			levels.pop_back();
+			if (levels.empty())
+				return done;
+
+			// The parent's node was the last thing put in its array, so this goes after it.
+			OrderLevel& parent = levels.back();
+			CosArrayPut(parent.order, parent.pos++, done);
+			continue;
+		}
+
+		const Node& node = nodes[(*level.siblings)[level.next++]];
+		CosArrayPut(level.order, level.pos++, PDOCGGetCosObj(groups[node.group]));
+		if (!node.children.empty())
+			levels.push_back(OrderLevel(cosDoc, nodes, node.children));
+	}
+}
+
+// The membership of a node of group under a node with parentMembership (-1 at the top level),
+// made from the parent's expression and the group alone, so that it costs the same at any depth.
+int LayerTree::MembershipFor(PDDoc pdDoc, int parentMembership, int group)
+{
+	std::pair<int, int> key(parentMembership, group);
+	std::map<std::pair<int, int>, int>::const_iterator known = membershipIndex.find(key);
+	if (known != membershipIndex.end())
+		return known->second;
+
+	// The group array passed to PDOCMDCreate is NULL terminated.
+	PDOCG ocgs[2] = { groups[group], static_cast<PDOCG>(NULL) };
+	Membership membership;
+	membership.ocmd = PDOCMDCreate(pdDoc, ocgs, kOCMDVisibility_AllOn);
+	membership.expression = PDOCGGetCosObj(groups[group]);
+	if (parentMembership >= 0)
+	{
+		CosDoc cosDoc = PDDocGetCosDoc(pdDoc);
+		CosObj expression = CosNewArray(cosDoc, true, 3);
+		CosArrayPut(expression, 0, CosNewName(cosDoc, false, ASAtomFromString("And")));
+		CosArrayPut(expression, 1, memberships[parentMembership].expression);
+		CosArrayPut(expression, 2, membership.expression);
+		CosDictPut(PDOCMDGetCosObj(membership.ocmd), ASAtomFromString("VE"), expression);
+		membership.expression = expression;
+	}
+
+	memberships.push_back(membership);
+	membershipIndex[key] = static_cast<int>(memberships.size()) - 1;
+	return membershipIndex[key];
+}
+
+void LayerTree::Build(PDDoc pdDoc)
+{
+	// Anything from an earlier Build() belongs to another document.
+	memberships.clear();
+	membershipIndex.clear();
+
+	// One group per distinct name.
+	groups.resize(groupNames.size());
+	for (size_t i = 0; i < groupNames.size(); i++)
+	{
+		ASText name = ASTextFromUnicode(reinterpret_cast<const ASUTF16Val*>(groupNames[i].c_str()), kUTF8);
+		groups[i] = PDOCGCreate(pdDoc, name);
+		ASTextDestroy(name);
+	}
+
+	// Append the whole tree to the existing order, if there is one, in one step.
+	PDOCConfig ocConfig = PDDocGetOCConfig(pdDoc);
+	CosDoc cosDoc = PDDocGetCosDoc(pdDoc);
+	CosObj treeOrder = BuildOrder(cosDoc, roots);
+
+	CosObj order;
+	PDOCConfigGetOCGOrder(ocConfig, &order);
+	if (CosObjGetType(order) != CosArray || CosArrayLength(order) == 0)
+	{
+		order = treeOrder;
+	}
+	else
+	{
+		ASInt32 insertPos = CosArrayLength(order);
+		ASInt32 numNew = CosArrayLength(treeOrder);
+		for (ASInt32 i = 0; i < numNew; i++)
+			CosArrayPut(order, insertPos + i, CosArrayGet(treeOrder, i));
+	}
+	PDOCConfigSetOCGOrder(ocConfig, order);
+
+	// A parent always comes before its children, so its membership is made first.
+	std::vector<int> nodeMembership(nodes.size(), -1);
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		int parent = nodes[i].parent;
+		nodeMembership[i] = MembershipFor(pdDoc, parent >= 0 ? nodeMembership[parent] : -1, nodes[i].group);
+		nodes[i].ocmd = memberships[nodeMembership[i]].ocmd;
+	}
+}
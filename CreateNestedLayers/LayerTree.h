@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// A tree of optional content groups (layers), read from a text spec and added to a document
+// in one pass.
+//
+// The spec has one layer name per line. Indentation gives the nesting: a line indented more
+// than the line above it is a child of that line. Blank lines and lines starting with '#'
+// are ignored. A name used more than once refers to the same group, so, for example, a
+// "Dimensions" layer can appear under each of several drawings and be turned on and off
+// everywhere at once.
+//
+//    Site
+//        Building A
+//            Walls
+//            Dimensions
+//        Building B
+//            Walls
+//            Dimensions
+//
+// Each node of the tree gets a membership dictionary that is on only when the node and all
+// of its ancestors are on. Its visibility expression is its parent's, held by reference, and
+// its own group, so each level adds one entry however deep the tree is. Nodes with the same
+// groups on their path share one dictionary. (Readers that do not know visibility expressions
+// see only the node's own group.)
+//
+
+#ifndef LAYERTREE_H
+#define LAYERTREE_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CosCalls.h"
+#include "PDCalls.h"
+
+class LayerTree
+{
+public:
+	struct Node
+	{
+		std::string name;
+		int parent;                 // Index of the parent node, -1 at the top level.
+		int depth;
+		int group;                  // Index into the groups of the tree.
+		std::vector<int> children;
+		PDOCMD ocmd;                // Set by Build().
+	};
+
+	LayerTree();
+
+	// Read a spec file as described above. Returns false, with a message in error, if it can't.
+	bool LoadSpec(const char* path, std::string& error);
+	// Make a balanced tree of numLayers nodes, each with up to fanout children, for benchmarking.
+	void MakeSynthetic(int numLayers, int fanout);
+
+	// Create the groups and membership dictionaries in pdDoc and append the tree to the
+	// document's layer order.
+	void Build(PDDoc pdDoc);
+
+	int NumNodes() const { return static_cast<int>(nodes.size()); }
+	const Node& GetNode(int index) const { return nodes[index]; }
+	int NumGroups() const { return static_cast<int>(groupNames.size()); }
+	int NumMemberships() const { return static_cast<int>(memberships.size()); }
+
+private:
+	struct Membership
+	{
+		PDOCMD ocmd;
+		CosObj expression;          // The group itself at the top level, else [/And <parent's> <group>].
+	};
+
+	int AddNode(int parent, const std::string& name);
+	CosObj BuildOrder(CosDoc cosDoc, const std::vector<int>& siblings);
+	int MembershipFor(PDDoc pdDoc, int parentMembership, int group);
+
+	std::vector<Node> nodes;
+	std::vector<int> roots;
+	std::vector<std::string> groupNames;
+	std::map<std::string, int> groupIndex;
+	std::vector<PDOCG> groups;                          // Set by Build().
+	std::vector<Membership> memberships;                // Set by Build().
+	std::map<std::pair<int, int>, int> membershipIndex; // Keyed by the parent's membership (or -1) and the group.
+};
+
+#endif // LAYERTREE_H
@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Fonts and color spaces shared by all of the content generated for one document. See
+// ResourceCache.h.
+//
+
+#include <string.h>
+
+#include "ASCalls.h"
+#include "PSFCalls.h"
+#include "PERCalls.h"
+#include "PEWCalls.h"
+
+#include "ResourceCache.h"
+
+ResourceCache::ResourceCache() : fontHits(0), colorSpaceHits(0)
+{
+}
+
+ResourceCache::~ResourceCache()
+{
+	for (std::map<FontKey, PDEFont>::iterator it = fonts.begin(); it != fonts.end(); ++it)
+		PDERelease(reinterpret_cast<PDEObject>(it->second));
+	for (std::map<std::string, PDEColorSpace>::iterator it = colorSpaces.begin(); it != colorSpaces.end(); ++it)
+		PDERelease(reinterpret_cast<PDEObject>(it->second));
+}
+
+PDEFont ResourceCache::GetFont(const char* fontName, const char* fontType, PDEFontCreateFlags flags)
+{
+	FontKey key;
+	key.name = fontName;
+	key.type = fontType;
+	key.flags = flags;
+
+	PDEFont font;
+	std::map<FontKey, PDEFont>::const_iterator known = fonts.find(key);
+	if (known != fonts.end())
+	{
+		font = known->second;
+		++fontHits;
+	}
+	else
+	{
+		PDEFontAttrs fontAttrs;
+		memset(&fontAttrs, 0, sizeof(fontAttrs));
+		fontAttrs.name = ASAtomFromString(fontName);
+		fontAttrs.type = ASAtomFromString(fontType);
+
+		PDSysFont sysFont = PDFindSysFont(&fontAttrs, sizeof(fontAttrs), 0);
+		font = PDEFontCreateFromSysFont(sysFont, flags);
+		fonts[key] = font;
+	}
+
+	PDEAcquire(reinterpret_cast<PDEObject>(font));
+	return font;
+}
+
+PDEColorSpace ResourceCache::GetColorSpace(const char* name)
+{
+	PDEColorSpace space;
+	std::map<std::string, PDEColorSpace>::const_iterator known = colorSpaces.find(name);
+	if (known != colorSpaces.end())
+	{
+		space = known->second;
+		++colorSpaceHits;
+	}
+	else
+	{
+		space = PDEColorSpaceCreateFromName(ASAtomFromString(name));
+		colorSpaces[name] = space;
+	}
+
+	PDEAcquire(reinterpret_cast<PDEObject>(space));
+	return space;
+}
+
+void ResourceCache::SetRGBFillColor(PDEGraphicState* gState, unsigned char red, unsigned char green, unsigned char blue)
+{
+	PDERelease(reinterpret_cast<PDEObject>(gState->fillColorSpec.space));
+	gState->fillColorSpec.space = GetColorSpace("DeviceRGB");
+
+	gState->fillColorSpec.value.color[0] = ASFloatToFixed(red * 1.0f / 255.0f);
+	gState->fillColorSpec.value.color[1] = ASFloatToFixed(green * 1.0f / 255.0f);
+	gState->fillColorSpec.value.color[2] = ASFloatToFixed(blue * 1.0f / 255.0f);
+}
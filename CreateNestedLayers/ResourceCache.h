@@ -0,0 +1,68 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Fonts and color spaces shared by all of the content generated for one document.
+//
+// Finding a system font and creating a PDEFont from it is expensive, and every PDEFont
+// created is a separate font resource in the output, embedded again. Each color space
+// created by name is likewise a separate object. ResourceCache creates each font (by name,
+// type and flags) and each color space (by name) once, and hands out the same object on
+// every later request, so every page and layer refers to a single resource.
+//
+// Objects handed out are acquired for the caller, who releases them as usual. The cache
+// keeps its own reference until it is destroyed, which must happen before the document
+// is closed.
+//
+
+#ifndef RESOURCECACHE_H
+#define RESOURCECACHE_H
+
+#include <map>
+#include <string>
+
+#include "PagePDECntCalls.h"
+
+class ResourceCache
+{
+public:
+	ResourceCache();
+	~ResourceCache();
+
+	PDEFont GetFont(const char* fontName, const char* fontType, PDEFontCreateFlags flags);
+	PDEColorSpace GetColorSpace(const char* name);
+
+	// Set the fill color of gState to an RGB value, using the cached DeviceRGB color space.
+	void SetRGBFillColor(PDEGraphicState* gState, unsigned char red, unsigned char green, unsigned char blue);
+
+	int FontHits() const { return fontHits; }
+	int FontMisses() const { return static_cast<int>(fonts.size()); }
+	int ColorSpaceHits() const { return colorSpaceHits; }
+	int ColorSpaceMisses() const { return static_cast<int>(colorSpaces.size()); }
+
+private:
+	struct FontKey
+	{
+		std::string name;
+		std::string type;
+		PDEFontCreateFlags flags;
+
+		bool operator<(const FontKey& other) const
+		{
+			if (name != other.name)
+				return name < other.name;
+			if (type != other.type)
+				return type < other.type;
+			return flags < other.flags;
+		}
+	};
+
+	std::map<FontKey, PDEFont> fonts;
+	std::map<std::string, PDEColorSpace> colorSpaces;
+	int fontHits, colorSpaceHits;
+
+	// Not copyable; the cache owns a reference to each object.
+	ResourceCache(const ResourceCache&);
+	ResourceCache& operator=(const ResourceCache&);
+};
+
+#endif // RESOURCECACHE_H
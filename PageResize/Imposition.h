@@ -0,0 +1,32 @@
+//
+// Copyright (c) 2018-2024, Datalogics, Inc. All rights reserved.
+//
+// Resizing the pages of a document: each page is replaced by one of the new size, with the
+// old page's content scaled to fit and centered on it, as a Form XObject. Used by PageResize,
+// and by the Pipeline sample to resize a document it already has open.
+//
+
+#ifndef IMPOSITION_H
+#define IMPOSITION_H
+
+#include "PDCalls.h"
+
+/**
+@param fOldMediaBox The input rect
+@param dim1 one of the output dimensions
+@param dim2 the other output dimensions
+@param fNewRect the output rectangle to be filled with dimensions aligned to the input rect
+*/
+void sizeNewPage(ASFixedRect* fOldMediaBox, ASFixed dim1, ASFixed dim2, ASFixedRect* fNewRect);
+
+/**
+@param fOldMediaBox the original page size
+@param fNewMediaBox the new page size
+@param fMatrix the output matrix for scaling the old to the new and centering the content, to be filled.
+*/
+void calcScalingMatrix(ASFixedRect* fOldMediaBox, ASFixedRect* fNewMediaBox, ASDoubleMatrix* matrix);
+
+// Replace every page of doc with one dim1 by dim2 points, in the orientation of the original.
+void doImposition(PDDoc doc, ASFixed dim1, ASFixed dim2);
+
+#endif // IMPOSITION_H
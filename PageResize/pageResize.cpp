@@ -3,7 +3,17 @@
 //
 // This sample demonstrates how to resize a page.
 //
-//  Command-line:   <input-file>  <output-file>     (Both optional)
+//  Command-line:   [-permcache <store>]  <input-file>  <output-file>     (All optional)
+//
+//  -permcache refuses documents whose permissions do not allow pages to be modified, using
+//  (and adding to) the permission matrices stored in that file. See PermCheck/PermMatrix.h.
+//
+//  -prefork <n> <jobfile>, given first, runs each line of <jobfile> as the arguments of a
+//  run of the sample, in n processes forked from this one once the library is initialized.
+//  See Shared/PreforkPool.h.
+//
+//  With the DL_MEMTRACK environment variable set, the memory allocated while opening, resizing
+//  and saving is counted, and reported at exit. See Shared/MemTrack.h.
 
 
 #include "InitializeLibrary.h"
@@ -17,153 +27,63 @@
 #include "PEWCalls.h"
 #include "PagePDECntCalls.h"
 #include "PSFCalls.h"
+#include "Imposition.h"
+#include "PermMatrix.h"
+#include "MemTrack.h"
+#include "PreforkPool.h"
 #include <iostream>
 
 #define INPUT_LOC "../../../../Resources/Sample_Input/"
 #define DEF_INPUT "ducky.pdf"
 #define DEF_OUTPUT "pageResize-out.pdf"
 
-/**
-@param fOldMediaBox The input rect
-@param dim1 one of the output dimensions
-@param dim2 the other output dimensions
-@param fNewRect the output rectangle to be filled with dimensions aligned to the input rect
-*/
-void sizeNewPage(ASFixedRect* fOldMediaBox, ASFixed dim1, ASFixed dim2, ASFixedRect* fNewRect)
+// One run of the sample, on its own command line or as a -prefork job.
+static int resizeDocument(APDFLib& lib, int argc, char** argv)
 {
-	ASFixed biggerDim = dim1 > dim2 ? dim1 : dim2;
-	ASFixed smallerDim = dim1 > dim2 ? dim2 : dim1;
-	if ((fOldMediaBox->top - fOldMediaBox->bottom) > (fOldMediaBox->right - fOldMediaBox->left))
-	{
-		fNewRect->right = smallerDim;
-		fNewRect->top = biggerDim;
-	}
-	else
-	{
-		fNewRect->right = biggerDim;
-		fNewRect->top = smallerDim;
-	}
-	fNewRect->left = fNewRect->bottom = fixedZero;
-}
-
-/**
-@param fOldMediaBox the original page size
-@param fNewMediaBox the new page size
-@param fMatrix the output matrix for scaling the old to the new and centering the content, to be filled.
-*/
-void calcScalingMatrix(ASFixedRect* fOldMediaBox, ASFixedRect* fNewMediaBox, ASDoubleMatrix* matrix)
-{
-	ASFixed fOldWidth = fOldMediaBox->right - fOldMediaBox->left;
-	ASFixed fNewWidth = fNewMediaBox->right - fNewMediaBox->left;
-	ASFixed fOldHeight = fOldMediaBox->top - fOldMediaBox->bottom;
-	ASFixed fNewHeight = fNewMediaBox->top - fNewMediaBox->bottom;
-	double widthScaling = ASFixedToFloat(fNewWidth) / ASFixedToFloat(fOldWidth);
-	double heightScaling = ASFixedToFloat(fNewHeight) / ASFixedToFloat(fOldHeight);
-	double ScalingFactor = min(widthScaling, heightScaling);
-
-	// if we need to scale up by less than 10%, then keep the scale as is.
-	if (ScalingFactor > 1.0 && ((1.0 - ScalingFactor) < 0.10))
-		ScalingFactor = 1.0;
-
-	double scaledWidth = ScalingFactor * ASFixedToFloat(fOldWidth);
-	double scaledHeight = ScalingFactor * ASFixedToFloat(fOldHeight);
-
-	double leftOffset = ASFixedToFloat(fNewMediaBox->left) + (0.5 * (ASFixedToFloat(fNewWidth) - scaledWidth));
-	double bottomOffset = ASFixedToFloat(fNewMediaBox->bottom) + (0.5 * (ASFixedToFloat(fNewHeight) - scaledHeight));
-
-	matrix->a = matrix->d = ScalingFactor;
-	matrix->b = matrix->c = 0.0;
-	matrix->h = leftOffset;
-	matrix->v = bottomOffset;
-}
+	ASErrorCode errCode = 0;
 
-void doImposition(PDDoc doc, ASFixed dim1, ASFixed dim2)
-{
-	int originalPages = PDDocGetNumPages(doc);
-	for (int currentpage = 0; currentpage < originalPages; currentpage++)
+	int curArg = 1;
+	PermCache* permCache = NULL;
+	if (argc > curArg + 1 && strcmp(argv[curArg], "-permcache") == 0)
 	{
-		PDPage pdPage = PDDocAcquirePage(doc, currentpage);
-		PDEContent pdeContent = PDPageAcquirePDEContent(pdPage, 0);
-		ASFixedRect origRect, newRect, fOldBBoxRect;
-		ASDoubleMatrix matrix;
-		CosObj cosContent, cosRes;
-
-		PDPageGetCropBox(pdPage, &fOldBBoxRect);
-
-		PDEContentAttrs ContentAttrs;
-		memset(&ContentAttrs, 0, sizeof(ContentAttrs));
-		ContentAttrs.flags = kPDEContentToForm;
-		ContentAttrs.formType = 1;
-		ContentAttrs.bbox = fOldBBoxRect;
-
-		PDEFilterArray filter;
-		filter.numFilters = 1;
-		filter.spec[0].decodeParms = CosNewNull();
-		filter.spec[0].encodeParms = CosNewNull();
-		filter.spec[0].name = ASAtomFromString("FlateDecode");
-		filter.spec[0].padding = 0;
-
-		PDEContentToCosObj(pdeContent, kPDEContentToForm | kPDEContentFormFromPage | kPDEContentUseMaxPrecision, &ContentAttrs, sizeof(ContentAttrs), PDDocGetCosDoc(doc), &filter, &cosContent, &cosRes);
-
-		PDPageGetMediaBox(pdPage, &origRect);
-		sizeNewPage(&origRect, dim1, dim2, &newRect);
-		calcScalingMatrix(&origRect, &newRect, &matrix);
-
-		// Note: this will break any logical structure/tagging the source page may have had.
-		PDEForm newForm = PDEFormCreateFromCosObjEx(&cosContent, &cosRes, &matrix);
-
-		PDPage newPage = PDDocCreatePage(doc, originalPages + currentpage - 1, newRect);
-		PDPageSetRotate(newPage, PDPageGetRotate(pdPage));
-
-		PDEContent newContent = PDPageAcquirePDEContent(newPage, 0);
-		PDEContentAddElem(newContent, kPDEBeforeFirst, (PDEElement)newForm);
-		PDERelease((PDEObject)newForm);
-
-		PDPageSetPDEContent(newPage, 0);
-		PDPageNotifyContentsDidChange(newPage);
-		PDPageReleasePDEContent(newPage, 0);
-		PDPageRelease(newPage);
-
-		PDPageReleasePDEContent(pdPage, NULL);
-		PDPageRelease(pdPage);
-		pdPage = NULL;
-
+		permCache = new PermCache(argv[curArg + 1]);
+		curArg += 2;
 	}
-	// Note: Bookmarks and Link Annotations may not be pointing to the right pages.
-	PDDocDeletePages(doc, 0, originalPages - 1, NULL, NULL);
-}
-
-
 
+	std::string csInputFileName(argc > curArg ? argv[curArg] : INPUT_LOC DEF_INPUT);
+	std::string csOutputFileName(argc > curArg + 1 ? argv[curArg + 1] : DEF_OUTPUT);
+	std::cout << "Will modify " << csInputFileName.c_str()
+		<< " and save as " << csOutputFileName.c_str() << std::endl;
 
-int main(int argc, char** argv)
-{
-	APDFLib lib;
-	ASErrorCode errCode = 0;
-	if (lib.isValid() == false)
+	// A document already known to forbid this can be skipped without opening it.
+	if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), NULL, PDPermReqObjPage, PDPermReqOprModify) == kPermDenied)
 	{
-		errCode = lib.getInitError();
-		std::cout << "Initialization failed with code " << errCode << std::endl;
+		errCode = pdErrOpNotPermitted;
+		lib.displayError(errCode);
+		delete permCache;
 		return errCode;
 	}
 
-	std::string csInputFileName(argc > 1 ? argv[1] : INPUT_LOC DEF_INPUT);
-	std::string csOutputFileName(argc > 2 ? argv[2] : DEF_OUTPUT);
-	std::cout << "Will modify " << csInputFileName.c_str()
-		<< " and save as " << csOutputFileName.c_str() << std::endl;
-
 	DURING
 
 	// Open the Document
+	MemTrackStage(kMemStageOpen);
 	ASPathName asPathName = ASFileSysCreatePathFromDIPath(NULL, csInputFileName.c_str(), NULL);
 	PDDoc pdDoc = PDDocOpen(asPathName, NULL, NULL, true);
 	ASFileSysReleasePath(NULL, asPathName);
+	if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), pdDoc, PDPermReqObjPage, PDPermReqOprModify) == kPermDenied)
+	{
+		PDDocClose(pdDoc);
+		ASRaise(pdErrOpNotPermitted);
+	}
 
 	// Resizing operation
+	MemTrackStage(kMemStageEdit);
 	doImposition(pdDoc, fixedOne * 306, fixedOne * 396);
 
 
 	// Save and exit
+	MemTrackStage(kMemStageSave);
 	asPathName = ASFileSysCreatePathFromDIPath(NULL, csOutputFileName.c_str(), NULL);
 	PDDocSave(pdDoc, PDSaveFull, asPathName, NULL, NULL, NULL);
 	ASFileSysReleasePath(NULL, asPathName);
@@ -174,5 +94,20 @@ int main(int argc, char** argv)
 	lib.displayError(errCode);
 	END_HANDLER
 
+		delete permCache;
 		return errCode;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv)
+{
+	MemTrackStart("PageResize");
+	APDFLib lib;
+	if (lib.isValid() == false)
+	{
+		ASErrorCode errCode = lib.getInitError();
+		std::cout << "Initialization failed with code " << errCode << std::endl;
+		return errCode;
+	}
+
+	return RunSampleJobs(argc, argv, [&lib](int jobArgc, char** jobArgv) { return resizeDocument(lib, jobArgc, jobArgv); });
+}
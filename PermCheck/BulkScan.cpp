@@ -0,0 +1,360 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Bulk permission scanning for the PermCheck sample. See BulkScan.h for the record format.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CosCalls.h"
+#include "ASCalls.h"
+#include "PDCalls.h"
+#include "InitializeLibrary.h"
+#include "APDFLDoc.h"
+
+#include "BulkScan.h"
+#include "EncryptScan.h"
+#include "MemTrack.h"
+
+// Hands out the paths to check, one at a time, to the worker threads. Paths are produced
+// lazily so that a tree with millions of files does not have to be listed up front.
+class PathSource
+{
+private:
+	std::mutex lock;
+	std::ifstream list;
+	std::vector<std::filesystem::directory_iterator> dirs;   // The directories being walked, innermost last.
+	long long numWalkErrors;
+	std::string extension;
+	std::string singleFile;
+	bool fromList;
+
+	bool MatchesExtension(const std::filesystem::path& path) const
+	{
+		if (extension.empty())
+			return true;
+		std::string ext = path.extension().string();
+		if (ext.size() != extension.size())
+			return false;
+		for (size_t i = 0; i < ext.size(); i++)
+		{
+			if (tolower(static_cast<unsigned char>(ext[i])) != tolower(static_cast<unsigned char>(extension[i])))
+				return false;
+		}
+		return true;
+	}
+
+	// A directory that can't be read is reported and left out, rather than ending the walk.
+	void OpenDirectory(const std::filesystem::path& dir)
+	{
+		std::error_code err;
+		std::filesystem::directory_iterator it(dir, std::filesystem::directory_options::skip_permission_denied, err);
+		if (err)
+			WalkError(dir, err);
+		else
+			dirs.push_back(std::move(it));
+	}
+
+	void WalkError(const std::filesystem::path& dir, const std::error_code& err)
+	{
+		std::cerr << "Unable to read directory " << dir.string() << ": " << err.message() << std::endl;
+		++numWalkErrors;
+	}
+
+public:
+	PathSource(const BulkScanOptions& options) : extension(options.extension), numWalkErrors(0), fromList(false)
+	{
+		std::error_code err;
+		if (!options.listFile.empty())
+		{
+			list.open(options.listFile.c_str());
+			fromList = true;
+		}
+		else if (std::filesystem::is_directory(options.root, err))
+		{
+			OpenDirectory(options.root);
+		}
+		else
+		{
+			singleFile = options.root;
+		}
+	}
+
+	bool IsValid() const
+	{
+		return fromList ? list.is_open() : true;
+	}
+
+	// The number of directories that could not be read. Only complete once Next returns false.
+	long long WalkErrors() const
+	{
+		return numWalkErrors;
+	}
+
+	bool Next(std::string& path)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (fromList)
+		{
+			while (std::getline(list, path))
+			{
+				if (!path.empty() && path[path.size() - 1] == '\r')
+					path.erase(path.size() - 1);
+				if (!path.empty())
+					return true;
+			}
+			return false;
+		}
+
+		if (!singleFile.empty())
+		{
+			path.swap(singleFile);
+			singleFile.clear();
+			return true;
+		}
+
+		std::error_code err;
+		while (!dirs.empty())
+		{
+			if (dirs.back() == std::filesystem::directory_iterator())
+			{
+				dirs.pop_back();
+				continue;
+			}
+
+			// Step past the entry before looking at it, as opening a subdirectory
+			// adds to dirs.
+			std::filesystem::directory_entry entry = *dirs.back();
+			dirs.back().increment(err);
+			if (err)
+			{
+				// Whatever is left of this directory can't be listed; carry on with its parent.
+				WalkError(entry.path().parent_path(), err);
+				dirs.pop_back();
+			}
+
+			// Symbolic links to directories are not followed, which keeps the walk from looping.
+			if (!entry.is_symlink(err) && entry.is_directory(err))
+			{
+				OpenDirectory(entry.path());
+				continue;
+			}
+			if (entry.is_regular_file(err) && MatchesExtension(entry.path()))
+			{
+				path = entry.path().string();
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+struct BulkScanState
+{
+	PathSource* source;
+	PermCache* cache;           // NULL if not caching.
+	FILE* out;                  // NULL to discard the records.
+	bool fastTriage;
+	std::mutex outLock;
+	std::atomic<long long> numChecked{ 0 };
+	std::atomic<long long> numErrors{ 0 };
+	std::atomic<long long> numEncrypted{ 0 };
+	std::atomic<long long> numTriaged{ 0 };     // Answered without opening the document.
+	std::atomic<int> numFailedWorkers{ 0 };     // Counted in numErrors too.
+};
+
+static void writeRecord(BulkScanState* state, const char* record)
+{
+	if (state->out == NULL)
+		return;
+	std::lock_guard<std::mutex> guard(state->outLock);
+	fputs(record, state->out);
+}
+
+static void scanWorker(BulkScanState* state)
+{
+	// Each thread needs its own initialization of the library.
+	APDFLib libInit;
+	if (libInit.isValid() == false)
+	{
+		std::cerr << "Worker initialization failed with code " << libInit.getInitError() << std::endl;
+		++state->numFailedWorkers;
+		++state->numErrors;
+		return;
+	}
+
+	std::string path;
+	std::vector<char> record(1024);
+	while (state->source->Next(path))
+	{
+		if (record.size() < path.size() + 512)
+			record.resize(path.size() + 512);
+
+		if (state->fastTriage)
+		{
+			EncryptInfo info;
+			TriageResult triage = TriageEncryption(path.c_str(), info);
+			if (triage != kTriageNeedsFullOpen)
+			{
+				if (triage == kTriageEncrypted)
+				{
+					snprintf(&record[0], record.size(), "OK\t%d\t%08x\t-\t%s\n", info.R, static_cast<ASUns32>(info.P), path.c_str());
+					++state->numEncrypted;
+				}
+				else
+					snprintf(&record[0], record.size(), "OK\t0\tffffffff\t-\t%s\n", path.c_str());
+				writeRecord(state, &record[0]);
+				++state->numTriaged;
+				++state->numChecked;
+				continue;
+			}
+		}
+
+		PermMatrix perms;
+		PermCache::FileIdentity id;
+		ASErrorCode errCode = 0;
+
+		if (state->cache != NULL)
+			state->cache->Identify(path.c_str(), id);
+		if (state->cache == NULL || !state->cache->Lookup(id, perms))
+		{
+			DURING
+				MemTrackStage(kMemStageOpen);
+				APDFLDoc APDoc(path.c_str(), true);
+				PDDoc pddoc = APDoc.getPDDoc();
+				if (pddoc == NULL)
+					ASRaise(genErrBadParm);
+				MemTrackStage(kMemStageOther);
+				perms.Evaluate(pddoc);
+			HANDLER
+				errCode = ERRORCODE;
+			END_HANDLER
+
+			if (errCode == 0 && state->cache != NULL)
+				state->cache->Store(path.c_str(), id, perms);
+		}
+
+		if (errCode == 0)
+		{
+			snprintf(&record[0], record.size(), "OK\t%d\t%08x\t%s\t%s\n", perms.revision, perms.perms,
+				perms.MatrixHex().c_str(), path.c_str());
+			if (perms.revision != 0)
+				++state->numEncrypted;
+		}
+		else
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			// Keep the record on one line whatever the message says.
+			for (char* c = buf; *c; c++)
+			{
+				if (*c == '\t' || *c == '\n' || *c == '\r')
+					*c = ' ';
+			}
+			snprintf(&record[0], record.size(), "ERR\t0x%08x\t%s\t%s\n", errCode, buf, path.c_str());
+			++state->numErrors;
+		}
+		writeRecord(state, &record[0]);
+		++state->numChecked;
+	}
+}
+
+// One pass over the input. Returns the number of files that could not be checked, and
+// of threads that could not start, or -1 if the input can't be read.
+static long long runPass(const BulkScanOptions& options, PermCache* cache, FILE* out, bool fastTriage)
+{
+	PathSource source(options);
+	if (!source.IsValid())
+	{
+		std::cerr << "Unable to read file list " << options.listFile.c_str() << std::endl;
+		return -1;
+	}
+
+	BulkScanState state;
+	state.source = &source;
+	state.cache = cache;
+	state.out = out;
+	state.fastTriage = fastTriage;
+
+	int numThreads = options.numThreads;
+	if (numThreads <= 0)
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(scanWorker, &state));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	long long numChecked = state.numChecked;
+	long long numErrors = state.numErrors + source.WalkErrors();
+	std::cerr << (fastTriage ? "[fast] " : "[full] ") << "Checked " << numChecked << " files ("
+		<< state.numEncrypted << " encrypted, " << numErrors << " errors";
+	if (fastTriage)
+		std::cerr << ", " << state.numTriaged << " without opening";
+	if (cache != NULL)
+		std::cerr << ", " << cache->Hits() << " from cache";
+	if (state.numFailedWorkers > 0)
+		std::cerr << ", " << state.numFailedWorkers << " threads failed to start";
+	std::cerr << ") in " << elapsed << " s with " << numThreads << " threads: "
+		<< (elapsed > 0 ? numChecked / elapsed : 0.0) << " files/s." << std::endl;
+
+	return numErrors;
+}
+
+int RunBulkScan(const BulkScanOptions& options)
+{
+	FILE* out = stdout;
+	if (!options.outFile.empty())
+	{
+		out = fopen(options.outFile.c_str(), "w");
+		if (out == NULL)
+		{
+			std::cerr << "Unable to create " << options.outFile.c_str() << std::endl;
+			return 1;
+		}
+	}
+
+	PermCache* cache = NULL;
+	if (!options.cacheFile.empty())
+		cache = new PermCache(options.cacheFile.c_str());
+
+	long long numErrors = 0;
+	if (options.benchmark)
+	{
+		// The fast pass goes first, so that the full pass is the one that gets
+		// any benefit from the file cache. Only the fast pass records are kept.
+		// The permission cache would hide the cost being measured, so it is not used.
+		numErrors = runPass(options, NULL, out, true);
+		if (numErrors >= 0)
+			runPass(options, NULL, NULL, false);
+	}
+	else
+		numErrors = runPass(options, cache, out, options.fastTriage);
+
+	delete cache;
+
+	if (out != stdout)
+		fclose(out);
+
+	// The count itself was reported above; as an exit status it would be taken mod 256.
+	return (numErrors == 0) ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Bulk permission scanning for the PermCheck sample.
+//
+// Walks a directory tree (or reads a list of files, one path per line) and checks each
+// document on a pool of worker threads. Every worker initializes its own copy of the
+// library, as APDFL objects may not be shared between threads.
+//
+// One record is written per file, tab separated:
+//
+//    OK   <revision> <perms> <matrix> <path>
+//    ERR  <error code> <error message> <path>
+//
+// revision is the StdSecurityData revision (0 for an unencrypted document), perms is the
+// StdSecurityData permission bitfield in hex, and matrix is the PDDocPermRequest result
+// for every operation/object pair in hex (see PermMatrix::BitIndex() for the bit layout).
+//
+// With fastTriage set, the encryption dictionary is first read straight from the file (see
+// EncryptScan.h), and the document is only opened when that fails. Records produced this
+// way have "-" for the matrix, and /R and /P from the file for revision and perms.
+//
+// With cacheFile set, documents already in the PermCache store are not opened again, and
+// the matrix of every document that is opened is added to the store.
+//
+
+#ifndef BULKSCAN_H
+#define BULKSCAN_H
+
+#include <string>
+
+#include "PDCalls.h"
+#include "PermMatrix.h"
+
+struct BulkScanOptions
+{
+	std::string root;           // Directory to walk, or a single file.
+	std::string listFile;       // If set, read the paths to check from this file instead.
+	std::string outFile;        // Records go to stdout if empty.
+	std::string extension;      // Only files with this extension are checked when walking a directory.
+	std::string cacheFile;      // If set, matrices are looked up in and added to this PermCache store.
+	int numThreads;
+	bool fastTriage;
+	bool benchmark;             // Run the whole set twice, with and without fastTriage, and compare.
+
+	BulkScanOptions() : extension(".pdf"), numThreads(0), fastTriage(false), benchmark(false) {}
+};
+
+// Returns 0 if every file was checked, and 1 if any could not be, or the scan could not
+// run at all. The number of files that failed is written to stderr.
+int RunBulkScan(const BulkScanOptions& options);
+
+#endif // BULKSCAN_H
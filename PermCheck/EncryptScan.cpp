@@ -0,0 +1,537 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Lightweight encryption triage for the PermCheck sample. See EncryptScan.h.
+//
+// This only understands as much PDF syntax as is needed to read a trailer and one
+// dictionary: it does not decrypt, decompress, or validate anything.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+
+#include "EncryptScan.h"
+
+// How much of the end of the file to search for startxref, first try and last try.
+static const long long kTailSize = 2048;
+static const long long kMaxTailSize = 65536;
+// How much to read when parsing a dictionary.
+static const long long kDictReadSize = 65536;
+// How much of the start and end of the file to search for an object that the xref
+// section could not locate.
+static const long long kObjSearchSize = 1024 * 1024;
+// Limit on the number of /Prev links followed.
+static const int kMaxSections = 64;
+
+static bool readAt(std::ifstream& file, long long fileSize, long long offset, long long length, std::string& out)
+{
+	out.clear();
+	if (offset < 0 || offset >= fileSize)
+		return false;
+	if (length > fileSize - offset)
+		length = fileSize - offset;
+
+	out.resize(static_cast<size_t>(length));
+	file.clear();
+	file.seekg(offset, std::ios::beg);
+	file.read(&out[0], length);
+	out.resize(static_cast<size_t>(file.gcount()));
+	return !out.empty();
+}
+
+static bool isWhite(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\0';
+}
+
+static bool isDelim(char c)
+{
+	return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+		c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+// A minimal PDF tokenizer over a buffer.
+class PdfLexer
+{
+public:
+	enum TokenType { tEnd, tDictBegin, tDictEnd, tArrayBegin, tArrayEnd, tName, tNumber, tString, tKeyword };
+
+	struct Token
+	{
+		TokenType type;
+		std::string text;
+	};
+
+	PdfLexer(const std::string& buf, size_t start = 0) : data(buf), pos(start) {}
+
+	size_t Position() const { return pos; }
+	void SetPosition(size_t p) { pos = p; }
+
+	void SkipWhite()
+	{
+		while (pos < data.size())
+		{
+			if (isWhite(data[pos]))
+				++pos;
+			else if (data[pos] == '%')
+			{
+				while (pos < data.size() && data[pos] != '\r' && data[pos] != '\n')
+					++pos;
+			}
+			else
+				break;
+		}
+	}
+
+	Token Next()
+	{
+		Token tok;
+		tok.type = tEnd;
+		SkipWhite();
+		if (pos >= data.size())
+			return tok;
+
+		char c = data[pos];
+		if (c == '<' && pos + 1 < data.size() && data[pos + 1] == '<')
+		{
+			tok.type = tDictBegin;
+			pos += 2;
+		}
+		else if (c == '>' && pos + 1 < data.size() && data[pos + 1] == '>')
+		{
+			tok.type = tDictEnd;
+			pos += 2;
+		}
+		else if (c == '[' || c == ']')
+		{
+			tok.type = (c == '[') ? tArrayBegin : tArrayEnd;
+			++pos;
+		}
+		else if (c == '/')
+		{
+			tok.type = tName;
+			++pos;
+			size_t start = pos;
+			while (pos < data.size() && !isWhite(data[pos]) && !isDelim(data[pos]))
+				++pos;
+			tok.text = data.substr(start, pos - start);
+		}
+		else if (c == '(')
+		{
+			// Literal string; balanced parentheses nest, backslash escapes the next character.
+			tok.type = tString;
+			int depth = 0;
+			while (pos < data.size())
+			{
+				char s = data[pos++];
+				if (s == '\\')
+					++pos;
+				else if (s == '(')
+					++depth;
+				else if (s == ')' && --depth == 0)
+					break;
+			}
+		}
+		else if (c == '<')
+		{
+			tok.type = tString;
+			while (pos < data.size() && data[pos] != '>')
+				++pos;
+			++pos;
+		}
+		else if (c == '+' || c == '-' || c == '.' || (c >= '0' && c <= '9'))
+		{
+			tok.type = tNumber;
+			size_t start = pos++;
+			while (pos < data.size() && ((data[pos] >= '0' && data[pos] <= '9') || data[pos] == '.'))
+				++pos;
+			tok.text = data.substr(start, pos - start);
+		}
+		else
+		{
+			tok.type = tKeyword;
+			size_t start = pos;
+			while (pos < data.size() && !isWhite(data[pos]) && !isDelim(data[pos]))
+				++pos;
+			if (pos == start)
+				++pos;  // A stray delimiter; step over it.
+			tok.text = data.substr(start, pos - start);
+		}
+		return tok;
+	}
+
+private:
+	const std::string& data;
+	size_t pos;
+};
+
+// A top level dictionary value. Nested dictionaries and arrays are skipped, not kept.
+struct PdfValue
+{
+	PdfLexer::TokenType type;
+	std::string text;
+	long long objNum;           // For indirect references, else -1.
+	bool isDict;
+
+	PdfValue() : type(PdfLexer::tEnd), objNum(-1), isDict(false) {}
+};
+
+typedef std::map<std::string, PdfValue> PdfDict;
+
+static bool parseDict(PdfLexer& lex, PdfDict* dict, int depth);
+
+static bool skipArray(PdfLexer& lex, int depth)
+{
+	for (;;)
+	{
+		PdfLexer::Token tok = lex.Next();
+		if (tok.type == PdfLexer::tEnd)
+			return false;
+		if (tok.type == PdfLexer::tArrayEnd)
+			return true;
+		if (tok.type == PdfLexer::tDictBegin && !parseDict(lex, NULL, depth + 1))
+			return false;
+		if (tok.type == PdfLexer::tArrayBegin && !skipArray(lex, depth + 1))
+			return false;
+	}
+}
+
+// Parse the rest of a dictionary, after its "<<". If dict is NULL the contents are skipped.
+static bool parseDict(PdfLexer& lex, PdfDict* dict, int depth)
+{
+	if (depth > 32)
+		return false;
+
+	for (;;)
+	{
+		PdfLexer::Token key = lex.Next();
+		if (key.type == PdfLexer::tDictEnd)
+			return true;
+		if (key.type != PdfLexer::tName)
+			return false;
+
+		PdfValue value;
+		PdfLexer::Token tok = lex.Next();
+		value.type = tok.type;
+		value.text = tok.text;
+		switch (tok.type)
+		{
+		case PdfLexer::tDictBegin:
+			value.isDict = true;
+			if (!parseDict(lex, NULL, depth + 1))
+				return false;
+			break;
+		case PdfLexer::tArrayBegin:
+			if (!skipArray(lex, depth + 1))
+				return false;
+			break;
+		case PdfLexer::tNumber:
+		{
+			// Might be the start of an indirect reference: <num> <gen> R
+			size_t mark = lex.Position();
+			PdfLexer::Token gen = lex.Next();
+			PdfLexer::Token r = lex.Next();
+			if (gen.type == PdfLexer::tNumber && r.type == PdfLexer::tKeyword && r.text == "R")
+				value.objNum = atoll(tok.text.c_str());
+			else
+				lex.SetPosition(mark);
+			break;
+		}
+		case PdfLexer::tEnd:
+		case PdfLexer::tDictEnd:
+		case PdfLexer::tArrayEnd:
+			return false;
+		default:
+			break;
+		}
+
+		if (dict != NULL)
+			(*dict)[key.text] = value;
+	}
+}
+
+// Parse "<num> <gen> obj << ... >>" at the start of buf. If objNum is not negative it must match.
+static bool parseObjectDict(const std::string& buf, long long objNum, PdfDict& dict, PdfLexer::Token* afterDict = NULL)
+{
+	PdfLexer lex(buf);
+	PdfLexer::Token num = lex.Next();
+	PdfLexer::Token gen = lex.Next();
+	PdfLexer::Token obj = lex.Next();
+	if (num.type != PdfLexer::tNumber || gen.type != PdfLexer::tNumber || obj.type != PdfLexer::tKeyword || obj.text != "obj")
+		return false;
+	if (objNum >= 0 && atoll(num.text.c_str()) != objNum)
+		return false;
+	if (lex.Next().type != PdfLexer::tDictBegin)
+		return false;
+	if (!parseDict(lex, &dict, 0))
+		return false;
+	if (afterDict != NULL)
+		*afterDict = lex.Next();
+	return true;
+}
+
+static bool dictInt(const PdfDict& dict, const char* key, long long& value)
+{
+	PdfDict::const_iterator it = dict.find(key);
+	if (it == dict.end() || it->second.type != PdfLexer::tNumber || it->second.objNum >= 0)
+		return false;
+	value = atoll(it->second.text.c_str());
+	return true;
+}
+
+class TailScanner
+{
+public:
+	TailScanner(const char* path) : file(path, std::ios::binary), fileSize(0)
+	{
+		if (file.is_open())
+		{
+			file.seekg(0, std::ios::end);
+			fileSize = static_cast<long long>(file.tellg());
+		}
+	}
+
+	bool IsOpen() const { return file.is_open() && fileSize > 0; }
+
+	bool FindStartXref(long long& offset)
+	{
+		for (long long tailSize = kTailSize; ; tailSize = kMaxTailSize)
+		{
+			long long start = fileSize > tailSize ? fileSize - tailSize : 0;
+			if (!readAt(file, fileSize, start, tailSize, buf))
+				return false;
+
+			size_t at = buf.rfind("startxref");
+			if (at != std::string::npos)
+			{
+				PdfLexer lex(buf, at + 9);
+				PdfLexer::Token tok = lex.Next();
+				if (tok.type != PdfLexer::tNumber)
+					return false;
+				offset = atoll(tok.text.c_str());
+				return offset > 0 && offset < fileSize;
+			}
+			if (tailSize >= kMaxTailSize || start == 0)
+				return false;
+		}
+	}
+
+	// Walk one classic xref section at offset. If target is not negative and is in use in
+	// this section, its file offset is returned in targetOffset. The section's trailer is
+	// parsed into trailer.
+	bool ScanXrefTable(long long offset, long long target, PdfDict& trailer, long long& targetOffset)
+	{
+		std::string line;
+		if (!readAt(file, fileSize, offset, 64, line) || line.compare(0, 4, "xref") != 0)
+			return false;
+
+		long long pos = offset + 4;
+		for (;;)
+		{
+			if (!readAt(file, fileSize, pos, 64, line))
+				return false;
+			PdfLexer lex(line);
+			lex.SkipWhite();
+			if (lex.Position() < line.size() && line.compare(lex.Position(), 7, "trailer") == 0)
+			{
+				pos += lex.Position() + 7;
+				break;
+			}
+
+			PdfLexer::Token first = lex.Next();
+			PdfLexer::Token count = lex.Next();
+			if (first.type != PdfLexer::tNumber || count.type != PdfLexer::tNumber)
+				return false;
+
+			// The entries start on the line after the subsection header.
+			size_t eol = lex.Position();
+			while (eol < line.size() && line[eol] == ' ')
+				++eol;
+			if (eol < line.size() && line[eol] == '\r')
+				++eol;
+			if (eol < line.size() && line[eol] == '\n')
+				++eol;
+
+			long long start = atoll(first.text.c_str());
+			long long num = atoll(count.text.c_str());
+			long long entries = pos + static_cast<long long>(eol);
+			if (num < 0 || entries + (num * 20) > fileSize)
+				return false;
+
+			if (target >= start && target < start + num)
+			{
+				std::string entry;
+				if (!readAt(file, fileSize, entries + ((target - start) * 20), 20, entry) || entry.size() < 18)
+					return false;
+				if (entry[17] == 'n')
+					targetOffset = atoll(entry.substr(0, 10).c_str());
+			}
+			pos = entries + (num * 20);
+		}
+
+		if (!readAt(file, fileSize, pos, kDictReadSize, buf))
+			return false;
+		PdfLexer lex(buf);
+		if (lex.Next().type != PdfLexer::tDictBegin)
+			return false;
+		return parseDict(lex, &trailer, 0);
+	}
+
+	// Parse the dictionary of the object at offset, which must be object objNum.
+	bool ReadObjectDict(long long offset, long long objNum, PdfDict& dict)
+	{
+		if (!readAt(file, fileSize, offset, kDictReadSize, buf))
+			return false;
+		return parseObjectDict(buf, objNum, dict);
+	}
+
+	// Parse the cross-reference stream dictionary at offset.
+	bool ReadXrefStreamDict(long long offset, PdfDict& dict)
+	{
+		PdfLexer::Token after;
+		if (!readAt(file, fileSize, offset, kDictReadSize, buf) || !parseObjectDict(buf, -1, dict, &after))
+			return false;
+		PdfDict::const_iterator type = dict.find("Type");
+		return type != dict.end() && type->second.text == "XRef" && after.text == "stream";
+	}
+
+	// Look for "<objNum> <gen> obj" near the start and the end of the file, for objects the
+	// cross-reference information read so far does not locate.
+	bool SearchObject(long long objNum, PdfDict& dict)
+	{
+		char pattern[32];
+		snprintf(pattern, sizeof(pattern), "%lld 0 obj", objNum);
+
+		long long starts[2] = { 0, fileSize > kObjSearchSize ? fileSize - kObjSearchSize : 0 };
+		for (int i = 0; i < 2; i++)
+		{
+			if (i == 1 && starts[1] == 0)
+				break;
+			std::string window;
+			if (!readAt(file, fileSize, starts[i], kObjSearchSize, window))
+				continue;
+
+			// Search from the end, as a later definition replaces an earlier one.
+			size_t at = window.size();
+			while (at > 0 && (at = window.rfind(pattern, at - 1)) != std::string::npos)
+			{
+				if (at == 0 || isWhite(window[at - 1]))
+				{
+					PdfDict candidate;
+					std::string objBuf = window.substr(at, kDictReadSize);
+					if (parseObjectDict(objBuf, objNum, candidate) && candidate.find("Filter") != candidate.end())
+					{
+						dict.swap(candidate);
+						return true;
+					}
+				}
+				if (at == 0)
+					break;
+			}
+		}
+		return false;
+	}
+
+private:
+	std::ifstream file;
+	long long fileSize;
+	std::string buf;
+};
+
+static TriageResult needsFullOpen(EncryptInfo& info, const char* reason)
+{
+	info.reason = reason;
+	return kTriageNeedsFullOpen;
+}
+
+static TriageResult readEncryptDict(const PdfDict& encrypt, EncryptInfo& info)
+{
+	PdfDict::const_iterator filter = encrypt.find("Filter");
+	if (filter == encrypt.end() || filter->second.type != PdfLexer::tName)
+		return needsFullOpen(info, "encryption dictionary has no /Filter");
+	info.filter = filter->second.text;
+	if (info.filter != "Standard")
+		return needsFullOpen(info, "not the standard security handler");
+
+	long long V = 0, R = 0, P = 0;
+	if (!dictInt(encrypt, "R", R) || !dictInt(encrypt, "P", P))
+		return needsFullOpen(info, "encryption dictionary has no /R or /P");
+	dictInt(encrypt, "V", V);
+
+	info.V = static_cast<int>(V);
+	info.R = static_cast<int>(R);
+	// Some writers store /P as an unsigned number; the bits are what matter.
+	info.P = static_cast<int>(static_cast<unsigned int>(P & 0xFFFFFFFF));
+	return kTriageEncrypted;
+}
+
+TriageResult TriageEncryption(const char* path, EncryptInfo& info)
+{
+	TailScanner scanner(path);
+	if (!scanner.IsOpen())
+		return needsFullOpen(info, "cannot read file");
+
+	long long xrefOffset = 0;
+	if (!scanner.FindStartXref(xrefOffset))
+		return needsFullOpen(info, "no startxref");
+
+	PdfDict trailer;
+	long long unused = 0;
+	bool classic = scanner.ScanXrefTable(xrefOffset, -1, trailer, unused);
+	if (!classic)
+	{
+		trailer.clear();
+		if (!scanner.ReadXrefStreamDict(xrefOffset, trailer))
+			return needsFullOpen(info, "broken xref");
+	}
+
+	PdfDict::const_iterator encryptRef = trailer.find("Encrypt");
+	if (encryptRef == trailer.end())
+		return kTriageUnencrypted;
+
+	PdfDict encrypt;
+	if (encryptRef->second.isDict)
+	{
+		// A direct dictionary was skipped when the trailer was parsed; it is rare enough to
+		// leave to the library.
+		return needsFullOpen(info, "direct encryption dictionary");
+	}
+	if (encryptRef->second.objNum < 0)
+		return needsFullOpen(info, "bad /Encrypt entry");
+
+	long long objNum = encryptRef->second.objNum;
+	bool found = false;
+	if (classic)
+	{
+		// Look for the object in this section, then in each older one.
+		PdfDict section = trailer;
+		long long sectionOffset = xrefOffset;
+		for (int n = 0; n < kMaxSections && !found; n++)
+		{
+			long long objOffset = -1;
+			PdfDict sectionTrailer;
+			if (!scanner.ScanXrefTable(sectionOffset, objNum, sectionTrailer, objOffset))
+				break;
+			if (objOffset > 0)
+			{
+				found = scanner.ReadObjectDict(objOffset, objNum, encrypt);
+				break;
+			}
+			long long prev = 0;
+			if (!dictInt(sectionTrailer, "Prev", prev))
+				break;
+			sectionOffset = prev;
+		}
+	}
+
+	// Cross-reference streams are compressed; rather than inflating them, look for the object itself.
+	if (!found)
+		found = scanner.SearchObject(objNum, encrypt);
+	if (!found)
+		return needsFullOpen(info, "encryption dictionary not located");
+
+	return readEncryptDict(encrypt, info);
+}
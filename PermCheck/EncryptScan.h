@@ -0,0 +1,42 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// Lightweight encryption triage for the PermCheck sample.
+//
+// Reads the last cross-reference section of a PDF file directly, without opening the
+// document through the library, and reports whether the trailer has an /Encrypt entry and,
+// if so, the /Filter, /V, /R and /P values of the encryption dictionary.
+//
+// Only the common layouts are handled: a classic xref table (following /Prev as needed),
+// and cross-reference streams whose /Encrypt dictionary can be found near the start or the
+// end of the file. Anything else (damaged files, encryption handlers other than /Standard,
+// encryption dictionaries inside object streams) is reported as kTriageNeedsFullOpen, and
+// the caller should open the document with the library instead.
+//
+
+#ifndef ENCRYPTSCAN_H
+#define ENCRYPTSCAN_H
+
+#include <string>
+
+enum TriageResult
+{
+	kTriageUnencrypted,
+	kTriageEncrypted,
+	kTriageNeedsFullOpen
+};
+
+struct EncryptInfo
+{
+	std::string filter;     // Name of the security handler, without the leading slash.
+	int V;
+	int R;
+	int P;                  // Permission bits as stored in the file (a signed 32 bit value).
+	std::string reason;     // Why a full open is needed, for kTriageNeedsFullOpen.
+
+	EncryptInfo() : V(0), R(0), P(0) {}
+};
+
+TriageResult TriageEncryption(const char* path, EncryptInfo& info);
+
+#endif // ENCRYPTSCAN_H
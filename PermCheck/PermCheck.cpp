@@ -2,6 +2,22 @@
 // Copyright (c) 2000-2024, Datalogics, Inc. All rights reserved.
 //
 // This sample retrieves a PDF's permissions information.
+//
+// Command-line:  [options] <input-file>     (optional)
+//
+//   -bulk          Treat the input as a directory tree (or a single file) and write one
+//                  record per document instead of the full report. See BulkScan.h.
+//   -list <file>   With -bulk, check the paths listed in <file>, one per line.
+//   -threads <n>   With -bulk, number of worker threads (defaults to one per core).
+//   -ext <ext>     With -bulk, only check files with this extension (default .pdf, "" for all).
+//   -out <file>    With -bulk, write the records to <file> rather than stdout.
+//   -fast          With -bulk, read the encryption dictionary from the file where possible,
+//                  and only open the document through the library when that fails.
+//   -bench         With -bulk, scan everything with and without -fast and report both rates.
+//   -permcache <f> With -bulk, reuse and add to the permission matrices stored in <f> (see PermMatrix.h).
+//
+// With the DL_MEMTRACK environment variable set, the memory allocated while opening documents
+// and checking them is counted, and reported at exit. See Shared/MemTrack.h.
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -24,6 +40,9 @@
 #include "InitializeLibrary.h"
 #include "APDFLDoc.h"
 
+#include "BulkScan.h"
+#include "MemTrack.h"
+
 #define DIR_LOC "../../../../Resources/Sample_Input/"
 #define DEF_INPUT "LockDocument.pdf"
 
@@ -51,6 +70,7 @@ int main(int argc, char** argv)
 	PDPermReqOpr curOp;
 	PDPermReqStatus status;
 
+	MemTrackStart("PermCheck");
 	APDFLib libInit;
 	PDDoc pddoc = NULL;
 
@@ -64,11 +84,63 @@ int main(int argc, char** argv)
 
 	PDPrefSetAllowOpeningXFA(true);
 
-	std::string csInputFileName(argc > 1 ? argv[1] : DIR_LOC DEF_INPUT);
+	int curArg = 1;
+	bool bBulk = false;
+	BulkScanOptions bulkOptions;
+	while (argc > curArg)
+	{
+		if (strcmp(argv[curArg], "-bulk") == 0)
+		{
+			bBulk = true;
+		}
+		else if (strcmp(argv[curArg], "-list") == 0)
+		{
+			bBulk = true;
+			bulkOptions.listFile = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-threads") == 0)
+		{
+			bulkOptions.numThreads = atoi(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-ext") == 0)
+		{
+			bulkOptions.extension = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-out") == 0)
+		{
+			bulkOptions.outFile = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-fast") == 0)
+		{
+			bulkOptions.fastTriage = true;
+		}
+		else if (strcmp(argv[curArg], "-permcache") == 0)
+		{
+			bulkOptions.cacheFile = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-bench") == 0)
+		{
+			bBulk = true;
+			bulkOptions.benchmark = true;
+		}
+		else
+			break;
+		++curArg;
+	}
+
+	std::string csInputFileName(argc > curArg ? argv[curArg] : DIR_LOC DEF_INPUT);
+
+	if (bBulk)
+	{
+		bulkOptions.root = csInputFileName;
+		return RunBulkScan(bulkOptions);
+	}
 
 	DURING
+		MemTrackStage(kMemStageOpen);
 		APDFLDoc APDoc(csInputFileName.c_str(), true);
 	pddoc = APDoc.getPDDoc();
+	MemTrackStage(kMemStageOther);
 
 	if (pddoc == NULL)
 	{
@@ -0,0 +1,314 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// The permission matrix of a document, and a persistent cache of them. See PermMatrix.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "CosCalls.h"
+#include "ASCalls.h"
+#include "PDCalls.h"
+
+#include "PermMatrix.h"
+
+PermMatrix::PermMatrix()
+{
+	revision = 0;
+	perms = 0;
+	matrix[0] = matrix[1] = 0;
+}
+
+int PermMatrix::BitIndex(PDPermReqOpr op, int objIndex)
+{
+	return ((op - 1) * kNumPermTestObjs) + objIndex;
+}
+
+void PermMatrix::Evaluate(PDDoc pdDoc)
+{
+	StdSecurityData data = (StdSecurityData)PDDocGetSecurityData(pdDoc);
+	if (data != NULL)
+	{
+		revision = data->revision;
+		perms = data->perms;
+	}
+	else
+	{
+		// Not encrypted, so nothing is restricted.
+		revision = 0;
+		perms = 0xFFFFFFFF;
+	}
+
+	matrix[0] = matrix[1] = 0;
+	for (PDPermReqOpr curOp = 1; curOp < PDPermReqOprLast; curOp++)
+	{
+		if (curOp == PDPermReqOprUnknownOpr)
+			continue;
+
+		for (int i = 0; i < kNumPermTestObjs; i++)
+		{
+			if (PDDocPermRequest(pdDoc, kPermTestObjs[i], curOp, data) == PDPermReqGranted)
+			{
+				int bit = BitIndex(curOp, i);
+				matrix[bit / 64] |= (static_cast<ASUns64>(1) << (bit % 64));
+			}
+		}
+	}
+}
+
+bool PermMatrix::IsGranted(PDPermReqOpr op, int objIndex) const
+{
+	int bit = BitIndex(op, objIndex);
+	return (matrix[bit / 64] & (static_cast<ASUns64>(1) << (bit % 64))) != 0;
+}
+
+bool PermMatrix::IsAllowed(PDPermReqObj obj, PDPermReqOpr op) const
+{
+	for (int i = 0; i < kNumPermTestObjs; i++)
+	{
+		if (kPermTestObjs[i] == obj)
+			return IsGranted(op, i);
+	}
+	return false;
+}
+
+std::string PermMatrix::MatrixHex() const
+{
+	char buffer[33];
+	sprintf(buffer, "%016llx%016llx", static_cast<unsigned long long>(matrix[1]), static_cast<unsigned long long>(matrix[0]));
+	return std::string(buffer);
+}
+
+bool PermMatrix::SetMatrixHex(const char* hex)
+{
+	if (hex == NULL || strlen(hex) != 32)
+		return false;
+
+	char word[17];
+	word[16] = '\0';
+	memcpy(word, hex, 16);
+	matrix[1] = strtoull(word, NULL, 16);
+	memcpy(word, hex + 16, 16);
+	matrix[0] = strtoull(word, NULL, 16);
+	return true;
+}
+
+// SHA-256 (FIPS 180-4) of the whole file, as 64 hex digits. A digest that can't be made to
+// collide is needed here, since a cache hit lets a job through without opening the document:
+// with a weaker hash, a file made to match an allowed document would get its permissions.
+static const ASUns32 kSha256K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline ASUns32 rotr(ASUns32 x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(ASUns32 state[8], const unsigned char* block)
+{
+	ASUns32 w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = (static_cast<ASUns32>(block[4 * i]) << 24) | (static_cast<ASUns32>(block[4 * i + 1]) << 16)
+			| (static_cast<ASUns32>(block[4 * i + 2]) << 8) | block[4 * i + 3];
+	for (int i = 16; i < 64; i++)
+	{
+		ASUns32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		ASUns32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	ASUns32 a = state[0], b = state[1], c = state[2], d = state[3];
+	ASUns32 e = state[4], f = state[5], g = state[6], h = state[7];
+	for (int i = 0; i < 64; i++)
+	{
+		ASUns32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kSha256K[i] + w[i];
+		ASUns32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static bool hashFile(const char* path, std::string& digest)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	ASUns32 state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	static const size_t kChunk = 64 * 1024;            // A whole number of 64 byte blocks.
+	std::vector<unsigned char> buffer(kChunk + 128);    // Room for the padding after the last chunk.
+	ASUns64 length = 0;
+	size_t got;
+	for (;;)
+	{
+		got = fread(&buffer[0], 1, kChunk, file);
+		length += got;
+		if (got < kChunk)
+			break;
+		for (size_t pos = 0; pos < kChunk; pos += 64)
+			sha256Block(state, &buffer[pos]);
+	}
+	bool readError = ferror(file) != 0;
+	fclose(file);
+	if (readError)
+		return false;
+
+	// The last part chunk, then 0x80, zeros, and the length in bits, to a multiple of 64 bytes.
+	size_t tail = got;
+	buffer[tail++] = 0x80;
+	while (tail % 64 != 56)
+		buffer[tail++] = 0;
+	ASUns64 bits = length * 8;
+	for (int i = 7; i >= 0; i--)
+		buffer[tail++] = static_cast<unsigned char>(bits >> (8 * i));
+	for (size_t pos = 0; pos < tail; pos += 64)
+		sha256Block(state, &buffer[pos]);
+
+	char hex[65];
+	for (int i = 0; i < 8; i++)
+		sprintf(hex + 8 * i, "%08x", static_cast<unsigned int>(state[i]));
+	digest.assign(hex, 64);
+	return true;
+}
+
+PermCache::PermCache(const char* path) : storePath(path), hits(0), misses(0)
+{
+	std::ifstream store(path);
+	std::string line;
+	while (std::getline(store, line))
+	{
+		char digest[65];
+		unsigned long long size;
+		long long mtime;
+		int revision;
+		unsigned int perms;
+		char matrixHex[33];
+		int pathStart = 0;
+		// Entries in any other form, as from earlier versions, are ignored.
+		if (sscanf(line.c_str(), "%64s %llu %lld %d %8x %32s %n", digest, &size, &mtime, &revision, &perms, matrixHex, &pathStart) < 6
+			|| strlen(digest) != 64 || strspn(digest, "0123456789abcdef") != 64
+			|| strlen(matrixHex) != 32 || strspn(matrixHex, "0123456789abcdefABCDEF") != 32)
+			continue;
+
+		Entry entry;
+		entry.id.digest = digest;
+		entry.id.size = size;
+		entry.id.mtime = mtime;
+		entry.perms.revision = revision;
+		entry.perms.perms = perms;
+		if (!entry.perms.SetMatrixHex(matrixHex))
+			continue;
+
+		entries[entry.id.digest] = entry;
+		if (pathStart > 0)
+			byPath[line.substr(pathStart)] = entry.id;
+	}
+}
+
+bool PermCache::Identify(const char* path, FileIdentity& id)
+{
+	id.digest.clear();
+	std::error_code err;
+	std::filesystem::path filePath(path);
+	id.size = static_cast<ASUns64>(std::filesystem::file_size(filePath, err));
+	if (err)
+		return false;
+	id.mtime = static_cast<long long>(std::filesystem::last_write_time(filePath, err).time_since_epoch().count());
+	if (err)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		std::map<std::string, FileIdentity>::const_iterator seen = byPath.find(path);
+		if (seen != byPath.end() && seen->second.size == id.size && seen->second.mtime == id.mtime)
+		{
+			id.digest = seen->second.digest;
+			return true;
+		}
+	}
+
+	// New, or changed since it was seen: only the contents say what it is.
+	if (!hashFile(path, id.digest))
+	{
+		id.digest.clear();
+		return false;
+	}
+	std::lock_guard<std::mutex> guard(lock);
+	byPath[path] = id;
+	return true;
+}
+
+bool PermCache::Lookup(const FileIdentity& id, PermMatrix& perms)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	// The same content under a different name or time is still the same document.
+	std::map<std::string, Entry>::const_iterator known = id.digest.empty() ? entries.end() : entries.find(id.digest);
+	if (known != entries.end() && known->second.id.size == id.size)
+	{
+		perms = known->second.perms;
+		++hits;
+		return true;
+	}
+	++misses;
+	return false;
+}
+
+void PermCache::Store(const char* path, const FileIdentity& id, const PermMatrix& perms)
+{
+	if (id.digest.empty())
+		return;
+	Entry entry;
+	entry.id = id;
+	entry.perms = perms;
+
+	std::lock_guard<std::mutex> guard(lock);
+	entries[entry.id.digest] = entry;
+	byPath[path] = id;
+
+	FILE* store = fopen(storePath.c_str(), "a");
+	if (store != NULL)
+	{
+		fprintf(store, "%s %llu %lld %d %08x %s %s\n", id.digest.c_str(), static_cast<unsigned long long>(id.size),
+			id.mtime, perms.revision, perms.perms, perms.MatrixHex().c_str(), path);
+		fclose(store);
+	}
+}
+
+PermGateResult PermGateCheck(PermCache* cache, const char* path, PDDoc pdDoc, PDPermReqObj obj, PDPermReqOpr op)
+{
+	PermMatrix perms;
+	PermCache::FileIdentity id;
+	if (cache != NULL)
+		cache->Identify(path, id);
+	if (cache == NULL || !cache->Lookup(id, perms))
+	{
+		if (pdDoc == NULL)
+			return kPermUnknown;
+		perms.Evaluate(pdDoc);
+		if (cache != NULL)
+			cache->Store(path, id, perms);
+	}
+	return perms.IsAllowed(obj, op) ? kPermAllowed : kPermDenied;
+}
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// The permission matrix of a document, and a persistent cache of them.
+//
+// PermMatrix evaluates PDDocPermRequest once for every operation against each of the objects
+// in kPermTestObjs and keeps the answers as a packed bitset, along with the StdSecurityData
+// revision and permission bits.
+//
+// PermCache keeps matrices on disk, keyed by the SHA-256 digest and size of the file. A copy
+// or rename of a file already seen is found by its digest. A file is only hashed when its
+// path, size and modification time do not match one already seen. The other samples use
+// it, through PermGateCheck(), to refuse a job before doing any work on a document that
+// does not allow it. The store is a text file, one entry per line:
+//
+//    <sha256> <size> <mtime> <revision> <perms> <matrix> <path>
+//
+// Entries are appended as they are added, so the store can be shared by several runs.
+//
+
+#ifndef PERMMATRIX_H
+#define PERMMATRIX_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "PDCalls.h"
+
+// The objects checked for each operation; the same set the PermCheck report uses.
+static const PDPermReqObj kPermTestObjs[] = { PDPermReqObjDoc, PDPermReqObjPage, PDPermReqObjAnnot, PDPermReqObjForm };
+static const int kNumPermTestObjs = sizeof(kPermTestObjs) / sizeof(kPermTestObjs[0]);
+
+class PermMatrix
+{
+public:
+	ASInt32 revision;
+	ASUns32 perms;
+	ASUns64 matrix[2];      // One bit per (operation, object) pair, set when the request is granted.
+
+	PermMatrix();
+
+	// Bit position of an operation/object pair in matrix. Operations run from 1 to
+	// PDPermReqOprLast - 1, objects are indexes into kPermTestObjs.
+	static int BitIndex(PDPermReqOpr op, int objIndex);
+
+	void Evaluate(PDDoc pdDoc);
+	bool IsGranted(PDPermReqOpr op, int objIndex) const;
+	// obj must be one of kPermTestObjs; anything else is reported as not granted.
+	bool IsAllowed(PDPermReqObj obj, PDPermReqOpr op) const;
+
+	std::string MatrixHex() const;
+	bool SetMatrixHex(const char* hex);
+};
+
+class PermCache
+{
+public:
+	struct FileIdentity
+	{
+		std::string digest;     // SHA-256 of the contents, in hex; empty if the file could not be read.
+		ASUns64 size;
+		long long mtime;        // Only to tell whether a file seen before needs hashing again.
+	};
+
+	PermCache(const char* storePath);
+
+	// Identify the file at path, hashing it unless its path, size and modification time match
+	// a file already seen. Returns false if it cannot be read.
+	bool Identify(const char* path, FileIdentity& id);
+	// Find the matrix for the file identified by id, without opening it. Returns false if it
+	// has not been seen.
+	bool Lookup(const FileIdentity& id, PermMatrix& perms);
+	// Add the matrix for the file at path, identified by id, to the store.
+	void Store(const char* path, const FileIdentity& id, const PermMatrix& perms);
+
+	int Hits() const { return hits; }
+	int Misses() const { return misses; }
+
+private:
+	struct Entry
+	{
+		FileIdentity id;
+		PermMatrix perms;
+	};
+
+	std::string storePath;
+	std::mutex lock;
+	std::map<std::string, Entry> entries;           // Keyed by digest.
+	std::map<std::string, FileIdentity> byPath;     // The last identity seen for each path.
+	int hits, misses;
+};
+
+enum PermGateResult
+{
+	kPermAllowed,
+	kPermDenied,
+	kPermUnknown        // Not in the cache, and no document was given to evaluate.
+};
+
+// Check whether op on obj is allowed for the document at path. If it is not cached and
+// pdDoc is not NULL, the matrix is evaluated from pdDoc and added to the cache. Called
+// before opening the document (pdDoc NULL) this costs no more than hashing the file.
+// The path is only used to read the file; what is found depends on its contents alone.
+PermGateResult PermGateCheck(PermCache* cache, const char* path, PDDoc pdDoc, PDPermReqObj obj, PDPermReqOpr op);
+
+#endif // PERMMATRIX_H
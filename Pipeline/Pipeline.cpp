@@ -0,0 +1,391 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: Pipeline - does the work of PermCheck, ColorConvert, PageResize and RenderPageToImage,
+//   in the order given, on a document opened once, rather than each reopening the file that
+//   the one before it wrote.
+//
+// Command-line:  [options] <input-file> [<output-file>]
+//
+//   -steps <list>      The steps to take, in order, separated by commas, from permcheck,
+//                      convert, resize and render (default permcheck,convert,resize,render).
+//   -permcache <f>     permcheck: reuse and add to the permission matrices stored in <f>
+//                      (see PermCheck/PermMatrix.h).
+//   -profile <name>    convert: the first profile whose description contains <name> (default SWOP).
+//   -iccprofile <f>    convert: the profile in the ICC file <f> instead.
+//   -embed, -preserveblack, -preservecmykprimaries, -promotegraytocmyk
+//                      convert: as for ColorConvert.
+//   -size <w> <h>      resize: the new page size, in points (default 306 396, as PageResize).
+//   -render <name>     render: write each page to <name> with the page number added (default
+//                      Pipeline-out.png).
+//   -resolution <dpi>, -colorspace <DeviceGray|DeviceRGB|DeviceCMYK|DeviceRGBA>, -bpc <n>
+//                      render: as for RenderPageToImage (default 300, DeviceRGB, 8).
+//
+// permcheck refuses the document, before anything else is done to it, if it does not allow
+// what the steps after it do: modifying it for convert and resize, copying from it for render.
+// The document is saved to <output-file> once, after the last step, and only if one of the
+// steps changed it and an output file is given; a chain that only checks and renders never
+// saves. How long opening, each step and saving took is reported at the end.
+//
+// The steps are those of the other samples: FindTargetProfile() and SetUpConvertParams()
+// from ColorConvert/ConvertParams.h, doImposition() from PageResize/Imposition.h, and
+// RenderPage and the output file naming of RenderWorkers.h from RenderPageToImage.
+//
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PERCalls.h"
+#include "DLExtrasCalls.h"
+#include "AcroColorCalls.h"
+#include "APDFLDoc.h"
+#include "InitializeLibrary.h"
+
+#include "ConvertParams.h"
+#include "Imposition.h"
+#include "MemTrack.h"
+#include "PermMatrix.h"
+#include "RenderPage.h"
+#include "RenderWorkers.h"
+
+#define DIR_LOC "../../../../Resources/Sample_Input/"
+#define DEF_INPUT "ducky.pdf"
+#define DEF_RENDER "Pipeline-out.png"
+
+enum PipelineStep { kStepPermCheck, kStepConvert, kStepResize, kStepRender, kNumSteps };
+
+static const char* const sStepNames[kNumSteps] = { "permcheck", "convert", "resize", "render" };
+
+struct PipelineOptions
+{
+	std::vector<PipelineStep> steps;
+	std::string inputFile;
+	std::string outputFile;
+	std::string permCacheFile;
+	const char* profilePath;
+	std::string profileKey;
+	ConvertOptions convert;
+	ASFixed width, height;
+	std::string renderFile;
+	RenderPageParams renderParms;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool parseSteps(const std::string& list, std::vector<PipelineStep>& steps)
+{
+	steps.clear();
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		std::string name = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+		int step = 0;
+		while (step < kNumSteps && name != sStepNames[step])
+			++step;
+		if (step == kNumSteps)
+		{
+			std::cout << "Unknown step " << name.c_str() << std::endl;
+			return false;
+		}
+		steps.push_back(static_cast<PipelineStep>(step));
+		if (comma == std::string::npos)
+			break;
+		start = comma + 1;
+	}
+	return !steps.empty();
+}
+
+// The permission a step needs, as the sample it comes from checks it.
+static void stepPermission(PipelineStep step, PDPermReqObj& obj, PDPermReqOpr& op)
+{
+	switch (step)
+	{
+	case kStepConvert: obj = PDPermReqObjDoc; op = PDPermReqOprModify; break;
+	case kStepResize: obj = PDPermReqObjPage; op = PDPermReqOprModify; break;
+	default: obj = PDPermReqObjDoc; op = PDPermReqOprCopy; break;
+	}
+}
+
+// Refuse the document if a later step would do what it does not allow.
+static void checkPermissions(PDDoc doc, const PipelineOptions& options, size_t stepIndex)
+{
+	PermMatrix perms;
+	std::unique_ptr<PermCache> cache;
+	if (!options.permCacheFile.empty())
+		cache.reset(new PermCache(options.permCacheFile.c_str()));
+	PermCache::FileIdentity id;
+	if (cache != NULL)
+		cache->Identify(options.inputFile.c_str(), id);
+	if (cache == NULL || !cache->Lookup(id, perms))
+	{
+		perms.Evaluate(doc);
+		if (cache != NULL)
+			cache->Store(options.inputFile.c_str(), id, perms);
+	}
+	cache.reset();
+
+	std::cout << "Security revision " << perms.revision << ", permission matrix " << perms.MatrixHex().c_str() << std::endl;
+	for (size_t i = stepIndex + 1; i < options.steps.size(); i++)
+	{
+		PDPermReqObj obj;
+		PDPermReqOpr op;
+		stepPermission(options.steps[i], obj, op);
+		if (options.steps[i] != kStepPermCheck && !perms.IsAllowed(obj, op))
+		{
+			std::cout << "The document does not allow " << sStepNames[options.steps[i]] << "." << std::endl;
+			ASRaise(pdErrOpNotPermitted);
+		}
+	}
+}
+
+static void convertColors(PDDoc doc, const PipelineOptions& options)
+{
+	char profileDescr[128] = "";
+	AC_Profile iccProfile = FindTargetProfile(options.profilePath, options.profileKey.c_str(), profileDescr, sizeof(profileDescr));
+	if (iccProfile == NULL)
+	{
+		std::cout << "No target profile: " << (options.profilePath != NULL ? options.profilePath : options.profileKey.c_str()) << std::endl;
+		ASRaise(genErrBadParm);
+	}
+	std::cout << "Converting to " << profileDescr << std::endl;
+
+	PDColorConvertParamsRecEx convParmsEx;
+	SetUpConvertParams(convParmsEx, iccProfile, options.convert);
+
+	ASErrorCode errCode = 0;
+	DURING
+		for (ASInt32 i = 0; i < PDDocGetNumPages(doc); i++)
+		{
+			ASBool bPageChanged = FALSE;
+			PDDocColorConvertPageEx(doc, &convParmsEx, i, NULL, NULL, NULL, NULL, &bPageChanged);
+		}
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+
+	ACUnReferenceProfile(iccProfile);
+	ASfree(convParmsEx.mActions);
+	if (errCode != 0)
+		ASRaise(errCode);
+}
+
+// The image of page pageNum, named as RenderPageToImage -allpages names them.
+static std::string pageImageName(const std::string& renderFile, ASInt32 pageNum)
+{
+	return OutputFileNameWithSuffix(renderFile, "p" + std::to_string(pageNum + 1));
+}
+
+static void renderPages(PDDoc doc, const PipelineOptions& options)
+{
+	RenderPageParams parms = options.renderParms;
+	parms.setOCContext(PDDocGetOCContext(doc));
+
+	for (ASInt32 pageNum = 0; pageNum < PDDocGetNumPages(doc); pageNum++)
+	{
+		PDPage pdPage = PDDocAcquirePage(doc, pageNum);
+		ASErrorCode errCode = 0;
+		DURING
+			ASFixedRect cropRect, outRect;
+			PDPageGetCropBox(pdPage, &cropRect);
+			PDRotate rotation = PDPageGetRotate(pdPage);
+			if (rotation == pdRotate90 || rotation == pdRotate270)
+				outRect = { cropRect.bottom, cropRect.right, cropRect.top, cropRect.left };
+			else
+				outRect = cropRect;
+
+			RenderPage drawPage(pdPage, &cropRect, &parms);
+			PDEImage pageImage = drawPage.GetPDEImage(outRect);
+
+			// The stage, path and image are put back or released whether or not the export raises.
+			ASPathName outPath = CreateOutputPath(pageImageName(options.renderFile, pageNum));
+			MemStage outerStage = MemTrackStage(kMemStageExport);
+			ASErrorCode exportError = 0;
+			DURING
+				DLPDEImageExportParams exportParams = DLPDEImageGetExportParams();
+				exportParams.ExportHorizontalDPI = exportParams.ExportVerticalDPI = parms.Resolution();
+				DLExportPDEImage(pageImage, outPath, ExportType_PNG, exportParams);
+			HANDLER
+				exportError = ERRORCODE;
+			END_HANDLER
+			MemTrackStage(outerStage);
+			ASFileSysReleasePath(NULL, outPath);
+			PDERelease(reinterpret_cast<PDEObject>(pageImage));
+			if (exportError != 0)
+				ASRaise(exportError);
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+
+		PDPageRelease(pdPage);
+		if (errCode != 0)
+			ASRaise(errCode);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	MemTrackStart("Pipeline");
+
+	APDFLib libInit;
+	ASErrorCode errCode = 0;
+	if (libInit.isValid() == false)
+	{
+		errCode = libInit.getInitError();
+		std::cout << "Initialization failed with code " << errCode << std::endl;
+		return libInit.getInitError();
+	}
+
+	PipelineOptions options;
+	parseSteps("permcheck,convert,resize,render", options.steps);
+	options.profilePath = NULL;
+	options.profileKey = "SWOP";
+	options.convert.bEmbed = options.convert.bPreserveBlack = FALSE;
+	options.convert.bPreserveCMYKPrimaries = options.convert.bGrayToK = FALSE;
+	options.width = fixedOne * 306;
+	options.height = fixedOne * 396;
+	options.renderFile = DEF_RENDER;
+	options.renderParms.setVerbose(FALSE);
+	options.renderParms.SetColorSpace("DeviceRGB");
+	options.renderParms.setResolution(300.0);
+	options.renderParms.setBitsPerComponents(8);
+	options.renderParms.setSmoothFlags(kPDPageDrawSmoothText | kPDPageDrawSmoothLineArt | kPDPageDrawSmoothImage);
+	options.renderParms.setDrawFlags(kPDPageDoLazyErase | kPDPageUseAnnotFaces);
+
+	int curArg = 1;
+	while (argc > curArg)
+	{
+		if (strcmp(argv[curArg], "-steps") == 0)
+		{
+			if (!parseSteps(argv[++curArg], options.steps))
+				return genErrBadParm;
+		}
+		else if (strcmp(argv[curArg], "-permcache") == 0)
+		{
+			options.permCacheFile = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-profile") == 0)
+		{
+			options.profileKey = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-iccprofile") == 0)
+		{
+			options.profilePath = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-embed") == 0)
+		{
+			options.convert.bEmbed = TRUE;
+		}
+		else if (strcmp(argv[curArg], "-preserveblack") == 0)
+		{
+			options.convert.bPreserveBlack = TRUE;
+		}
+		else if (strcmp(argv[curArg], "-preservecmykprimaries") == 0)
+		{
+			options.convert.bPreserveCMYKPrimaries = TRUE;
+		}
+		else if (strcmp(argv[curArg], "-promotegraytocmyk") == 0)
+		{
+			options.convert.bGrayToK = TRUE;
+		}
+		else if (strcmp(argv[curArg], "-size") == 0)
+		{
+			options.width = FloatToASFixed(atof(argv[++curArg]));
+			options.height = FloatToASFixed(atof(argv[++curArg]));
+		}
+		else if (strcmp(argv[curArg], "-render") == 0)
+		{
+			options.renderFile = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-resolution") == 0)
+		{
+			options.renderParms.setResolution(atof(argv[++curArg]));
+		}
+		else if (strcmp(argv[curArg], "-colorspace") == 0)
+		{
+			options.renderParms.SetColorSpace(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-bpc") == 0)
+		{
+			options.renderParms.setBitsPerComponents(atoi(argv[++curArg]));
+		}
+		else
+			break;
+		++curArg;
+	}
+
+	options.inputFile = argc > curArg ? argv[curArg] : DIR_LOC DEF_INPUT;
+	options.outputFile = argc > curArg + 1 ? argv[curArg + 1] : "";
+
+	std::vector<double> stepSeconds(options.steps.size(), 0.0);
+	double openSeconds = 0, saveSeconds = 0;
+	bool bChanged = false;
+
+	DURING
+		Clock::time_point start = Clock::now();
+		MemTrackStage(kMemStageOpen);
+		APDFLDoc doc(options.inputFile.c_str(), true);
+		PDDoc pdDoc = doc.getPDDoc();
+		openSeconds = secondsSince(start);
+
+		for (size_t i = 0; i < options.steps.size(); i++)
+		{
+			start = Clock::now();
+			switch (options.steps[i])
+			{
+			case kStepPermCheck:
+				MemTrackStage(kMemStageOther);
+				checkPermissions(pdDoc, options, i);
+				break;
+			case kStepConvert:
+				MemTrackStage(kMemStageEdit);
+				convertColors(pdDoc, options);
+				bChanged = true;
+				break;
+			case kStepResize:
+				MemTrackStage(kMemStageEdit);
+				doImposition(pdDoc, options.width, options.height);
+				bChanged = true;
+				break;
+			default:
+				MemTrackStage(kMemStageOther);
+				renderPages(pdDoc, options);
+				break;
+			}
+			stepSeconds[i] = secondsSince(start);
+		}
+
+		if (bChanged && !options.outputFile.empty())
+		{
+			start = Clock::now();
+			MemTrackStage(kMemStageSave);
+			doc.saveDoc(options.outputFile.c_str());
+			saveSeconds = secondsSince(start);
+		}
+		MemTrackStage(kMemStageOther);
+	HANDLER
+		errCode = ERRORCODE;
+		libInit.displayError(errCode);
+	END_HANDLER
+
+	std::cout << "Open: " << openSeconds << " s." << std::endl;
+	for (size_t i = 0; i < options.steps.size(); i++)
+		std::cout << sStepNames[options.steps[i]] << ": " << stepSeconds[i] << " s." << std::endl;
+	if (saveSeconds > 0)
+		std::cout << "Save to " << options.outputFile.c_str() << ": " << saveSeconds << " s." << std::endl;
+	else if (bChanged)
+		std::cout << "Not saved: no output file was given." << std::endl;
+
+	return errCode;
+}
@@ -0,0 +1,67 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// A first in, first out queue between two threads, with a fixed number of places. A full
+// queue holds up the thread that fills it, so that a fast stage cannot run far ahead of a
+// slow one and use memory without limit.
+//
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template <class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false)
+	{
+	}
+
+	// Wait until there is a place for item, then add it.
+	void Push(const T& item)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		notFull.wait(guard, [this] { return items.size() < capacity; });
+		items.push_back(item);
+		notEmpty.notify_one();
+	}
+
+	// Wait for an item. Returns false once the queue is closed and has nothing left.
+	bool Pop(T& item)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		notEmpty.wait(guard, [this] { return !items.empty() || closed; });
+		if (items.empty())
+			return false;
+		item = items.front();
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	// No more items will be pushed.
+	void Close()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closed = true;
+		notEmpty.notify_all();
+	}
+
+private:
+	std::mutex lock;
+	std::condition_variable notFull, notEmpty;
+	std::deque<T> items;
+	size_t capacity;
+	bool closed;
+};
+
+#endif // BOUNDEDQUEUE_H
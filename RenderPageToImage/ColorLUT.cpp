@@ -0,0 +1,531 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// 3D lookup tables for color conversion of rendered bitmaps. See ColorLUT.h.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define COLORLUT_SSE 1
+#endif
+
+#include "ASCalls.h"
+#include "AcroColorCalls.h"
+
+#include "ColorLUT.h"
+#include "RenderWorkers.h"
+
+static const int kMinGridSize = 2;
+static const int kMaxGridSize = 65;
+
+// The packing of 8 bit data for an output color space, and the number of channels it has.
+static bool outputPacking(AC_ColorSpace colorSpace, AC_PackingCode& packing, int& numComps)
+{
+	switch (colorSpace)
+	{
+	case AC_Space_Gray: packing = AC_Packing_Gray8; numComps = 1; return true;
+	case AC_Space_RGB: packing = AC_Packing_RGB8; numComps = 3; return true;
+	case AC_Space_CMYK: packing = AC_Packing_CMYK8; numComps = 4; return true;
+	default: return false;
+	}
+}
+
+static AC_PackingCode packingForComps(int numComps)
+{
+	return numComps == 1 ? AC_Packing_Gray8 : numComps == 3 ? AC_Packing_RGB8 : AC_Packing_CMYK8;
+}
+
+ColorLUT::ColorLUT() : gridSize(0), outComps(0)
+{
+	memset(cell, 0, sizeof(cell));
+	memset(fraction, 0, sizeof(fraction));
+}
+
+void ColorLUT::SetUpIndexes()
+{
+	for (int v = 0; v < 256; v++)
+	{
+		double position = v * (gridSize - 1) / 255.0;
+		int index = (std::min)(static_cast<int>(position), gridSize - 2);
+		cell[v] = index;
+		fraction[v] = static_cast<float>(position - index);
+	}
+}
+
+bool ColorLUT::Build(AC_Profile src, AC_Profile dst, AC_RenderIntent intent, int size)
+{
+	AC_ColorSpace dstSpace;
+	AC_PackingCode dstPacking;
+	if (ACProfileColorSpace(dst, &dstSpace) != 0 || !outputPacking(dstSpace, dstPacking, outComps))
+		return false;
+
+	AC_Transform transform = NULL;
+	if (ACMakeColorTransform(&transform, src, dst, intent, 0) != 0 || transform == NULL)
+		return false;
+
+	gridSize = (std::max)(kMinGridSize, (std::min)(size, kMaxGridSize));
+	size_t numPoints = static_cast<size_t>(gridSize) * gridSize * gridSize;
+
+	// Every grid point, through the color engine in one call.
+	std::vector<unsigned char> grid(numPoints * 3);
+	unsigned char* point = &grid[0];
+	for (int r = 0; r < gridSize; r++)
+	{
+		for (int g = 0; g < gridSize; g++)
+		{
+			for (int b = 0; b < gridSize; b++)
+			{
+				*point++ = static_cast<unsigned char>((r * 255 + (gridSize - 1) / 2) / (gridSize - 1));
+				*point++ = static_cast<unsigned char>((g * 255 + (gridSize - 1) / 2) / (gridSize - 1));
+				*point++ = static_cast<unsigned char>((b * 255 + (gridSize - 1) / 2) / (gridSize - 1));
+			}
+		}
+	}
+	std::vector<unsigned char> converted(numPoints * outComps);
+	AC_Error err = ACApplyTransform(transform, &grid[0], &converted[0], static_cast<ASUns32>(numPoints), AC_Packing_RGB8, dstPacking);
+	ACUnReferenceTransform(transform);
+	if (err != 0)
+		return false;
+
+	// Four floats per entry, whatever the number of channels, so that each is one SSE register.
+	table.assign(numPoints * 4, 0.0f);
+	for (size_t i = 0; i < numPoints; i++)
+	{
+		for (int c = 0; c < outComps; c++)
+			table[i * 4 + c] = converted[i * outComps + c];
+	}
+
+	SetUpIndexes();
+	return true;
+}
+
+bool ColorLUT::Load(const std::string& path, const std::string& key)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	// A file from another key, whose name hashed the same, or from before keys were kept, is not used.
+	char magic[4];
+	ASUns64 keySize = 0;
+	std::string fileKey;
+	bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "DLU2", 4) == 0
+		&& fread(&keySize, sizeof(keySize), 1, file) == 1 && keySize == key.size();
+	if (ok && keySize > 0)
+	{
+		fileKey.resize(static_cast<size_t>(keySize));
+		ok = fread(&fileKey[0], 1, fileKey.size(), file) == fileKey.size() && fileKey == key;
+	}
+
+	int header[2];
+	ok = ok && fread(header, sizeof(int), 2, file) == 2
+		&& header[0] >= kMinGridSize && header[0] <= kMaxGridSize
+		&& (header[1] == 1 || header[1] == 3 || header[1] == 4);
+	if (ok)
+	{
+		gridSize = header[0];
+		outComps = header[1];
+		table.resize(static_cast<size_t>(gridSize) * gridSize * gridSize * 4);
+		ok = fread(&table[0], sizeof(float), table.size(), file) == table.size();
+	}
+	fclose(file);
+
+	if (ok)
+		SetUpIndexes();
+	return ok;
+}
+
+bool ColorLUT::Save(const std::string& path, const std::string& key) const
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	ASUns64 keySize = key.size();
+	int header[2] = { gridSize, outComps };
+	bool ok = fwrite("DLU2", 1, 4, file) == 4
+		&& fwrite(&keySize, sizeof(keySize), 1, file) == 1
+		&& fwrite(key.data(), 1, key.size(), file) == key.size()
+		&& fwrite(header, sizeof(int), 2, file) == 2
+		&& fwrite(&table[0], sizeof(float), table.size(), file) == table.size();
+	return (fclose(file) == 0) && ok;
+}
+
+ASAtom ColorLUT::OutColorSpace() const
+{
+	return ASAtomFromString(outComps == 1 ? "DeviceGray" : outComps == 3 ? "DeviceRGB" : "DeviceCMYK");
+}
+
+void ColorLUT::ApplyRows(const unsigned char* pixels, const RenderBitmapInfo& info, unsigned char* out, int firstRow, int lastRow) const
+{
+	// Offsets, in floats, of the next grid point along each axis.
+	const int strideB = 4;
+	const int strideG = gridSize * 4;
+	const int strideR = gridSize * gridSize * 4;
+	const float* lut = &table[0];
+	size_t inStep = static_cast<size_t>(info.nComps);
+
+	for (int row = firstRow; row < lastRow; row++)
+	{
+		const unsigned char* in = pixels + row * info.rowBytes;
+		unsigned char* dst = out + static_cast<size_t>(row) * info.width * outComps;
+		for (ASInt32 x = 0; x < info.width; x++, in += inStep, dst += outComps)
+		{
+			float fr = fraction[in[0]], fg = fraction[in[1]], fb = fraction[in[2]];
+			const float* base = lut + (cell[in[0]] * strideR) + (cell[in[1]] * strideG) + (cell[in[2]] * strideB);
+
+			// The tetrahedron the point is in: walk from the cell's low corner to its high
+			// corner along the axes in order of decreasing fraction.
+			int step1, step2;
+			float f1, f2, f3;
+			if (fr >= fg)
+			{
+				if (fg >= fb)      { step1 = strideR; step2 = strideG; f1 = fr; f2 = fg; f3 = fb; }
+				else if (fr >= fb) { step1 = strideR; step2 = strideB; f1 = fr; f2 = fb; f3 = fg; }
+				else               { step1 = strideB; step2 = strideR; f1 = fb; f2 = fr; f3 = fg; }
+			}
+			else
+			{
+				if (fr >= fb)      { step1 = strideG; step2 = strideR; f1 = fg; f2 = fr; f3 = fb; }
+				else if (fg >= fb) { step1 = strideG; step2 = strideB; f1 = fg; f2 = fb; f3 = fr; }
+				else               { step1 = strideB; step2 = strideG; f1 = fb; f2 = fg; f3 = fr; }
+			}
+			const float* c0 = base;
+			const float* c1 = base + step1;
+			const float* c2 = c1 + step2;
+			const float* c3 = base + strideR + strideG + strideB;
+
+#ifdef COLORLUT_SSE
+			__m128 v0 = _mm_loadu_ps(c0);
+			__m128 v1 = _mm_loadu_ps(c1);
+			__m128 v2 = _mm_loadu_ps(c2);
+			__m128 v3 = _mm_loadu_ps(c3);
+			__m128 result = _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), _mm_set1_ps(f1)));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_sub_ps(v2, v1), _mm_set1_ps(f2)));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_sub_ps(v3, v2), _mm_set1_ps(f3)));
+			__m128i levels = _mm_cvttps_epi32(_mm_add_ps(result, _mm_set1_ps(0.5f)));
+			levels = _mm_packs_epi32(levels, levels);
+			levels = _mm_packus_epi16(levels, levels);
+			int packed = _mm_cvtsi128_si32(levels);
+			memcpy(dst, &packed, outComps);
+#else
+			for (int c = 0; c < outComps; c++)
+			{
+				float value = c0[c] + (c1[c] - c0[c]) * f1 + (c2[c] - c1[c]) * f2 + (c3[c] - c2[c]) * f3;
+				dst[c] = static_cast<unsigned char>((std::min)(255.0f, (std::max)(0.0f, value)) + 0.5f);
+			}
+#endif
+		}
+	}
+}
+
+void ColorLUT::Apply(const char* pixels, const RenderBitmapInfo& info, std::vector<unsigned char>& out, int numThreads) const
+{
+	out.resize(static_cast<size_t>(info.width) * info.height * outComps);
+	if (out.empty())
+		return;
+
+	if (numThreads <= 0)
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (numThreads <= 0)
+		numThreads = 1;
+	if (numThreads > info.height)
+		numThreads = info.height;
+
+	const unsigned char* in = reinterpret_cast<const unsigned char*>(pixels);
+	std::vector<std::thread> workers;
+	for (int i = 1; i < numThreads; i++)
+	{
+		int firstRow = static_cast<int>(static_cast<long long>(info.height) * i / numThreads);
+		int lastRow = static_cast<int>(static_cast<long long>(info.height) * (i + 1) / numThreads);
+		workers.push_back(std::thread(&ColorLUT::ApplyRows, this, in, std::cref(info), &out[0], firstRow, lastRow));
+	}
+	ApplyRows(in, info, &out[0], 0, static_cast<int>(static_cast<long long>(info.height) / numThreads));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// 64 bit FNV-1a, continued from hash.
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+ColorLUTCache::ColorLUTCache(const std::string& cacheDir) : dir(cacheDir)
+{
+}
+
+ColorLUTCache::~ColorLUTCache()
+{
+	for (std::map<std::string, ColorLUT*>::iterator it = tables.begin(); it != tables.end(); ++it)
+		delete it->second;
+}
+
+const ColorLUT* ColorLUTCache::Get(AC_Profile src, const std::string& srcKey, AC_Profile dst, const std::string& dstKey,
+	AC_RenderIntent intent, int gridSize, bool& built)
+{
+	built = false;
+
+	// Everything the table depends on, each profile with its length before it so that no two
+	// keys run together the same.
+	std::string key = std::to_string(srcKey.size()) + ":" + srcKey + std::to_string(dstKey.size()) + ":" + dstKey
+		+ " " + std::to_string(static_cast<int>(intent)) + " " + std::to_string(gridSize);
+
+	std::map<std::string, ColorLUT*>::const_iterator known = tables.find(key);
+	if (known != tables.end())
+		return known->second;
+
+	std::string path;
+	if (!dir.empty())
+	{
+		char name[32];
+		sprintf(name, "%016llx.lut", hashBytes(0xcbf29ce484222325ULL, key.data(), key.size()));
+		path = dir + "/" + name;
+	}
+
+	ColorLUT* lut = new ColorLUT;
+	if (path.empty() || !lut->Load(path, key))
+	{
+		if (!lut->Build(src, dst, intent, gridSize))
+		{
+			delete lut;
+			return NULL;
+		}
+		built = true;
+		if (!path.empty())
+			lut->Save(path, key);
+	}
+	tables[key] = lut;
+	return lut;
+}
+
+ColorLUTCheck CheckColorLUT(const ColorLUT& lut, AC_Profile src, AC_Profile dst, AC_RenderIntent intent,
+	const char* pixels, const RenderBitmapInfo& info, int numThreads)
+{
+	ColorLUTCheck check;
+	memset(&check, 0, sizeof(check));
+
+	AC_Transform transform = NULL;
+	if (ACMakeColorTransform(&transform, src, dst, intent, 0) != 0 || transform == NULL)
+		return check;
+
+	// The color engine is given rows of plain RGB, so RGBA is repacked first.
+	int outComps = lut.OutComps();
+	size_t numPixels = static_cast<size_t>(info.width) * info.height;
+	std::vector<unsigned char> exact(numPixels * outComps);
+	std::vector<unsigned char> rgbRow(static_cast<size_t>(info.width) * 3);
+	AC_Error err = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (ASInt32 row = 0; row < info.height && err == 0; row++)
+	{
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(pixels) + row * info.rowBytes;
+		if (info.nComps != 3)
+		{
+			for (ASInt32 x = 0; x < info.width; x++)
+				memcpy(&rgbRow[x * 3], &in[x * info.nComps], 3);
+			in = &rgbRow[0];
+		}
+		err = ACApplyTransform(transform, in, &exact[static_cast<size_t>(row) * info.width * outComps],
+			static_cast<ASUns32>(info.width), AC_Packing_RGB8, packingForComps(outComps));
+	}
+	check.exactSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	ACUnReferenceTransform(transform);
+	if (err != 0)
+		return check;
+
+	std::vector<unsigned char> approximate;
+	start = std::chrono::steady_clock::now();
+	lut.Apply(pixels, info, approximate, numThreads);
+	check.lutSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double total = 0;
+	for (size_t i = 0; i < exact.size(); i++)
+	{
+		int difference = abs(static_cast<int>(exact[i]) - static_cast<int>(approximate[i]));
+		check.maxDifference = (std::max)(check.maxDifference, difference);
+		total += difference;
+	}
+	check.meanDifference = exact.empty() ? 0 : total / exact.size();
+	check.valid = true;
+	return check;
+}
+
+// The sRGB profile the color engine knows, for a page drawn without a working RGB profile.
+static AC_Profile findStandardRGB(std::string& description)
+{
+	AC_Profile found = NULL;
+	AC_ProfileList profList;
+	if (ACMakeProfileList(&profList, AC_Selector_RGB_Standard) != 0)
+		return NULL;
+
+	ASUns32 profCount = 0;
+	ACProfileListCount(profList, &profCount);
+	for (ASUns32 candidate = 0; candidate < profCount && found == NULL; candidate++)
+	{
+		AC_String profACString;
+		char profileDescr[256] = { 0 };
+		ASUns32 bufUsed;
+		if (ACProfileListItemDescription(profList, candidate, &profACString) != 0)
+			continue;
+		ACStringASCII(profACString, profileDescr, &bufUsed, sizeof(profileDescr));
+		if (strstr(profileDescr, "sRGB") != NULL)
+		{
+			ACProfileFromDescription(&found, profACString);
+			description = profileDescr;
+		}
+		ACUnReferenceString(profACString);
+	}
+	ACUnReferenceProfileList(profList);
+	return found;
+}
+
+int DeriveColorOutputs(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& parms,
+	const char* pixels, const RenderBitmapInfo& info, const DeriveJob& job, ColorLUTCache& cache)
+{
+	static const ASAtom sDeviceRGB_K = ASAtomFromString("DeviceRGB");
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	if ((info.colorSpace != sDeviceRGB_K && info.colorSpace != sDeviceRGBA_K) || info.bpc != 8)
+	{
+		std::cout << "Other color spaces can only be made from an 8 bit RGB rendering." << std::endl;
+		return static_cast<int>(job.targets.size());
+	}
+
+	// The page was drawn in the working RGB space, so that is where the tables start from.
+	AC_Profile src = NULL;
+	std::string srcKey;
+	if (!job.workingRGB.empty())
+	{
+		std::vector<char> data(job.workingRGB);
+		ACMakeBufferProfile(&src, &data[0], static_cast<ASUns32>(data.size()));
+		srcKey.assign(data.begin(), data.end());
+	}
+	else
+		src = findStandardRGB(srcKey);
+	if (src == NULL)
+	{
+		std::cout << "No working RGB profile to convert from; give one with -rgbworkingprofile." << std::endl;
+		return static_cast<int>(job.targets.size());
+	}
+
+	// The graphics state intent means nothing outside the page; use the default for it.
+	AC_RenderIntent intent = (job.intent == AC_UseGStateIntent) ? AC_Perceptual : job.intent;
+
+	int numFailed = 0;
+	for (size_t i = 0; i < job.targets.size(); i++)
+	{
+		std::vector<char> data(job.targets[i]);
+		AC_Profile dst = NULL;
+		if (ACMakeBufferProfile(&dst, &data[0], static_cast<ASUns32>(data.size())) != 0 || dst == NULL)
+		{
+			std::cout << "Target profile " << i + 1 << " could not be read." << std::endl;
+			++numFailed;
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool built = false;
+		const ColorLUT* lut = cache.Get(src, srcKey, dst, std::string(data.begin(), data.end()), intent, job.gridSize, built);
+		double tableTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (lut == NULL)
+		{
+			std::cout << "No color transform to target profile " << i + 1 << "." << std::endl;
+			ACUnReferenceProfile(dst);
+			++numFailed;
+			continue;
+		}
+
+		start = std::chrono::steady_clock::now();
+		std::vector<unsigned char> converted;
+		lut->Apply(pixels, info, converted, job.numThreads);
+		double applyTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		RenderBitmapInfo outInfo = info;
+		outInfo.colorSpace = lut->OutColorSpace();
+		outInfo.nComps = lut->OutComps();
+		outInfo.rowBytes = static_cast<ASSize_t>(info.width) * outInfo.nComps;
+
+		std::string spaceName(ASAtomGetString(outInfo.colorSpace) + 6);    // Without "Device"
+		std::string fileName = OutputFileNameWithSuffix(job.outputFile,
+			job.targets.size() > 1 ? std::to_string(i + 1) + "-" + spaceName : spaceName);
+
+		ASErrorCode errCode = 0;
+		double renderTime = 0;
+		DURING
+			ExportBitmap(fileName, reinterpret_cast<const char*>(&converted[0]), static_cast<ASSize_t>(converted.size()), outInfo);
+
+			// Drawing the page again, straight into the target, is what the table saves.
+			if (job.checkTolerance >= 0)
+			{
+				RenderPageParams targetParms = parms;
+				targetParms.SetColorSpace(outInfo.colorSpace);
+				targetParms.setBitsPerComponents(8);
+				targetParms.setOutputProfile(dst);
+				targetParms.setBufferAllocator(NULL);
+				start = std::chrono::steady_clock::now();
+				RenderPage targetPage(pdPage, &cropRect, &targetParms);
+				renderTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			std::cout << "Writing " << fileName.c_str() << " failed: " << buf << std::endl;
+			ACUnReferenceProfile(dst);
+			++numFailed;
+			continue;
+		}
+
+		std::cout << fileName.c_str() << ": " << (built ? "built" : "reused") << " a " << job.gridSize << "^3 table in "
+			<< tableTime << " s, applied it in " << applyTime << " s." << std::endl;
+
+		if (job.checkTolerance >= 0)
+		{
+			ColorLUTCheck check = CheckColorLUT(*lut, src, dst, intent, pixels, info, job.numThreads);
+			if (!check.valid)
+			{
+				std::cout << "  The color engine could not transform the page to check the table." << std::endl;
+				++numFailed;
+			}
+			else
+			{
+				bool withinTolerance = check.maxDifference <= job.checkTolerance;
+				std::cout << "  Off by at most " << check.maxDifference << " (mean " << check.meanDifference << ") from the color engine, "
+					<< (withinTolerance ? "within" : "outside") << " the tolerance of " << job.checkTolerance << ". The color engine took "
+					<< check.exactSeconds << " s, the table " << check.lutSeconds << " s; drawing the page again took " << renderTime
+					<< " s (" << (applyTime > 0 ? renderTime / applyTime : 0.0) << "x the table)." << std::endl;
+				if (!withinTolerance)
+					++numFailed;
+			}
+		}
+		ACUnReferenceProfile(dst);
+	}
+
+	ACUnReferenceProfile(src);
+	return numFailed;
+}
@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Other color spaces from one rendering. The page is drawn once, in RGB, and each further
+// output (Gray, RGB or CMYK, for a target ICC profile) is made from that bitmap with a 3D
+// lookup table: the color transform from the working RGB profile to the target, sampled on
+// a grid of gridSize points per channel, with tetrahedral interpolation between the grid
+// points. The interpolation handles all of a pixel's output channels at once, in SSE
+// registers where they are available.
+//
+// Building a table takes gridSize^3 trips through the color engine, so tables are kept,
+// in memory and, if given a directory, on disk, keyed by the two profiles, the intent
+// and the grid size. A table file is named by a hash of the key and holds the whole key,
+// which must match for the table to be used.
+//
+
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AcroColorExpT.h"
+
+#include "RenderPage.h"
+
+class ColorLUT
+{
+public:
+	ColorLUT();
+
+	// Sample the transform from src (an RGB profile) to dst. Returns false if the color
+	// engine cannot make the transform.
+	bool Build(AC_Profile src, AC_Profile dst, AC_RenderIntent intent, int gridSize);
+
+	// A table file holds the key it was saved with; Load() fails if it is not key.
+	bool Load(const std::string& path, const std::string& key);
+	bool Save(const std::string& path, const std::string& key) const;
+
+	int OutComps() const { return outComps; }
+	ASAtom OutColorSpace() const;
+
+	// Transform an 8 bit DeviceRGB or DeviceRGBA bitmap (alpha is ignored) into out, which
+	// is resized to hold width * height pixels of OutComps() bytes each, with no row padding.
+	void Apply(const char* pixels, const RenderBitmapInfo& info, std::vector<unsigned char>& out, int numThreads) const;
+
+private:
+	void SetUpIndexes();
+	void ApplyRows(const unsigned char* pixels, const RenderBitmapInfo& info, unsigned char* out, int firstRow, int lastRow) const;
+
+	int gridSize;
+	int outComps;
+	std::vector<float> table;       // gridSize^3 entries of 4 floats, 0 to 255; blue varies fastest.
+	int cell[256];                  // The grid cell an 8 bit input value falls in,
+	float fraction[256];            // and how far across it.
+};
+
+class ColorLUTCache
+{
+public:
+	// cacheDir may be empty, to keep tables in memory only. Kept for as long as tables may be
+	// wanted again, across calls to DeriveColorOutputs().
+	explicit ColorLUTCache(const std::string& cacheDir);
+	~ColorLUTCache();
+
+	// The table for src to dst, built if it is not already known. srcKey and dstKey identify
+	// the profiles: their data, or their descriptions. Returns NULL if it cannot be built.
+	const ColorLUT* Get(AC_Profile src, const std::string& srcKey, AC_Profile dst, const std::string& dstKey,
+		AC_RenderIntent intent, int gridSize, bool& built);
+
+private:
+	std::string dir;
+	std::map<std::string, ColorLUT*> tables;         // Keyed by everything the table depends on.
+};
+
+// How closely a table matches the color engine, over every pixel of a bitmap.
+struct ColorLUTCheck
+{
+	int maxDifference;              // In 8 bit output levels.
+	double meanDifference;
+	double exactSeconds;            // Transforming every pixel with the color engine,
+	double lutSeconds;              // and with the table.
+	bool valid;
+};
+
+ColorLUTCheck CheckColorLUT(const ColorLUT& lut, AC_Profile src, AC_Profile dst, AC_RenderIntent intent,
+	const char* pixels, const RenderBitmapInfo& info, int numThreads);
+
+// The outputs to make from a page drawn in DeviceRGB.
+struct DeriveJob
+{
+	std::vector<char> workingRGB;               // The profile the page was drawn in; sRGB if empty.
+	std::vector<std::vector<char> > targets;    // The output profiles.
+	AC_RenderIntent intent;
+	int gridSize;
+	std::string cacheDir;
+	std::string outputFile;
+	int numThreads;
+	int checkTolerance;                         // The most a table may be off by, or -1 not to check.
+
+	DeriveJob() : intent(AC_Perceptual), gridSize(17), numThreads(0), checkTolerance(-1)
+	{
+	}
+};
+
+// Write an image for each target profile, transformed from pixels, an 8 bit DeviceRGB or
+// DeviceRGBA bitmap, and named after the output file with the color space added. With a
+// check, each table is compared with the color engine, and the page is drawn again for the
+// target, to compare the time. The tables are taken from, and added to, cache. Returns the
+// number of outputs that failed or were off by more than the tolerance.
+int DeriveColorOutputs(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& parms,
+	const char* pixels, const RenderBitmapInfo& info, const DeriveJob& job, ColorLUTCache& cache);
+
+#endif // COLORLUT_H
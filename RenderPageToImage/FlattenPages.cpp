@@ -0,0 +1,495 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Flattening a document to images, rendered on many threads. See FlattenPages.h.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CosCalls.h"
+#include "PERCalls.h"
+#include "PEWCalls.h"
+#include "AcroColorCalls.h"
+#include "APDFLDoc.h"
+#include "InitializeLibrary.h"
+
+#include "FlattenPages.h"
+#include "MemTrack.h"
+
+// A page is taken as black and white when this share of its pixels is within kNearLevel of
+// black or white, with no more than kNeutralSpread between its components. What is left is
+// mostly the anti-aliased edges of text and lines, which thresholding sharpens.
+static const double kBilevelShare = 0.97;
+static const int kNearLevel = 40;
+static const int kNeutralSpread = 16;
+
+// A page is taken as continuous tone when this share of neighboring pixels differ, but by no
+// more than kSmoothStep in any component. Text and flat color are mostly pixels the same as
+// their neighbors, with sharp edges between.
+static const double kSmoothShare = 0.25;
+static const int kSmoothStep = 24;
+
+// Rows looked at when choosing; every pixel of those rows is.
+static const ASInt32 kSampleRows = 512;
+
+static const char* const sFilterNames[] = { "auto", "Flate", "DCT", "CCITT G4" };
+
+// One page, compressed, on its way from a worker to the output.
+struct FlatPage
+{
+	ASInt32 pageNum;
+	ASErrorCode errCode;
+	ASFixedRect pageRect;       // The page as shown, at the origin.
+	ASInt32 width, height, bpc, nComps;
+	std::string colorSpace;     // A name, as atoms are not shared between threads' libraries.
+	FlattenFilter filter;
+	std::vector<char> data;     // Compressed with filter.
+
+	FlatPage() : pageNum(0), errCode(0), width(0), height(0), bpc(0), nComps(0), filter(kFlattenFlate)
+	{
+		memset(&pageRect, 0, sizeof(pageRect));
+	}
+};
+
+struct FlattenState
+{
+	const FlattenJob* job;
+	ASInt32 numPages;
+	std::mutex lock;
+	std::condition_variable changed;
+	ASInt32 nextToRender;
+	ASInt32 nextToAdd;
+	ASInt32 maxAhead;           // Pages that may be started past the last one added.
+	int numRunning;
+	std::map<ASInt32, FlatPage*> done;
+
+	FlattenState() : job(NULL), numPages(0), nextToRender(0), nextToAdd(0), maxAhead(1), numRunning(0)
+	{
+	}
+};
+
+// Choose how to compress a bitmap, from rows spread over it.
+static FlattenFilter chooseFilter(const char* pixels, const RenderBitmapInfo& info)
+{
+	static const ASAtom sDeviceCMYK_K = ASAtomFromString("DeviceCMYK");
+
+	if (info.bpc != 8)
+		return kFlattenFlate;
+
+	bool cmyk = (info.colorSpace == sDeviceCMYK_K);
+	ASInt32 rowStep = info.height > kSampleRows ? info.height / kSampleRows : 1;
+	size_t numSamples = 0, numBilevel = 0, numPairs = 0, numSmooth = 0;
+	for (ASInt32 row = 0; row < info.height; row += rowStep)
+	{
+		const ASUns8* pixel = reinterpret_cast<const ASUns8*>(pixels) + static_cast<size_t>(row) * info.rowBytes;
+		for (ASInt32 col = 0; col < info.width; col++, pixel += info.nComps)
+		{
+			int level;
+			bool neutral;
+			if (info.nComps == 1)
+			{
+				level = pixel[0];
+				neutral = true;
+			}
+			else if (cmyk)
+			{
+				level = 255 - pixel[3];
+				neutral = std::max(std::max(pixel[0], pixel[1]), pixel[2]) <= kNeutralSpread;
+			}
+			else
+			{
+				int lowest = std::min(std::min(pixel[0], pixel[1]), pixel[2]);
+				int highest = std::max(std::max(pixel[0], pixel[1]), pixel[2]);
+				level = (pixel[0] + pixel[1] + pixel[2]) / 3;
+				neutral = highest - lowest <= kNeutralSpread;
+			}
+
+			++numSamples;
+			if (neutral && (level <= kNearLevel || level >= 255 - kNearLevel))
+				++numBilevel;
+
+			if (col > 0)
+			{
+				int step = 0;
+				for (ASInt32 comp = 0; comp < info.nComps; comp++)
+					step = std::max(step, abs(pixel[comp] - pixel[comp - info.nComps]));
+				++numPairs;
+				if (step > 0 && step <= kSmoothStep)
+					++numSmooth;
+			}
+		}
+	}
+
+	if (numSamples > 0 && numBilevel >= numSamples * kBilevelShare)
+		return kFlattenCCITT;
+	if (numPairs > 0 && numSmooth >= numPairs * kSmoothShare)
+		return kFlattenDCT;
+	return kFlattenFlate;
+}
+
+// The filter for kind, for an image of width by height pixels of nComps components. The
+// image data is always given to the library uncompressed, so the same parameters do to
+// compress it in a worker and, in the output, to describe what was compressed.
+static void makeFilters(CosDoc cosDoc, FlattenFilter kind, ASInt32 width, ASInt32 height, ASInt32 nComps, PDEFilterArray& filters)
+{
+	memset(&filters, 0, sizeof(PDEFilterArray));
+	filters.numFilters = 1;
+	PDEFilterSpec& spec = filters.spec[0];
+	spec.encodeParms = CosNewNull();
+	spec.decodeParms = CosNewNull();
+
+	switch (kind)
+	{
+	case kFlattenDCT:
+		spec.name = ASAtomFromString("DCTDecode");
+		spec.encodeParms = CosNewDict(cosDoc, false, 3);
+		CosDictPut(spec.encodeParms, ASAtomFromString("Columns"), CosNewInteger(cosDoc, false, width));
+		CosDictPut(spec.encodeParms, ASAtomFromString("Rows"), CosNewInteger(cosDoc, false, height));
+		CosDictPut(spec.encodeParms, ASAtomFromString("Colors"), CosNewInteger(cosDoc, false, nComps));
+		break;
+
+	case kFlattenCCITT:
+		// K < 0 is Group 4.
+		spec.name = ASAtomFromString("CCITTFaxDecode");
+		spec.encodeParms = CosNewDict(cosDoc, false, 3);
+		CosDictPut(spec.encodeParms, ASAtomFromString("K"), CosNewInteger(cosDoc, false, -1));
+		CosDictPut(spec.encodeParms, ASAtomFromString("Columns"), CosNewInteger(cosDoc, false, width));
+		CosDictPut(spec.encodeParms, ASAtomFromString("Rows"), CosNewInteger(cosDoc, false, height));
+		spec.decodeParms = CosNewDict(cosDoc, false, 3);
+		CosDictPut(spec.decodeParms, ASAtomFromString("K"), CosNewInteger(cosDoc, false, -1));
+		CosDictPut(spec.decodeParms, ASAtomFromString("Columns"), CosNewInteger(cosDoc, false, width));
+		CosDictPut(spec.decodeParms, ASAtomFromString("Rows"), CosNewInteger(cosDoc, false, height));
+		break;
+
+	default:
+		spec.name = ASAtomFromString("FlateDecode");
+		break;
+	}
+}
+
+// Render a page and compress it into flat.
+static void flattenPage(PDDoc pdDoc, RenderPageParams& parms, FlattenFilter filter, FlatPage* flat)
+{
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+
+	PDPage pdPage = PDDocAcquirePage(pdDoc, flat->pageNum);
+	ASErrorCode errCode = 0;
+	DURING
+		ASFixedRect cropRect;
+		PDPageGetCropBox(pdPage, &cropRect);
+
+		// The page is drawn turned as it is shown, so the new page is turned the same way.
+		ASFixed width = cropRect.right - cropRect.left;
+		ASFixed height = cropRect.top - cropRect.bottom;
+		PDRotate rotation = PDPageGetRotate(pdPage);
+		if (rotation == pdRotate90 || rotation == pdRotate270)
+			std::swap(width, height);
+		flat->pageRect.left = flat->pageRect.bottom = 0;
+		flat->pageRect.right = width;
+		flat->pageRect.top = height;
+
+		RenderPage drawPage(pdPage, &cropRect, &parms);
+		RenderBitmapInfo info = drawPage.BitmapInfo();
+
+		FlattenFilter chosen = (filter == kFlattenAuto) ? chooseFilter(drawPage.GetImageBuffer(), info) : filter;
+		if (chosen == kFlattenCCITT && !drawPage.ReduceToBilevel())
+			chosen = kFlattenFlate;
+		if (chosen == kFlattenDCT && (info.bpc != 8 || info.colorSpace == sDeviceRGBA_K))
+			chosen = kFlattenFlate;
+		info = drawPage.BitmapInfo();
+
+		PDEFilterArray filters;
+		makeFilters(PDDocGetCosDoc(pdDoc), chosen, info.width, info.height, info.nComps, filters);
+		PDEImage image = drawPage.GetPDEImage(flat->pageRect, &filters);
+
+		MemStage outerStage = MemTrackStage(kMemStageExport);
+		ASStm imageData = PDEImageGetDataStm(image, kPDEImageEncodedData);
+		char chunk[65536];
+		ASTCount numRead;
+		while ((numRead = ASStmRead(chunk, 1, sizeof(chunk), imageData)) > 0)
+			flat->data.insert(flat->data.end(), chunk, chunk + numRead);
+		ASStmClose(imageData);
+		PDERelease(reinterpret_cast<PDEObject>(image));
+		MemTrackStage(outerStage);
+
+		flat->width = info.width;
+		flat->height = info.height;
+		flat->bpc = info.bpc;
+		flat->nComps = info.nComps;
+		flat->colorSpace = ASAtomGetString(info.colorSpace);
+		flat->filter = chosen;
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+
+	PDPageRelease(pdPage);
+	if (errCode != 0)
+		ASRaise(errCode);
+}
+
+static void flattenWorker(FlattenState* state)
+{
+	const FlattenJob& job = *state->job;
+
+	// Each thread needs its own initialization of the library, and its own copy of the document.
+	APDFLib libInit;
+	ASErrorCode errCode = libInit.isValid() ? 0 : libInit.getInitError();
+	AC_Profile outputProfile = NULL;
+	if (errCode == 0 && !job.targetProfile.empty())
+		ACMakeBufferProfile(&outputProfile, const_cast<char*>(&job.targetProfile[0]), static_cast<ASUns32>(job.targetProfile.size()));
+
+	if (errCode == 0)
+	{
+		DURING
+			MemTrackStage(kMemStageOpen);
+			APDFLDoc doc(job.inputFile.c_str(), true);
+			MemTrackStage(kMemStageOther);
+			RenderPageParams parms = job.parms;
+			parms.setOCContext(PDDocGetOCContext(doc.getPDDoc()));
+			parms.setOutputProfile(outputProfile);
+			parms.setBufferAllocator(NULL);
+
+			while (true)
+			{
+				FlatPage* flat = new FlatPage;
+				{
+					// Stay no more than maxAhead pages ahead of the output.
+					std::unique_lock<std::mutex> guard(state->lock);
+					state->changed.wait(guard, [state] {
+						return state->nextToRender >= state->numPages
+							|| state->nextToRender < state->nextToAdd + state->maxAhead;
+					});
+					if (state->nextToRender >= state->numPages)
+					{
+						delete flat;
+						break;
+					}
+					flat->pageNum = state->nextToRender++;
+				}
+
+				DURING
+					flattenPage(doc.getPDDoc(), parms, job.filter, flat);
+				HANDLER
+					flat->errCode = ERRORCODE;
+				END_HANDLER
+
+				std::lock_guard<std::mutex> guard(state->lock);
+				state->done[flat->pageNum] = flat;
+				state->changed.notify_all();
+			}
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+	}
+
+	if (outputProfile != NULL)
+		ACUnReferenceProfile(outputProfile);
+
+	std::lock_guard<std::mutex> guard(state->lock);
+	if (errCode != 0)
+		std::cout << "Flattening worker could not start: error " << errCode << std::endl;
+	--state->numRunning;
+	state->changed.notify_all();
+}
+
+// Add a page showing the image in flat to the end of pdDoc.
+static void addFlatPage(PDDoc pdDoc, const FlatPage& flat)
+{
+	PDPage newPage = PDDocCreatePage(pdDoc, PDDocGetNumPages(pdDoc) - 1, flat.pageRect);
+
+	PDEImageAttrs attrs;
+	memset(&attrs, 0, sizeof(PDEImageAttrs));
+	attrs.flags = kPDEImageExternal;
+	attrs.width = flat.width;
+	attrs.height = flat.height;
+	attrs.bitsPerComponent = flat.bpc;
+
+	ASDoubleMatrix imageMatrix = { ASFixedToFloat(flat.pageRect.right), 0, 0, ASFixedToFloat(flat.pageRect.top), 0, 0 };
+	PDEColorSpace colorSpace = PDEColorSpaceCreateFromName(ASAtomFromString(flat.colorSpace.c_str()));
+	PDEFilterArray filters;
+	makeFilters(PDDocGetCosDoc(pdDoc), flat.filter, flat.width, flat.height, flat.nComps, filters);
+	PDEImage image = PDEImageCreateEx(&attrs, sizeof(attrs), &imageMatrix, kPDEImageEncodedData, colorSpace, NULL, &filters, 0,
+		reinterpret_cast<ASUns8*>(const_cast<char*>(&flat.data[0])), static_cast<ASSize_t>(flat.data.size()));
+
+	PDEContent content = PDPageAcquirePDEContent(newPage, 0);
+	PDEContentAddElem(content, kPDEAfterLast, reinterpret_cast<PDEElement>(image));
+	PDPageSetPDEContentCanRaise(newPage, 0);
+	PDPageReleasePDEContent(newPage, 0);
+
+	PDERelease(reinterpret_cast<PDEObject>(image));
+	PDERelease(reinterpret_cast<PDEObject>(colorSpace));
+	PDPageRelease(newPage);
+}
+
+// Save the pages added so far, in full the first time, and close the output.
+static void saveOutput(PDDoc& outDoc, ASPathName outPath, bool& saved)
+{
+	MemStage outerStage = MemTrackStage(kMemStageSave);
+	if (!saved)
+		PDDocSave(outDoc, PDSaveFull | PDSaveCollectGarbage, outPath, NULL, NULL, NULL);
+	else
+		PDDocSave(outDoc, PDSaveIncremental, NULL, NULL, NULL, NULL);
+	saved = true;
+	PDDocClose(outDoc);
+	outDoc = NULL;
+	MemTrackStage(outerStage);
+}
+
+int FlattenPages(PDDoc pdDoc, FlattenJob& job)
+{
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	if (job.parms.ColorSpaceName() == sDeviceRGBA_K)
+	{
+		std::cout << "Flattened pages are opaque; use DeviceRGB rather than DeviceRGBA." << std::endl;
+		return 1;
+	}
+
+	FlattenState state;
+	state.job = &job;
+	state.numPages = PDDocGetNumPages(pdDoc);
+	if (job.queueDepth < 1)
+		job.queueDepth = 1;
+	if (job.windowSize < 1)
+		job.windowSize = 1;
+
+	int numWorkers = job.numThreads > 0 ? job.numThreads : static_cast<int>(std::thread::hardware_concurrency());
+	numWorkers = std::max(1, std::min(numWorkers, static_cast<int>(state.numPages)));
+	state.numRunning = numWorkers;
+	// However short the queue, every worker can have a page in hand.
+	state.maxAhead = static_cast<ASInt32>(std::max(job.queueDepth, static_cast<size_t>(numWorkers)));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int i = 0; i < numWorkers; i++)
+		workers.push_back(std::thread(flattenWorker, &state));
+
+	ASPathName outPath = CreateOutputPath(job.outputFile);
+	PDDoc outDoc = PDDocCreate();
+	bool saved = false;
+	int numFailed = 0, inWindow = 0;
+	int filterPages[4] = { 0, 0, 0, 0 };
+	size_t filterBytes[4] = { 0, 0, 0, 0 };
+	ASErrorCode saveError = 0;
+
+	for (ASInt32 pageNum = 0; pageNum < state.numPages && saveError == 0; pageNum++)
+	{
+		FlatPage* flat = NULL;
+		{
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.changed.wait(guard, [&state, pageNum] { return state.done.count(pageNum) != 0 || state.numRunning == 0; });
+			std::map<ASInt32, FlatPage*>::iterator found = state.done.find(pageNum);
+			if (found != state.done.end())
+			{
+				flat = found->second;
+				state.done.erase(found);
+			}
+			state.nextToAdd = pageNum + 1;
+			state.changed.notify_all();
+		}
+
+		ASErrorCode errCode = (flat != NULL) ? flat->errCode : genErrGeneral;
+		if (errCode == 0)
+		{
+			DURING
+				MemTrackStage(kMemStageEdit);
+				if (outDoc == NULL)
+					outDoc = PDDocOpen(outPath, NULL, NULL, true);
+				addFlatPage(outDoc, *flat);
+			HANDLER
+				errCode = ERRORCODE;
+			END_HANDLER
+			MemTrackStage(kMemStageOther);
+		}
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			std::cout << "Flattening page " << pageNum + 1 << " failed: " << buf << std::endl;
+			++numFailed;
+		}
+		else
+		{
+			++filterPages[flat->filter];
+			filterBytes[flat->filter] += flat->data.size();
+			++inWindow;
+		}
+		delete flat;
+
+		// The page is in the output whether or not the save works. If it does not, what the
+		// file holds is not known, so the loop ends there.
+		if (inWindow == job.windowSize)
+		{
+			DURING
+				saveOutput(outDoc, outPath, saved);
+			HANDLER
+				saveError = ERRORCODE;
+			END_HANDLER
+			inWindow = 0;
+		}
+	}
+
+	if (saveError != 0)
+	{
+		// Let the workers finish the pages they have in hand, and start no more.
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.nextToRender = state.numPages;
+		state.changed.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	// Pages drawn but never added, after a failed save.
+	for (std::map<ASInt32, FlatPage*>::iterator it = state.done.begin(); it != state.done.end(); ++it)
+		delete it->second;
+	state.done.clear();
+
+	if (saveError == 0)
+	{
+		DURING
+			if (outDoc != NULL && (saved || PDDocGetNumPages(outDoc) > 0))
+				saveOutput(outDoc, outPath, saved);
+		HANDLER
+			saveError = ERRORCODE;
+		END_HANDLER
+	}
+	if (outDoc != NULL)
+		PDDocClose(outDoc);
+	ASFileSysReleasePath(NULL, outPath);
+
+	if (saveError != 0)
+	{
+		char buf[256];
+		ASGetErrorString(saveError, buf, sizeof(buf));
+		std::cout << "Saving " << job.outputFile.c_str() << " failed: " << buf << std::endl;
+		return state.numPages;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	long residentKB = 0, peakKB = 0;
+	MemTrackResident(residentKB, peakKB);
+	std::cout << "Flattened " << state.numPages - numFailed << " of " << state.numPages << " pages to " << job.outputFile.c_str()
+		<< " in " << elapsed << " s, on " << numWorkers << " thread(s), saving every " << job.windowSize << " pages; peak resident "
+		<< peakKB / 1024 << " MB." << std::endl;
+	for (int filter = kFlattenFlate; filter <= kFlattenCCITT; filter++)
+	{
+		if (filterPages[filter] > 0)
+			std::cout << "  " << sFilterNames[filter] << ": " << filterPages[filter] << " pages, " << filterBytes[filter] / 1024 << " KB" << std::endl;
+	}
+	return numFailed;
+}
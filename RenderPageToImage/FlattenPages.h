@@ -0,0 +1,61 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Flattening a document to one of images only: every page is rendered, and the image put on
+// a page of its own in a new document, the size of the page as it is shown. Nothing else of
+// the document (text, fonts, annotations, forms, links, scripts, attachments) is carried over.
+//
+// The pages are rendered on numThreads threads, each with its own initialization of the
+// library and its own copy of the document. A thread chooses how to compress each page it
+// draws, from what is in the bitmap:
+//
+//   CCITT G4   pages that are nearly all black or white, as text and line art are, which are
+//              reduced to 1 bit (RenderPage::ReduceToBilevel()).
+//   DCT        pages where many neighboring pixels differ a little, as in photographs.
+//   Flate      everything else, such as flat color, charts and colored text.
+//
+// and makes a PDEImage of the page with RenderPage::GetPDEImage(), which compresses it. The
+// image belongs to the thread's library, so it is the compressed data that is handed to the
+// calling thread, which makes an image of it in the output, without compressing it again, on
+// a page after the pages before it.
+//
+// A thread does not start a page more than queueDepth pages past the last page added to the
+// output, or as many pages as there are threads, if that is more. Every windowSize pages,
+// the output is saved (in full the first time, incrementally after that) and closed, and
+// opened again for the next pages, so that the memory used stays about the same however many
+// pages there are. A page that fails is reported and left out. If a save fails, no more pages
+// are added, and every page is counted as failed, as what the file holds is not known.
+//
+
+#ifndef FLATTENPAGES_H
+#define FLATTENPAGES_H
+
+#include <string>
+
+#include "RenderWorkers.h"
+
+enum FlattenFilter
+{
+	kFlattenAuto,               // Chosen for each page, as above.
+	kFlattenFlate,
+	kFlattenDCT,
+	kFlattenCCITT
+};
+
+struct FlattenJob : PageRenderJob
+{
+	std::string outputFile;
+	FlattenFilter filter;       // The same for every page, unless kFlattenAuto.
+	size_t queueDepth;          // Pages rendered ahead of the output, at least one per thread.
+	int windowSize;             // Pages added to the output between saves.
+};
+
+// Returns the number of pages that failed.
+int FlattenPages(PDDoc pdDoc, FlattenJob& job);
+
+#endif // FLATTENPAGES_H
@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Writing JPEG files with libjpeg-turbo. See JpegWriter.h.
+//
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "jpeglib.h"
+
+#include "ASCalls.h"
+
+#include "JpegWriter.h"
+
+// libjpeg reports errors through error_exit, which must not return. This one jumps back to
+// WriteJpeg with the message.
+struct JpegErrorManager
+{
+	struct jpeg_error_mgr pub;
+	jmp_buf escape;
+	char message[JMSG_LENGTH_MAX];
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+	JpegErrorManager* manager = reinterpret_cast<JpegErrorManager*>(cinfo->err);
+	(*cinfo->err->format_message)(cinfo, manager->message);
+	longjmp(manager->escape, 1);
+}
+
+bool ParseJpegSubsampling(const char* name, JpegSubsampling& subsampling)
+{
+	if (strcmp(name, "444") == 0)
+		subsampling = kJpegSubsample444;
+	else if (strcmp(name, "422") == 0)
+		subsampling = kJpegSubsample422;
+	else if (strcmp(name, "420") == 0)
+		subsampling = kJpegSubsample420;
+	else
+		return false;
+	return true;
+}
+
+// The libjpeg input color space for a bitmap color space, or JCS_UNKNOWN if there is none.
+static J_COLOR_SPACE jpegColorSpace(ASAtom colorSpace)
+{
+	static const ASAtom sDeviceGray_K = ASAtomFromString("DeviceGray");
+	static const ASAtom sDeviceRGB_K = ASAtomFromString("DeviceRGB");
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	static const ASAtom sDeviceCMYK_K = ASAtomFromString("DeviceCMYK");
+	if (colorSpace == sDeviceGray_K)
+		return JCS_GRAYSCALE;
+	if (colorSpace == sDeviceRGB_K)
+		return JCS_RGB;
+	if (colorSpace == sDeviceRGBA_K)
+		return JCS_EXT_RGBX;
+	if (colorSpace == sDeviceCMYK_K)
+		return JCS_CMYK;
+	return JCS_UNKNOWN;
+}
+
+bool CanWriteJpeg(ASAtom colorSpace, ASInt32 bpc)
+{
+	return bpc == 8 && jpegColorSpace(colorSpace) != JCS_UNKNOWN;
+}
+
+bool WriteJpeg(const std::string& fileName, const char* pixels, const RenderBitmapInfo& info,
+	const JpegWriteOptions& options, std::string& error)
+{
+	J_COLOR_SPACE inColorSpace = jpegColorSpace(info.colorSpace);
+	if (!CanWriteJpeg(info.colorSpace, info.bpc))
+	{
+		error = std::string("JPEG cannot hold ") + ASAtomGetString(info.colorSpace) + " at this depth";
+		return false;
+	}
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+	{
+		error = "Unable to create " + fileName;
+		return false;
+	}
+
+	struct jpeg_compress_struct cinfo;
+	JpegErrorManager errorManager;
+	cinfo.err = jpeg_std_error(&errorManager.pub);
+	errorManager.pub.error_exit = jpegErrorExit;
+
+	// CMYK rows are inverted into here. It is set up before the setjmp(), so that nothing
+	// about it changes between there and a longjmp().
+	bool invert = (inColorSpace == JCS_CMYK);
+	std::vector<JSAMPLE> invertedRow(invert ? static_cast<size_t>(info.width) * 4 : 0);
+
+	if (setjmp(errorManager.escape))
+	{
+		error = std::string("JPEG compression failed: ") + errorManager.message;
+		jpeg_destroy_compress(&cinfo);
+		fclose(file);
+		return false;
+	}
+
+	jpeg_create_compress(&cinfo);
+	jpeg_stdio_dest(&cinfo, file);
+
+	cinfo.image_width = static_cast<JDIMENSION>(info.width);
+	cinfo.image_height = static_cast<JDIMENSION>(info.height);
+	cinfo.input_components = info.nComps;
+	cinfo.in_color_space = inColorSpace;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, options.quality, TRUE);
+
+	cinfo.density_unit = 1;     // Dots per inch
+	cinfo.X_density = cinfo.Y_density = static_cast<UINT16>(info.resolution + 0.5);
+
+	// Subsampling applies to the color (chroma) components of YCbCr only; the luminance
+	// keeps the sampling set here, and the others stay at 1x1.
+	if (cinfo.jpeg_color_space == JCS_YCbCr)
+	{
+		cinfo.comp_info[0].h_samp_factor = (options.subsampling == kJpegSubsample444) ? 1 : 2;
+		cinfo.comp_info[0].v_samp_factor = (options.subsampling == kJpegSubsample420) ? 2 : 1;
+	}
+	if (options.progressive)
+		jpeg_simple_progression(&cinfo);
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	const JSAMPLE* bitmap = reinterpret_cast<const JSAMPLE*>(pixels);
+	while (cinfo.next_scanline < cinfo.image_height)
+	{
+		JSAMPROW row = const_cast<JSAMPROW>(bitmap + static_cast<size_t>(cinfo.next_scanline) * info.rowBytes);
+		if (invert)
+		{
+			for (size_t i = 0; i < invertedRow.size(); i++)
+				invertedRow[i] = static_cast<JSAMPLE>(255 - row[i]);
+			row = &invertedRow[0];
+		}
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	if (fclose(file) != 0)
+	{
+		error = "Unable to write " + fileName;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// A JPEG writer for page previews, fed row by row straight from the bitmap RenderPage drew,
+// with no image object or repack in between. It uses the libjpeg interface of libjpeg-turbo,
+// whose encoder is SIMD accelerated; LIBJPEG_TURBO_DIR is expected to name a directory with
+// jpeglib.h in include and jpeg.lib in lib.
+//
+// 8 bit DeviceGray, DeviceRGB, DeviceRGBA (the alpha is dropped) and DeviceCMYK bitmaps can
+// be written. CMYK is written inverted, with an Adobe marker, as Photoshop and most readers
+// expect.
+//
+
+#ifndef JPEGWRITER_H
+#define JPEGWRITER_H
+
+#include <string>
+
+#include "RenderPage.h"
+
+enum JpegSubsampling
+{
+	kJpegSubsample444,          // Full resolution color.
+	kJpegSubsample422,          // Half the color horizontally.
+	kJpegSubsample420           // Half the color both ways; the usual for photographs.
+};
+
+struct JpegWriteOptions
+{
+	int quality;                // 1 to 100.
+	JpegSubsampling subsampling;
+	bool progressive;
+
+	JpegWriteOptions() : quality(85), subsampling(kJpegSubsample420), progressive(false)
+	{
+	}
+};
+
+// Parse a -subsample argument: 444, 422 or 420. Returns false if it is none of them.
+bool ParseJpegSubsampling(const char* name, JpegSubsampling& subsampling);
+
+// True if WriteJpeg() can write a bitmap with this color space and depth.
+bool CanWriteJpeg(ASAtom colorSpace, ASInt32 bpc);
+
+// Write pixels to fileName. Returns false, with a message in error, if it can't.
+bool WriteJpeg(const std::string& fileName, const char* pixels, const RenderBitmapInfo& info,
+	const JpegWriteOptions& options, std::string& error);
+
+#endif // JPEGWRITER_H
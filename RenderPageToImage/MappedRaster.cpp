@@ -0,0 +1,274 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering into memory mapped from a temporary file. See MappedRaster.h.
+//
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "PERCalls.h"
+#include "APDFLDoc.h"
+
+#include "MappedRaster.h"
+
+static const ASUns64 k4GB = static_cast<ASUns64>(1) << 32;
+static const ASInt32 kCheckRows = 64;
+
+MappedRasterAllocator::MappedRasterAllocator()
+{
+}
+
+MappedRasterAllocator::~MappedRasterAllocator()
+{
+	while (!mappings.empty())
+		Free(mappings.begin()->first);
+}
+
+void MappedRasterAllocator::UseDirectory(const std::string& dir)
+{
+	directory = dir.empty() ? "." : dir;
+}
+
+#ifndef _WIN32
+
+char* MappedRasterAllocator::Allocate(ASSize_t size, const RenderBitmapInfo&)
+{
+	lastError.clear();
+	std::string pattern = directory + "/RenderPageToImage-XXXXXX";
+	std::vector<char> path(pattern.begin(), pattern.end());
+	path.push_back('\0');
+	int fd = mkstemp(&path[0]);
+	if (fd < 0)
+	{
+		lastError = "Unable to make a file in " + directory + ": " + strerror(errno);
+		return NULL;
+	}
+	// The file lives on, without a name, until it is closed.
+	unlink(&path[0]);
+
+	void* memory = MAP_FAILED;
+	if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+		memory = mmap(NULL, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED)
+	{
+		lastError = std::string("Unable to map a bitmap file: ") + strerror(errno);
+		close(fd);
+		return NULL;
+	}
+
+	Mapping mapping = { static_cast<size_t>(size), fd, NULL, NULL };
+	mappings[static_cast<char*>(memory)] = mapping;
+	return static_cast<char*>(memory);
+}
+
+void MappedRasterAllocator::Free(char* buffer)
+{
+	std::map<char*, Mapping>::iterator found = mappings.find(buffer);
+	if (found == mappings.end())
+		return;
+	munmap(buffer, found->second.size);
+	close(found->second.fd);
+	mappings.erase(found);
+}
+
+#else
+
+char* MappedRasterAllocator::Allocate(ASSize_t size, const RenderBitmapInfo&)
+{
+	lastError.clear();
+	char path[MAX_PATH];
+	if (GetTempFileNameA(directory.c_str(), "RPI", 0, path) == 0)
+	{
+		lastError = "Unable to make a file in " + directory;
+		return NULL;
+	}
+
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		lastError = std::string("Unable to open ") + path;
+		DeleteFileA(path);
+		return NULL;
+	}
+
+	// Without this, NTFS would write zeros over the whole file before mapping it.
+	DWORD returned = 0;
+	DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL);
+
+	ULARGE_INTEGER mappingSize;
+	mappingSize.QuadPart = static_cast<ULONGLONG>(size);
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, NULL);
+	void* memory = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size)) : NULL;
+	if (memory == NULL)
+	{
+		lastError = "Unable to map a bitmap file, error " + std::to_string(GetLastError());
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return NULL;
+	}
+
+	Mapping record = { static_cast<size_t>(size), -1, file, mapping };
+	mappings[static_cast<char*>(memory)] = record;
+	return static_cast<char*>(memory);
+}
+
+void MappedRasterAllocator::Free(char* buffer)
+{
+	std::map<char*, Mapping>::iterator found = mappings.find(buffer);
+	if (found == mappings.end())
+		return;
+	UnmapViewOfFile(buffer);
+	CloseHandle(static_cast<HANDLE>(found->second.mapping));
+	CloseHandle(static_cast<HANDLE>(found->second.file));
+	mappings.erase(found);
+}
+
+#endif
+
+// Draw rows top to bottom of the page on their own, placed as the bands of -schedule are, and
+// count those that differ from the same rows of whole by more than two levels in any byte,
+// which anti-aliasing at the edge of the band can account for.
+static int compareRows(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& pageParms, RenderPage& whole,
+	ASInt32 top, ASInt32 bottom)
+{
+	ASDoubleMatrix pageMatrix, inverseMatrix;
+	RenderPage::PageToImageMatrix(pdPage, &cropRect, pageParms.Resolution() / 72.0, &pageMatrix);
+	ASDoubleMatrixInvert(&inverseMatrix, &pageMatrix);
+
+	ASDoubleMatrix shift = { 1, 0, 0, 1, 0, static_cast<double>(-top) };
+	ASDoubleMatrix bandMatrix;
+	ASDoubleMatrixConcat(&bandMatrix, &shift, &pageMatrix);
+	ASDoubleRect destRect = { 0, static_cast<double>(bottom - top), static_cast<double>(whole.Width()), 0 };
+	ASDoubleRect bandPixels = { 0, static_cast<double>(top), static_cast<double>(whole.Width()), static_cast<double>(bottom) };
+	ASDoubleRect bandArea;
+	ASDoubleMatrixTransformRect(&bandArea, &inverseMatrix, &bandPixels);
+	ASDoubleRect pageRect = { ASFixedToFloat(cropRect.left), ASFixedToFloat(cropRect.top),
+		ASFixedToFloat(cropRect.right), ASFixedToFloat(cropRect.bottom) };
+	ASFixedRect bandRect = { FloatToASFixed((std::max)(bandArea.left, pageRect.left)), FloatToASFixed((std::min)(bandArea.top, pageRect.top)),
+		FloatToASFixed((std::min)(bandArea.right, pageRect.right)), FloatToASFixed((std::max)(bandArea.bottom, pageRect.bottom)) };
+
+	RenderPageParams parms = pageParms;
+	parms.setBufferAllocator(NULL);
+	parms.setMatrix(&bandMatrix);
+	parms.setDestRect(&destRect);
+	RenderPage band(pdPage, &bandRect, &parms);
+
+	RenderBitmapInfo info = whole.BitmapInfo();
+	ASSize_t usedBytes = (static_cast<ASSize_t>(info.width) * info.bpc * info.nComps + 7) / 8;
+	usedBytes = (std::min)(usedBytes, band.RowBytes());
+	ASInt32 numRows = (std::min)(bottom - top, band.Height());
+	const unsigned char* wholeBits = reinterpret_cast<const unsigned char*>(whole.GetImageBuffer());
+	const unsigned char* bandBits = reinterpret_cast<const unsigned char*>(band.GetImageBuffer());
+
+	int numDifferent = 0;
+	for (ASInt32 row = 0; row < numRows; row++)
+	{
+		const unsigned char* wholeRow = wholeBits + static_cast<ASSize_t>(top + row) * info.rowBytes;
+		const unsigned char* bandRow = bandBits + static_cast<ASSize_t>(row) * band.RowBytes();
+		for (ASSize_t i = 0; i < usedBytes; i++)
+		{
+			if (abs(static_cast<int>(wholeRow[i]) - static_cast<int>(bandRow[i])) > 2)
+			{
+				++numDifferent;
+				break;
+			}
+		}
+	}
+	return numDifferent;
+}
+
+int CheckMappedRaster(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& pageParms, MappedRasterAllocator& allocator)
+{
+	// The resolution for a bitmap a sixteenth past 4 GB, so that there are rows wholly beyond it.
+	double width = fabs(ASFixedToFloat(cropRect.right - cropRect.left));
+	double height = fabs(ASFixedToFloat(cropRect.top - cropRect.bottom));
+	double bytesPerPixel = pageParms.NumComps() * pageParms.BitsPerComponent() / 8.0;
+	if (width <= 0 || height <= 0 || bytesPerPixel <= 0)
+		return -1;
+	double resolution = 72.0 * sqrt(static_cast<double>(k4GB) * 1.0625 / (width * height * bytesPerPixel));
+
+	RenderPageParams parms = pageParms;
+	parms.setResolution(resolution);
+	parms.setMatrix(NULL);
+	parms.setDestRect(NULL);
+	parms.setBufferAllocator(&allocator);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ASFixedRect drawRect = cropRect;
+	RenderPage* whole = NULL;
+	ASErrorCode errCode = 0;
+	DURING
+		whole = new RenderPage(pdPage, &drawRect, &parms);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+	if (errCode != 0)
+	{
+		std::cout << "Drawing a bitmap past 4 GB at " << resolution << " dpi failed with code " << errCode;
+		if (!allocator.LastError().empty())
+			std::cout << ": " << allocator.LastError().c_str();
+		std::cout << std::endl;
+		return -1;
+	}
+	double drawTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ASUns64 size = static_cast<ASUns64>(whole->RowBytes()) * whole->Height();
+	std::cout << "Drew " << whole->Width() << " x " << whole->Height() << " at " << resolution << " dpi, "
+		<< size << " bytes, in " << drawTime << " s." << std::endl;
+	if (size <= k4GB + static_cast<ASUns64>(whole->RowBytes()) * kCheckRows)
+	{
+		std::cout << "The bitmap is not far enough past 4 GB to check." << std::endl;
+		delete whole;
+		return -1;
+	}
+
+	// The rows either side of the first one to start past 4 GB, and the last rows.
+	ASInt32 firstPast = static_cast<ASInt32>((k4GB + whole->RowBytes() - 1) / whole->RowBytes());
+	ASInt32 ranges[2][2] = { { firstPast - kCheckRows / 2, firstPast + kCheckRows / 2 },
+		{ whole->Height() - kCheckRows, whole->Height() } };
+	int numDifferent = 0;
+	errCode = 0;
+	DURING
+		for (int i = 0; i < 2; i++)
+		{
+			int different = compareRows(pdPage, cropRect, parms, *whole, ranges[i][0], ranges[i][1]);
+			std::cout << "Rows " << ranges[i][0] << " to " << ranges[i][1] - 1 << " (from byte "
+				<< static_cast<ASUns64>(ranges[i][0]) * whole->RowBytes() << "): " << different << " differ." << std::endl;
+			numDifferent += different;
+		}
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+	delete whole;
+
+	if (errCode != 0)
+	{
+		std::cout << "Drawing the rows to compare failed with code " << errCode << std::endl;
+		return -1;
+	}
+	return numDifferent;
+}
@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Drawing a page into memory mapped from a temporary file, for bitmaps bigger than the memory
+// there is to hold them: a wall-size drawing at print resolution can need well over 4 GB.
+//
+// The file is made the size of the bitmap without writing to it, so that it takes no disk
+// space until it is drawn into where the file system allows sparse files, and the system
+// pages the bitmap to and from it rather than to the swap file. It is deleted as soon as it
+// is made (POSIX) or when it is closed (Windows), so that nothing is left behind if the
+// sample stops part way.
+//
+// -mapbuffer <dir> makes the files in <dir>, which needs room for the whole bitmap.
+//
+// -mapcheck <dir> checks that a bitmap past 4 GB is drawn whole: the page is drawn into a
+// file in <dir>, at the resolution that makes its bitmap a little over 4 GB, and the rows
+// either side of the 4 GB mark and at the end of the bitmap are drawn again on their own and
+// compared with it. A row whose offset wrapped at 32 bits would be left undrawn, or drawn
+// over the start of the bitmap, and so differ.
+//
+
+#ifndef MAPPEDRASTER_H
+#define MAPPEDRASTER_H
+
+#include <map>
+#include <string>
+
+#include "RenderPage.h"
+
+class MappedRasterAllocator : public RenderBufferAllocator
+{
+public:
+	MappedRasterAllocator();
+	~MappedRasterAllocator();
+
+	void    UseDirectory(const std::string& dir);
+	bool    IsEnabled() const { return !directory.empty(); }
+
+	char*   Allocate(ASSize_t size, const RenderBitmapInfo& info);
+	void    Free(char* buffer);
+
+	// Why the last Allocate() failed.
+	const std::string& LastError() const { return lastError; }
+
+private:
+	struct Mapping
+	{
+		size_t  size;
+		int     fd;             // POSIX.
+		void*   file;           // Windows: the file and mapping handles.
+		void*   mapping;
+	};
+
+	std::string                 directory;      // Empty until UseDirectory().
+	std::map<char*, Mapping>    mappings;
+	std::string                 lastError;
+};
+
+// Draw the cropRect area of pdPage with parms (but for the resolution, matrix and destination)
+// into a bitmap of a little over 4 GB from allocator, and compare the rows around and past
+// 4 GB with the same rows drawn on their own. Returns the number of rows that differ, or -1
+// if the bitmap could not be made.
+int CheckMappedRaster(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& parms, MappedRasterAllocator& allocator);
+
+#endif // MAPPEDRASTER_H
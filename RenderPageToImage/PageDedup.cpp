@@ -0,0 +1,380 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Hashing pages to find those that draw the same. See PageDedup.h.
+//
+
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ASCalls.h"
+#include "CosCalls.h"
+#include "PDCalls.h"
+
+#include "PageDedup.h"
+
+static const int kMaxDepth = 32;
+
+// 64 bit FNV-1a, continued from hash.
+static unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static unsigned long long hashObj(unsigned long long hash, CosObj obj, int depth);
+
+struct HashEnumState
+{
+	unsigned long long hash;
+	bool isDict;
+	int depth;
+};
+
+static ASBool hashEntry(CosObj obj, CosObj value, void* clientData)
+{
+	HashEnumState* state = static_cast<HashEnumState*>(clientData);
+	if (state->isDict)
+	{
+		// The entries of a dictionary come in no set order, so their hashes are added up.
+		unsigned long long entry = hashObj(0xcbf29ce484222325ULL, obj, state->depth);
+		state->hash += hashObj(entry, value, state->depth);
+	}
+	else
+		state->hash = hashObj(state->hash, obj, state->depth);
+	return true;
+}
+
+// The value of obj, continued from hash. Indirect objects below the top are taken by their
+// object number, rather than their value.
+static unsigned long long hashObj(unsigned long long hash, CosObj obj, int depth)
+{
+	CosType type = CosObjGetType(obj);
+	hash = hashBytes(hash, &type, sizeof(type));
+	if (depth > 0 && CosObjIsIndirect(obj))
+	{
+		ASInt32 ref[2] = { CosObjGetID(obj), CosObjGetGeneration(obj) };
+		return hashBytes(hash, ref, sizeof(ref));
+	}
+
+	switch (type)
+	{
+	case CosInteger:
+	{
+		ASInt32 value = CosIntegerValue(obj);
+		return hashBytes(hash, &value, sizeof(value));
+	}
+	case CosFixed:
+	{
+		ASFixed value = CosFixedValue(obj);
+		return hashBytes(hash, &value, sizeof(value));
+	}
+	case CosBoolean:
+	{
+		unsigned char value = CosBooleanValue(obj) ? 1 : 0;
+		return hashBytes(hash, &value, sizeof(value));
+	}
+	case CosName:
+	{
+		const char* name = ASAtomGetString(CosNameValue(obj));
+		return hashBytes(hash, name, strlen(name) + 1);
+	}
+	case CosString:
+	{
+		ASTCount length = 0;
+		const char* value = CosStringValue(obj, &length);
+		hash = hashBytes(hash, &length, sizeof(length));
+		return hashBytes(hash, value, static_cast<size_t>(length));
+	}
+	case CosArray:
+	case CosDict:
+	{
+		if (depth >= kMaxDepth)
+			return hash;
+		HashEnumState state = { hash, type == CosDict, depth + 1 };
+		CosObjEnum(obj, hashEntry, &state);
+		return state.hash;
+	}
+	default:
+		return hash;
+	}
+}
+
+// The decoded bytes of a content stream, continued from hash; length is added to.
+static unsigned long long hashStream(unsigned long long hash, CosObj stream, unsigned long long& length)
+{
+	if (CosObjGetType(stream) != CosStream)
+		return hash;
+
+	char buffer[65536];
+	ASStm stm = CosStreamOpenStm(stream, cosOpenFiltered);
+	ASInt32 numRead;
+	while ((numRead = ASStmRead(buffer, 1, sizeof(buffer), stm)) > 0)
+	{
+		hash = hashBytes(hash, buffer, static_cast<size_t>(numRead));
+		length += static_cast<unsigned long long>(numRead);
+	}
+	ASStmClose(stm);
+	return hash;
+}
+
+static bool sameObj(CosObj a, CosObj b, int depth);
+
+struct CompareEnumState
+{
+	CosObj other;
+	int depth;
+	ASInt32 index;              // For arrays.
+	bool same;
+};
+
+static ASBool compareEntry(CosObj obj, CosObj value, void* clientData)
+{
+	CompareEnumState* state = static_cast<CompareEnumState*>(clientData);
+	if (CosObjGetType(state->other) == CosDict)
+	{
+		ASAtom key = CosNameValue(obj);
+		state->same = CosDictKnown(state->other, key) && sameObj(value, CosDictGet(state->other, key), state->depth);
+	}
+	else
+		state->same = sameObj(obj, CosArrayGet(state->other, state->index++), state->depth);
+	return state->same;
+}
+
+static ASBool countEntry(CosObj, CosObj, void* clientData)
+{
+	++*static_cast<ASInt32*>(clientData);
+	return true;
+}
+
+// Whether a and b have the same value, as hashObj() sees them: indirect objects below the
+// top must be the same object. Anything this does not know how to compare is taken to
+// differ, which only costs drawing a page that could have been skipped.
+static bool sameObj(CosObj a, CosObj b, int depth)
+{
+	CosType type = CosObjGetType(a);
+	if (CosObjGetType(b) != type)
+		return false;
+	if (depth > 0 && (CosObjIsIndirect(a) || CosObjIsIndirect(b)))
+		return CosObjIsIndirect(a) && CosObjIsIndirect(b)
+			&& CosObjGetID(a) == CosObjGetID(b) && CosObjGetGeneration(a) == CosObjGetGeneration(b);
+
+	switch (type)
+	{
+	case CosNull:
+		return true;
+	case CosInteger:
+		return CosIntegerValue(a) == CosIntegerValue(b);
+	case CosFixed:
+		return CosFixedValue(a) == CosFixedValue(b);
+	case CosBoolean:
+		return (CosBooleanValue(a) != 0) == (CosBooleanValue(b) != 0);
+	case CosName:
+		return CosNameValue(a) == CosNameValue(b);
+	case CosString:
+	{
+		ASTCount lengthA = 0, lengthB = 0;
+		const char* valueA = CosStringValue(a, &lengthA);
+		const char* valueB = CosStringValue(b, &lengthB);
+		return lengthA == lengthB && memcmp(valueA, valueB, static_cast<size_t>(lengthA)) == 0;
+	}
+	case CosArray:
+	case CosDict:
+	{
+		// Past the depth hashObj() goes to, the objects must be the very same.
+		if (depth >= kMaxDepth)
+			return CosObjEqual(a, b) != 0;
+		ASInt32 countA = 0, countB = 0;
+		CosObjEnum(a, countEntry, &countA);
+		CosObjEnum(b, countEntry, &countB);
+		if (countA != countB)
+			return false;
+		CompareEnumState state = { b, depth + 1, 0, true };
+		CosObjEnum(a, compareEntry, &state);
+		return state.same;
+	}
+	default:
+		return CosObjEqual(a, b) != 0;
+	}
+}
+
+// Reads the decoded bytes of a page's content streams as one run of bytes, however they are
+// split between streams.
+class ContentReader
+{
+public:
+	ContentReader(CosObj pageObj) : stm(NULL), next(0)
+	{
+		CosObj contents = CosDictGet(pageObj, ASAtomFromString("Contents"));
+		if (CosObjGetType(contents) == CosArray)
+		{
+			for (ASInt32 i = 0; i < CosArrayLength(contents); i++)
+				streams.push_back(CosArrayGet(contents, i));
+		}
+		else
+			streams.push_back(contents);
+	}
+
+	~ContentReader()
+	{
+		if (stm != NULL)
+			ASStmClose(stm);
+	}
+
+	// Fill buffer as far as the content goes; returns the number of bytes read.
+	size_t Read(char* buffer, size_t size)
+	{
+		size_t got = 0;
+		while (got < size)
+		{
+			if (stm == NULL)
+			{
+				while (next < streams.size() && CosObjGetType(streams[next]) != CosStream)
+					++next;
+				if (next == streams.size())
+					break;
+				stm = CosStreamOpenStm(streams[next++], cosOpenFiltered);
+			}
+			ASInt32 numRead = ASStmRead(buffer + got, 1, static_cast<ASTCount>(size - got), stm);
+			if (numRead <= 0)
+			{
+				ASStmClose(stm);
+				stm = NULL;
+				continue;
+			}
+			got += static_cast<size_t>(numRead);
+		}
+		return got;
+	}
+
+private:
+	std::vector<CosObj> streams;
+	ASStm stm;
+	size_t next;
+};
+
+// Whether two pages, whose hashes are the same, draw the same: compared byte for byte,
+// everything that went into the hash.
+static bool samePage(PDDoc pdDoc, ASInt32 pageA, ASInt32 pageB)
+{
+	bool same = false;
+	PDPage a = NULL, b = NULL;
+	DURING
+		a = PDDocAcquirePage(pdDoc, pageA);
+		b = PDDocAcquirePage(pdDoc, pageB);
+		CosObj objA = PDPageGetCosObj(a), objB = PDPageGetCosObj(b);
+
+		ASFixedRect boxesA[2], boxesB[2];
+		PDPageGetMediaBox(a, &boxesA[0]);
+		PDPageGetCropBox(a, &boxesA[1]);
+		PDPageGetMediaBox(b, &boxesB[0]);
+		PDPageGetCropBox(b, &boxesB[1]);
+		same = memcmp(boxesA, boxesB, sizeof(boxesA)) == 0 && PDPageGetRotate(a) == PDPageGetRotate(b)
+			&& sameObj(PDPageGetCosResources(a), PDPageGetCosResources(b), 0)
+			&& sameObj(CosDictGet(objA, ASAtomFromString("Annots")), CosDictGet(objB, ASAtomFromString("Annots")), 0)
+			&& sameObj(CosDictGet(objA, ASAtomFromString("Group")), CosDictGet(objB, ASAtomFromString("Group")), 0);
+
+		if (same)
+		{
+			ContentReader contentA(objA), contentB(objB);
+			std::vector<char> bufferA(65536), bufferB(65536);
+			while (same)
+			{
+				size_t gotA = contentA.Read(&bufferA[0], bufferA.size());
+				size_t gotB = contentB.Read(&bufferB[0], bufferB.size());
+				same = gotA == gotB && memcmp(&bufferA[0], &bufferB[0], gotA) == 0;
+				if (gotA < bufferA.size())
+					break;
+			}
+		}
+	HANDLER
+		same = false;
+	END_HANDLER
+	if (a != NULL)
+		PDPageRelease(a);
+	if (b != NULL)
+		PDPageRelease(b);
+	return same;
+}
+
+std::vector<ASInt32> FindDuplicatePages(PDDoc pdDoc, double& seconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	ASInt32 numPages = PDDocGetNumPages(pdDoc);
+	std::vector<ASInt32> original(numPages);
+	// Pages whose hashes are the same, but which turned out to differ, are all kept.
+	std::map<std::pair<unsigned long long, unsigned long long>, std::vector<ASInt32> > firstPages;
+
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		original[pageNum] = pageNum;
+
+		unsigned long long hash = 0xcbf29ce484222325ULL;
+		unsigned long long length = 0;
+		PDPage pdPage = NULL;
+		ASErrorCode errCode = 0;
+		DURING
+			pdPage = PDDocAcquirePage(pdDoc, pageNum);
+			CosObj pageObj = PDPageGetCosObj(pdPage);
+
+			CosObj contents = CosDictGet(pageObj, ASAtomFromString("Contents"));
+			if (CosObjGetType(contents) == CosArray)
+			{
+				for (ASInt32 i = 0; i < CosArrayLength(contents); i++)
+					hash = hashStream(hash, CosArrayGet(contents, i), length);
+			}
+			else
+				hash = hashStream(hash, contents, length);
+
+			hash = hashObj(hash, PDPageGetCosResources(pdPage), 0);
+			hash = hashObj(hash, CosDictGet(pageObj, ASAtomFromString("Annots")), 0);
+			hash = hashObj(hash, CosDictGet(pageObj, ASAtomFromString("Group")), 0);
+
+			ASFixedRect boxes[2];
+			PDPageGetMediaBox(pdPage, &boxes[0]);
+			PDPageGetCropBox(pdPage, &boxes[1]);
+			PDRotate rotation = PDPageGetRotate(pdPage);
+			hash = hashBytes(hash, boxes, sizeof(boxes));
+			hash = hashBytes(hash, &rotation, sizeof(rotation));
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+		if (pdPage != NULL)
+			PDPageRelease(pdPage);
+
+		// A page that cannot be read is left to be drawn, and to fail, on its own.
+		if (errCode != 0)
+			continue;
+
+		// A hash can be made to match, so a match is only taken once the pages are compared.
+		std::vector<ASInt32>& candidates = firstPages[std::make_pair(hash, length)];
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			if (samePage(pdDoc, candidates[i], pageNum))
+			{
+				original[pageNum] = candidates[i];
+				break;
+			}
+		}
+		if (original[pageNum] == pageNum)
+			candidates.push_back(pageNum);
+	}
+
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return original;
+}
@@ -0,0 +1,37 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Finding the pages of a document that draw the same, so that each is drawn only once.
+// Forms, statements and reports made from a template often repeat a page many times over.
+//
+// Each page is reduced to a 64 bit hash of everything its drawing depends on:
+//
+//   - the bytes of its content streams, decoded;
+//   - its resources (inherited or its own), its annotations and its transparency group,
+//     with indirect objects taken by object number, as the pages of a template share them;
+//   - its media box, crop box and rotation.
+//
+// Pages with the same hash and the same length of content are then compared, byte for byte
+// and entry by entry, and are only taken to be the same if nothing differs, so that a page
+// made to hash like another is still drawn. Two pages that draw alike but are built
+// differently (their own copies of a font, say) are not found, but that costs only the time
+// to draw them both.
+//
+
+#ifndef PAGEDEDUP_H
+#define PAGEDEDUP_H
+
+#include <vector>
+
+#include "PDFLExpT.h"
+
+// For each page of pdDoc, the number of the first page that draws the same: its own number
+// if it is the first. seconds is set to the time taken.
+std::vector<ASInt32> FindDuplicatePages(PDDoc pdDoc, double& seconds);
+
+#endif // PAGEDEDUP_H
@@ -0,0 +1,393 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering the pages of a document in stages that overlap. See PagePipeline.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PERCalls.h"
+#include "DLExtrasCalls.h"
+#include "InitializeLibrary.h"
+
+#include "BoundedQueue.h"
+#include "MemTrack.h"
+#include "PageDedup.h"
+#include "PagePipeline.h"
+
+typedef std::chrono::steady_clock PipelineClock;
+
+// One page on its way through the pipeline. The pixels are those RenderPage drew into; they
+// are handed on, not copied.
+struct PageRaster
+{
+	int pageNum;
+	RenderBitmapInfo info;
+	char* pixels;
+	ASSize_t size;
+	// info.colorSpace is an atom of the render thread's library, which the other stages must
+	// not use; they go by these instead.
+	std::string colorSpace;
+	bool hasAlpha;
+	std::vector<char> alpha;    // For DeviceRGBA, once repacked.
+
+	PageRaster() : pageNum(0), pixels(NULL), size(0), hasAlpha(false)
+	{
+		memset(&info, 0, sizeof(info));
+	}
+
+	~PageRaster()
+	{
+		free(pixels);
+	}
+};
+
+// Lets the render stage keep the bitmap of a RenderPage after the RenderPage is gone. The
+// bitmap is allocated with malloc, rather than ASmalloc, as it is freed on another thread.
+class HandoffAllocator : public RenderBufferAllocator
+{
+public:
+	HandoffAllocator() : last(NULL), taken(NULL)
+	{
+	}
+
+	char* Allocate(ASSize_t size, const RenderBitmapInfo& info)
+	{
+		last = static_cast<char*>(malloc(size));
+		lastInfo = info;
+		return last;
+	}
+
+	void Free(char* buffer)
+	{
+		if (buffer == taken)
+		{
+			taken = NULL;
+			return;
+		}
+		// A RenderPage that failed gives back its bitmap before it can be taken.
+		if (buffer == last)
+			last = NULL;
+		free(buffer);
+	}
+
+	// Take the last bitmap allocated. The RenderPage that drew it will leave it alone.
+	char* Take(RenderBitmapInfo& info)
+	{
+		taken = last;
+		last = NULL;
+		info = lastInfo;
+		return taken;
+	}
+
+private:
+	char* last;
+	char* taken;
+	RenderBitmapInfo lastInfo;
+};
+
+struct StageStats
+{
+	const char* name;
+	int numThreads;
+	int numPages;
+	double busy;                // Seconds spent working, over all of the stage's threads.
+	double waitForWork;         // Seconds spent waiting for the stage before.
+	double waitForRoom;         // Seconds spent waiting for the stage after.
+
+	StageStats(const char* stageName, int threads) : name(stageName), numThreads(threads), numPages(0),
+		busy(0), waitForWork(0), waitForRoom(0)
+	{
+	}
+
+	void Add(const StageStats& other)
+	{
+		numPages += other.numPages;
+		busy += other.busy;
+		waitForWork += other.waitForWork;
+		waitForRoom += other.waitForRoom;
+	}
+
+	void Report(double elapsed) const
+	{
+		double available = elapsed * numThreads;
+		std::cout << "  " << name << ": " << numPages << " pages, busy " << busy << " s ("
+			<< (available > 0 ? 100.0 * busy / available : 0.0) << "% of " << numThreads << " thread(s)), waited "
+			<< waitForWork << " s for work and " << waitForRoom << " s for room." << std::endl;
+	}
+};
+
+static std::string pageFileName(const PipelineJob& job, ASInt32 pageNum)
+{
+	return OutputFileNameWithSuffix(job.outputFile, "p" + std::to_string(pageNum + 1));
+}
+
+static double secondsSince(PipelineClock::time_point& start)
+{
+	PipelineClock::time_point now = PipelineClock::now();
+	double seconds = std::chrono::duration<double>(now - start).count();
+	start = now;
+	return seconds;
+}
+
+// Take the row padding off, and separate the alpha of RGBA, as GetPDEImage() does. This runs
+// on a thread with no library, so it makes no library calls.
+static void repackRaster(PageRaster* raster)
+{
+	const RenderBitmapInfo& info = raster->info;
+	ASSize_t usedBytes = (static_cast<ASSize_t>(info.width) * info.bpc * info.nComps) / 8;
+	if (usedBytes != info.rowBytes)
+	{
+		for (ASInt32 row = 1; row < info.height; row++)
+			memmove(&raster->pixels[row * usedBytes], &raster->pixels[row * info.rowBytes], usedBytes);
+		raster->size = usedBytes * info.height;
+	}
+
+	if (raster->hasAlpha)
+	{
+		ASSize_t numPixels = raster->size / 4;
+		raster->alpha.resize(numPixels);
+		char* color = raster->pixels;
+		for (ASSize_t i = 0; i < numPixels; i++)
+		{
+			color[(i * 3) + 0] = raster->pixels[(i * 4) + 0];
+			color[(i * 3) + 1] = raster->pixels[(i * 4) + 1];
+			color[(i * 3) + 2] = raster->pixels[(i * 4) + 2];
+			raster->alpha[i] = raster->pixels[(i * 4) + 3];
+		}
+		raster->size = numPixels * 3;
+	}
+}
+
+struct PipelineState
+{
+	const PipelineJob* job;
+	BoundedQueue<PageRaster*>* toRepack;
+	BoundedQueue<PageRaster*>* toWrite;
+	StageStats repackStats;
+	StageStats writeStats;
+	std::mutex lock;            // For writeStats and the report.
+	std::atomic<int> numFailed{ 0 };
+
+	PipelineState(int numWriters) : repackStats("repack", 1), writeStats("write", numWriters)
+	{
+	}
+};
+
+static void repackStage(PipelineState* state)
+{
+	MemTrackStage(kMemStageRepack);
+	PipelineClock::time_point mark = PipelineClock::now();
+	PageRaster* raster;
+	while (true)
+	{
+		bool more = state->toRepack->Pop(raster);
+		state->repackStats.waitForWork += secondsSince(mark);
+		if (!more)
+			break;
+
+		repackRaster(raster);
+		++state->repackStats.numPages;
+		state->repackStats.busy += secondsSince(mark);
+
+		state->toWrite->Push(raster);
+		state->repackStats.waitForRoom += secondsSince(mark);
+	}
+	state->toWrite->Close();
+}
+
+static void writeStage(PipelineState* state)
+{
+	StageStats stats("write", 1);
+
+	// Each thread needs its own initialization of the library.
+	APDFLib libInit;
+	if (libInit.isValid() == false)
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		std::cout << "Writer initialization failed with code " << libInit.getInitError() << std::endl;
+		// Keep the pipeline moving; the pages this thread would have written are lost.
+	}
+
+	PipelineClock::time_point mark = PipelineClock::now();
+	PageRaster* raster;
+	while (true)
+	{
+		bool more = state->toWrite->Pop(raster);
+		stats.waitForWork += secondsSince(mark);
+		if (!more)
+			break;
+
+		std::string fileName = pageFileName(*state->job, raster->pageNum);
+		ASErrorCode errCode = libInit.isValid() ? 0 : libInit.getInitError();
+		if (errCode == 0)
+		{
+			DURING
+				raster->info.colorSpace = ASAtomFromString(raster->colorSpace.c_str());
+				ExportBitmap(fileName, raster->pixels, raster->size, raster->info,
+					raster->alpha.empty() ? NULL : &raster->alpha[0], static_cast<ASSize_t>(raster->alpha.size()));
+			HANDLER
+				errCode = ERRORCODE;
+			END_HANDLER
+		}
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			std::lock_guard<std::mutex> guard(state->lock);
+			std::cout << "Writing " << fileName.c_str() << " failed: " << buf << std::endl;
+			++state->numFailed;
+		}
+
+		delete raster;
+		++stats.numPages;
+		stats.busy += secondsSince(mark);
+	}
+
+	std::lock_guard<std::mutex> guard(state->lock);
+	state->writeStats.Add(stats);
+}
+
+int RenderPagesPipelined(PDDoc pdDoc, PipelineJob& job)
+{
+	int numWriters = job.numThreads > 0 ? job.numThreads : 1;
+	BoundedQueue<PageRaster*> toRepack(job.queueDepth);
+	BoundedQueue<PageRaster*> toWrite(job.queueDepth);
+	PipelineState state(numWriters);
+	state.job = &job;
+	state.toRepack = &toRepack;
+	state.toWrite = &toWrite;
+	StageStats renderStats("render", 1);
+
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	HandoffAllocator handoff;
+	RenderPageParams parms = job.parms;
+	parms.setBufferAllocator(&handoff);
+
+	ASInt32 numPages = PDDocGetNumPages(pdDoc);
+	std::vector<ASInt32> original;
+	double hashTime = 0;
+	if (job.skipDuplicates)
+		original = FindDuplicatePages(pdDoc, hashTime);
+
+	PipelineClock::time_point start = PipelineClock::now();
+
+	std::thread repacker(repackStage, &state);
+	std::vector<std::thread> writers;
+	for (int i = 0; i < numWriters; i++)
+		writers.push_back(std::thread(writeStage, &state));
+
+	PipelineClock::time_point mark = PipelineClock::now();
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		if (!original.empty() && original[pageNum] != pageNum)
+			continue;
+
+		PageRaster* raster = new PageRaster;
+		raster->pageNum = pageNum;
+
+		PDPage pdPage = NULL;
+		ASErrorCode errCode = 0;
+		DURING
+			pdPage = PDDocAcquirePage(pdDoc, pageNum);
+			ASFixedRect cropRect;
+			PDPageGetCropBox(pdPage, &cropRect);
+			RenderPage drawPage(pdPage, &cropRect, &parms);
+			raster->size = drawPage.GetImageBufferSize();
+			raster->pixels = handoff.Take(raster->info);
+			raster->colorSpace = ASAtomGetString(raster->info.colorSpace);
+			raster->hasAlpha = (raster->info.colorSpace == sDeviceRGBA_K);
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+		if (pdPage != NULL)
+			PDPageRelease(pdPage);
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			{
+				std::lock_guard<std::mutex> guard(state.lock);
+				std::cout << "Rendering page " << pageNum + 1 << " failed: " << buf << std::endl;
+			}
+			++state.numFailed;
+			delete raster;
+			continue;
+		}
+
+		++renderStats.numPages;
+		renderStats.busy += secondsSince(mark);
+
+		toRepack.Push(raster);
+		renderStats.waitForRoom += secondsSince(mark);
+	}
+	toRepack.Close();
+
+	repacker.join();
+	for (size_t i = 0; i < writers.size(); i++)
+		writers[i].join();
+
+	double elapsed = std::chrono::duration<double>(PipelineClock::now() - start).count();
+	std::cout << "Rendered " << renderStats.numPages << " pages in " << elapsed << " s, " << job.queueDepth
+		<< " page(s) between stages:" << std::endl;
+	renderStats.Report(elapsed);
+	state.repackStats.Report(elapsed);
+	state.writeStats.Report(elapsed);
+
+	// The images of the repeated pages, now that those they repeat are written.
+	if (!original.empty())
+	{
+		mark = PipelineClock::now();
+		int numDuplicates = 0;
+		for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+		{
+			if (original[pageNum] == pageNum)
+				continue;
+			++numDuplicates;
+
+			std::string from = pageFileName(job, original[pageNum]);
+			std::string to = pageFileName(job, pageNum);
+			std::error_code err;
+			std::filesystem::remove(to, err);
+			err.clear();
+			std::filesystem::create_hard_link(from, to, err);
+			if (err)
+			{
+				err.clear();
+				std::filesystem::copy_file(from, to, err);
+			}
+			if (err)
+			{
+				std::cout << "Page " << pageNum + 1 << " repeats page " << original[pageNum] + 1 << ", but " << to.c_str()
+					<< " could not be made: " << err.message().c_str() << std::endl;
+				++state.numFailed;
+			}
+		}
+		double linkTime = secondsSince(mark);
+
+		// What the repeated pages would have cost, at the pace of the pages that were drawn.
+		double saved = renderStats.numPages > 0 ? elapsed * numDuplicates / renderStats.numPages : 0.0;
+		std::cout << numDuplicates << " of " << numPages << " pages (" << (numPages > 0 ? 100.0 * numDuplicates / numPages : 0.0)
+			<< "%) repeat an earlier page. Hashing took " << hashTime << " s and linking " << linkTime << " s, saving about "
+			<< saved - hashTime - linkTime << " s." << std::endl;
+	}
+
+	return state.numFailed;
+}
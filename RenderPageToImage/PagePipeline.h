@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering every page of a document to PNG files, with the work of a page split into
+// stages that run at the same time, on different pages:
+//
+//   render   draws the page, on the calling thread, which has the document open.
+//   repack   takes the padding off the rows of the bitmap, and the alpha out of RGBA.
+//   write    makes an image of the bitmap, compresses it and writes the file.
+//
+// While page n+1 is drawn, page n is repacked and page n-1 is written. The stages are joined
+// by queues of queueDepth pages; a stage that gets ahead waits for room, so that no more
+// than about 2 * queueDepth + numThreads + 2 bitmaps are held at once: those in the queues,
+// and one in each thread. Only the render stage uses the caller's document and its library.
+// The repack stage makes no library calls. The write stage runs on numThreads threads, each
+// with its own initialization of the library, and is handed only the pixels and the name of
+// their color space.
+//
+// The page <n> image is named after the output file, with "-p<n>" added. At the end, the
+// time each stage was busy, and waited for work or for room, is reported.
+//
+// With skipDuplicates, the pages are first hashed (see PageDedup.h), and a page that draws
+// the same as one before it is not drawn: once the pipeline is done, its image is made a
+// hard link to the earlier page's image, or a copy where links cannot be made.
+//
+
+#ifndef PAGEPIPELINE_H
+#define PAGEPIPELINE_H
+
+#include <string>
+
+#include "RenderWorkers.h"
+
+struct PipelineJob : PageRenderJob
+{
+	std::string outputFile;
+	size_t queueDepth;          // Pages held between one stage and the next.
+	bool skipDuplicates;        // Draw each page that repeats an earlier one only once.
+};
+
+// Returns the number of pages that failed.
+int RenderPagesPipelined(PDDoc pdDoc, PipelineJob& job);
+
+#endif // PAGEPIPELINE_H
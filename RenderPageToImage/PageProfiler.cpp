@@ -0,0 +1,676 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Counting what pages draw, and fitting render times to the counts. See PageProfiler.h.
+//
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "ASCalls.h"
+#include "CosCalls.h"
+#include "PDCalls.h"
+#include "PagePDECntCalls.h"
+
+#include "PageProfiler.h"
+
+// A page is "unexpected" if it takes this many times the predicted time, and this much longer.
+static const double kUnexpectedFactor = 3.0;
+static const double kUnexpectedMargin = 0.25;
+
+PageProfile::PageProfile() : pageNum(0), operators(0), pathSegments(0), textRuns(0), textChars(0), images(0),
+	imagesWithSMask(0), forms(0), transparencyGroups(0), softMasks(0), transparentFills(0), shadings(0),
+	patternFills(0), ocgs(0), annotations(0), outputPixels(0), countSeconds(0), renderSeconds(0),
+	predictedSeconds(0), failed(false)
+{
+}
+
+double PageProfile::Feature(int feature) const
+{
+	switch (feature)
+	{
+	case kCostOperators:
+		return operators / 1000.0;
+	case kCostPathSegments:
+		return pathSegments / 1000.0;
+	case kCostTextRuns:
+		return textRuns / 1000.0;
+	case kCostImagePixels:
+	{
+		unsigned long long pixels = 0;
+		for (std::map<std::string, unsigned long long>::const_iterator it = imagePixels.begin(); it != imagePixels.end(); ++it)
+			pixels += it->second;
+		return pixels / 1e6;
+	}
+	case kCostTransparency:
+		return static_cast<double>(transparencyGroups + softMasks + transparentFills);
+	case kCostShadings:
+		return static_cast<double>(shadings + patternFills);
+	case kCostOutputPixels:
+		return outputPixels / 1e6;
+	default:
+		return 0;
+	}
+}
+
+static bool isWhite(unsigned char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+static bool isRegular(unsigned char c)
+{
+	return !isWhite(c) && strchr("()<>[]{}/%", c) == NULL;
+}
+
+// The operators in the decoded bytes of a content stream: the keywords that are not
+// true, false or null. The data of inline images is skipped.
+static unsigned long long countOperators(const std::vector<char>& data)
+{
+	unsigned long long count = 0;
+	size_t n = data.size();
+	size_t i = 0;
+	while (i < n)
+	{
+		unsigned char c = static_cast<unsigned char>(data[i]);
+		if (isWhite(c))
+		{
+			++i;
+			continue;
+		}
+
+		switch (c)
+		{
+		case '%':
+			while (i < n && data[i] != '\n' && data[i] != '\r')
+				++i;
+			break;
+		case '(':
+		{
+			int depth = 0;
+			for (; i < n; i++)
+			{
+				if (data[i] == '\\')
+					++i;
+				else if (data[i] == '(')
+					++depth;
+				else if (data[i] == ')' && --depth == 0)
+				{
+					++i;
+					break;
+				}
+			}
+			break;
+		}
+		case '<':
+			if (i + 1 < n && data[i + 1] == '<')
+				i += 2;
+			else
+			{
+				while (i < n && data[i] != '>')
+					++i;
+				++i;
+			}
+			break;
+		case '/':
+			++i;
+			while (i < n && isRegular(static_cast<unsigned char>(data[i])))
+				++i;
+			break;
+		default:
+		{
+			size_t start = i;
+			while (i < n && isRegular(static_cast<unsigned char>(data[i])))
+				++i;
+			if (i == start)
+			{
+				++i;            // A delimiter: ) > [ ] { }
+				break;
+			}
+
+			if (isdigit(c) || c == '+' || c == '-' || c == '.')
+				break;
+			size_t length = i - start;
+			const char* token = &data[start];
+			if ((length == 4 && (memcmp(token, "true", 4) == 0 || memcmp(token, "null", 4) == 0))
+				|| (length == 5 && memcmp(token, "false", 5) == 0))
+				break;
+			++count;
+
+			// Inline image data runs from one byte after ID to an EI between white space.
+			if (length == 2 && token[0] == 'I' && token[1] == 'D')
+			{
+				i += 1;
+				while (i + 1 < n && !(data[i] == 'E' && data[i + 1] == 'I' && isWhite(static_cast<unsigned char>(data[i - 1]))
+					&& (i + 2 == n || isWhite(static_cast<unsigned char>(data[i + 2])))))
+					++i;
+				if (i + 1 < n)
+				{
+					i += 2;
+					++count;
+				}
+				else
+					i = n;
+			}
+			break;
+		}
+		}
+	}
+	return count;
+}
+
+// Add the decoded bytes of stream to data.
+static void readStream(CosObj stream, std::vector<char>& data)
+{
+	if (CosObjGetType(stream) != CosStream)
+		return;
+
+	char buffer[65536];
+	ASStm stm = CosStreamOpenStm(stream, cosOpenFiltered);
+	ASInt32 numRead;
+	while ((numRead = ASStmRead(buffer, 1, sizeof(buffer), stm)) > 0)
+		data.insert(data.end(), buffer, buffer + numRead);
+	ASStmClose(stm);
+	data.push_back('\n');
+}
+
+static bool isTransparencyGroup(CosObj obj)
+{
+	static const ASAtom sGroup_K = ASAtomFromString("Group");
+	static const ASAtom sS_K = ASAtomFromString("S");
+	static const ASAtom sTransparency_K = ASAtomFromString("Transparency");
+
+	CosObj group = CosDictGet(obj, sGroup_K);
+	if (CosObjGetType(group) != CosDict)
+		return false;
+	CosObj subtype = CosDictGet(group, sS_K);
+	return CosObjGetType(subtype) == CosName && CosNameValue(subtype) == sTransparency_K;
+}
+
+struct CountState
+{
+	PageProfile* profile;
+	std::map<ASInt32, unsigned long long> formOperators;    // By object number, as a form may be drawn many times.
+};
+
+static void countContent(PDEContent content, CountState& state);
+
+static void countGState(PDEElement element, PageProfile& profile)
+{
+	static const ASAtom sPattern_K = ASAtomFromString("Pattern");
+
+	PDEGraphicState gState;
+	if (!PDEElementGetGState(element, &gState, sizeof(gState)))
+		return;
+
+	if ((gState.fillColorSpec.space != NULL && PDEColorSpaceGetName(gState.fillColorSpec.space) == sPattern_K)
+		|| (gState.strokeColorSpec.space != NULL && PDEColorSpaceGetName(gState.strokeColorSpec.space) == sPattern_K))
+		++profile.patternFills;
+
+	if ((gState.wasSetFlags & kPDEExtGStateWasSet) && gState.extGState != NULL)
+	{
+		if (PDEExtGStateHasSoftMask(gState.extGState))
+			++profile.softMasks;
+		if (PDEExtGStateGetOpacityFill(gState.extGState) < fixedOne)
+			++profile.transparentFills;
+	}
+}
+
+static void countPath(PDEPath path, PageProfile& profile)
+{
+	ASUns32 size = PDEPathGetData(path, NULL, 0);
+	if (size == 0)
+		return;
+	std::vector<ASInt32> data(size / sizeof(ASInt32));
+	PDEPathGetData(path, &data[0], size);
+
+	// Each operator is followed by its operands: two fixed numbers to a point.
+	size_t i = 0;
+	while (i < data.size())
+	{
+		switch (data[i++])
+		{
+		case kPDEMoveTo:
+			i += 2;
+			break;
+		case kPDELineTo:
+			i += 2;
+			++profile.pathSegments;
+			break;
+		case kPDECurveTo:
+			i += 6;
+			++profile.pathSegments;
+			break;
+		case kPDECurveToV:
+		case kPDECurveToY:
+			i += 4;
+			++profile.pathSegments;
+			break;
+		case kPDERect:
+			i += 4;
+			profile.pathSegments += 4;
+			break;
+		case kPDEClosePath:
+			++profile.pathSegments;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+static void countImage(PDEImage image, PageProfile& profile)
+{
+	static const ASAtom sSMask_K = ASAtomFromString("SMask");
+
+	PDEImageAttrs attrs;
+	PDEImageGetAttrs(image, &attrs, sizeof(attrs));
+	++profile.images;
+
+	std::string colorSpace("ImageMask");
+	if (!(attrs.flags & kPDEImageIsMask))
+		colorSpace = ASAtomGetString(PDEColorSpaceGetName(PDEImageGetColorSpace(image)));
+	profile.imagePixels[colorSpace] += static_cast<unsigned long long>(attrs.width) * attrs.height;
+
+	if (attrs.flags & kPDEImageExternal)
+	{
+		CosObj imageObj;
+		PDEImageGetCosObj(image, &imageObj);
+		if (CosDictKnown(imageObj, sSMask_K))
+		{
+			++profile.imagesWithSMask;
+			++profile.softMasks;
+		}
+	}
+}
+
+static void countForm(PDEForm form, CountState& state)
+{
+	PageProfile& profile = *state.profile;
+	++profile.forms;
+
+	CosObj formObj;
+	PDEFormGetCosObj(form, &formObj);
+	if (isTransparencyGroup(formObj))
+		++profile.transparencyGroups;
+
+	ASInt32 id = CosObjGetID(formObj);
+	std::map<ASInt32, unsigned long long>::const_iterator known = state.formOperators.find(id);
+	if (known != state.formOperators.end())
+		profile.operators += known->second;
+	else
+	{
+		std::vector<char> data;
+		readStream(formObj, data);
+		unsigned long long operators = countOperators(data);
+		state.formOperators[id] = operators;
+		profile.operators += operators;
+	}
+
+	PDEContent content = PDEFormGetContent(form);
+	countContent(content, state);
+	PDERelease(reinterpret_cast<PDEObject>(content));
+}
+
+static void countContent(PDEContent content, CountState& state)
+{
+	PageProfile& profile = *state.profile;
+	ASInt32 numElems = PDEContentGetNumElems(content);
+	for (ASInt32 i = 0; i < numElems; i++)
+	{
+		PDEElement element = PDEContentGetElem(content, i);
+		switch (PDEObjectGetType(reinterpret_cast<PDEObject>(element)))
+		{
+		case kPDEPath:
+			countGState(element, profile);
+			countPath(reinterpret_cast<PDEPath>(element), profile);
+			break;
+		case kPDEText:
+			countGState(element, profile);
+			profile.textRuns += PDETextGetNumRuns(reinterpret_cast<PDEText>(element));
+			profile.textChars += PDETextGetNumChars(reinterpret_cast<PDEText>(element));
+			break;
+		case kPDEImage:
+			countGState(element, profile);
+			countImage(reinterpret_cast<PDEImage>(element), profile);
+			break;
+		case kPDEForm:
+			countGState(element, profile);
+			countForm(reinterpret_cast<PDEForm>(element), state);
+			break;
+		case kPDEShading:
+			countGState(element, profile);
+			++profile.shadings;
+			break;
+		case kPDEContainer:
+			countContent(PDEContainerGetContent(reinterpret_cast<PDEContainer>(element)), state);
+			break;
+		case kPDEGroup:
+			countContent(PDEGroupGetContent(reinterpret_cast<PDEGroup>(element)), state);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void CountPageContent(PDPage pdPage, PageProfile& profile)
+{
+	static const ASAtom sContents_K = ASAtomFromString("Contents");
+
+	CosObj pageObj = PDPageGetCosObj(pdPage);
+	CosObj contents = CosDictGet(pageObj, sContents_K);
+	std::vector<char> data;
+	if (CosObjGetType(contents) == CosArray)
+	{
+		for (ASInt32 i = 0; i < CosArrayLength(contents); i++)
+			readStream(CosArrayGet(contents, i), data);
+	}
+	else
+		readStream(contents, data);
+	profile.operators += countOperators(data);
+
+	if (isTransparencyGroup(pageObj))
+		++profile.transparencyGroups;
+
+	PDOCG* ocgs = PDPageGetOCGs(pdPage);
+	if (ocgs != NULL)
+	{
+		while (ocgs[profile.ocgs] != NULL)
+			++profile.ocgs;
+		ASfree(ocgs);
+	}
+	profile.annotations = PDPageGetNumAnnots(pdPage);
+
+	CountState state;
+	state.profile = &profile;
+	PDEContent content = PDPageAcquirePDEContent(pdPage, NULL);
+	ASErrorCode errCode = 0;
+	DURING
+		countContent(content, state);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+	PDPageReleasePDEContent(pdPage, NULL);
+	if (errCode != 0)
+		ASRaise(errCode);
+}
+
+PageCostModel::PageCostModel() : intercept(0), rSquared(0)
+{
+	for (int f = 0; f < kNumCostFeatures; f++)
+		weights[f] = 0;
+}
+
+const char* PageCostModel::FeatureName(int feature)
+{
+	static const char* names[kNumCostFeatures] =
+	{
+		"kiloOperators", "kiloPathSegments", "kiloTextRuns", "imageMegapixels", "transparency", "shadings", "outputMegapixels"
+	};
+	return (feature >= 0 && feature < kNumCostFeatures) ? names[feature] : "";
+}
+
+bool PageCostModel::Fit(const std::vector<PageProfile>& pages)
+{
+	const int n = kNumCostFeatures + 1;
+
+	// Each count is scaled to at most 1 for the fit, so that one small ridge term keeps it
+	// stable when a count is the same on every page, or never occurs.
+	double scale[kNumCostFeatures];
+	for (int f = 0; f < kNumCostFeatures; f++)
+		scale[f] = 0;
+	int numPages = 0;
+	double meanSeconds = 0;
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		if (pages[p].failed)
+			continue;
+		++numPages;
+		meanSeconds += pages[p].renderSeconds;
+		for (int f = 0; f < kNumCostFeatures; f++)
+			scale[f] = (std::max)(scale[f], pages[p].Feature(f));
+	}
+	if (numPages == 0)
+		return false;
+	meanSeconds /= numPages;
+	for (int f = 0; f < kNumCostFeatures; f++)
+	{
+		if (scale[f] <= 0)
+			scale[f] = 1;
+	}
+
+	// The normal equations, (X'X + lambda I) b = X'y, with the intercept not penalized.
+	double a[n][n + 1];
+	memset(a, 0, sizeof(a));
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		if (pages[p].failed)
+			continue;
+		double x[n];
+		x[0] = 1;
+		for (int f = 0; f < kNumCostFeatures; f++)
+			x[f + 1] = pages[p].Feature(f) / scale[f];
+		for (int j = 0; j < n; j++)
+		{
+			for (int k = 0; k < n; k++)
+				a[j][k] += x[j] * x[k];
+			a[j][n] += x[j] * pages[p].renderSeconds;
+		}
+	}
+	for (int j = 1; j < n; j++)
+		a[j][j] += 1e-4 * numPages;
+
+	// Gaussian elimination, with partial pivoting.
+	for (int col = 0; col < n; col++)
+	{
+		int pivot = col;
+		for (int row = col + 1; row < n; row++)
+		{
+			if (fabs(a[row][col]) > fabs(a[pivot][col]))
+				pivot = row;
+		}
+		if (fabs(a[pivot][col]) < 1e-12)
+			continue;
+		for (int k = 0; k <= n; k++)
+			std::swap(a[col][k], a[pivot][k]);
+		for (int row = 0; row < n; row++)
+		{
+			if (row == col)
+				continue;
+			double factor = a[row][col] / a[col][col];
+			for (int k = col; k <= n; k++)
+				a[row][k] -= factor * a[col][k];
+		}
+	}
+	double b[n];
+	for (int j = 0; j < n; j++)
+		b[j] = fabs(a[j][j]) < 1e-12 ? 0 : a[j][n] / a[j][j];
+
+	intercept = b[0];
+	for (int f = 0; f < kNumCostFeatures; f++)
+		weights[f] = b[f + 1] / scale[f];
+
+	double residual = 0;
+	double total = 0;
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		if (pages[p].failed)
+			continue;
+		double error = pages[p].renderSeconds - Predict(pages[p]);
+		residual += error * error;
+		total += (pages[p].renderSeconds - meanSeconds) * (pages[p].renderSeconds - meanSeconds);
+	}
+	rSquared = total > 0 ? 1 - residual / total : 1;
+	return true;
+}
+
+double PageCostModel::Predict(const PageProfile& page) const
+{
+	double seconds = intercept;
+	for (int f = 0; f < kNumCostFeatures; f++)
+		seconds += weights[f] * page.Feature(f);
+	return (std::max)(seconds, 0.0);
+}
+
+static std::string jsonString(const std::string& value)
+{
+	std::string quoted("\"");
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		unsigned char c = static_cast<unsigned char>(value[i]);
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += static_cast<char>(c);
+		}
+		else if (c < 0x20)
+		{
+			char escape[8];
+			sprintf(escape, "\\u%04x", c);
+			quoted += escape;
+		}
+		else
+			quoted += static_cast<char>(c);
+	}
+	return quoted + "\"";
+}
+
+static void writeJson(std::ostream& out, const std::string& documentName, const RenderPageParams& parms,
+	const PageCostModel& model, bool fitted, const std::vector<PageProfile>& pages, double slowSeconds)
+{
+	out << "{" << std::endl;
+	out << "  \"document\": " << jsonString(documentName) << "," << std::endl;
+	out << "  \"resolution\": " << parms.Resolution() << "," << std::endl;
+	out << "  \"colorSpace\": " << jsonString(ASAtomGetString(parms.ColorSpaceName())) << "," << std::endl;
+	out << "  \"bitsPerComponent\": " << parms.BitsPerComponent() << "," << std::endl;
+	out << "  \"slowSeconds\": " << slowSeconds << "," << std::endl;
+
+	if (fitted)
+	{
+		out << "  \"model\": { \"intercept\": " << model.Intercept();
+		for (int f = 0; f < kNumCostFeatures; f++)
+			out << ", \"" << PageCostModel::FeatureName(f) << "\": " << model.Weight(f);
+		out << ", \"rSquared\": " << model.RSquared() << " }," << std::endl;
+	}
+	else
+		out << "  \"model\": null," << std::endl;
+
+	out << "  \"pages\": [" << std::endl;
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		const PageProfile& page = pages[p];
+		out << "    { \"page\": " << page.pageNum + 1;
+		if (page.failed)
+			out << ", \"failed\": true";
+		else
+		{
+			out << ", \"operators\": " << page.operators << ", \"pathSegments\": " << page.pathSegments
+				<< ", \"textRuns\": " << page.textRuns << ", \"textChars\": " << page.textChars
+				<< ", \"images\": " << page.images << ", \"imagesWithSMask\": " << page.imagesWithSMask << ", \"imagePixels\": {";
+			for (std::map<std::string, unsigned long long>::const_iterator it = page.imagePixels.begin(); it != page.imagePixels.end(); ++it)
+				out << (it == page.imagePixels.begin() ? " " : ", ") << jsonString(it->first) << ": " << it->second;
+			out << (page.imagePixels.empty() ? "}" : " }")
+				<< ", \"forms\": " << page.forms << ", \"transparencyGroups\": " << page.transparencyGroups
+				<< ", \"softMasks\": " << page.softMasks << ", \"transparentFills\": " << page.transparentFills
+				<< ", \"shadings\": " << page.shadings << ", \"patternFills\": " << page.patternFills
+				<< ", \"ocgs\": " << page.ocgs << ", \"annotations\": " << page.annotations
+				<< ", \"outputPixels\": " << page.outputPixels << ", \"countSeconds\": " << page.countSeconds
+				<< ", \"renderSeconds\": " << page.renderSeconds << ", \"predictedSeconds\": " << page.predictedSeconds;
+
+			out << ", \"flags\": [";
+			bool slow = page.renderSeconds >= slowSeconds;
+			bool unexpected = fitted && page.renderSeconds > kUnexpectedFactor * page.predictedSeconds
+				&& page.renderSeconds - page.predictedSeconds > kUnexpectedMargin;
+			if (slow)
+				out << " \"slow\"";
+			if (unexpected)
+				out << (slow ? ", " : " ") << "\"unexpected\"";
+			out << (slow || unexpected ? " ]" : "]");
+		}
+		out << " }" << (p + 1 < pages.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+int ProfilePages(PDDoc pdDoc, const std::string& documentName, const RenderPageParams& parms,
+	const std::string& jsonFile, double slowSeconds)
+{
+	RenderPageParams renderParms = parms;
+	renderParms.setBufferAllocator(NULL);
+
+	ASInt32 numPages = PDDocGetNumPages(pdDoc);
+	std::vector<PageProfile> pages(numPages);
+	int numFailed = 0;
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		PageProfile& profile = pages[pageNum];
+		profile.pageNum = pageNum;
+
+		PDPage pdPage = NULL;
+		ASErrorCode errCode = 0;
+		DURING
+			pdPage = PDDocAcquirePage(pdDoc, pageNum);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			CountPageContent(pdPage, profile);
+			profile.countSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			ASFixedRect cropRect;
+			PDPageGetCropBox(pdPage, &cropRect);
+			start = std::chrono::steady_clock::now();
+			RenderPage drawPage(pdPage, &cropRect, &renderParms);
+			profile.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			profile.outputPixels = static_cast<unsigned long long>(drawPage.Width()) * drawPage.Height();
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+		if (pdPage != NULL)
+			PDPageRelease(pdPage);
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			std::cout << "Profiling page " << pageNum + 1 << " failed: " << buf << std::endl;
+			profile.failed = true;
+			++numFailed;
+			continue;
+		}
+		std::cout << "Page " << pageNum + 1 << ": " << profile.operators << " operators, drawn in "
+			<< profile.renderSeconds << " s." << std::endl;
+	}
+
+	PageCostModel model;
+	bool fitted = model.Fit(pages);
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		if (fitted && !pages[p].failed)
+			pages[p].predictedSeconds = model.Predict(pages[p]);
+	}
+	if (fitted)
+		std::cout << "Cost model fitted to " << numPages - numFailed << " pages, R squared " << model.RSquared() << "." << std::endl;
+
+	std::ofstream out(jsonFile.c_str());
+	if (out.is_open())
+		writeJson(out, documentName, parms, model, fitted, pages, slowSeconds);
+	if (!out.is_open() || !out.good())
+	{
+		std::cout << "Unable to write " << jsonFile.c_str() << std::endl;
+		++numFailed;
+	}
+	return numFailed;
+}
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Profiling pages, to tell in advance which will be slow to render. For each page, what
+// the page draws is counted:
+//
+//   - the operators in its content streams, and in those of the forms it draws;
+//   - path segments, text runs and characters;
+//   - image pixels, by color space, and images with soft masks;
+//   - transparency groups, soft masks and transparent fills;
+//   - shadings and pattern fills;
+//   - the optional content groups and annotations of the page.
+//
+// The page is then drawn with RenderPage, at the resolution, color space and flags
+// given, and the time taken is measured. A cost model, seconds as a weighted sum of the
+// counts, is fitted to the pages by least squares, and each page is reported, with its
+// counts, measured and predicted times, as JSON:
+//
+//   { "document": ..., "resolution": ..., "colorSpace": ..., "bitsPerComponent": ...,
+//     "model": { "intercept": ..., "operators": ..., ..., "rSquared": ... },
+//     "pages": [ { "page": 1, "operators": ..., ..., "renderSeconds": ...,
+//                  "predictedSeconds": ..., "flags": [ ... ] }, ... ] }
+//
+// A scheduler can apply the model's weights (seconds per unit of each count) to the
+// counts of pages it has not drawn. A page is flagged "slow" if it took at least
+// slowSeconds to draw, and "unexpected" if it took much longer than the model predicts.
+//
+
+#ifndef PAGEPROFILER_H
+#define PAGEPROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "PDFLExpT.h"
+
+#include "RenderPage.h"
+
+// The counts that go into the cost model, in the order of PageProfile::Feature().
+enum PageCostFeature
+{
+	kCostOperators,             // Thousands of content operators.
+	kCostPathSegments,          // Thousands of path segments.
+	kCostTextRuns,              // Thousands of text runs.
+	kCostImagePixels,           // Millions of image pixels.
+	kCostTransparency,          // Transparency groups, soft masks and transparent fills.
+	kCostShadings,              // Shadings and pattern fills.
+	kCostOutputPixels,          // Millions of pixels drawn.
+	kNumCostFeatures
+};
+
+struct PageProfile
+{
+	ASInt32 pageNum;
+	unsigned long long operators;
+	unsigned long long pathSegments;
+	unsigned long long textRuns;
+	unsigned long long textChars;
+	unsigned long long images;
+	unsigned long long imagesWithSMask;
+	std::map<std::string, unsigned long long> imagePixels;     // By color space name.
+	unsigned long long forms;
+	unsigned long long transparencyGroups;
+	unsigned long long softMasks;
+	unsigned long long transparentFills;
+	unsigned long long shadings;
+	unsigned long long patternFills;
+	ASInt32 ocgs;
+	ASInt32 annotations;
+	unsigned long long outputPixels;
+	double countSeconds;        // Time to count all of this.
+	double renderSeconds;
+	double predictedSeconds;
+	bool failed;
+
+	PageProfile();
+
+	double Feature(int feature) const;
+};
+
+class PageCostModel
+{
+public:
+	PageCostModel();
+
+	// Fit the weights to the pages that did not fail. Returns false if there are none.
+	bool Fit(const std::vector<PageProfile>& pages);
+	double Predict(const PageProfile& page) const;
+
+	double Intercept() const { return intercept; }
+	double Weight(int feature) const { return weights[feature]; }
+	double RSquared() const { return rSquared; }
+	static const char* FeatureName(int feature);
+
+private:
+	double intercept;
+	double weights[kNumCostFeatures];
+	double rSquared;
+};
+
+// Count what pdPage draws into profile. Raises if the page content cannot be read.
+void CountPageContent(PDPage pdPage, PageProfile& profile);
+
+// Profile and draw every page of pdDoc, fit the cost model and write the JSON report to
+// jsonFile. Returns the number of pages that failed.
+int ProfilePages(PDDoc pdDoc, const std::string& documentName, const RenderPageParams& parms,
+	const std::string& jsonFile, double slowSeconds);
+
+#endif // PAGEPROFILER_H
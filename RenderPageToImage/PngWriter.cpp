@@ -0,0 +1,308 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Writing PNG files with the compression spread over several threads. See PngWriter.h.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "zlib.h"
+
+#include "ASCalls.h"
+
+#include "PngWriter.h"
+
+// Deflate looks back at most this far, so this is all of a chunk that the next one needs.
+static const size_t kWindowSize = 32 * 1024;
+
+bool ParsePngFilter(const char* name, PngFilter& filter)
+{
+	static const struct { const char* name; PngFilter filter; } kFilters[] = {
+		{ "none", kPngFilterNone }, { "sub", kPngFilterSub }, { "up", kPngFilterUp },
+		{ "average", kPngFilterAverage }, { "paeth", kPngFilterPaeth }, { "adaptive", kPngFilterAdaptive }
+	};
+	for (size_t i = 0; i < sizeof(kFilters) / sizeof(kFilters[0]); i++)
+	{
+		if (strcmp(name, kFilters[i].name) == 0)
+		{
+			filter = kFilters[i].filter;
+			return true;
+		}
+	}
+	return false;
+}
+
+// The PNG color type for a color space, or -1 if PNG has none.
+static int pngColorType(ASAtom colorSpace)
+{
+	static const ASAtom sDeviceGray_K = ASAtomFromString("DeviceGray");
+	static const ASAtom sDeviceRGB_K = ASAtomFromString("DeviceRGB");
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	if (colorSpace == sDeviceGray_K)
+		return 0;
+	if (colorSpace == sDeviceRGB_K)
+		return 2;
+	if (colorSpace == sDeviceRGBA_K)
+		return 6;
+	return -1;
+}
+
+bool CanWritePng(ASAtom colorSpace, ASInt32 bpc)
+{
+	return bpc == 8 && pngColorType(colorSpace) >= 0;
+}
+
+static unsigned char paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return static_cast<unsigned char>(a);
+	return static_cast<unsigned char>(pb <= pc ? b : c);
+}
+
+// Filter one row with filter type, into out, which has room for the type byte and the row.
+// prior is the row above, or NULL for the first row.
+static void filterRow(int type, const unsigned char* row, const unsigned char* prior, size_t length, size_t bpp, unsigned char* out)
+{
+	*out++ = static_cast<unsigned char>(type);
+	for (size_t i = 0; i < length; i++)
+	{
+		int a = (i >= bpp) ? row[i - bpp] : 0;
+		int b = prior ? prior[i] : 0;
+		int c = (prior && i >= bpp) ? prior[i - bpp] : 0;
+		int predicted = 0;
+		switch (type)
+		{
+		case kPngFilterSub: predicted = a; break;
+		case kPngFilterUp: predicted = b; break;
+		case kPngFilterAverage: predicted = (a + b) / 2; break;
+		case kPngFilterPaeth: predicted = paeth(a, b, c); break;
+		}
+		out[i] = static_cast<unsigned char>(row[i] - predicted);
+	}
+}
+
+// The usual guess at which filter will compress best: the one whose output, taken as signed
+// bytes, is closest to zero.
+static void filterRowAdaptive(const unsigned char* row, const unsigned char* prior, size_t length, size_t bpp,
+	unsigned char* out, std::vector<unsigned char>& scratch)
+{
+	scratch.resize(length + 1);
+	unsigned long best = 0xFFFFFFFF;
+	for (int type = kPngFilterNone; type <= kPngFilterPaeth; type++)
+	{
+		filterRow(type, row, prior, length, bpp, &scratch[0]);
+		unsigned long sum = 0;
+		for (size_t i = 1; i <= length && sum < best; i++)
+			sum += (scratch[i] < 128) ? scratch[i] : 256 - scratch[i];
+		if (sum < best)
+		{
+			best = sum;
+			memcpy(out, &scratch[0], length + 1);
+		}
+	}
+}
+
+static void runOnThreads(int numThreads, size_t numItems, const std::function<void(size_t)>& work)
+{
+	std::atomic<size_t> next{ 0 };
+	std::function<void()> worker = [&]()
+	{
+		size_t item;
+		while ((item = next++) < numItems)
+			work(item);
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numThreads && static_cast<size_t>(i) < numItems; i++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+static void putUns32BE(std::vector<unsigned char>& out, unsigned long value)
+{
+	out.push_back(static_cast<unsigned char>(value >> 24));
+	out.push_back(static_cast<unsigned char>(value >> 16));
+	out.push_back(static_cast<unsigned char>(value >> 8));
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+static bool writeChunk(FILE* file, const char* type, const unsigned char* data, size_t length)
+{
+	std::vector<unsigned char> head;
+	putUns32BE(head, static_cast<unsigned long>(length));
+	head.insert(head.end(), type, type + 4);
+
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, reinterpret_cast<const Bytef*>(type), 4);
+	if (length > 0)
+		crc = crc32_z(crc, data, length);
+	std::vector<unsigned char> tail;
+	putUns32BE(tail, crc);
+
+	return fwrite(&head[0], 1, head.size(), file) == head.size()
+		&& (length == 0 || fwrite(data, 1, length, file) == length)
+		&& fwrite(&tail[0], 1, tail.size(), file) == tail.size();
+}
+
+bool WritePng(const std::string& fileName, const char* pixels, const RenderBitmapInfo& info,
+	const PngWriteOptions& options, std::string& error)
+{
+	int colorType = pngColorType(info.colorSpace);
+	if (!CanWritePng(info.colorSpace, info.bpc))
+	{
+		error = std::string("PNG cannot hold ") + ASAtomGetString(info.colorSpace) + " at this depth";
+		return false;
+	}
+	if (info.width <= 0 || info.height <= 0)
+	{
+		error = "Nothing to write";
+		return false;
+	}
+
+	int numThreads = options.numThreads;
+	if (numThreads <= 0)
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	size_t bpp = static_cast<size_t>(info.nComps);
+	size_t length = static_cast<size_t>(info.width) * bpp;
+	size_t rowsPerChunk = options.chunkSize / (length + 1);
+	if (rowsPerChunk < 1)
+		rowsPerChunk = 1;
+	size_t numRows = static_cast<size_t>(info.height);
+	size_t numChunks = (numRows + rowsPerChunk - 1) / rowsPerChunk;
+	const unsigned char* bitmap = reinterpret_cast<const unsigned char*>(pixels);
+
+	// Filter every chunk. Each row depends only on the unfiltered row above it.
+	std::vector<std::vector<unsigned char> > filtered(numChunks);
+	runOnThreads(numThreads, numChunks, [&](size_t chunk)
+	{
+		size_t firstRow = chunk * rowsPerChunk;
+		size_t lastRow = (std::min)(firstRow + rowsPerChunk, numRows);
+		std::vector<unsigned char>& out = filtered[chunk];
+		out.resize((lastRow - firstRow) * (length + 1));
+		std::vector<unsigned char> scratch;
+		for (size_t row = firstRow; row < lastRow; row++)
+		{
+			const unsigned char* rowBits = bitmap + row * info.rowBytes;
+			const unsigned char* prior = row > 0 ? rowBits - info.rowBytes : NULL;
+			unsigned char* rowOut = &out[(row - firstRow) * (length + 1)];
+			if (options.filter == kPngFilterAdaptive)
+				filterRowAdaptive(rowBits, prior, length, bpp, rowOut, scratch);
+			else
+				filterRow(options.filter, rowBits, prior, length, bpp, rowOut);
+		}
+	});
+
+	// Deflate every chunk, each primed with the end of the one before, so that the pieces
+	// join into a single stream.
+	std::vector<std::vector<unsigned char> > compressed(numChunks);
+	std::vector<uLong> checks(numChunks);
+	std::atomic<bool> failed{ false };
+	runOnThreads(numThreads, numChunks, [&](size_t chunk)
+	{
+		const std::vector<unsigned char>& in = filtered[chunk];
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		int strategy = (options.filter == kPngFilterNone) ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+		if (deflateInit2(&stream, options.level, Z_DEFLATED, -15, 8, strategy) != Z_OK)
+		{
+			failed = true;
+			return;
+		}
+		if (chunk > 0)
+		{
+			const std::vector<unsigned char>& before = filtered[chunk - 1];
+			size_t dictionarySize = (std::min)(before.size(), kWindowSize);
+			deflateSetDictionary(&stream, &before[before.size() - dictionarySize], static_cast<uInt>(dictionarySize));
+		}
+
+		std::vector<unsigned char>& out = compressed[chunk];
+		out.resize(deflateBound(&stream, static_cast<uLong>(in.size())) + 16);
+		stream.next_in = const_cast<Bytef*>(&in[0]);
+		stream.avail_in = static_cast<uInt>(in.size());
+		stream.next_out = &out[0];
+		stream.avail_out = static_cast<uInt>(out.size());
+		int result = deflate(&stream, chunk + 1 == numChunks ? Z_FINISH : Z_SYNC_FLUSH);
+		if ((result != Z_STREAM_END && result != Z_OK) || stream.avail_in != 0)
+			failed = true;
+		out.resize(stream.total_out);
+		deflateEnd(&stream);
+
+		checks[chunk] = adler32_z(adler32(0L, Z_NULL, 0), &in[0], in.size());
+	});
+	if (failed)
+	{
+		error = "Compression failed";
+		return false;
+	}
+
+	// The zlib wrapper: a header before the first piece, and the Adler-32 of everything after the last.
+	static const int kLevelFlags[] = { 0, 0, 1, 1, 1, 1, 2, 3, 3, 3 };
+	int level = (options.level < 0 || options.level > 9) ? 6 : options.level;
+	unsigned int zlibHeader = (0x78 << 8) | (kLevelFlags[level] << 6);
+	zlibHeader += 31 - (zlibHeader % 31);
+	compressed[0].insert(compressed[0].begin(), static_cast<unsigned char>(zlibHeader & 0xFF));
+	compressed[0].insert(compressed[0].begin(), static_cast<unsigned char>(zlibHeader >> 8));
+
+	uLong adler = checks[0];
+	for (size_t i = 1; i < numChunks; i++)
+		adler = adler32_combine(adler, checks[i], static_cast<z_off_t>(filtered[i].size()));
+	putUns32BE(compressed[numChunks - 1], adler);
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+	{
+		error = "Unable to create " + fileName;
+		return false;
+	}
+
+	static const unsigned char kSignature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool written = fwrite(kSignature, 1, sizeof(kSignature), file) == sizeof(kSignature);
+
+	std::vector<unsigned char> header;
+	putUns32BE(header, static_cast<unsigned long>(info.width));
+	putUns32BE(header, static_cast<unsigned long>(info.height));
+	header.push_back(8);
+	header.push_back(static_cast<unsigned char>(colorType));
+	header.push_back(0);        // Deflate
+	header.push_back(0);        // Adaptive filtering, one filter type per row
+	header.push_back(0);        // Not interlaced
+	written = written && writeChunk(file, "IHDR", &header[0], header.size());
+
+	std::vector<unsigned char> physical;
+	unsigned long pixelsPerMeter = static_cast<unsigned long>(info.resolution / 0.0254 + 0.5);
+	putUns32BE(physical, pixelsPerMeter);
+	putUns32BE(physical, pixelsPerMeter);
+	physical.push_back(1);      // Meters
+	written = written && writeChunk(file, "pHYs", &physical[0], physical.size());
+
+	for (size_t i = 0; i < numChunks && written; i++)
+		written = writeChunk(file, "IDAT", &compressed[i][0], compressed[i].size());
+	written = written && writeChunk(file, "IEND", NULL, 0);
+
+	if (fclose(file) != 0 || !written)
+	{
+		error = "Unable to write " + fileName;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// A PNG writer for large bitmaps that compresses on several threads at once, as pigz does.
+// The filtered rows are cut into chunks of about chunkSize bytes, and each chunk is deflated
+// on its own, primed with the last 32K of the chunk before it and ended with a sync flush,
+// so that the pieces join into one ordinary deflate stream. Each piece goes into the file
+// as an IDAT chunk of its own. The result is a little larger than deflating in one piece,
+// and takes about 1/numThreads of the time.
+//
+// Bitmaps are written as PDPageDrawContentsToMemoryWithParams() makes them: 8 bits per
+// component of DeviceGray, DeviceRGB or DeviceRGBA, with rows rowBytes apart. Other
+// bitmaps are left to DLExportPDEImage.
+//
+// This needs zlib. In the project, ZLIB_DIR is expected to name a directory with zlib.h in
+// include and zlib.lib in lib.
+//
+
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <string>
+
+#include "RenderPage.h"
+
+enum PngFilter
+{
+	kPngFilterNone = 0,
+	kPngFilterSub,
+	kPngFilterUp,
+	kPngFilterAverage,
+	kPngFilterPaeth,
+	kPngFilterAdaptive          // Per row, whichever of the others gives the smallest sum of differences.
+};
+
+struct PngWriteOptions
+{
+	int level;                  // zlib compression level, 0 to 9.
+	PngFilter filter;
+	int numThreads;             // 0 for one per core.
+	size_t chunkSize;           // Bytes of filtered rows per independently compressed piece.
+
+	PngWriteOptions() : level(6), filter(kPngFilterAdaptive), numThreads(0), chunkSize(1024 * 1024)
+	{
+	}
+};
+
+// Parse a -pngfilter argument. Returns false if it is not a filter name.
+bool ParsePngFilter(const char* name, PngFilter& filter);
+
+// True if WritePng() can write a bitmap with this color space and depth.
+bool CanWritePng(ASAtom colorSpace, ASInt32 bpc);
+
+// Write pixels to fileName. Returns false, with a message in error, if it can't.
+bool WritePng(const std::string& fileName, const char* pixels, const RenderBitmapInfo& info,
+	const PngWriteOptions& options, std::string& error);
+
+#endif // PNGWRITER_H
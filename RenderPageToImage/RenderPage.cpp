@@ -14,6 +14,8 @@
 #include <assert.h>
 #include <time.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 #include "ASCalls.h"
 #include "PDCalls.h"
@@ -21,6 +23,8 @@
 #include "PERCalls.h"
 #include "PEWCalls.h"
 
+#include "MemTrack.h"
+
 // These are utility routines to convert Rects and Matrices between ASDouble and
 // ASReal, and ASFixed.
 // ASFixed was the original method of specifing "real" numbers in APDFL. It is still widely present in APDFL interfaces, though it is 
@@ -291,6 +295,26 @@ AC_Profile RenderPageParams::getOutputProfile() const
 		return NULL;
 }
 
+void RenderPageParams::setBufferAllocator(RenderBufferAllocator* bufferAllocator)
+{
+	allocator = bufferAllocator;
+}
+
+RenderBufferAllocator* RenderPageParams::getBufferAllocator() const
+{
+	return allocator;
+}
+
+void RenderPageParams::setSeparationInk(PDPageInk ink)
+{
+	separationInk = ink;
+}
+
+PDPageInk RenderPageParams::SeparationInk() const
+{
+	return separationInk;
+}
+
 void RenderPageParams::setVerbose(ASBool verbose)
 {
 	bVerbose = verbose;
@@ -313,6 +337,75 @@ static ASBool renderpageCancelProc(void *clientData)
 	std::cout << ".";
 	return false;
 }
+
+// Set up the draw parameters that do not depend on the area being drawn. Redraw() uses the
+// same settings as the original rendering, so that redrawn areas match the rest of the page.
+static void initDrawParams(PDPageDrawMParamsRec& drawParams, RenderPageParams* parms, ASAtom csAtom, ASInt32 bpc)
+{
+	memset(&drawParams, 0, sizeof(PDPageDrawMParamsRec));
+	drawParams.size = sizeof(PDPageDrawMParamsRec);
+	drawParams.csAtom = csAtom;
+	drawParams.bpc = bpc;
+	drawParams.clientOCContext = parms->OCContext();
+	drawParams.iccProfile = parms->getOutputProfile();
+
+	// For this example we will smooth (anti-alias) all of the marks. For a given application,
+	// this may or may not be desireable. See the enumeration PDPageDrawSmoothFlags for the full set of options.
+	drawParams.smoothFlags = parms->SmoothFlags();
+
+	// The DoLazyErase flag is usually, if not always turned on, UseAnnotFaces will cause annotations
+	// in the page to be displayed, and kPDPageDsiplayOverprintPreview will display the page showing 
+	// overprinting. The precise meaning of these flags, as well as others that may be used here, can be
+	// seen in the definition of PDPageDrawFlags
+	drawParams.flags = parms->DrawFlags();
+
+	drawParams.renderIntent = parms->RenderIntent();
+
+	drawParams.progressProc = parms->verbose() ? renderpageProgressProc : NULL;
+	drawParams.cancelProc = parms->verbose() ? renderpageCancelProc : NULL;
+
+	// A separation is drawn as DeviceN with the one ink as its only colorant.
+	if (parms->SeparationInk() != NULL)
+	{
+		drawParams.inks = parms->SeparationInk();
+		drawParams.numInks = 1;
+	}
+}
+
+// Get the matrix that transforms user space coordinates to Image coordinates, taking into account page 
+// rotation. Note that page rotation is clockwise, so pdRotate90 is effectively a rotation of -90 degrees. 
+// Also note that Page coordinates have their origin in the lower-left while image coordinates have their 
+// origin in the upper-right, so the matrix must also mirror vertically.
+void RenderPage::PageToImageMatrix(PDPage pdPage, const ASFixedRect* fRectP, double scaleFactor, ASDoubleMatrix* matrix)
+{
+	PDRotate rotation = PDPageGetRotate(pdPage);
+	ASDoubleMatrix updateMatrix = { 1,0,0,1,0,0 };
+	ASDoubleMatrix flipMatrix = { 1, 0, 0, -1, 0, ASFixedToFloat(fRectP->top - fRectP->bottom) };
+
+	ASDoubleMatrix scaleMatrix = { scaleFactor, 0, 0, scaleFactor, 0, 0 };
+
+	switch (rotation)
+	{
+		//Note, rotation is clockwise.
+	case pdRotate0:
+		updateMatrix = { 1, 0, 0, 1, -ASFixedToFloat(fRectP->left), -ASFixedToFloat(fRectP->bottom) };
+		break;
+	case pdRotate90:
+		updateMatrix = { 0, -1, 1, 0, -ASFixedToFloat(fRectP->bottom), ASFixedToFloat(fRectP->right) };
+		flipMatrix.v = ASFixedToFloat(fRectP->right - fRectP->left);
+		break;
+	case pdRotate180:
+		updateMatrix = { -1, 0, 0, -1, ASFixedToFloat(fRectP->right), ASFixedToFloat(fRectP->top) };
+		break;
+	case pdRotate270:
+		updateMatrix = { 0, 1, -1, 0, ASFixedToFloat(fRectP->top), -ASFixedToFloat(fRectP->left) };
+		flipMatrix.v = ASFixedToFloat(fRectP->right - fRectP->left);
+		break;
+	}
+	ASDoubleMatrixConcat(&updateMatrix, &flipMatrix, &updateMatrix);
+	ASDoubleMatrixConcat(matrix, &scaleMatrix, &updateMatrix);
+}
+
 // This both constructs the RenderPage object, and creates the page rendering. 
 //  The rendered page can be accessed as a bitmap via the methods GetImageBuffer() and GetImageBufferSize(), or as a PDEImage, 
 //  via the method GetPDEImage(). The PDEImage creation will be deferred until it is requested.
@@ -340,7 +433,15 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	csAtom = parms->ColorSpaceName();
 	nComps = parms->NumComps();
 	// initialize the output colorspace for the PDEImage we'll generate in MakePDEImage
-	cs = PDEColorSpaceCreateFromName(csAtom);
+	if (parms->SeparationInk() != NULL)
+	{
+		// A separation has one component, the amount of its ink. As an image, it shows as gray.
+		csAtom = ASAtomFromString("DeviceN");
+		nComps = 1;
+		cs = PDEColorSpaceCreateFromName(ASAtomFromString("DeviceGray"));
+	}
+	else
+		cs = PDEColorSpaceCreateFromName(csAtom);
 
 	//The size of each color component to be represented in the image.
 	bpc = parms->BitsPerComponent();
@@ -351,11 +452,7 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	attrs.flags = kPDEImageExternal;
 	attrs.bitsPerComponent = bpc;
 
-	// Get the matrix that transforms user space coordinates to Image coordinates, taking into account page 
-	// rotation. Note that page rotation is clockwise, so pdRotate90 is effectively a rotation of -90 degrees. 
-	// Also note that Page coordinates have their origin in the lower-left while image coordinates have their 
-	// origin in the upper-right, so the matrix must also mirror vertically.
-	PDRotate rotation = PDPageGetRotate(pdPage);
+	// Get the matrix that transforms user space coordinates to Image coordinates, unless one was given.
 	ASDoubleMatrix updateMatrix = { 1,0,0,1,0,0 };
 	if (parms->getMatrix() != NULL)
 	{
@@ -369,31 +466,7 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	}
 	else
 	{
-		ASFixedRect* fRectP = fixedUpdateRect;
-		ASDoubleMatrix flipMatrix = { 1, 0, 0, -1, 0, ASFixedToFloat(fRectP->top - fRectP->bottom) };
-
-		ASDoubleMatrix scaleMatrix = { scaleFactor, 0, 0, scaleFactor, 0, 0 };
-
-		switch (rotation)
-		{
-			//Note, rotation is clockwise.
-		case pdRotate0:
-			updateMatrix = { 1, 0, 0, 1, -ASFixedToFloat(fRectP->left), -ASFixedToFloat(fRectP->bottom) };
-			break;
-		case pdRotate90:
-			updateMatrix = { 0, -1, 1, 0, -ASFixedToFloat(fRectP->bottom), ASFixedToFloat(fRectP->right) };
-			flipMatrix.v = ASFixedToFloat(fRectP->right - fRectP->left);
-			break;
-		case pdRotate180:
-			updateMatrix = { -1, 0, 0, -1, ASFixedToFloat(fRectP->right), ASFixedToFloat(fRectP->top) };
-			break;
-		case pdRotate270:
-			updateMatrix = { 0, 1, -1, 0, ASFixedToFloat(fRectP->top), -ASFixedToFloat(fRectP->left) };
-			flipMatrix.v = ASFixedToFloat(fRectP->right - fRectP->left);
-			break;
-		}
-		ASDoubleMatrixConcat(&updateMatrix, &flipMatrix, &updateMatrix);
-		ASDoubleMatrixConcat(&updateMatrix, &scaleMatrix, &updateMatrix);
+		PageToImageMatrix(pdPage, fixedUpdateRect, scaleFactor, &updateMatrix);
 	}
 
 	// Set up the destination rectangle. 
@@ -418,6 +491,14 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	assert(((ASInt32)realDestRect.left) == 0);
 	assert(((ASInt32)realDestRect.bottom) == 0);
 
+	// The size in pixels must fit the image attributes, or it would wrap around without notice.
+	// The destructor does not run for an object whose constructor raised, so release cs first.
+	if (realDestRect.right + 0.5 >= 2147483647.0 || realDestRect.top + 0.5 >= 2147483647.0)
+	{
+		PDERelease(reinterpret_cast<PDEObject>(cs));
+		cs = NULL;
+		ASRaise(genErrBadParm);
+	}
 	attrs.width = (ASInt32)floor(realDestRect.right + 0.5);
 	attrs.height = (ASInt32)floor(realDestRect.top + 0.5);
 
@@ -430,6 +511,9 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	ASDoubleRectToASReal(realUpdateRect, updateRect);
 	ASDoubleMatrixToASReal(realUpdateMatrix, updateMatrix);
 
+	// Kept for Redraw().
+	pageMatrix = updateMatrix;
+
 	//Allocate the buffer for storing the rendered page content
 	// It is important that ALL of the flags and options used in the actual draw be set the same here!
 	// Calling this interface with drawParms.bufferSize or drawParams.buffer equal to zero will return the size of the buffer
@@ -441,24 +525,7 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 		// the matrix and rects to be specified in floating point, eliminating the need
 		// to test for ASFixed Overflows.
 	PDPageDrawMParamsRec drawParams;
-	memset(&drawParams, 0, sizeof(PDPageDrawMParamsRec));
-	drawParams.size = sizeof(PDPageDrawMParamsRec);
-	drawParams.csAtom = csAtom;
-	drawParams.bpc = bpc;
-	drawParams.clientOCContext = parms->OCContext();
-	drawParams.iccProfile = parms->getOutputProfile();
-
-	// For this example we will smooth (anti-alias) all of the marks. For a given application,
-	// this may or may not be desireable. See the enumeration PDPageDrawSmoothFlags for the full set of options.
-	drawParams.smoothFlags = parms->SmoothFlags();
-
-	// The DoLazyErase flag is usually, if not always turned on, UseAnnotFaces will cause annotations
-	// in the page to be displayed, and kPDPageDsiplayOverprintPreview will display the page showing 
-	// overprinting. The precise meaning of these flags, as well as others that may be used here, can be
-	// seen in the definition of PDPageDrawFlags
-	drawParams.flags = parms->DrawFlags();
-
-	drawParams.renderIntent = parms->RenderIntent();
+	initDrawParams(drawParams, parms, csAtom, bpc);
 
 	drawParams.asRealDestRect = &realDestRect;                // This is where the image is drawn on the resultant bitmap.
 	//   It is generally set at 0, 0 and width/height in pixels.
@@ -466,29 +533,57 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 	// it will be the document media box, which is generally what is wanted.
 	drawParams.asRealMatrix = &realUpdateMatrix;             // the matrix is used to translate coordinates within the UpdateRect to pixels in the DestRect.
 
-	drawParams.progressProc = parms->verbose() ? renderpageProgressProc : NULL;
-	drawParams.cancelProc = parms->verbose() ? renderpageCancelProc : NULL;
-
 	// Additional values in this record control such features as drawing separations, 
 	// specifiying a desired output profile, selecting optional content, and providing for 
 	// a progress reporting callback.
 
-	bufferSize = PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);   // This call, with a NULL buffer pointer, returns needed buffer size
+	MemStage outerStage = MemTrackStage(kMemStageSizeQuery);
+	buffer = NULL;
+	ASErrorCode sizeError = 0;
+	DURING
+		bufferSize = PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);   // This call, with a NULL buffer pointer, returns needed buffer size
+
+		//  One frequent failure point in rendering images is being unable to allocate sufficient contiguous space 
+		//  for the bitmap buffer. Here, that will be indicated by a zero value for drawParams.buffer after the 
+		//  call to malloc. If the buffer size is larger than the internal limit of malloc, it may also raise an
+		//  interupt! Catch these conditions here, and raise an out of memory error to the caller.
+		padded = (((nComps % 4) != 0) ? true : false); //note: this flag is so we don't remove padding more than once,max.
+
+		// Work out the size the bitmap should be in 64 bits. If it cannot be addressed, or the library
+		// asks for less (as it would if its own arithmetic had wrapped), fail rather than draw a
+		// bitmap that is cut short.
+		ASUns64 bitsPerRow = static_cast<ASUns64>(attrs.width) * bpc * nComps;
+		ASUns64 neededSize = (padded ? ((bitsPerRow + 31) / 32) * 4 : bitsPerRow / 8) * static_cast<ASUns64>(attrs.height);
+		if (neededSize > static_cast<ASUns64>(static_cast<ASSize_t>(-1)) || static_cast<ASUns64>(bufferSize) < neededSize)
+			ASRaise(genErrNoMemory);
 
-	//  One frequent failure point in rendering images is being unable to allocate sufficient contiguous space 
-	//  for the bitmap buffer. Here, that will be indicated by a zero value for drawParams.buffer after the 
-	//  call to malloc. If the buffer size is larger than the internal limit of malloc, it may also raise an
-	//  interupt! Catch these conditions here, and raise an out of memory error to the caller.
-	try
-	{
-		buffer = (char*)ASmalloc(bufferSize);
-		if (!buffer)
+		allocator = parms->getBufferAllocator();
+		MemTrackStage(kMemStageDraw);
+		try
+		{
+			if (allocator != NULL)
+				buffer = allocator->Allocate(bufferSize, BitmapInfo());
+			else
+				buffer = (char*)ASmalloc(bufferSize);
+			if (!buffer)
+				ASRaise(genErrNoMemory);
+			memset(buffer, 0x7F, bufferSize);
+		}
+		catch (...)
+		{
 			ASRaise(genErrNoMemory);
-		memset(buffer, 0x7F, bufferSize);
-	}
-	catch (...)
+		}
+	HANDLER
+		sizeError = ERRORCODE;
+	END_HANDLER
+
+	// No bitmap was had, so only the color space and the stage need putting back.
+	if (sizeError != 0)
 	{
-		ASRaise(genErrNoMemory);
+		MemTrackStage(outerStage);
+		PDERelease(reinterpret_cast<PDEObject>(cs));
+		cs = NULL;
+		ASRaise(sizeError);
 	}
 
 	static const ASAtom atmDeviceRGBA = ASAtomFromString("DeviceRGBA");
@@ -499,7 +594,7 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 			 * what the RGB channels initialize too, as the alpha of zero
 			 * will make it transparent
 			 */
-		for (ASInt32 offset = 0; offset < bufferSize; offset += 4)
+		for (ASSize_t offset = 0; offset + 3 < bufferSize; offset += 4)
 		{
 			buffer[offset + 3] = 0x00;
 		}
@@ -511,10 +606,28 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 
 	// Render page content to the bitmap buffer
 	start_time[0] = clock();
-	PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);
+	ASErrorCode drawError = 0;
+	DURING
+		PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);
+	HANDLER
+		drawError = ERRORCODE;
+	END_HANDLER
 	stop_time[0] = clock();
+	MemTrackStage(outerStage);
 
-	padded = (((nComps % 4) != 0) ? true : false); //note: this flag is so we don't remove padding more than once,max.
+	// The destructor does not run for an object whose constructor raised, so give back the
+	// bitmap (to its allocator, which may have handed it out) and the color space here.
+	if (drawError != 0)
+	{
+		if (allocator != NULL)
+			allocator->Free(buffer);
+		else
+			ASfree(buffer);
+		buffer = NULL;
+		PDERelease(reinterpret_cast<PDEObject>(cs));
+		cs = NULL;
+		ASRaise(drawError);
+	}
 
 	if (parms->verbose())
 	{
@@ -528,7 +641,12 @@ RenderPage::RenderPage(PDPage& pdPage, ASFixedRect* fixedUpdateRect, RenderPageP
 RenderPage::~RenderPage() 
 { 
     if(buffer)
-        ASfree (buffer);
+    {
+        if (allocator != NULL)
+            allocator->Free(buffer);
+        else
+            ASfree (buffer);
+    }
     buffer = NULL;
 
     PDERelease(reinterpret_cast<PDEObject>(cs));
@@ -544,10 +662,223 @@ ASSize_t RenderPage::GetImageBufferSize() const
     return bufferSize;
 }
 
+ASInt32 RenderPage::Width() const
+{
+	return attrs.width;
+}
+
+ASInt32 RenderPage::Height() const
+{
+	return attrs.height;
+}
+
+// Rows are 32 bit aligned until GetPDEImage() strips the padding.
+ASSize_t RenderPage::RowBytes() const
+{
+	ASSize_t bitsPerRow = static_cast<ASSize_t>(attrs.width) * bpc * nComps;
+	return padded ? ((bitsPerRow + 31) / 32) * 4 : bitsPerRow / 8;
+}
+
+RenderBitmapInfo RenderPage::BitmapInfo() const
+{
+	RenderBitmapInfo info = { attrs.width, attrs.height, RowBytes(), csAtom, nComps, bpc, parms->Resolution() };
+	return info;
+}
+
+bool RenderPage::ReduceToBilevel()
+{
+	static const ASAtom sDeviceRGB_K = ASAtomFromString("DeviceRGB");
+	static const ASAtom sDeviceCMYK_K = ASAtomFromString("DeviceCMYK");
+	static const ASAtom sDeviceGray_K = ASAtomFromString("DeviceGray");
+
+	if (bpc != 8 || (csAtom != sDeviceGray_K && csAtom != sDeviceRGB_K && csAtom != sDeviceCMYK_K))
+		return false;
+
+	// Each packed row is no longer than the row it is made from, and is written no further
+	// on than the pixels already read, so the rows can be packed where they are.
+	ASSize_t fromRowBytes = RowBytes();
+	ASSize_t toRowBytes = (static_cast<ASSize_t>(attrs.width) + 7) / 8;
+	for (ASInt32 row = 0; row < attrs.height; row++)
+	{
+		const ASUns8* from = reinterpret_cast<ASUns8*>(buffer) + static_cast<ASSize_t>(row) * fromRowBytes;
+		ASUns8* to = reinterpret_cast<ASUns8*>(buffer) + static_cast<ASSize_t>(row) * toRowBytes;
+		ASUns8 bits = 0;
+		for (ASInt32 col = 0; col < attrs.width; col++, from += nComps)
+		{
+			int level;
+			if (csAtom == sDeviceGray_K)
+				level = from[0];
+			else if (csAtom == sDeviceRGB_K)
+				level = (30 * from[0] + 59 * from[1] + 11 * from[2]) / 100;
+			else
+			{
+				int ink = (30 * from[0] + 59 * from[1] + 11 * from[2]) / 100 + from[3];
+				level = ink < 255 ? 255 - ink : 0;
+			}
+
+			// In 1 bit DeviceGray, 1 is white.
+			if (level >= 128)
+				bits |= static_cast<ASUns8>(0x80 >> (col % 8));
+			if ((col % 8) == 7 || col == attrs.width - 1)
+			{
+				to[col / 8] = bits;
+				bits = 0;
+			}
+		}
+	}
+
+	PDERelease(reinterpret_cast<PDEObject>(cs));
+	csAtom = sDeviceGray_K;
+	cs = PDEColorSpaceCreateFromName(csAtom);
+	nComps = 1;
+	bpc = 1;
+	attrs.bitsPerComponent = 1;
+	bufferSize = toRowBytes * static_cast<ASSize_t>(attrs.height);
+	padded = false;
+	return true;
+}
+
+// Redraw the parts of the page under dirtyRects (in user space) into the existing bitmap,
+// leaving the rest of it as it is. Each area is drawn into a small bitmap of its own, with the
+// page matrix shifted so that the area is at the origin, and then copied row by row into place.
+// Areas that overlap enough to be cheaper drawn together are merged first. Returns the number
+// of pixels drawn.
+ASSize_t RenderPage::Redraw(PDPage pdPage, const ASFixedRect* dirtyRects, int numRects)
+{
+	struct PixelArea { ASInt32 left, top, right, bottom; };
+
+	// A region must start and end on a byte boundary to be copied with memcpy.
+	ASInt32 bitsPerPixel = bpc * nComps;
+	ASInt32 align = 1;
+	while (((align * bitsPerPixel) % 8) != 0)
+		align *= 2;
+
+	MemStage outerStage = MemTrackStage(kMemStageDraw);
+	std::vector<PixelArea> areas;
+	for (int i = 0; i < numRects; i++)
+	{
+		ASDoubleRect dirty;
+		ASFixedRect fixedDirty = dirtyRects[i];
+		ASFixedRectToASDouble(dirty, fixedDirty);
+		ASDoubleRect pixels;
+		ASDoubleMatrixTransformRect(&pixels, &pageMatrix, &dirty);
+
+		PixelArea area;
+		area.left = static_cast<ASInt32>(floor(pixels.left < pixels.right ? pixels.left : pixels.right));
+		area.right = static_cast<ASInt32>(ceil(pixels.left < pixels.right ? pixels.right : pixels.left));
+		area.top = static_cast<ASInt32>(floor(pixels.top < pixels.bottom ? pixels.top : pixels.bottom));
+		area.bottom = static_cast<ASInt32>(ceil(pixels.top < pixels.bottom ? pixels.bottom : pixels.top));
+
+		// Widen by a pixel for anti-aliasing at the edges, align, and clip to the bitmap.
+		area.left = ((area.left - 1) / align) * align;
+		area.right = ((area.right + 1 + align - 1) / align) * align;
+		area.top -= 1;
+		area.bottom += 1;
+		if (area.left < 0) area.left = 0;
+		if (area.top < 0) area.top = 0;
+		if (area.right > attrs.width) area.right = attrs.width;
+		if (area.bottom > attrs.height) area.bottom = attrs.height;
+		if (area.left < area.right && area.top < area.bottom)
+			areas.push_back(area);
+	}
+
+	// Merge any two areas whose bounding box is no bigger than the two of them apart.
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < areas.size() && !merged; i++)
+		{
+			for (size_t j = i + 1; j < areas.size() && !merged; j++)
+			{
+				PixelArea both = { (std::min)(areas[i].left, areas[j].left), (std::min)(areas[i].top, areas[j].top),
+					(std::max)(areas[i].right, areas[j].right), (std::max)(areas[i].bottom, areas[j].bottom) };
+				double sizeI = static_cast<double>(areas[i].right - areas[i].left) * (areas[i].bottom - areas[i].top);
+				double sizeJ = static_cast<double>(areas[j].right - areas[j].left) * (areas[j].bottom - areas[j].top);
+				double sizeBoth = static_cast<double>(both.right - both.left) * (both.bottom - both.top);
+				if (sizeBoth <= sizeI + sizeJ)
+				{
+					areas[i] = both;
+					areas.erase(areas.begin() + j);
+					merged = true;
+				}
+			}
+		}
+	}
+
+	ASDoubleMatrix inverseMatrix;
+	ASDoubleMatrixInvert(&inverseMatrix, &pageMatrix);
+	ASSize_t rowBytes = RowBytes();
+	ASSize_t pixelsDrawn = 0;
+
+	static const ASAtom atmDeviceRGBA = ASAtomFromString("DeviceRGBA");
+	for (size_t i = 0; i < areas.size(); i++)
+	{
+		const PixelArea& area = areas[i];
+		ASInt32 areaWidth = area.right - area.left;
+		ASInt32 areaHeight = area.bottom - area.top;
+
+		// The page matrix, shifted so that the area is at the origin of its own bitmap.
+		ASDoubleMatrix shift = { 1, 0, 0, 1, static_cast<double>(-area.left), static_cast<double>(-area.top) };
+		ASDoubleMatrix areaMatrix;
+		ASDoubleMatrixConcat(&areaMatrix, &shift, &pageMatrix);
+		ASDoubleRect destRect = { 0, static_cast<double>(areaHeight), static_cast<double>(areaWidth), 0 };
+		ASDoubleRect areaPixels = { static_cast<double>(area.left), static_cast<double>(area.top),
+			static_cast<double>(area.right), static_cast<double>(area.bottom) };
+		ASDoubleRect areaUpdate;
+		ASDoubleMatrixTransformRect(&areaUpdate, &inverseMatrix, &areaPixels);
+
+		ASRealRect realDestRect, realUpdateRect;
+		ASRealMatrix realAreaMatrix;
+		ASDoubleRectToASReal(realDestRect, destRect);
+		ASDoubleRectToASReal(realUpdateRect, areaUpdate);
+		ASDoubleMatrixToASReal(realAreaMatrix, areaMatrix);
+
+		PDPageDrawMParamsRec drawParams;
+		initDrawParams(drawParams, parms, csAtom, bpc);
+		drawParams.asRealDestRect = &realDestRect;
+		drawParams.asRealUpdateRect = &realUpdateRect;
+		drawParams.asRealMatrix = &realAreaMatrix;
+
+		ASSize_t areaSize = PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);
+		char* areaBuffer = (char*)ASmalloc(areaSize);
+		if (!areaBuffer)
+			ASRaise(genErrNoMemory);
+		// As in the constructor; with alpha, anything not drawn is transparent.
+		memset(areaBuffer, (csAtom == atmDeviceRGBA) ? 0x00 : 0x7F, areaSize);
+		drawParams.bufferSize = areaSize;
+		drawParams.buffer = areaBuffer;
+		ASErrorCode drawError = 0;
+		DURING
+			PDPageDrawContentsToMemoryWithParams(pdPage, &drawParams);
+		HANDLER
+			drawError = ERRORCODE;
+		END_HANDLER
+		if (drawError != 0)
+		{
+			ASfree(areaBuffer);
+			MemTrackStage(outerStage);
+			ASRaise(drawError);
+		}
+
+		ASSize_t areaRowBytes = ((static_cast<ASSize_t>(areaWidth) * bitsPerPixel + 31) / 32) * 4;
+		ASSize_t copyBytes = static_cast<ASSize_t>(areaWidth) * bitsPerPixel / 8;
+		ASSize_t firstByte = static_cast<ASSize_t>(area.left) * bitsPerPixel / 8;
+		for (ASInt32 row = 0; row < areaHeight; row++)
+			memcpy(&buffer[(static_cast<ASSize_t>(area.top + row) * rowBytes) + firstByte], &areaBuffer[static_cast<ASSize_t>(row) * areaRowBytes], copyBytes);
+
+		ASfree(areaBuffer);
+		pixelsDrawn += static_cast<ASSize_t>(areaWidth) * areaHeight;
+	}
+
+	MemTrackStage(outerStage);
+	return pixelsDrawn;
+}
+
 // This method will scale the image to fit the imageRect.  
 // If the ImageRect does not have the same aspect ratio as the original updateRect,
 // then the image will appear distorted.
-PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
+PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect, PDEFilterArray* filters)
 {
 	// Set up the static colorspace atoms
 	static const ASAtom sDeviceRGB_K = ASAtomFromString("DeviceRGB");
@@ -555,6 +886,8 @@ PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
 	static const ASAtom sDeviceGray_K = ASAtomFromString("DeviceGray");
 	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
 
+	MemStage outerStage = MemTrackStage(kMemStageRepack);
+
 	// The bitmap data generated by PDPageDrawContentsTo* uses 32-bit aligned rows. 
 	// The PDF image operator expects, however, 8-bit aligned image rows. 
 	// To remedy this difference, we check to see if the 32-bit aligned width
@@ -562,14 +895,14 @@ PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
 	// stripping off the padding at the end of each row.
 	if (padded)
 	{
-		ASSize_t createdWidth = (((static_cast<ASSize_t>(attrs.width * bpc * nComps) + 31) / 32) * 4);
-		ASSize_t desiredWidth = static_cast<ASSize_t>(attrs.width * bpc * nComps) / 8;
+		ASSize_t createdWidth = (((static_cast<ASSize_t>(attrs.width) * bpc * nComps + 31) / 32) * 4);
+		ASSize_t desiredWidth = static_cast<ASSize_t>(attrs.width) * bpc * nComps / 8;
 
 		if (createdWidth != desiredWidth)
 		{
-			for (int row = 1; row < attrs.height; row++)
-				memmove(&buffer[row * desiredWidth], &buffer[row * createdWidth], desiredWidth);
-			bufferSize = static_cast<ASSize_t>(desiredWidth * attrs.height);
+			for (ASInt32 row = 1; row < attrs.height; row++)
+				memmove(&buffer[static_cast<ASSize_t>(row) * desiredWidth], &buffer[static_cast<ASSize_t>(row) * createdWidth], desiredWidth);
+			bufferSize = desiredWidth * static_cast<ASSize_t>(attrs.height);
 		}
 		padded = false;
 	}
@@ -595,11 +928,19 @@ PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
 		ASSize_t ColorSize = bufferSize - AlphaSize;
 
 		/* Allocate alpha and color buffers */
-		ASUns8* ColorBuffer = reinterpret_cast<ASUns8*>(ASmalloc(static_cast<ASSize_t>(attrs.width *attrs.height * 3)));
-		ASUns8* AlphaBuffer = reinterpret_cast<ASUns8*>(ASmalloc(static_cast<ASSize_t>(attrs.width * attrs.height)));
+		ASUns8* ColorBuffer = reinterpret_cast<ASUns8*>(ASmalloc(ColorSize));
+		ASUns8* AlphaBuffer = reinterpret_cast<ASUns8*>(ASmalloc(AlphaSize));
+		if (ColorBuffer == NULL || AlphaBuffer == NULL)
+		{
+			if (ColorBuffer != NULL)
+				ASfree(ColorBuffer);
+			if (AlphaBuffer != NULL)
+				ASfree(AlphaBuffer);
+			ASRaise(genErrNoMemory);
+		}
 
 		/* Do the separation - this is not an optimized implementation */
-		for (ASInt32 Index = 0; Index < AlphaSize; Index++)
+		for (ASSize_t Index = 0; Index < AlphaSize; Index++)
 		{
 			ColorBuffer[(Index * 3) + 0] = buffer[(Index * 4) + 0];
 			ColorBuffer[(Index * 3) + 1] = buffer[(Index * 4) + 1];
@@ -625,7 +966,7 @@ PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
 			0,
 			cs1,
 			NULL,
-			NULL,
+			filters,
 			0,
 			ColorBuffer,
 			ColorSize);
@@ -644,11 +985,12 @@ PDEImage RenderPage::GetPDEImage(ASFixedRect imageRect)
 			0,
 			cs,
 			NULL,
-			NULL,
+			filters,
 			0,
 			reinterpret_cast<ASUns8*>(buffer),
 			bufferSize);
 	}
 
+	MemTrackStage(outerStage);
     return image;
 }
@@ -9,12 +9,35 @@
 // This file contains declarations for the RenderPage class.
 //
 
+#ifndef RENDERPAGE_H
+#define RENDERPAGE_H
+
 #include <stdio.h>
 #include <string.h>
 
 #include "PDFLExpT.h"
 #include "AcroColorExpT.h"
 
+// What is known of a bitmap when it is allocated: enough for a consumer to read it.
+struct RenderBitmapInfo
+{
+	ASInt32             width, height;
+	ASSize_t            rowBytes;       // Rows are padded to 32 bits, unless nComps is a multiple of 4.
+	ASAtom              colorSpace;
+	ASInt32             nComps, bpc;
+	double              resolution;     // Pixels per inch.
+};
+
+// Allocates the bitmap that a RenderPage draws into. Without one, it is allocated with ASmalloc.
+// The allocator must outlive the RenderPage objects that use it.
+class RenderBufferAllocator
+{
+public:
+	virtual ~RenderBufferAllocator() {}
+	// Return size bytes for the bitmap described by info, or NULL if they cannot be had.
+	virtual char*   Allocate(ASSize_t size, const RenderBitmapInfo& info) = 0;
+	virtual void    Free(char* buffer) = 0;
+};
 
 class RenderPageParams
 {
@@ -31,6 +54,8 @@ private:
 	ASDoubleMatrix*		matrix;
 	ASDoubleRect*		destRect;
 	AC_Profile			outputProfile{ nullptr };
+	RenderBufferAllocator*	allocator{ nullptr };
+	PDPageInk			separationInk{ nullptr };
 
 public:
 	RenderPageParams();
@@ -70,6 +95,14 @@ public:
 
 	void			setOutputProfile(AC_Profile profile);
 	AC_Profile		getOutputProfile() const;
+
+	void			setBufferAllocator(RenderBufferAllocator* allocator);
+	RenderBufferAllocator*	getBufferAllocator() const;
+
+	// Draw only this ink, as a separation: one component, the amount of the ink, whatever
+	// the color space. The ink record must outlive the RenderPage objects that use it.
+	void			setSeparationInk(PDPageInk ink);
+	PDPageInk		SeparationInk() const;
 };
 
 class RenderPage 
@@ -86,6 +119,8 @@ private:
 	ASUns32				smoothFlags;
     char*               buffer; 
 	bool				padded;
+	RenderBufferAllocator*	allocator;	// NULL if the buffer is from ASmalloc.
+	ASDoubleMatrix		pageMatrix;		// User space to bitmap, as drawn.
 	
 public:
 	RenderPage(PDPage &pdPage, ASFixedRect* updateRect, RenderPageParams* parms);
@@ -94,5 +129,26 @@ public:
 
     char*               GetImageBuffer();
     ASSize_t             GetImageBufferSize() const;
-    PDEImage            GetPDEImage(ASFixedRect ImageRect);
+    // The bitmap as an image of ImageRect. With filters, the image data is compressed with them.
+    PDEImage            GetPDEImage(ASFixedRect ImageRect, PDEFilterArray* filters = NULL);
+
+	// Threshold the bitmap, in place, to 1 bit DeviceGray: pixels darker than mid gray become
+	// black, the rest white. Only 8 bit DeviceGray, DeviceRGB and DeviceCMYK bitmaps can be
+	// reduced; returns false, and leaves the bitmap as it is, for others.
+	bool				ReduceToBilevel();
+
+	ASInt32				Width() const;
+	ASInt32				Height() const;
+	ASSize_t			RowBytes() const;
+	RenderBitmapInfo	BitmapInfo() const;
+
+	// Redraw only the parts of the page under dirtyRects (in user space) into the bitmap,
+	// after the page has been changed. Returns the number of pixels drawn.
+	ASSize_t			Redraw(PDPage pdPage, const ASFixedRect* dirtyRects, int numRects);
+
+	// The matrix from the user space of pdPage to the pixels of an image of updateRect at
+	// scaleFactor pixels per point, with the page rotation applied.
+	static void         PageToImageMatrix(PDPage pdPage, const ASFixedRect* updateRect, double scaleFactor, ASDoubleMatrix* matrix);
 };
+
+#endif // RENDERPAGE_H
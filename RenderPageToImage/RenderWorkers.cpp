@@ -0,0 +1,526 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering of one page many times over, by several threads. See RenderWorkers.h.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "PERCalls.h"
+#include "DLExtrasCalls.h"
+#include "AcroColorCalls.h"
+#include "APDFLDoc.h"
+#include "InitializeLibrary.h"
+
+#include "MemTrack.h"
+#include "RenderWorkers.h"
+
+ASPathName CreateOutputPath(const std::string& fileName)
+{
+	// The names are narrow strings, from the command line or made from it, so are taken as UTF-8.
+	ASText textToCreatePath = ASTextFromUnicode(reinterpret_cast<const ASUTF16Val*>(fileName.c_str()), kUTF8);
+	ASPathName outPath = ASFileSysCreatePathFromDIPathText(NULL, textToCreatePath, NULL);
+	ASTextDestroy(textToCreatePath);
+	return outPath;
+}
+
+std::string OutputFileNameWithSuffix(const std::string& fileName, const std::string& suffix)
+{
+	std::string cleanSuffix(suffix);
+	for (size_t i = 0; i < cleanSuffix.size(); i++)
+	{
+		char c = cleanSuffix[i];
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+			cleanSuffix[i] = '_';
+	}
+
+	size_t dot = fileName.find_last_of('.');
+	size_t slash = fileName.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return fileName + "-" + cleanSuffix;
+	return fileName.substr(0, dot) + "-" + cleanSuffix + fileName.substr(dot);
+}
+
+void ExportBitmap(const std::string& fileName, const char* pixels, ASSize_t size, const RenderBitmapInfo& info,
+	const char* alpha, ASSize_t alphaSize)
+{
+	// Not static: this is called on threads with libraries of their own, each with its own atoms.
+	ASAtom deviceRGBA = ASAtomFromString("DeviceRGBA");
+
+	MemStage outerStage = MemTrackStage(kMemStageExport);
+	PDEImageAttrs attrs;
+	memset(&attrs, 0, sizeof(PDEImageAttrs));
+	attrs.flags = kPDEImageExternal;
+	attrs.width = info.width;
+	attrs.height = info.height;
+	attrs.bitsPerComponent = info.bpc;
+
+	ASDoubleMatrix imageMatrix = { static_cast<double>(attrs.width), 0, 0, static_cast<double>(attrs.height), 0, 0 };
+
+	bool hasAlpha = info.colorSpace == deviceRGBA;
+	PDEColorSpace cs = PDEColorSpaceCreateFromName(hasAlpha ? ASAtomFromString("DeviceRGB") : info.colorSpace);
+	PDEImage image = PDEImageCreateEx(&attrs, sizeof(attrs), &imageMatrix, 0, cs, NULL, NULL, 0,
+		reinterpret_cast<ASUns8*>(const_cast<char*>(pixels)), size);
+	PDERelease(reinterpret_cast<PDEObject>(cs));
+
+	if (hasAlpha && alpha != NULL)
+	{
+		PDEColorSpace grayCS = PDEColorSpaceCreateFromName(ASAtomFromString("DeviceGray"));
+		PDEImage mask = PDEImageCreateEx(&attrs, sizeof(attrs), &imageMatrix, 0, grayCS, NULL, NULL, 0,
+			reinterpret_cast<ASUns8*>(const_cast<char*>(alpha)), alphaSize);
+		PDEImageSetSMask(image, mask);
+		PDERelease(reinterpret_cast<PDEObject>(mask));
+		PDERelease(reinterpret_cast<PDEObject>(grayCS));
+	}
+
+	DLPDEImageExportParams exportParams = DLPDEImageGetExportParams();
+	exportParams.ExportHorizontalDPI = exportParams.ExportVerticalDPI = info.resolution;
+
+	ASPathName outPath = CreateOutputPath(fileName);
+	DLExportPDEImage(image, outPath, ExportType_PNG, exportParams);
+	ASFileSysReleasePath(NULL, outPath);
+	PDERelease(reinterpret_cast<PDEObject>(image));
+	MemTrackStage(outerStage);
+}
+
+// The name of a layer, as UTF-8.
+static std::string layerName(PDOCG ocg)
+{
+	ASText name = PDOCGGetName(ocg);
+	char* utf8 = reinterpret_cast<char*>(ASTextGetUnicodeCopy(name, kUTF8));
+	std::string result(utf8 ? utf8 : "");
+	ASfree(utf8);
+	ASTextDestroy(name);
+	return result;
+}
+
+void SelectLayers(PDPage pdPage, const std::vector<std::string>& names, LayerRenderJob& job)
+{
+	job.ocgIndexes.clear();
+	job.layerNames.clear();
+
+	PDOCG* ocgs = PDPageGetOCGs(pdPage);
+	if (ocgs == NULL)
+		return;
+
+	// Each name on the page is converted once. Where a name is used by more than one
+	// group, the first is the one found.
+	std::unordered_map<std::string, int> index;
+	std::vector<std::string> pageNames;
+	for (int n = 0; ocgs[n] != NULL; n++)
+	{
+		pageNames.push_back(layerName(ocgs[n]));
+		index.insert(std::make_pair(pageNames.back(), n));
+	}
+	ASfree(ocgs);
+
+	if (names.empty())
+	{
+		for (size_t n = 0; n < pageNames.size(); n++)
+		{
+			job.ocgIndexes.push_back(static_cast<int>(n));
+			job.layerNames.push_back(pageNames[n]);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		std::unordered_map<std::string, int>::const_iterator found = index.find(names[i]);
+		if (found == index.end())
+		{
+			std::cout << "Layer [" << names[i].c_str() << "] is not on page " << job.pageNum << std::endl;
+			continue;
+		}
+		job.ocgIndexes.push_back(found->second);
+		job.layerNames.push_back(names[i]);
+	}
+}
+
+// The work one thread does, with its own copy of the page and output profile.
+typedef std::function<void(PDDoc pdDoc, PDPage pdPage, AC_Profile outputProfile, int workerIndex)> PageWork;
+
+static void pageWorker(const PageRenderJob* job, const PageWork* work, int workerIndex, std::mutex* reportLock)
+{
+	// Each thread needs its own initialization of the library, and its own copy of the document.
+	APDFLib libInit;
+	if (libInit.isValid() == false)
+	{
+		std::lock_guard<std::mutex> guard(*reportLock);
+		std::cout << "Worker initialization failed with code " << libInit.getInitError() << std::endl;
+		return;
+	}
+
+	AC_Profile outputProfile = NULL;
+	if (!job->targetProfile.empty())
+		ACMakeBufferProfile(&outputProfile, const_cast<char*>(&job->targetProfile[0]), static_cast<ASUns32>(job->targetProfile.size()));
+
+	ASErrorCode errCode = 0;
+	DURING
+		MemTrackStage(kMemStageOpen);
+		APDFLDoc doc(job->inputFile.c_str(), true);
+		PDPage pdPage = doc.getPage(job->pageNum);
+		MemTrackStage(kMemStageOther);
+		(*work)(doc.getPDDoc(), pdPage, outputProfile, workerIndex);
+		PDPageRelease(pdPage);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+
+	if (outputProfile != NULL)
+		ACUnReferenceProfile(outputProfile);
+
+	if (errCode != 0)
+	{
+		std::lock_guard<std::mutex> guard(*reportLock);
+		std::cout << "Worker could not open page " << job->pageNum << " of " << job->inputFile.c_str() << ": error " << errCode << std::endl;
+	}
+}
+
+// Run work on job.numThreads threads, or on this thread, with pdDoc, if there is only one.
+// The work takes its share of the job from a counter that all of the threads share.
+static void runPageWork(PDDoc pdDoc, const PageRenderJob& job, size_t numItems, const PageWork& work, std::mutex& reportLock)
+{
+	if (job.numThreads <= 1)
+	{
+		PDPage pdPage = PDDocAcquirePage(pdDoc, job.pageNum);
+		work(pdDoc, pdPage, job.parms.getOutputProfile(), 0);
+		PDPageRelease(pdPage);
+		return;
+	}
+
+	size_t numThreads = static_cast<size_t>(job.numThreads);
+	if (numThreads > numItems)
+		numThreads = numItems;
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(pageWorker, &job, &work, static_cast<int>(i), &reportLock));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+static void reportFailure(std::mutex& reportLock, const std::string& what, ASErrorCode errCode)
+{
+	char buf[256];
+	ASGetErrorString(errCode, buf, sizeof(buf));
+	std::lock_guard<std::mutex> guard(reportLock);
+	std::cout << what.c_str() << " failed: " << buf << std::endl;
+}
+
+int RenderLayers(PDDoc pdDoc, LayerRenderJob& job)
+{
+	std::atomic<size_t> next{ 0 };      // The next entry of job.ocgIndexes to render.
+	std::atomic<int> numFailed{ 0 };
+	std::mutex reportLock;
+
+	PageWork work = [&](PDDoc workerDoc, PDPage pdPage, AC_Profile outputProfile, int)
+	{
+		RenderPageParams parms = job.parms;
+		parms.setOutputProfile(outputProfile);
+
+		DLPDEImageExportParams exportParams = DLPDEImageGetExportParams();
+		exportParams.ExportHorizontalDPI = exportParams.ExportVerticalDPI = parms.Resolution();
+
+		PDOCG* ocgs = PDPageGetOCGs(pdPage);
+
+		size_t entry;
+		while ((entry = next++) < job.ocgIndexes.size())
+		{
+			std::string outputFile = OutputFileNameWithSuffix(job.outputFile, job.layerNames[entry]);
+			PDOCContext context = NULL;
+			ASErrorCode errCode = 0;
+
+			DURING
+				// Start with every group off, and turn on just this one. The list of groups is NULL terminated.
+				context = PDOCContextNew(kOCCInit_OFF, NULL, NULL, workerDoc);
+				PDOCG layers[2] = { ocgs[job.ocgIndexes[entry]], NULL };
+				ASBool on = true;
+				PDOCContextSetOCGStates(context, layers, &on);
+				parms.setOCContext(context);
+
+				RenderPage drawPage(pdPage, &job.cropRect, &parms);
+				PDEImage pageImage = drawPage.GetPDEImage(job.outRect);
+				ASPathName outPath = CreateOutputPath(outputFile);
+				DLExportPDEImage(pageImage, outPath, ExportType_PNG, exportParams);
+				ASFileSysReleasePath(NULL, outPath);
+				PDERelease(reinterpret_cast<PDEObject>(pageImage));
+			HANDLER
+				errCode = ERRORCODE;
+			END_HANDLER
+
+			if (context != NULL)
+				PDOCContextFree(context);
+
+			if (errCode != 0)
+			{
+				reportFailure(reportLock, "Layer [" + job.layerNames[entry] + "]", errCode);
+				++numFailed;
+			}
+			else if (parms.verbose())
+			{
+				std::lock_guard<std::mutex> guard(reportLock);
+				std::cout << "Layer [" << job.layerNames[entry].c_str() << "] written to " << outputFile.c_str() << std::endl;
+			}
+		}
+
+		if (ocgs != NULL)
+			ASfree(ocgs);
+	};
+
+	runPageWork(pdDoc, job, job.ocgIndexes.size(), work, reportLock);
+
+	// Anything no worker got to (because no worker could open the document) has failed too.
+	size_t taken = next;
+	int notRendered = (taken < job.ocgIndexes.size()) ? static_cast<int>(job.ocgIndexes.size() - taken) : 0;
+	return numFailed + notRendered;
+}
+
+struct TileSpec
+{
+	int level, column, row;
+	int left, top, width, height;   // In the pixels of the level.
+};
+
+static void putLittleEndian(std::vector<unsigned char>& out, unsigned long long value, int numBytes)
+{
+	for (int i = 0; i < numBytes; i++)
+		out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+// A tile is blank if every pixel is paper: white, or no ink for CMYK. Only 8 bit tiles are
+// checked, and never those with alpha.
+static bool isBlankTile(RenderPage& drawPage, const RenderPageParams& parms, int width, int height)
+{
+	static const ASAtom sDeviceRGBA_K = ASAtomFromString("DeviceRGBA");
+	static const ASAtom sDeviceCMYK_K = ASAtomFromString("DeviceCMYK");
+	if (parms.BitsPerComponent() != 8 || parms.ColorSpaceName() == sDeviceRGBA_K)
+		return false;
+
+	unsigned char paper = (parms.ColorSpaceName() == sDeviceCMYK_K) ? 0x00 : 0xFF;
+	size_t usedBytes = static_cast<size_t>(width) * parms.NumComps();
+	size_t rowBytes = drawPage.RowBytes();
+	const unsigned char* row = reinterpret_cast<const unsigned char*>(drawPage.GetImageBuffer());
+	for (int y = 0; y < height; y++, row += rowBytes)
+	{
+		for (size_t x = 0; x < usedBytes; x++)
+		{
+			if (row[x] != paper)
+				return false;
+		}
+	}
+	return true;
+}
+
+int RenderTiles(PDDoc pdDoc, TileRenderJob& job)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// The size of the page at the highest level, and the number of levels below it.
+	double scale = job.parms.Resolution() / 72.0;
+	ASDoubleRect pageRect = { ASFixedToFloat(job.pageRect.left), ASFixedToFloat(job.pageRect.top),
+		ASFixedToFloat(job.pageRect.right), ASFixedToFloat(job.pageRect.bottom) };
+	ASDoubleMatrix fullMatrix;
+	PDPage firstPage = PDDocAcquirePage(pdDoc, job.pageNum);
+	RenderPage::PageToImageMatrix(firstPage, &job.pageRect, scale, &fullMatrix);
+	PDPageRelease(firstPage);
+	ASDoubleRect pixelRect;
+	ASDoubleMatrixTransformRect(&pixelRect, &fullMatrix, &pageRect);
+	int fullWidth = static_cast<int>(floor(fabs(pixelRect.right - pixelRect.left) + 0.5));
+	int fullHeight = static_cast<int>(floor(fabs(pixelRect.top - pixelRect.bottom) + 0.5));
+	int maxLevel = 0;
+	while ((1 << maxLevel) < fullWidth || (1 << maxLevel) < fullHeight)
+		++maxLevel;
+
+	// Every tile of every level, the smallest levels first.
+	std::vector<TileSpec> tiles;
+	for (int level = 0; level <= maxLevel; level++)
+	{
+		int divisor = 1 << (maxLevel - level);
+		int levelWidth = (fullWidth + divisor - 1) / divisor;
+		int levelHeight = (fullHeight + divisor - 1) / divisor;
+		for (int row = 0; row * job.tileSize < levelHeight; row++)
+		{
+			for (int column = 0; column * job.tileSize < levelWidth; column++)
+			{
+				TileSpec tile;
+				tile.level = level;
+				tile.column = column;
+				tile.row = row;
+				tile.left = column * job.tileSize;
+				tile.top = row * job.tileSize;
+				tile.width = (std::min)(job.tileSize, levelWidth - tile.left);
+				tile.height = (std::min)(job.tileSize, levelHeight - tile.top);
+				tiles.push_back(tile);
+			}
+		}
+	}
+
+	std::string descriptorName = job.outputName + ".dzi";
+	std::ofstream descriptor(descriptorName.c_str());
+	descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		<< "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"png\" Overlap=\"0\" TileSize=\"" << job.tileSize << "\">\n"
+		<< "  <Size Width=\"" << fullWidth << "\" Height=\"" << fullHeight << "\"/>\n"
+		<< "</Image>\n";
+	descriptor.close();
+
+	std::string packName = job.outputName + ".dzpk";
+	FILE* pack = NULL;
+	if (job.pack)
+	{
+		pack = fopen(packName.c_str(), "wb");
+		if (pack == NULL)
+		{
+			std::cout << "Unable to create " << packName.c_str() << std::endl;
+			return static_cast<int>(tiles.size());
+		}
+	}
+	else
+	{
+		std::error_code err;
+		for (int level = 0; level <= maxLevel; level++)
+			std::filesystem::create_directories(job.outputName + "_files/" + std::to_string(level), err);
+	}
+
+	std::atomic<size_t> next{ 0 };
+	std::atomic<int> numFailed{ 0 }, numBlank{ 0 };
+	std::mutex reportLock, packLock;
+	std::vector<unsigned char> index;
+	unsigned long long packOffset = 0;
+	int numPacked = 0;
+
+	PageWork work = [&](PDDoc workerDoc, PDPage pdPage, AC_Profile outputProfile, int workerIndex)
+	{
+		// Tiles show the layers that are visible by default.
+		RenderPageParams parms = job.parms;
+		parms.setOCContext(PDDocGetOCContext(workerDoc));
+		parms.setOutputProfile(outputProfile);
+
+		DLPDEImageExportParams exportParams = DLPDEImageGetExportParams();
+		exportParams.ExportHorizontalDPI = exportParams.ExportVerticalDPI = parms.Resolution();
+
+		// Packed tiles are exported to a file of this thread's own, then copied into the pack.
+		std::string tempName = packName + "." + std::to_string(workerIndex) + ".tmp";
+
+		int matrixLevel = -1;
+		ASDoubleMatrix levelMatrix, inverseMatrix;
+
+		size_t entry;
+		while ((entry = next++) < tiles.size())
+		{
+			const TileSpec& tile = tiles[entry];
+			if (tile.level != matrixLevel)
+			{
+				RenderPage::PageToImageMatrix(pdPage, &job.pageRect, scale / (1 << (maxLevel - tile.level)), &levelMatrix);
+				ASDoubleMatrixInvert(&inverseMatrix, &levelMatrix);
+				matrixLevel = tile.level;
+			}
+
+			// Shift the level so that the tile is at the origin, and draw only the part of the page under it.
+			ASDoubleMatrix shift = { 1, 0, 0, 1, static_cast<double>(-tile.left), static_cast<double>(-tile.top) };
+			ASDoubleMatrix tileMatrix;
+			ASDoubleMatrixConcat(&tileMatrix, &shift, &levelMatrix);
+			ASDoubleRect destRect = { 0, static_cast<double>(tile.height), static_cast<double>(tile.width), 0 };
+			ASDoubleRect tilePixels = { static_cast<double>(tile.left), static_cast<double>(tile.top),
+				static_cast<double>(tile.left + tile.width), static_cast<double>(tile.top + tile.height) };
+			ASDoubleRect tileArea;
+			ASDoubleMatrixTransformRect(&tileArea, &inverseMatrix, &tilePixels);
+			ASFixedRect tileRect = { FloatToASFixed((std::max)(tileArea.left, pageRect.left)), FloatToASFixed((std::min)(tileArea.top, pageRect.top)),
+				FloatToASFixed((std::min)(tileArea.right, pageRect.right)), FloatToASFixed((std::max)(tileArea.bottom, pageRect.bottom)) };
+			parms.setMatrix(&tileMatrix);
+			parms.setDestRect(&destRect);
+
+			std::string tileName = job.pack ? tempName : job.outputName + "_files/" + std::to_string(tile.level) + "/"
+				+ std::to_string(tile.column) + "_" + std::to_string(tile.row) + ".png";
+			bool blank = false;
+			ASErrorCode errCode = 0;
+
+			DURING
+				RenderPage drawPage(pdPage, &tileRect, &parms);
+				blank = isBlankTile(drawPage, parms, tile.width, tile.height);
+				if (!blank)
+				{
+					PDEImage tileImage = drawPage.GetPDEImage(tileRect);
+					ASPathName outPath = CreateOutputPath(tileName);
+					DLExportPDEImage(tileImage, outPath, ExportType_PNG, exportParams);
+					ASFileSysReleasePath(NULL, outPath);
+					PDERelease(reinterpret_cast<PDEObject>(tileImage));
+				}
+			HANDLER
+				errCode = ERRORCODE;
+			END_HANDLER
+
+			if (errCode != 0)
+			{
+				reportFailure(reportLock, "Tile " + std::to_string(tile.level) + "/" + std::to_string(tile.column) + "_" + std::to_string(tile.row), errCode);
+				++numFailed;
+				continue;
+			}
+			if (blank)
+			{
+				++numBlank;
+				continue;
+			}
+
+			if (job.pack)
+			{
+				std::ifstream tileFile(tempName.c_str(), std::ios::binary);
+				std::vector<char> data((std::istreambuf_iterator<char>(tileFile)), std::istreambuf_iterator<char>());
+
+				std::lock_guard<std::mutex> guard(packLock);
+				if (!data.empty())
+					fwrite(&data[0], 1, data.size(), pack);
+				putLittleEndian(index, tile.level, 4);
+				putLittleEndian(index, tile.column, 4);
+				putLittleEndian(index, tile.row, 4);
+				putLittleEndian(index, packOffset, 8);
+				putLittleEndian(index, data.size(), 4);
+				packOffset += data.size();
+				++numPacked;
+			}
+		}
+
+		if (job.pack)
+			remove(tempName.c_str());
+	};
+
+	runPageWork(pdDoc, job, tiles.size(), work, reportLock);
+
+	if (pack != NULL)
+	{
+		putLittleEndian(index, numPacked, 4);
+		putLittleEndian(index, packOffset, 8);
+		index.push_back('D');
+		index.push_back('Z');
+		index.push_back('P');
+		index.push_back('K');
+		fwrite(&index[0], 1, index.size(), pack);
+		fclose(pack);
+	}
+
+	size_t taken = next;
+	int notRendered = (taken < tiles.size()) ? static_cast<int>(tiles.size() - taken) : 0;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << fullWidth << " x " << fullHeight << " pixels, " << (maxLevel + 1) << " levels, " << tiles.size() << " tiles ("
+		<< numBlank << " blank and not written, " << (numFailed + notRendered) << " failed) in " << elapsed << " s." << std::endl;
+
+	return numFailed + notRendered;
+}
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering of one page many times over, by several threads. PDF Library objects cannot be
+// shared between threads, so each worker initializes the library, opens the document and
+// acquires the page itself, once, and then renders every job it takes with that page.
+//
+
+#ifndef RENDERWORKERS_H
+#define RENDERWORKERS_H
+
+#include <string>
+#include <vector>
+
+#include "PDFLExpT.h"
+
+#include "RenderPage.h"
+
+// Create a path for an output file name given on the command line, as UTF-8.
+ASPathName CreateOutputPath(const std::string& fileName);
+
+// Make an output file name from the one given on the command line, by adding suffix before
+// the extension, with anything that is awkward in a file name replaced by '_'.
+std::string OutputFileNameWithSuffix(const std::string& fileName, const std::string& suffix);
+
+// Write a bitmap whose rows have no padding to fileName as a PNG, through a PDEImage, as the
+// single page output is written. For DeviceRGBA, pixels is the RGB and alpha the soft mask,
+// as GetPDEImage() separates them. info.rowBytes is not used.
+void ExportBitmap(const std::string& fileName, const char* pixels, ASSize_t size, const RenderBitmapInfo& info,
+	const char* alpha = NULL, ASSize_t alphaSize = 0);
+
+// What every job that renders one page many times needs to know.
+struct PageRenderJob
+{
+	std::string inputFile;
+	int pageNum;
+	RenderPageParams parms;         // Copied by each thread, which adds its own OC context and output profile.
+	std::vector<char> targetProfile;    // ICC data for the output profile, if any; each thread makes its own.
+	int numThreads;                 // 1 to render on the calling thread, with the document it has open.
+};
+
+// Render one image per optional content group of a page: each with only that group
+// turned on, along with the content that is not optional.
+struct LayerRenderJob : PageRenderJob
+{
+	ASFixedRect cropRect;           // The area of the page to render.
+	ASFixedRect outRect;            // The same area, after the page rotation.
+	std::string outputFile;         // Each layer's image is named from this, with the layer name added.
+
+	// Indexes into the page's PDPageGetOCGs() array, and the names to give the images.
+	std::vector<int> ocgIndexes;
+	std::vector<std::string> layerNames;
+};
+
+// Render a Deep Zoom (DZI) tile pyramid of a page. The highest level is the page at the
+// resolution in parms; each level below it is half the size of the one above, down to a
+// single pixel at level 0. Tiles are tileSize pixels square, less at the right and bottom
+// edges, with no overlap. Tiles that come out plain white (or, for CMYK, with no ink) are
+// not written; a viewer shows a missing tile as background.
+//
+// The descriptor is written to <outputName>.dzi, and the tiles, as PNG, to
+// <outputName>_files/<level>/<column>_<row>.png. With pack set, the tiles are instead
+// written one after another to <outputName>.dzpk, followed by an index:
+//
+//    for each tile:  level (4 bytes), column (4), row (4), offset (8), length (4)
+//    then:           number of tiles (4), offset of the index (8), "DZPK"
+//
+// All integers are unsigned and little-endian; offsets are from the start of the file.
+struct TileRenderJob : PageRenderJob
+{
+	ASFixedRect pageRect;           // The area of the page to tile.
+	int tileSize;
+	std::string outputName;
+	bool pack;
+};
+
+// Resolve layer names to indexes into the OCGs of pdPage, through a hash index of the
+// page's layer names. Names that are not on the page are reported and skipped. With no
+// names, every layer on the page is used.
+void SelectLayers(PDPage pdPage, const std::vector<std::string>& names, LayerRenderJob& job);
+
+// Render the layers selected in job. pdDoc is the document already open on the calling
+// thread, used when there is one thread. Returns the number of layers that failed.
+int RenderLayers(PDDoc pdDoc, LayerRenderJob& job);
+
+// Render the tile pyramid described by job. Returns the number of tiles that failed.
+int RenderTiles(PDDoc pdDoc, TileRenderJob& job);
+
+#endif // RENDERWORKERS_H
@@ -0,0 +1,434 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering pages, and bands of pages, as the scheduler hands them out. See ScheduledRender.h.
+//
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PERCalls.h"
+#include "AcroColorCalls.h"
+#include "APDFLDoc.h"
+#include "InitializeLibrary.h"
+
+#include "MemTrack.h"
+#include "ScheduledRender.h"
+#include "WorkScheduler.h"
+
+static const int kMaxBands = 16;
+static const int kMinBandRows = 256;
+
+// The bitmap of a page drawn in bands, filled in by whichever workers draw them. The pixels
+// are allocated when the first band is started and freed once the page is written, so only
+// the pages being worked on hold a bitmap, however many pages are split.
+struct BandedPage
+{
+	RenderBitmapInfo info;
+	std::vector<char> pixels;
+	std::mutex lock;            // For allocating pixels.
+	std::atomic<int> remaining;
+	std::atomic<bool> failed;
+
+	BandedPage() : remaining(0), failed(false)
+	{
+		memset(&info, 0, sizeof(info));
+	}
+
+	// Called by each band before it draws.
+	void Allocate()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (pixels.empty())
+			pixels.resize(static_cast<size_t>(info.rowBytes) * info.height);
+	}
+
+	// Called by the last band, when no other worker is using the pixels.
+	void Release()
+	{
+		std::vector<char>().swap(pixels);
+	}
+};
+
+struct ScheduleState
+{
+	const ScheduledRenderJob* job;
+	WorkScheduler* scheduler;
+	std::vector<BandedPage*> banded;    // For each page, if it is drawn in bands.
+	std::atomic<int> numFailed{ 0 };
+	std::mutex reportLock;
+};
+
+static void reportFailure(ScheduleState& state, const std::string& what, ASErrorCode errCode)
+{
+	char buf[256];
+	ASGetErrorString(errCode, buf, sizeof(buf));
+	std::lock_guard<std::mutex> guard(state.reportLock);
+	std::cout << what.c_str() << " failed: " << buf << std::endl;
+}
+
+// Write a bitmap laid out as RenderPage draws it: rows padded to info.rowBytes, and for
+// DeviceRGBA, the alpha in with the color.
+static void exportRaster(const std::string& fileName, const char* pixels, const RenderBitmapInfo& info)
+{
+	// Not static: each worker has its own library, and so its own atoms.
+	const ASAtom deviceRGBA = ASAtomFromString("DeviceRGBA");
+
+	bool rgba = (info.colorSpace == deviceRGBA);
+	size_t usedBytes = (static_cast<size_t>(info.width) * info.bpc * info.nComps + 7) / 8;
+	size_t colorBytes = rgba ? static_cast<size_t>(info.width) * 3 : usedBytes;
+	std::vector<char> color(colorBytes * info.height);
+	std::vector<char> alpha(rgba ? static_cast<size_t>(info.width) * info.height : 0);
+
+	for (ASInt32 row = 0; row < info.height; row++)
+	{
+		const char* in = pixels + static_cast<size_t>(row) * info.rowBytes;
+		char* out = &color[row * colorBytes];
+		if (!rgba)
+		{
+			memcpy(out, in, usedBytes);
+			continue;
+		}
+		for (ASInt32 x = 0; x < info.width; x++)
+		{
+			out[(x * 3) + 0] = in[(x * 4) + 0];
+			out[(x * 3) + 1] = in[(x * 4) + 1];
+			out[(x * 3) + 2] = in[(x * 4) + 2];
+			alpha[static_cast<size_t>(row) * info.width + x] = in[(x * 4) + 3];
+		}
+	}
+
+	ExportBitmap(fileName, &color[0], static_cast<ASSize_t>(color.size()), info,
+		alpha.empty() ? NULL : &alpha[0], static_cast<ASSize_t>(alpha.size()));
+}
+
+// Draw the rows of one band of the page into its place in the page's bitmap, placing the
+// page as the tiles of RenderTiles are placed.
+static void drawBand(PDPage pdPage, const ASFixedRect& cropRect, const RenderPageParams& pageParms, const WorkItem& item, BandedPage& banded)
+{
+	const RenderBitmapInfo& info = banded.info;
+	int top = static_cast<int>(static_cast<long long>(info.height) * item.band / item.numBands);
+	int bottom = static_cast<int>(static_cast<long long>(info.height) * (item.band + 1) / item.numBands);
+	if (bottom <= top)
+		return;
+
+	ASDoubleMatrix pageMatrix, inverseMatrix;
+	RenderPage::PageToImageMatrix(pdPage, &cropRect, pageParms.Resolution() / 72.0, &pageMatrix);
+	ASDoubleMatrixInvert(&inverseMatrix, &pageMatrix);
+
+	ASDoubleMatrix shift = { 1, 0, 0, 1, 0, static_cast<double>(-top) };
+	ASDoubleMatrix bandMatrix;
+	ASDoubleMatrixConcat(&bandMatrix, &shift, &pageMatrix);
+	ASDoubleRect destRect = { 0, static_cast<double>(bottom - top), static_cast<double>(info.width), 0 };
+	ASDoubleRect bandPixels = { 0, static_cast<double>(top), static_cast<double>(info.width), static_cast<double>(bottom) };
+	ASDoubleRect bandArea;
+	ASDoubleMatrixTransformRect(&bandArea, &inverseMatrix, &bandPixels);
+	ASDoubleRect pageRect = { ASFixedToFloat(cropRect.left), ASFixedToFloat(cropRect.top),
+		ASFixedToFloat(cropRect.right), ASFixedToFloat(cropRect.bottom) };
+	ASFixedRect bandRect = { FloatToASFixed((std::max)(bandArea.left, pageRect.left)), FloatToASFixed((std::min)(bandArea.top, pageRect.top)),
+		FloatToASFixed((std::min)(bandArea.right, pageRect.right)), FloatToASFixed((std::max)(bandArea.bottom, pageRect.bottom)) };
+
+	RenderPageParams parms = pageParms;
+	parms.setMatrix(&bandMatrix);
+	parms.setDestRect(&destRect);
+	RenderPage drawPage(pdPage, &bandRect, &parms);
+
+	int numRows = (std::min)(bottom - top, static_cast<int>(drawPage.Height()));
+	size_t rowBytes = (std::min)(static_cast<size_t>(info.rowBytes), static_cast<size_t>(drawPage.RowBytes()));
+	const char* bits = drawPage.GetImageBuffer();
+	for (int row = 0; row < numRows; row++)
+		memcpy(&banded.pixels[static_cast<size_t>(top + row) * info.rowBytes], bits + static_cast<size_t>(row) * drawPage.RowBytes(), rowBytes);
+}
+
+static std::string pageFileName(const ScheduledRenderJob& job, ASInt32 pageNum)
+{
+	return OutputFileNameWithSuffix(job.outputFile, "p" + std::to_string(pageNum + 1));
+}
+
+static void renderItem(PDDoc pdDoc, const RenderPageParams& parms, const WorkItem& item, ScheduleState& state)
+{
+	std::string fileName = pageFileName(*state.job, item.pageNum);
+	BandedPage* banded = (item.band >= 0) ? state.banded[item.pageNum] : NULL;
+
+	PDPage pdPage = NULL;
+	ASErrorCode errCode = 0;
+	DURING
+		pdPage = PDDocAcquirePage(pdDoc, item.pageNum);
+		ASFixedRect cropRect;
+		PDPageGetCropBox(pdPage, &cropRect);
+		if (banded == NULL)
+		{
+			RenderPage drawPage(pdPage, &cropRect, &parms);
+			exportRaster(fileName, drawPage.GetImageBuffer(), drawPage.BitmapInfo());
+		}
+		else
+		{
+			banded->Allocate();
+			drawBand(pdPage, cropRect, parms, item, *banded);
+		}
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+	if (pdPage != NULL)
+		PDPageRelease(pdPage);
+
+	if (banded == NULL)
+	{
+		if (errCode != 0)
+		{
+			reportFailure(state, "Page " + std::to_string(item.pageNum + 1), errCode);
+			++state.numFailed;
+		}
+		return;
+	}
+
+	if (errCode != 0)
+	{
+		reportFailure(state, "Band " + std::to_string(item.band + 1) + " of page " + std::to_string(item.pageNum + 1), errCode);
+		banded->failed = true;
+	}
+
+	// The last band done writes the page.
+	if (--banded->remaining != 0)
+		return;
+	if (banded->failed)
+	{
+		banded->Release();
+		++state.numFailed;
+		return;
+	}
+	DURING
+		exportRaster(fileName, &banded->pixels[0], banded->info);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+	banded->Release();
+	if (errCode != 0)
+	{
+		reportFailure(state, "Writing page " + std::to_string(item.pageNum + 1), errCode);
+		++state.numFailed;
+	}
+}
+
+// A worker that cannot draw leaves its items to be stolen by the others or, with no
+// stealing, counts them (whole pages) as failed. A page with bands left undrawn is counted
+// once the workers are done.
+static void drainWorker(ScheduleState* state, int worker)
+{
+	WorkItem item;
+	while (!state->scheduler->Stealing() && state->scheduler->Next(worker, item))
+	{
+		if (item.band < 0)
+			++state->numFailed;
+	}
+}
+
+static void scheduledWorker(ScheduleState* state, int worker)
+{
+	const ScheduledRenderJob& job = *state->job;
+	WorkItem item;
+
+	// Each thread needs its own initialization of the library, and its own copy of the document.
+	APDFLib libInit;
+	if (libInit.isValid() == false)
+	{
+		{
+			std::lock_guard<std::mutex> guard(state->reportLock);
+			std::cout << "Worker initialization failed with code " << libInit.getInitError() << std::endl;
+		}
+		drainWorker(state, worker);
+		return;
+	}
+
+	AC_Profile outputProfile = NULL;
+	if (!job.targetProfile.empty())
+		ACMakeBufferProfile(&outputProfile, const_cast<char*>(&job.targetProfile[0]), static_cast<ASUns32>(job.targetProfile.size()));
+
+	ASErrorCode errCode = 0;
+	DURING
+		MemTrackStage(kMemStageOpen);
+		APDFLDoc doc(job.inputFile.c_str(), true);
+		MemTrackStage(kMemStageOther);
+		RenderPageParams parms = job.parms;
+		parms.setOCContext(PDDocGetOCContext(doc.getPDDoc()));
+		parms.setOutputProfile(outputProfile);
+		parms.setBufferAllocator(NULL);
+
+		while (state->scheduler->Next(worker, item))
+			renderItem(doc.getPDDoc(), parms, item, *state);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+
+	if (outputProfile != NULL)
+		ACUnReferenceProfile(outputProfile);
+
+	if (errCode != 0)
+	{
+		reportFailure(*state, "Worker opening " + job.inputFile, errCode);
+		drainWorker(state, worker);
+	}
+}
+
+// Draw items on numWorkers workers. Returns the number of pages that failed.
+static int runSchedule(const ScheduledRenderJob& job, const std::vector<WorkItem>& items, const std::vector<BandedPage*>& banded,
+	int numWorkers, bool steal)
+{
+	WorkScheduler scheduler(numWorkers, steal);
+	scheduler.Deal(items);
+
+	ScheduleState state;
+	state.job = &job;
+	state.scheduler = &scheduler;
+	state.banded = banded;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (items[i].band >= 0)
+		{
+			state.banded[items[i].pageNum]->remaining = items[i].numBands;
+			state.banded[items[i].pageNum]->failed = false;
+		}
+	}
+
+	scheduler.Run([&state](int worker) { scheduledWorker(&state, worker); });
+	scheduler.Report(steal ? "Scheduled by cost, with work stealing" : "Round-robin split");
+
+	// What no worker took, as when none of them could start, failed; so did a page split into
+	// bands that were not all drawn, which was never written.
+	WorkItem item;
+	for (int worker = 0; worker < numWorkers; worker++)
+	{
+		while (scheduler.Next(worker, item))
+		{
+			if (item.band < 0)
+				++state.numFailed;
+		}
+	}
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		BandedPage* bands = (items[i].band == 0) ? state.banded[items[i].pageNum] : NULL;
+		if (bands != NULL && bands->remaining != 0)
+		{
+			bands->Release();
+			++state.numFailed;
+		}
+	}
+	return state.numFailed;
+}
+
+int RenderPagesScheduled(PDDoc pdDoc, ScheduledRenderJob& job)
+{
+	int numWorkers = job.numThreads > 0 ? job.numThreads : static_cast<int>(std::thread::hardware_concurrency());
+	if (numWorkers < 1)
+		numWorkers = 1;
+
+	// The estimates, and the size of each page's bitmap, from the document already open.
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	ASInt32 numPages = PDDocGetNumPages(pdDoc);
+	std::vector<WorkItem> pages(numPages);
+	std::vector<ASInt32> widths(numPages, 0), heights(numPages, 0);
+	double totalCost = 0;
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		WorkItem& item = pages[pageNum];
+		item.pageNum = pageNum;
+		item.band = -1;
+		item.numBands = 1;
+		item.cost = 1;
+
+		PDPage pdPage = NULL;
+		DURING
+			pdPage = PDDocAcquirePage(pdDoc, pageNum);
+			item.cost = EstimatePageCost(pdPage);
+
+			ASFixedRect cropRect;
+			PDPageGetCropBox(pdPage, &cropRect);
+			ASDoubleMatrix pageMatrix;
+			RenderPage::PageToImageMatrix(pdPage, &cropRect, job.parms.Resolution() / 72.0, &pageMatrix);
+			ASDoubleRect pageRect = { ASFixedToFloat(cropRect.left), ASFixedToFloat(cropRect.top),
+				ASFixedToFloat(cropRect.right), ASFixedToFloat(cropRect.bottom) };
+			ASDoubleRect pixelRect;
+			ASDoubleMatrixTransformRect(&pixelRect, &pageMatrix, &pageRect);
+			widths[pageNum] = static_cast<ASInt32>(floor(fabs(pixelRect.right - pixelRect.left) + 0.5));
+			heights[pageNum] = static_cast<ASInt32>(floor(fabs(pixelRect.top - pixelRect.bottom) + 0.5));
+		HANDLER
+			// Left to fail, and be reported, when it is drawn.
+		END_HANDLER
+		if (pdPage != NULL)
+			PDPageRelease(pdPage);
+		totalCost += item.cost;
+	}
+
+	// Split the pages that would hold a worker up, into bands of about half its share each.
+	double bandCost = totalCost / (2.0 * numWorkers);
+	std::vector<WorkItem> items;
+	std::vector<BandedPage*> banded(numPages, static_cast<BandedPage*>(NULL));
+	int numBandedPages = 0;
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		const WorkItem& page = pages[pageNum];
+		int numBands = (numWorkers > 1 && job.parms.BitsPerComponent() == 8 && page.cost > bandCost)
+			? static_cast<int>(ceil(page.cost / bandCost)) : 1;
+		numBands = (std::min)(numBands, (std::min)(kMaxBands, heights[pageNum] / kMinBandRows));
+		if (numBands < 2)
+		{
+			items.push_back(page);
+			continue;
+		}
+
+		BandedPage* bands = new BandedPage;
+		bands->info.width = widths[pageNum];
+		bands->info.height = heights[pageNum];
+		bands->info.nComps = job.parms.NumComps();
+		bands->info.bpc = 8;
+		bands->info.rowBytes = static_cast<ASSize_t>(widths[pageNum]) * bands->info.nComps;
+		bands->info.colorSpace = job.parms.ColorSpaceName();
+		bands->info.resolution = job.parms.Resolution();
+		banded[pageNum] = bands;
+		++numBandedPages;
+
+		for (int band = 0; band < numBands; band++)
+		{
+			WorkItem item = page;
+			item.band = band;
+			item.numBands = numBands;
+			item.cost = page.cost / numBands;
+			items.push_back(item);
+		}
+	}
+	double estimateTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Estimated the cost of " << numPages << " pages in " << estimateTime << " s; " << numBandedPages
+		<< " split into bands, for " << items.size() << " items of work." << std::endl;
+
+	double staticTime = 0;
+	if (job.compareStatic)
+	{
+		start = std::chrono::steady_clock::now();
+		runSchedule(job, pages, banded, numWorkers, false);
+		staticTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	start = std::chrono::steady_clock::now();
+	int numFailed = runSchedule(job, items, banded, numWorkers, true);
+	double scheduledTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (job.compareStatic)
+		std::cout << "Scheduling took " << (staticTime > 0 ? 100.0 * scheduledTime / staticTime : 0.0)
+			<< "% of the time of the round-robin split." << std::endl;
+
+	for (size_t i = 0; i < banded.size(); i++)
+		delete banded[i];
+	return numFailed;
+}
@@ -0,0 +1,40 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering every page of a document on several threads, with the pages scheduled by
+// their estimated cost (see WorkScheduler.h). Each worker has its own initialization of
+// the library and its own copy of the document, and writes the images of the pages it
+// draws, named after the output file with "-p<n>" added, as -allpages names them.
+//
+// A page estimated to cost more than half of a worker's fair share of the document is
+// split into horizontal bands, each drawn on its own, by whichever worker takes it, into
+// the page's bitmap, which is allocated when its first band is started; the worker that
+// draws the last band writes the image and frees the bitmap. Only 8 bit pages are split.
+//
+// With compareStatic, the pages are first drawn with the plain round-robin split (page n
+// to worker n modulo the number of workers, whole pages, no stealing), and the wall time
+// and each worker's busy time are reported for both.
+//
+
+#ifndef SCHEDULEDRENDER_H
+#define SCHEDULEDRENDER_H
+
+#include <string>
+
+#include "RenderWorkers.h"
+
+struct ScheduledRenderJob : PageRenderJob
+{
+	std::string outputFile;
+	bool compareStatic;
+};
+
+// Returns the number of pages that failed.
+int RenderPagesScheduled(PDDoc pdDoc, ScheduledRenderJob& job);
+
+#endif // SCHEDULEDRENDER_H
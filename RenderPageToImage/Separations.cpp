@@ -0,0 +1,370 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Separation plates of every page of a document. See Separations.h.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PERCalls.h"
+#include "AcroColorCalls.h"
+#include "APDFLDoc.h"
+#include "InitializeLibrary.h"
+
+#include "MemTrack.h"
+#include "Separations.h"
+
+// The process plates, drawn for every page.
+static const char* kProcessPlates[] = { "Cyan", "Magenta", "Yellow", "Black" };
+static const int kNumProcessPlates = 4;
+
+// One plate to draw, and how it went. Only names cross between threads: an ink's atom
+// belongs to the library of the thread that made it.
+struct PlateSpec
+{
+	ASInt32 pageNum;
+	std::string ink;
+	bool isProcess;
+	std::string fileName;
+	bool written;
+	ASErrorCode errCode;
+	double drawSeconds, writeSeconds;
+};
+
+struct SeparationState
+{
+	const SeparationJob* job;
+	std::vector<PlateSpec> plates;      // In page order, so the threads work on the same page together.
+	std::atomic<size_t> next{ 0 };      // The next plate to draw.
+	std::mutex reportLock;
+};
+
+static ASBool collectInk(PDPageInk ink, void* clientData)
+{
+	std::vector<PDPageInkRec>* inks = reinterpret_cast<std::vector<PDPageInkRec>*>(clientData);
+	inks->push_back(*ink);
+	return true;
+}
+
+static void putUns16(std::vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back(static_cast<unsigned char>(value));
+	out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void putUns32(std::vector<unsigned char>& out, unsigned long value)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+static void putTag(std::vector<unsigned char>& out, unsigned int tag, unsigned int type, unsigned long value)
+{
+	putUns16(out, tag);
+	putUns16(out, type);
+	putUns32(out, 1);
+	// SHORT values sit in the first two bytes of the value field.
+	if (type == 3)
+	{
+		putUns16(out, static_cast<unsigned int>(value));
+		putUns16(out, 0);
+	}
+	else
+		putUns32(out, value);
+}
+
+// Write one plate as an uncompressed, 8 bit grayscale, little endian TIFF, in a single strip.
+// The samples are ink amounts, so the image is WhiteIsZero. Rows of the bitmap are rowBytes
+// apart; only the first width bytes of each are written.
+static bool writePlateTIFF(const std::string& fileName, const char* pixels, size_t rowBytes,
+	int width, int height, double resolution)
+{
+	static const unsigned int kShort = 3, kLong = 4, kRational = 5;
+	static const int kNumTags = 12;
+
+	unsigned long ifdSize = 2 + (kNumTags * 12) + 4;
+	unsigned long resolutionOffset = 8 + ifdSize;
+	unsigned long imageOffset = resolutionOffset + 16;
+	unsigned long dpi = static_cast<unsigned long>(resolution + 0.5);
+	unsigned long imageSize = static_cast<unsigned long>(width) * static_cast<unsigned long>(height);
+
+	std::vector<unsigned char> header;
+	header.push_back('I');
+	header.push_back('I');
+	putUns16(header, 42);
+	putUns32(header, 8);
+
+	// The tags must be in ascending order.
+	putUns16(header, kNumTags);
+	putTag(header, 256, kLong, width);                  // ImageWidth
+	putTag(header, 257, kLong, height);                 // ImageLength
+	putTag(header, 258, kShort, 8);                     // BitsPerSample
+	putTag(header, 259, kShort, 1);                     // Compression: none
+	putTag(header, 262, kShort, 0);                     // PhotometricInterpretation: WhiteIsZero
+	putTag(header, 273, kLong, imageOffset);            // StripOffsets
+	putTag(header, 277, kShort, 1);                     // SamplesPerPixel
+	putTag(header, 278, kLong, height);                 // RowsPerStrip
+	putTag(header, 279, kLong, imageSize);              // StripByteCounts
+	putTag(header, 282, kRational, resolutionOffset);   // XResolution
+	putTag(header, 283, kRational, resolutionOffset + 8);   // YResolution
+	putTag(header, 296, kShort, 2);                     // ResolutionUnit: inch
+	putUns32(header, 0);                                // No further images.
+
+	putUns32(header, dpi);
+	putUns32(header, 1);
+	putUns32(header, dpi);
+	putUns32(header, 1);
+
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if (file == NULL)
+		return false;
+	bool written = fwrite(&header[0], 1, header.size(), file) == header.size();
+	for (int y = 0; written && y < height; y++)
+		written = fwrite(pixels + y * rowBytes, 1, width, file) == static_cast<size_t>(width);
+	return (fclose(file) == 0) && written;
+}
+
+// The plate file for suffix: named as the other outputs are, but always a TIFF file.
+static std::string plateFileName(const std::string& outputFile, const std::string& suffix)
+{
+	std::string name = OutputFileNameWithSuffix(outputFile, suffix);
+	size_t dot = name.find_last_of('.');
+	size_t slash = name.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		name.erase(dot);
+	return name + ".tif";
+}
+
+// The ink record for a plate, from those the page uses. A process plate the page has no
+// ink for is drawn all the same (and comes out empty), with a record made for it.
+static PDPageInkRec findInk(const std::vector<PDPageInkRec>& pageInks, const PlateSpec& plate)
+{
+	ASAtom name = ASAtomFromString(plate.ink.c_str());
+	for (size_t i = 0; i < pageInks.size(); i++)
+	{
+		if (pageInks[i].colorantName == name)
+			return pageInks[i];
+	}
+
+	PDPageInkRec ink;
+	memset(&ink, 0, sizeof(PDPageInkRec));
+	ink.size = sizeof(PDPageInkRec);
+	ink.colorantName = name;
+	ink.isProcessColor = plate.isProcess;
+	return ink;
+}
+
+// Take plates from the shared list and draw them, with pdDoc, until there are none left.
+static void drawPlates(PDDoc pdDoc, AC_Profile outputProfile, SeparationState* state)
+{
+	RenderPageParams parms = state->job->parms;
+	parms.setOCContext(PDDocGetOCContext(pdDoc));
+	parms.setOutputProfile(outputProfile);
+	parms.setBufferAllocator(NULL);
+
+	// Changed inside DURING and read after a raise, so volatile.
+	volatile PDPage pdPage = NULL;
+	volatile ASInt32 pageNum = -1;
+	std::vector<PDPageInkRec> pageInks;
+
+	size_t index;
+	while ((index = state->next++) < state->plates.size())
+	{
+		PlateSpec& plate = state->plates[index];
+		DURING
+			if (plate.pageNum != pageNum)
+			{
+				if (pdPage != NULL)
+					PDPageRelease(pdPage);
+				pdPage = NULL;
+				pageNum = -1;
+				pdPage = PDDocAcquirePage(pdDoc, plate.pageNum);
+				pageNum = plate.pageNum;
+				pageInks.clear();
+				PDPageEnumInks(pdPage, collectInk, &pageInks, false);
+			}
+
+			PDPageInkRec ink = findInk(pageInks, plate);
+			parms.setSeparationInk(&ink);
+
+			PDPage page = pdPage;
+			ASFixedRect cropRect;
+			PDPageGetCropBox(page, &cropRect);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			RenderPage drawPage(page, &cropRect, &parms);
+			std::chrono::steady_clock::time_point drawn = std::chrono::steady_clock::now();
+			plate.drawSeconds = std::chrono::duration<double>(drawn - start).count();
+
+			MemStage outerStage = MemTrackStage(kMemStageExport);
+			plate.written = writePlateTIFF(plate.fileName, drawPage.GetImageBuffer(), drawPage.RowBytes(),
+				drawPage.Width(), drawPage.Height(), parms.Resolution());
+			MemTrackStage(outerStage);
+			plate.writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - drawn).count();
+			plate.errCode = 0;
+		HANDLER
+			plate.errCode = ERRORCODE;
+		END_HANDLER
+		parms.setSeparationInk(NULL);
+	}
+
+	if (pdPage != NULL)
+		PDPageRelease(pdPage);
+}
+
+static void separationWorker(SeparationState* state)
+{
+	const SeparationJob& job = *state->job;
+
+	// Each thread needs its own initialization of the library, and its own copy of the document.
+	APDFLib libInit;
+	if (libInit.isValid() == false)
+	{
+		std::lock_guard<std::mutex> guard(state->reportLock);
+		std::cout << "Worker initialization failed with code " << libInit.getInitError() << std::endl;
+		return;
+	}
+
+	AC_Profile outputProfile = NULL;
+	if (!job.targetProfile.empty())
+		ACMakeBufferProfile(&outputProfile, const_cast<char*>(&job.targetProfile[0]), static_cast<ASUns32>(job.targetProfile.size()));
+
+	ASErrorCode errCode = 0;
+	DURING
+		MemTrackStage(kMemStageOpen);
+		APDFLDoc doc(job.inputFile.c_str(), true);
+		MemTrackStage(kMemStageOther);
+		drawPlates(doc.getPDDoc(), outputProfile, state);
+	HANDLER
+		errCode = ERRORCODE;
+	END_HANDLER
+
+	if (outputProfile != NULL)
+		ACUnReferenceProfile(outputProfile);
+
+	if (errCode != 0)
+	{
+		std::lock_guard<std::mutex> guard(state->reportLock);
+		std::cout << "Worker could not open " << job.inputFile.c_str() << ": error " << errCode << std::endl;
+	}
+}
+
+int RenderSeparations(PDDoc pdDoc, SeparationJob& job)
+{
+	job.parms.SetColorSpace(ASAtomFromString("DeviceGray"));
+	job.parms.setBitsPerComponents(8);
+
+	SeparationState state;
+	state.job = &job;
+
+	// Every plate of every page, found before any is drawn.
+	int numFailed = 0;
+	ASInt32 numPages = PDDocGetNumPages(pdDoc);
+	for (ASInt32 pageNum = 0; pageNum < numPages; pageNum++)
+	{
+		std::vector<PDPageInkRec> pageInks;
+		ASErrorCode errCode = 0;
+		DURING
+			PDPage pdPage = PDDocAcquirePage(pdDoc, pageNum);
+			PDPageEnumInks(pdPage, collectInk, &pageInks, false);
+			PDPageRelease(pdPage);
+		HANDLER
+			errCode = ERRORCODE;
+		END_HANDLER
+
+		if (errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(errCode, buf, sizeof(buf));
+			std::cout << "Page " << pageNum + 1 << " failed: " << buf << std::endl;
+			++numFailed;
+			continue;
+		}
+
+		std::vector<std::pair<std::string, bool> > inks;
+		for (int i = 0; i < kNumProcessPlates; i++)
+			inks.push_back(std::make_pair(std::string(kProcessPlates[i]), true));
+		for (size_t i = 0; i < pageInks.size(); i++)
+		{
+			if (!pageInks[i].isProcessColor)
+				inks.push_back(std::make_pair(std::string(ASAtomGetString(pageInks[i].colorantName)), false));
+		}
+
+		char pageSuffix[32];
+		sprintf(pageSuffix, "p%d-", pageNum + 1);
+		for (size_t i = 0; i < inks.size(); i++)
+		{
+			PlateSpec plate;
+			plate.pageNum = pageNum;
+			plate.ink = inks[i].first;
+			plate.isProcess = inks[i].second;
+			plate.fileName = plateFileName(job.outputFile, pageSuffix + inks[i].first);
+			plate.written = false;
+			plate.errCode = 0;
+			plate.drawSeconds = plate.writeSeconds = 0;
+			state.plates.push_back(plate);
+		}
+	}
+
+	int numThreads = job.numThreads > 0 ? job.numThreads : static_cast<int>(std::thread::hardware_concurrency());
+	numThreads = std::max(1, std::min(numThreads, static_cast<int>(state.plates.size())));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (numThreads == 1)
+		drawPlates(pdDoc, job.parms.getOutputProfile(), &state);
+	else
+	{
+		std::vector<std::thread> workers;
+		for (int i = 0; i < numThreads; i++)
+			workers.push_back(std::thread(separationWorker, &state));
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ASInt32 pageNum = -1;
+	for (size_t i = 0; i < state.plates.size(); i++)
+	{
+		const PlateSpec& plate = state.plates[i];
+		if (plate.pageNum != pageNum)
+		{
+			pageNum = plate.pageNum;
+			std::cout << "Page " << pageNum + 1 << ":" << std::endl;
+		}
+		std::cout << "  " << plate.ink.c_str() << (plate.isProcess ? "" : " (spot)") << ": ";
+		if (i >= state.next)
+			std::cout << "not drawn, as no thread could open the document";
+		else if (plate.errCode != 0)
+		{
+			char buf[256];
+			ASGetErrorString(plate.errCode, buf, sizeof(buf));
+			std::cout << "failed: " << buf;
+		}
+		else
+		{
+			std::cout << "drawn in " << plate.drawSeconds << " s, written in " << plate.writeSeconds << " s";
+			if (!plate.written)
+				std::cout << ", but could not write " << plate.fileName.c_str();
+		}
+		std::cout << std::endl;
+		if (i >= state.next || plate.errCode != 0 || !plate.written)
+			++numFailed;
+	}
+	std::cout << state.plates.size() << " plates of " << numPages << " pages in " << seconds << " s on "
+		<< numThreads << " thread(s)." << std::endl;
+	return numFailed;
+}
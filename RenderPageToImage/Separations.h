@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Separation plates for prepress proofing. Every plate of every page, the four process
+// plates and one for each spot ink the page uses (as PDPageEnumInks lists them), is drawn
+// on its own as a separation of that one ink, and written as an 8 bit grayscale TIFF file.
+// A plate's samples are the amount of ink, stored as WhiteIsZero, so that no ink shows as
+// white.
+//
+// The plates are shared out between numThreads threads (by default, one for each core),
+// each with its own initialization of the library and its own copy of the document, and
+// drawn at the same time, one plate to a thread at a time. The time to draw and to write
+// each plate is reported.
+//
+// The plates of page <n> are named after the output file, with "-p<n>-<ink>" added and the
+// extension changed to .tif.
+//
+
+#ifndef SEPARATIONS_H
+#define SEPARATIONS_H
+
+#include <string>
+
+#include "PDFLExpT.h"
+
+#include "RenderWorkers.h"
+
+struct SeparationJob : PageRenderJob
+{
+	std::string outputFile;         // The plates are named from this.
+};
+
+// Write the plates of every page of pdDoc. job.parms gives the resolution and flags; its
+// color space and bits per component are replaced. pageNum is not used: every page is
+// drawn. Returns the number of plates that failed.
+int RenderSeparations(PDDoc pdDoc, SeparationJob& job);
+
+#endif // SEPARATIONS_H
@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Rendering into shared memory. See SharedRaster.h.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // For memfd_create().
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <atomic>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include "ASCalls.h"
+
+#include "SharedRaster.h"
+
+SharedRasterAllocator::SharedRasterAllocator() : mode(kNone), fd(-1), mapping(NULL), mappingSize(0), published(false)
+{
+}
+
+SharedRasterAllocator::~SharedRasterAllocator()
+{
+	if (mapping != NULL)
+		Free(static_cast<char*>(mapping) + kSharedRasterHeaderSize);
+}
+
+void SharedRasterAllocator::UseSharedMemory(const std::string& objectName)
+{
+	mode = kSharedMemory;
+	// POSIX wants the name of a shared memory object to start with a '/'.
+	name = (!objectName.empty() && objectName[0] == '/') ? objectName : "/" + objectName;
+}
+
+void SharedRasterAllocator::UseMemfd(const std::string& socketPath)
+{
+	mode = kMemfd;
+	name = socketPath;
+}
+
+#ifndef _WIN32
+
+char* SharedRasterAllocator::Allocate(ASSize_t size, const RenderBitmapInfo& info)
+{
+	lastError.clear();
+	if (mapping != NULL)
+	{
+		lastError = "Only one page at a time can be put in shared memory";
+		return NULL;
+	}
+
+	if (mode == kSharedMemory)
+	{
+		fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+		if (fd < 0)
+		{
+			lastError = "shm_open " + name + ": " + strerror(errno);
+			return NULL;
+		}
+	}
+	else if (mode == kMemfd)
+	{
+#ifdef __linux__
+		fd = memfd_create("RenderPageToImage", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		if (fd < 0)
+		{
+			lastError = std::string("memfd_create: ") + strerror(errno);
+			return NULL;
+		}
+#else
+		lastError = "memfd is only available on Linux";
+		return NULL;
+#endif
+	}
+	else
+	{
+		lastError = "No shared memory chosen";
+		return NULL;
+	}
+
+	mappingSize = kSharedRasterHeaderSize + static_cast<size_t>(size);
+	void* memory = MAP_FAILED;
+	if (ftruncate(fd, static_cast<off_t>(mappingSize)) == 0)
+		memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED)
+	{
+		lastError = std::string("Unable to map shared memory: ") + strerror(errno);
+		close(fd);
+		fd = -1;
+		if (mode == kSharedMemory)
+			shm_unlink(name.c_str());
+		return NULL;
+	}
+	mapping = memory;
+	published = false;
+
+	// The magic and version are left zero until Publish(), so that the page is not taken
+	// as ready before it is drawn.
+	SharedRasterHeader* header = static_cast<SharedRasterHeader*>(mapping);
+	memset(header, 0, sizeof(SharedRasterHeader));
+	header->headerSize = kSharedRasterHeaderSize;
+	header->width = static_cast<ASUns32>(info.width);
+	header->height = static_cast<ASUns32>(info.height);
+	header->stride = static_cast<ASUns32>(info.rowBytes);
+	header->bitsPerComponent = static_cast<ASUns32>(info.bpc);
+	header->numComponents = static_cast<ASUns32>(info.nComps);
+	header->resolution = info.resolution;
+	header->dataSize = size;
+	strncpy(header->colorSpace, ASAtomGetString(info.colorSpace), sizeof(header->colorSpace) - 1);
+
+	return static_cast<char*>(mapping) + kSharedRasterHeaderSize;
+}
+
+void SharedRasterAllocator::Free(char* buffer)
+{
+	if (mapping == NULL || buffer != static_cast<char*>(mapping) + kSharedRasterHeaderSize)
+		return;
+
+	// A shared memory object lives on, for the consumer, after it is unmapped, unless the
+	// page never got as far as being published.
+	munmap(mapping, mappingSize);
+	mapping = NULL;
+	close(fd);
+	fd = -1;
+	if (mode == kSharedMemory && !published)
+		shm_unlink(name.c_str());
+}
+
+bool SharedRasterAllocator::Publish(std::string& error)
+{
+	if (mapping == NULL)
+	{
+		error = "Nothing has been drawn into shared memory";
+		return false;
+	}
+
+	// Everything else in the memory is written before the header is marked complete.
+	SharedRasterHeader* header = static_cast<SharedRasterHeader*>(mapping);
+	header->version = 1;
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header->magic, "DLRS", 4);
+	published = true;
+
+	if (mode == kSharedMemory)
+		return true;
+
+#ifdef __linux__
+	// The consumer may rely on the size staying as it is. The contents cannot be sealed
+	// while this process still has them mapped for writing.
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+#endif
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+	{
+		error = std::string("socket: ") + strerror(errno);
+		return false;
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (name.size() >= sizeof(address.sun_path))
+	{
+		close(sock);
+		error = "Socket path too long: " + name;
+		return false;
+	}
+	strcpy(address.sun_path, name.c_str());
+	if (connect(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		error = "connect " + name + ": " + strerror(errno);
+		close(sock);
+		return false;
+	}
+
+	// The header goes as the data of the message, and the memory as its descriptor.
+	struct iovec data;
+	data.iov_base = mapping;
+	data.iov_len = sizeof(SharedRasterHeader);
+
+	union
+	{
+		char buffer[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	memset(&control, 0, sizeof(control));
+
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control.buffer;
+	message.msg_controllen = sizeof(control.buffer);
+
+	struct cmsghdr* fdMessage = CMSG_FIRSTHDR(&message);
+	fdMessage->cmsg_level = SOL_SOCKET;
+	fdMessage->cmsg_type = SCM_RIGHTS;
+	fdMessage->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(fdMessage), &fd, sizeof(int));
+
+	bool sent = sendmsg(sock, &message, 0) == static_cast<ssize_t>(sizeof(SharedRasterHeader));
+	if (!sent)
+		error = "sendmsg " + name + ": " + strerror(errno);
+	close(sock);
+	return sent;
+}
+
+#else
+
+char* SharedRasterAllocator::Allocate(ASSize_t, const RenderBitmapInfo&)
+{
+	lastError = "Shared memory output needs POSIX shared memory";
+	return NULL;
+}
+
+void SharedRasterAllocator::Free(char*)
+{
+}
+
+bool SharedRasterAllocator::Publish(std::string& error)
+{
+	error = "Shared memory output needs POSIX shared memory";
+	return false;
+}
+
+#endif
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Handing a rendered page to another process without writing or encoding an image file.
+// The page is drawn straight into shared memory, behind a SharedRasterHeader:
+//
+//   -shm <name>      a POSIX shared memory object, which is left in place for the consumer
+//                    to shm_open(), mmap() and shm_unlink().
+//   -memfd <socket>  an anonymous memfd, sealed against resizing and sent, with a copy of the
+//                    header, to the Unix domain socket at <socket> (SCM_RIGHTS).
+//
+// The pixels start at headerSize, which is a page boundary, so a consumer can map them alone.
+// They are exactly as PDPageDrawContentsToMemoryWithParams() made them, rows padded to 32
+// bits where nComps is not a multiple of 4, so stride is what to step by.
+//
+// The header is filled in when the memory is allocated, except for magic and version, which
+// stay zero until the page has been drawn and Publish() writes them, last. A consumer that
+// opens the object and does not find "DLRS" and a version it knows has found a page that is
+// still being drawn, and must not read it. If the drawing fails, the object is removed.
+//
+// These are POSIX facilities; elsewhere, Allocate() fails and says why.
+//
+
+#ifndef SHAREDRASTER_H
+#define SHAREDRASTER_H
+
+#include <string>
+
+#include "RenderPage.h"
+
+struct SharedRasterHeader
+{
+	char        magic[4];           // "DLRS", once the page is drawn; zero until then.
+	ASUns32     version;            // 1, written with magic.
+	ASUns32     headerSize;         // Offset of the pixels from the start of the memory.
+	ASUns32     width, height;
+	ASUns32     stride;             // Bytes from the start of one row to the start of the next.
+	ASUns32     bitsPerComponent;
+	ASUns32     numComponents;
+	double      resolution;         // Pixels per inch.
+	ASUns64     dataSize;           // Bytes of pixels.
+	char        colorSpace[32];     // "DeviceGray", "DeviceRGB", "DeviceCMYK" or "DeviceRGBA"; NUL terminated.
+};
+
+static const ASUns32 kSharedRasterHeaderSize = 4096;
+
+class SharedRasterAllocator : public RenderBufferAllocator
+{
+public:
+	SharedRasterAllocator();
+	~SharedRasterAllocator();
+
+	void    UseSharedMemory(const std::string& name);
+	void    UseMemfd(const std::string& socketPath);
+	bool    IsEnabled() const { return mode != kNone; }
+
+	char*   Allocate(ASSize_t size, const RenderBitmapInfo& info);
+	void    Free(char* buffer);
+
+	// Make the drawn bitmap available to the consumer, marking the header complete. Returns
+	// false, with a message in error, if it can't. Memory freed before it is published is
+	// taken to hold a page that failed, and a shared memory object is removed.
+	bool    Publish(std::string& error);
+
+	// Why the last Allocate() failed.
+	const std::string& LastError() const { return lastError; }
+
+private:
+	enum Mode { kNone, kSharedMemory, kMemfd };
+
+	Mode            mode;
+	std::string     name;           // The shared memory object, or the socket.
+	int             fd;
+	void*           mapping;
+	size_t          mappingSize;
+	bool            published;
+	std::string     lastError;
+};
+
+#endif // SHAREDRASTER_H
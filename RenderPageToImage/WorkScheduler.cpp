@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Work-stealing deques for page work. See WorkScheduler.h.
+//
+
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "ASCalls.h"
+#include "CosCalls.h"
+#include "PDCalls.h"
+
+#include "WorkScheduler.h"
+
+WorkScheduler::WorkScheduler(int numWorkers, bool stealWork) : steal(stealWork),
+	queues(numWorkers > 0 ? numWorkers : 1), wallSeconds(0)
+{
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		memset(&queues[i].stats, 0, sizeof(queues[i].stats));
+		queues[i].working = false;
+	}
+}
+
+static bool moreCostly(const WorkItem& a, const WorkItem& b)
+{
+	return a.cost > b.cost;
+}
+
+void WorkScheduler::Deal(std::vector<WorkItem> items)
+{
+	if (steal)
+		std::stable_sort(items.begin(), items.end(), moreCostly);
+	for (size_t i = 0; i < items.size(); i++)
+		queues[i % queues.size()].items.push_back(items[i]);
+}
+
+void WorkScheduler::Run(const std::function<void(int worker)>& body)
+{
+	Clock::time_point start = Clock::now();
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < queues.size(); i++)
+		workers.push_back(std::thread(body, static_cast<int>(i)));
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool WorkScheduler::Next(int worker, WorkItem& item)
+{
+	// Only this worker's thread touches its stats and timing.
+	WorkerQueue& own = queues[worker];
+	Clock::time_point now = Clock::now();
+	if (own.working)
+		own.stats.busySeconds += std::chrono::duration<double>(now - own.started).count();
+	own.working = false;
+
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.items.empty())
+		{
+			item = own.items.front();
+			own.items.pop_front();
+			found = true;
+		}
+	}
+
+	// The back of another worker's deque holds its cheapest items, the quickest to move.
+	for (size_t i = 1; steal && !found && i < queues.size(); i++)
+	{
+		WorkerQueue& victim = queues[(worker + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.items.empty())
+		{
+			item = victim.items.back();
+			victim.items.pop_back();
+			found = true;
+			++own.stats.numStolen;
+		}
+	}
+
+	if (found)
+	{
+		++own.stats.numItems;
+		own.working = true;
+		own.started = Clock::now();
+	}
+	return found;
+}
+
+void WorkScheduler::Report(const char* title) const
+{
+	double totalBusy = 0;
+	for (size_t i = 0; i < queues.size(); i++)
+		totalBusy += queues[i].stats.busySeconds;
+
+	std::cout << title << ": " << wallSeconds << " s on " << queues.size() << " worker(s), "
+		<< (wallSeconds > 0 ? 100.0 * totalBusy / (wallSeconds * queues.size()) : 0.0) << "% busy." << std::endl;
+	for (size_t i = 0; i < queues.size(); i++)
+	{
+		const WorkerStats& stats = queues[i].stats;
+		std::cout << "  worker " << i << ": " << stats.numItems << " items (" << stats.numStolen << " stolen), busy "
+			<< stats.busySeconds << " s (" << (wallSeconds > 0 ? 100.0 * stats.busySeconds / wallSeconds : 0.0) << "%)." << std::endl;
+	}
+}
+
+static void addStreamLength(CosObj obj, double& cost)
+{
+	if (CosObjGetType(obj) == CosStream)
+		cost += CosStreamLength(obj);
+}
+
+static ASBool addXObjectLength(CosObj key, CosObj value, void* clientData)
+{
+	addStreamLength(value, *static_cast<double*>(clientData));
+	return true;
+}
+
+double EstimatePageCost(PDPage pdPage)
+{
+	static const ASAtom sContents_K = ASAtomFromString("Contents");
+	static const ASAtom sXObject_K = ASAtomFromString("XObject");
+
+	double cost = 0;
+	CosObj contents = CosDictGet(PDPageGetCosObj(pdPage), sContents_K);
+	if (CosObjGetType(contents) == CosArray)
+	{
+		for (ASInt32 i = 0; i < CosArrayLength(contents); i++)
+			addStreamLength(CosArrayGet(contents, i), cost);
+	}
+	else
+		addStreamLength(contents, cost);
+
+	CosObj resources = PDPageGetCosResources(pdPage);
+	if (CosObjGetType(resources) == CosDict)
+	{
+		CosObj xObjects = CosDictGet(resources, sXObject_K);
+		if (CosObjGetType(xObjects) == CosDict)
+			CosObjEnum(xObjects, addXObjectLength, &cost);
+	}
+
+	// Even an empty page costs something to set up and write.
+	return cost + 1024;
+}
@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Sample: RenderPageToImage
+//
+// Scheduling page work over a fixed set of worker threads. Splitting the pages evenly
+// leaves workers idle behind one page that is much more work than the others, so:
+//
+//   - each item of work has an estimated cost, and the items are dealt out most costly
+//     first, round the workers in turn, to a deque of each worker's own;
+//   - a worker takes from the front of its own deque, and when it is empty, steals from
+//     the back of another's, so that no worker sits idle while there is work anywhere;
+//   - a page can be split into bands beforehand, which are dealt out, and stolen, like
+//     pages.
+//
+// Dealt without stealing, in the order given, the same items make the plain round-robin
+// split, to compare against. The time each worker spends on its items is kept, and can be
+// reported against the wall time.
+//
+// ColorConvert uses this too, for its -all loop.
+//
+
+#ifndef WORKSCHEDULER_H
+#define WORKSCHEDULER_H
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "PDFLExpT.h"
+
+struct WorkItem
+{
+	ASInt32 pageNum;
+	int band;                   // Which band of the page, or -1 for all of it.
+	int numBands;
+	double cost;
+};
+
+struct WorkerStats
+{
+	int numItems;
+	int numStolen;
+	double busySeconds;
+};
+
+class WorkScheduler
+{
+public:
+	// With steal false, items stay with the worker they are dealt to.
+	WorkScheduler(int numWorkers, bool steal);
+
+	// Deal out items: when stealing, the most costly first; otherwise in the order given.
+	void Deal(std::vector<WorkItem> items);
+
+	// Run body(worker) on a thread for each worker, and wait for them all. body takes its
+	// work with Next().
+	void Run(const std::function<void(int worker)>& body);
+
+	// The next item for worker, from its own deque or, when stealing, another's. The time
+	// since the worker's last item was handed out is counted as busy. Returns false when
+	// there is nothing left to take.
+	bool Next(int worker, WorkItem& item);
+
+	int NumWorkers() const { return static_cast<int>(queues.size()); }
+	bool Stealing() const { return steal; }
+	double WallSeconds() const { return wallSeconds; }
+	const WorkerStats& Stats(int worker) const { return queues[worker].stats; }
+
+	// Wall time, and each worker's share of it, under title.
+	void Report(const char* title) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct WorkerQueue
+	{
+		std::mutex lock;
+		std::deque<WorkItem> items;
+		WorkerStats stats;
+		bool working;
+		Clock::time_point started;
+	};
+
+	bool steal;
+	std::vector<WorkerQueue> queues;
+	double wallSeconds;
+};
+
+// An estimate of the work in drawing or converting a page, from the size of what it draws:
+// the lengths of its content streams, and of the image and form streams its resources name.
+double EstimatePageCost(PDPage pdPage);
+
+#endif // WORKSCHEDULER_H
@@ -7,6 +7,86 @@
 // Sample: RenderPageToImage - Demonstrates the process of rasterizing an area of a PDF page 
 //   and saving it to an Image File
 //
+// With -alllayers, or -layers <name>,<name>,..., one image is made for each optional content
+// group (layer) of the page, showing that layer and the content that is not optional. The
+// images are named after the output file, with the layer name added. -threads <n> renders
+// the layers on n threads, each with its own copy of the document.
+//
+// With -tiles <name>, the page (or the -rect area of it) is rendered as a Deep Zoom tile
+// pyramid instead, with the resolution setting the size of the largest level: <name>.dzi
+// and <name>_files/, or with -pack, <name>.dzi and <name>.dzpk. -tilesize <n> sets the
+// tile size (default 256), and -threads <n> renders the tiles on n threads. See
+// RenderWorkers.h for the layout.
+//
+// -redrawbench times redrawing just the areas an edit changed (RenderPage::Redraw) against
+// drawing the whole page again, and compares the results. The areas are those given with
+// -dirty <left> <bottom> <right> <top> (which may be repeated) or, by default, the
+// rectangles of the annotations on the page, as for an edit that only changes annotations.
+//
+// -separations writes the Cyan, Magenta, Yellow and Black plates, and a plate for each spot
+// ink, of every page of the document as grayscale TIFF files, named after the output file
+// with the page number and ink added. The plates are drawn on -threads <n> threads (default,
+// one for each core), and the time for each reported. See Separations.h.
+//
+// -profile <file> counts what each page of the document draws (operators, path segments,
+// text, image pixels, transparency, shadings and so on), times drawing it, fits a model of
+// the cost to the counts and writes it all to <file> as JSON. Pages that take at least
+// -slowpage <seconds> (default 5) are flagged as slow. See PageProfiler.h.
+//
+// -shm <name> draws the page straight into the POSIX shared memory object <name>, and
+// -memfd <socket> into a memfd that is then sent to the Unix domain socket <socket>, for
+// another process to read without an image file being written. See SharedRaster.h.
+//
+// -mapbuffer <dir> draws the page into a temporary file in <dir> mapped into memory, rather
+// than into memory alone, for bitmaps too big for the memory there is. -mapcheck <dir> draws
+// the page into such a file at a resolution that makes the bitmap a little over 4 GB, and
+// checks that the rows past 4 GB are drawn where they belong. See MappedRaster.h.
+//
+// -allpages renders every page of the document to its own PNG file, named after the output
+// file with the page number added, drawing one page while the ones before it are compressed
+// and written. -queue <n> sets how many pages may wait between stages (default 2), and
+// -threads <n> the number of threads writing. A page that draws the same as one before it
+// is not drawn again; its image is a hard link to the earlier one's. -nodedupe draws every
+// page. See PagePipeline.h and PageDedup.h.
+//
+// -schedule also renders every page to its own PNG file, named as for -allpages, but on
+// -threads <n> threads (default, one for each core), each drawing whole pages, the most
+// costly first, and taking pages from the others when it runs out. Pages too big for one
+// thread are split into bands. -schedbench first renders the pages split round-robin
+// between the threads, and compares the time. See WorkScheduler.h and ScheduledRender.h.
+//
+// -flatten renders every page into a new PDF, the output file, as a single image filling a
+// page of the same size, with nothing else of the document kept, on -threads <n> threads
+// (default, one for each core). Each page is compressed with CCITT G4, DCT or Flate, chosen
+// from what it shows, or with -flattenfilter <flate|dct|ccitt> the same for all. No more than
+// -queue <n> pages (default 2), or one page for each thread if that is more, are rendered
+// ahead of the output, which is saved every
+// -flattenwindow <n> pages (default 50). See FlattenPages.h.
+//
+// -fastpng writes the PNG with PngWriter, which compresses on several threads, instead of
+// DLExportPDEImage. -pnglevel <0-9>, -pngfilter <none|sub|up|average|paeth|adaptive> and
+// -pngthreads <n> tune it. -pngbench writes the page both ways, the PngWriter copy with
+// "-parallel" added to its name, and compares the time and size. See PngWriter.h.
+//
+// -jpeg writes a JPEG instead of a PNG, with -jpegquality <1-100> (default 85), -subsample
+// <444|422|420> (default 420) and -progressive. -jpegbench writes the PNG as usual and a JPEG
+// beside it, named with .jpg, and compares the time and size. See JpegWriter.h.
+//
+// -derive draws the page once, in RGB, and makes the image for -targetprofile from that
+// with a color lookup table, besides the RGB image; -deriveprofile <icc> (which may be
+// repeated) adds more. Each is named after the output file with its color space added.
+// -lutsize <n> sets the points per channel of the tables (default 17), and -lutcache <dir>
+// keeps them on disk for the next run. -lutcheck <tolerance> compares each table with the
+// color engine, failing if it is off by more than tolerance levels, and times drawing the
+// page again for the target. See ColorLUT.h.
+//
+// -prefork <n> <jobfile>, given first, runs each line of <jobfile> as the arguments of a
+// run of the sample, in n processes forked from this one once the library is initialized.
+// See Shared/PreforkPool.h.
+//
+// With the DL_MEMTRACK environment variable set, the memory allocated while opening, sizing,
+// drawing, repacking and exporting is counted, and reported at exit. See Shared/MemTrack.h.
+//
 
 #include "PERCalls.h"
 #include "DLExtrasCalls.h"
@@ -18,8 +98,27 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <thread>
 
 #include "RenderPage.h"
+#include "RenderWorkers.h"
+#include "ColorLUT.h"
+#include "FlattenPages.h"
+#include "JpegWriter.h"
+#include "MappedRaster.h"
+#include "PagePipeline.h"
+#include "PageProfiler.h"
+#include "PngWriter.h"
+#include "ScheduledRender.h"
+#include "Separations.h"
+#include "SharedRaster.h"
+#include "PermMatrix.h"
+#include "MemTrack.h"
+#include "PreforkPool.h"
 
 #define DIR_LOC "../../../../Resources/Sample_Input/"
 #define DEF_INPUT "RenderPage.pdf"
@@ -47,20 +146,21 @@ static std::vector<char> ReadFromFile(const char* path)
 }
 
 
-int main(int argc, char** argv)
+// One run of the sample, on its own command line or as a -prefork job.
+// The color tables of -derive, kept while the process lives, so that each -prefork job a
+// process runs can use the tables the jobs before it built.
+static ColorLUTCache& lutCacheFor(const std::string& cacheDir)
 {
-	ASErrorCode errCode = 0;
-
-	// Initialize the library
-	APDFLib libInit;
+	static std::map<std::string, std::unique_ptr<ColorLUTCache> > sCaches;
+	std::unique_ptr<ColorLUTCache>& cache = sCaches[cacheDir];
+	if (!cache)
+		cache.reset(new ColorLUTCache(cacheDir));
+	return *cache;
+}
 
-	// If library in initialization failed.
-	if (libInit.isValid() == false)
-	{
-		errCode = libInit.getInitError();
-		std::cout << "Initialization failed with code " << errCode << std::endl;
-		return libInit.getInitError();
-	}
+static int renderPageToImage(APDFLib& libInit, int argc, char** argv)
+{
+	ASErrorCode errCode = 0;
 
 	int curArg = 1;
 	RenderPageParams parms;
@@ -78,6 +178,39 @@ int main(int argc, char** argv)
 	ASText layerName = ASTextNew(); //initialized to an empty string/
 	int pageNum = 0;
 	AC_Profile outputProfile{ nullptr };
+	std::vector<char> targetProfileData;
+	std::vector<char> workingRGBData;
+	PermCache* permCache = NULL;
+	bool bAllLayers = false;
+	std::vector<std::string> layerList;
+	int numThreads = 0;             // Until -threads is given; each mode has its own default.
+	std::string tilesName;
+	int tileSize = 256;
+	bool bPackTiles = false;
+	bool bRedrawBench = false;
+	bool bSeparations = false;
+	std::string profileName;
+	double slowSeconds = 5.0;
+	bool bAllPages = false;
+	bool bSchedule = false;
+	bool bScheduleBench = false;
+	int queueDepth = 2;
+	bool bSkipDuplicates = true;
+	bool bFlatten = false;
+	FlattenFilter flattenFilter = kFlattenAuto;
+	int flattenWindow = 50;
+	SharedRasterAllocator sharedRaster;
+	MappedRasterAllocator mappedRaster;
+	bool bMapCheck = false;
+	bool bFastPng = false;
+	bool bPngBench = false;
+	PngWriteOptions pngOptions;
+	bool bJpeg = false;
+	bool bJpegBench = false;
+	JpegWriteOptions jpegOptions;
+	bool bDerive = false;
+	DeriveJob deriveJob;
+	std::vector<ASFixedRect> dirtyRects;
 
 	while (argc > curArg)
 	{
@@ -156,6 +289,7 @@ int main(int argc, char** argv)
 			if (ProfBuf.size())
 			{
 				PDPrefSetWorkingRGB(&ProfBuf[0], static_cast<ASUns32>(ProfBuf.size()));
+				workingRGBData.swap(ProfBuf);
 			}
 		}
 		else if (strcmp(argv[curArg], "-cmykworkingprofile") == 0)
@@ -174,13 +308,217 @@ int main(int argc, char** argv)
 			if (ProfBuf.size())
 			{
 				ACMakeBufferProfile(&outputProfile, &ProfBuf[0], static_cast<ASUns32>(ProfBuf.size()));
+				targetProfileData.swap(ProfBuf);
 			}
 		}
+		else if (strcmp(argv[curArg], "-permcache") == 0)
+		{
+			// Refuse documents whose permissions do not allow content to be copied, using (and
+			// adding to) the permission matrices stored in this file. See PermCheck/PermMatrix.h.
+			delete permCache;
+			permCache = new PermCache(argv[++curArg]);
+		}
 		else if (strcmp(argv[curArg], "-layer") == 0) //experimental
 		{
 			ASTextDestroy(layerName);
 			layerName = ASTextFromUnicode(reinterpret_cast<const ASUTF16Val*>(argv[++curArg]), kUTF8);
 		}
+		else if (strcmp(argv[curArg], "-alllayers") == 0)
+		{
+			bAllLayers = true;
+		}
+		else if (strcmp(argv[curArg], "-layers") == 0)
+		{
+			std::string names(argv[++curArg]);
+			size_t start = 0;
+			while (start <= names.size())
+			{
+				size_t comma = names.find(',', start);
+				if (comma == std::string::npos)
+					comma = names.size();
+				if (comma > start)
+					layerList.push_back(names.substr(start, comma - start));
+				start = comma + 1;
+			}
+		}
+		else if (strcmp(argv[curArg], "-tiles") == 0)
+		{
+			tilesName = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-tilesize") == 0)
+		{
+			tileSize = atoi(argv[++curArg]);
+			if (tileSize < 16)
+				tileSize = 16;
+		}
+		else if (strcmp(argv[curArg], "-pack") == 0)
+		{
+			bPackTiles = true;
+		}
+		else if (strcmp(argv[curArg], "-redrawbench") == 0)
+		{
+			bRedrawBench = true;
+		}
+		else if (strcmp(argv[curArg], "-separations") == 0)
+		{
+			bSeparations = true;
+		}
+		else if (strcmp(argv[curArg], "-profile") == 0)
+		{
+			profileName = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-slowpage") == 0)
+		{
+			slowSeconds = atof(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-allpages") == 0)
+		{
+			bAllPages = true;
+		}
+		else if (strcmp(argv[curArg], "-schedule") == 0)
+		{
+			bSchedule = true;
+		}
+		else if (strcmp(argv[curArg], "-schedbench") == 0)
+		{
+			bSchedule = true;
+			bScheduleBench = true;
+		}
+		else if (strcmp(argv[curArg], "-queue") == 0)
+		{
+			queueDepth = atoi(argv[++curArg]);
+			if (queueDepth < 1)
+				queueDepth = 1;
+		}
+		else if (strcmp(argv[curArg], "-nodedupe") == 0)
+		{
+			bSkipDuplicates = false;
+		}
+		else if (strcmp(argv[curArg], "-flatten") == 0)
+		{
+			bFlatten = true;
+		}
+		else if (strcmp(argv[curArg], "-flattenfilter") == 0)
+		{
+			++curArg;
+			if (strcmp(argv[curArg], "flate") == 0)
+				flattenFilter = kFlattenFlate;
+			else if (strcmp(argv[curArg], "dct") == 0)
+				flattenFilter = kFlattenDCT;
+			else if (strcmp(argv[curArg], "ccitt") == 0)
+				flattenFilter = kFlattenCCITT;
+			else
+				flattenFilter = kFlattenAuto;
+		}
+		else if (strcmp(argv[curArg], "-flattenwindow") == 0)
+		{
+			flattenWindow = atoi(argv[++curArg]);
+			if (flattenWindow < 1)
+				flattenWindow = 1;
+		}
+		else if (strcmp(argv[curArg], "-fastpng") == 0)
+		{
+			bFastPng = true;
+		}
+		else if (strcmp(argv[curArg], "-pngbench") == 0)
+		{
+			bPngBench = true;
+		}
+		else if (strcmp(argv[curArg], "-pnglevel") == 0)
+		{
+			pngOptions.level = atoi(argv[++curArg]);
+			if (pngOptions.level < 0 || pngOptions.level > 9)
+				pngOptions.level = 6;
+		}
+		else if (strcmp(argv[curArg], "-pngfilter") == 0)
+		{
+			if (!ParsePngFilter(argv[++curArg], pngOptions.filter))
+				std::cout << "Unknown PNG filter " << argv[curArg] << "; using adaptive." << std::endl;
+		}
+		else if (strcmp(argv[curArg], "-pngthreads") == 0)
+		{
+			pngOptions.numThreads = atoi(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-jpeg") == 0)
+		{
+			bJpeg = true;
+		}
+		else if (strcmp(argv[curArg], "-jpegbench") == 0)
+		{
+			bJpegBench = true;
+		}
+		else if (strcmp(argv[curArg], "-jpegquality") == 0)
+		{
+			jpegOptions.quality = atoi(argv[++curArg]);
+			if (jpegOptions.quality < 1 || jpegOptions.quality > 100)
+				jpegOptions.quality = 85;
+		}
+		else if (strcmp(argv[curArg], "-subsample") == 0)
+		{
+			if (!ParseJpegSubsampling(argv[++curArg], jpegOptions.subsampling))
+				std::cout << "Unknown subsampling " << argv[curArg] << "; using 420." << std::endl;
+		}
+		else if (strcmp(argv[curArg], "-progressive") == 0)
+		{
+			jpegOptions.progressive = true;
+		}
+		else if (strcmp(argv[curArg], "-derive") == 0)
+		{
+			bDerive = true;
+		}
+		else if (strcmp(argv[curArg], "-deriveprofile") == 0)
+		{
+			std::vector<char> ProfBuf;
+			ProfBuf = ReadFromFile(argv[++curArg]);
+			if (ProfBuf.size())
+				deriveJob.targets.push_back(ProfBuf);
+			else
+				std::cout << "Unable to read profile " << argv[curArg] << std::endl;
+		}
+		else if (strcmp(argv[curArg], "-lutsize") == 0)
+		{
+			deriveJob.gridSize = atoi(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-lutcache") == 0)
+		{
+			deriveJob.cacheDir = argv[++curArg];
+		}
+		else if (strcmp(argv[curArg], "-lutcheck") == 0)
+		{
+			deriveJob.checkTolerance = atoi(argv[++curArg]);
+			if (deriveJob.checkTolerance < 0)
+				deriveJob.checkTolerance = 0;
+		}
+		else if (strcmp(argv[curArg], "-shm") == 0)
+		{
+			sharedRaster.UseSharedMemory(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-memfd") == 0)
+		{
+			sharedRaster.UseMemfd(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-mapbuffer") == 0)
+		{
+			mappedRaster.UseDirectory(argv[++curArg]);
+		}
+		else if (strcmp(argv[curArg], "-mapcheck") == 0)
+		{
+			mappedRaster.UseDirectory(argv[++curArg]);
+			bMapCheck = true;
+		}
+		else if (strcmp(argv[curArg], "-dirty") == 0)
+		{
+			ASFixedRect dirty;
+			dirty.left = FloatToASFixed(atof(argv[++curArg]));
+			dirty.bottom = FloatToASFixed(atof(argv[++curArg]));
+			dirty.right = FloatToASFixed(atof(argv[++curArg]));
+			dirty.top = FloatToASFixed(atof(argv[++curArg]));
+			dirtyRects.push_back(dirty);
+		}
+		else if (strcmp(argv[curArg], "-threads") == 0)
+		{
+			numThreads = atoi(argv[++curArg]);
+		}
 		else if (strcmp(argv[curArg], "-nosmoothtext") == 0)
 		{
 			smoothFlags &= ~kPDPageDrawSmoothText;
@@ -282,10 +620,128 @@ int main(int argc, char** argv)
 			<< " with " << std::endl << " Resolution of " << parms.Resolution() << ", Colorspace "
 			<< ASAtomGetString(parms.ColorSpaceName()) << ", and BPC " << parms.BitsPerComponent() << std::endl;
 	}
+
 	DURING
 
+		// A document already known to forbid this can be skipped without opening it.
+		if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), NULL, PDPermReqObjDoc, PDPermReqOprCopy) == kPermDenied)
+			ASRaise(pdErrOpNotPermitted);
+
 		// Open the input document and acquire the desired page
+		MemTrackStage(kMemStageOpen);
 		APDFLDoc inDoc(csInputFileName.c_str(), true);
+		if (permCache != NULL && PermGateCheck(permCache, csInputFileName.c_str(), inDoc.getPDDoc(), PDPermReqObjDoc, PDPermReqOprCopy) == kPermDenied)
+			ASRaise(pdErrOpNotPermitted);
+		MemTrackStage(kMemStageOther);
+
+		// An image of every page, on many threads.
+		if (bSchedule)
+		{
+			ScheduledRenderJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = 0;
+			job.parms = parms;
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.targetProfile = targetProfileData;
+			job.numThreads = numThreads;
+			job.outputFile = csOutputFileName;
+			job.compareStatic = bScheduleBench;
+
+			int numFailed = RenderPagesScheduled(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
+		// An image of every page, rather than of one.
+		if (bAllPages)
+		{
+			PipelineJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = 0;
+			job.parms = parms;
+			job.parms.setOCContext(PDDocGetOCContext(inDoc.getPDDoc()));
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.parms.setOutputProfile(outputProfile);
+			job.numThreads = numThreads > 0 ? numThreads : 1;
+			job.outputFile = csOutputFileName;
+			job.queueDepth = static_cast<size_t>(queueDepth);
+			job.skipDuplicates = bSkipDuplicates;
+
+			int numFailed = RenderPagesPipelined(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
+		// A document of images of every page, rather than an image of one.
+		if (bFlatten)
+		{
+			FlattenJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = 0;
+			job.parms = parms;
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.targetProfile = targetProfileData;
+			job.numThreads = numThreads;
+			job.outputFile = csOutputFileName;
+			job.filter = flattenFilter;
+			job.queueDepth = static_cast<size_t>(queueDepth);
+			job.windowSize = flattenWindow;
+
+			int numFailed = FlattenPages(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
+		// The plates of every page, rather than an image of one.
+		if (bSeparations)
+		{
+			SeparationJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = 0;
+			job.parms = parms;
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.parms.setOutputProfile(outputProfile);
+			job.targetProfile = targetProfileData;
+			job.numThreads = numThreads;
+			job.outputFile = csOutputFileName;
+
+			int numFailed = RenderSeparations(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
+		// A profile of every page, rather than an image of one.
+		if (!profileName.empty())
+		{
+			parms.setOCContext(PDDocGetOCContext(inDoc.getPDDoc()));
+			parms.setDrawFlags(drawFlags);
+			parms.setSmoothFlags(smoothFlags);
+			parms.setOutputProfile(outputProfile);
+
+			int numFailed = ProfilePages(inDoc.getPDDoc(), csInputFileName, parms, profileName, slowSeconds);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
 	    PDPage pdPage = inDoc.getPage(pageNum);
 
 		if (!bUseSpecifiedRect)
@@ -306,6 +762,79 @@ int main(int argc, char** argv)
 			std::cout << "Rendering page " << pageNum << " area: " << ((fOutRect.right - fOutRect.left) * 0.125 / fixedNine) << " * " << ((fOutRect.top - fOutRect.bottom) * 0.125 / fixedNine) << " inches." << std::endl;
 
 
+		// Check drawing past 4 GB, rather than writing an image.
+		if (bMapCheck)
+		{
+			parms.setOCContext(PDDocGetOCContext(inDoc.getPDDoc()));
+			parms.setDrawFlags(drawFlags);
+			parms.setSmoothFlags(smoothFlags);
+			parms.setOutputProfile(outputProfile);
+
+			int numDifferent = CheckMappedRaster(pdPage, fCropRect, parms, mappedRaster);
+			if (numDifferent == 0)
+				std::cout << "The rows past 4 GB match." << std::endl;
+			PDPageRelease(pdPage);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numDifferent == 0 ? 0 : 1);
+		}
+
+		// Render the tile pyramid, rather than a single image.
+		if (!tilesName.empty())
+		{
+			TileRenderJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = pageNum;
+			job.parms = parms;
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.parms.setOutputProfile(outputProfile);
+			job.targetProfile = targetProfileData;
+			job.numThreads = numThreads > 0 ? numThreads : 1;
+			job.pageRect = fCropRect;
+			job.tileSize = tileSize;
+			job.outputName = tilesName;
+			job.pack = bPackTiles;
+			PDPageRelease(pdPage);
+
+			int numFailed = RenderTiles(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
+		// Render each of the chosen layers into its own image, from this one opening of the page.
+		if (bAllLayers || !layerList.empty())
+		{
+			LayerRenderJob job;
+			job.inputFile = csInputFileName;
+			job.pageNum = pageNum;
+			job.cropRect = fCropRect;
+			job.outRect = fOutRect;
+			job.parms = parms;
+			job.parms.setDrawFlags(drawFlags);
+			job.parms.setSmoothFlags(smoothFlags);
+			job.parms.setOutputProfile(outputProfile);
+			job.targetProfile = targetProfileData;
+			job.outputFile = csOutputFileName;
+			job.numThreads = numThreads > 0 ? numThreads : 1;
+			SelectLayers(pdPage, layerList, job);
+			PDPageRelease(pdPage);
+
+			std::cout << "Rendering " << job.ocgIndexes.size() << " layers of page " << pageNum << " on "
+				<< job.numThreads << " thread(s)." << std::endl;
+			int numFailed = RenderLayers(inDoc.getPDDoc(), job);
+
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(numFailed == 0 ? 0 : 1);
+		}
+
 		//if specified, only render the optional content for a particular layer (along with non-optional content), otherwise use the default currently visible layers.
 		PDOCContext curContext = PDDocGetOCContext(inDoc.getPDDoc());
 		if (!ASTextIsEmpty(layerName))
@@ -333,21 +862,176 @@ int main(int argc, char** argv)
 		parms.setSmoothFlags(smoothFlags);
 		parms.setOutputProfile(outputProfile);
 
+		// To derive the other outputs, the page is drawn in the working RGB space, not the target's.
+		if (bDerive || !deriveJob.targets.empty())
+		{
+			if (bDerive)
+			{
+				if (targetProfileData.empty())
+				{
+					std::cout << "-derive makes the image for -targetprofile; give one." << std::endl;
+					ASRaise(genErrBadParm);
+				}
+				deriveJob.targets.insert(deriveJob.targets.begin(), targetProfileData);
+			}
+			parms.SetColorSpace(ASAtomFromString("DeviceRGB"));
+			parms.setBitsPerComponents(8);
+			parms.setOutputProfile(nullptr);
+			deriveJob.workingRGB = workingRGBData;
+			deriveJob.intent = parms.RenderIntent();
+			deriveJob.outputFile = csOutputFileName;
+			deriveJob.numThreads = numThreads;
+		}
+		if (sharedRaster.IsEnabled())
+			parms.setBufferAllocator(&sharedRaster);
+		else if (mappedRaster.IsEnabled())
+			parms.setBufferAllocator(&mappedRaster);
+
 		// Construction of the drawPage object does all the work to rasterize the page
 		RenderPage drawPage(pdPage, &fCropRect, &parms);
 
+		if (bRedrawBench)
+		{
+			if (dirtyRects.empty())
+			{
+				for (ASInt32 i = 0; i < PDPageGetNumAnnots(pdPage); i++)
+				{
+					ASFixedRect annotRect;
+					PDAnnotGetRect(PDPageGetAnnot(pdPage, i), &annotRect);
+					dirtyRects.push_back(annotRect);
+				}
+			}
+
+			if (dirtyRects.empty())
+				std::cout << "No areas to redraw: give them with -dirty, or use a page with annotations." << std::endl;
+			else
+			{
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				ASSize_t pixelsDrawn = drawPage.Redraw(pdPage, &dirtyRects[0], static_cast<int>(dirtyRects.size()));
+				std::chrono::steady_clock::time_point redrawn = std::chrono::steady_clock::now();
+				RenderPageParams fullParms = parms;
+				fullParms.setBufferAllocator(NULL);
+				RenderPage fullPage(pdPage, &fCropRect, &fullParms);
+				std::chrono::steady_clock::time_point full = std::chrono::steady_clock::now();
+
+				// The two should match, but for anti-aliasing where an area's edge crosses a mark.
+				ASSize_t numDifferent = 0;
+				const char* redrawnBits = drawPage.GetImageBuffer();
+				const char* fullBits = fullPage.GetImageBuffer();
+				for (ASSize_t i = 0; i < drawPage.GetImageBufferSize() && i < fullPage.GetImageBufferSize(); i++)
+				{
+					if (redrawnBits[i] != fullBits[i])
+						++numDifferent;
+				}
+
+				double redrawTime = std::chrono::duration<double>(redrawn - start).count();
+				double fullTime = std::chrono::duration<double>(full - redrawn).count();
+				std::cout << "Redrew " << dirtyRects.size() << " areas (" << pixelsDrawn << " of "
+					<< (static_cast<ASSize_t>(drawPage.Width()) * drawPage.Height()) << " pixels) in " << redrawTime
+					<< " s; the full page took " << fullTime << " s (" << (redrawTime > 0 ? fullTime / redrawTime : 0.0)
+					<< "x). " << numDifferent << " bytes differ from the full rendering." << std::endl;
+			}
+		}
+
+		// Hand the bitmap over as it was drawn, rather than writing an image file.
+		if (sharedRaster.IsEnabled())
+		{
+			std::string error;
+			bool published = sharedRaster.Publish(error);
+			if (published)
+				std::cout << "Page " << pageNum << " is in shared memory: " << drawPage.Width() << " x " << drawPage.Height()
+					<< ", " << drawPage.RowBytes() << " bytes per row." << std::endl;
+			else
+				std::cout << error.c_str() << std::endl;
+
+			PDPageRelease(pdPage);
+			if (outputProfile != nullptr)
+				ACUnReferenceProfile(outputProfile);
+			delete permCache;
+			E_RETURN(published ? 0 : 1);
+		}
+
+		// The derived outputs, the JPEG and the parallel PNG writers go first, as GetPDEImage()
+		// repacks the bitmap in place.
+		MemTrackStage(kMemStageExport);
+		RenderBitmapInfo bitmapInfo = drawPage.BitmapInfo();
+
+		int numDeriveFailed = 0;
+		if (!deriveJob.targets.empty())
+			numDeriveFailed = DeriveColorOutputs(pdPage, fCropRect, parms, drawPage.GetImageBuffer(), bitmapInfo, deriveJob,
+				lutCacheFor(deriveJob.cacheDir));
+
+		std::string jpegName = csOutputFileName;
+		double jpegTime = 0;
+		if (bJpeg || bJpegBench)
+		{
+			if (!CanWriteJpeg(bitmapInfo.colorSpace, bitmapInfo.bpc))
+			{
+				std::cout << "JpegWriter takes only 8 bit Gray, RGB, RGBA or CMYK." << std::endl;
+				ASRaise(genErrBadParm);
+			}
+
+			if (bJpegBench)
+			{
+				size_t dot = jpegName.find_last_of('.');
+				size_t slash = jpegName.find_last_of("/\\");
+				if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+					jpegName.erase(dot);
+				jpegName += ".jpg";
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::string error;
+			if (!WriteJpeg(jpegName, drawPage.GetImageBuffer(), bitmapInfo, jpegOptions, error))
+			{
+				std::cout << error.c_str() << std::endl;
+				ASRaise(genErrGeneral);
+			}
+			jpegTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (!bJpegBench)
+			{
+				PDPageRelease(pdPage);
+				if (outputProfile != nullptr)
+					ACUnReferenceProfile(outputProfile);
+				delete permCache;
+				E_RETURN(numDeriveFailed == 0 ? 0 : 1);
+			}
+		}
+
+		bool bWriteFastPng = (bFastPng || bPngBench) && CanWritePng(bitmapInfo.colorSpace, bitmapInfo.bpc);
+		if ((bFastPng || bPngBench) && !bWriteFastPng)
+			std::cout << "PngWriter takes only 8 bit Gray, RGB or RGBA; writing with DLExportPDEImage." << std::endl;
+
+		std::string fastPngName = bPngBench ? OutputFileNameWithSuffix(csOutputFileName, "parallel") : csOutputFileName;
+		double fastPngTime = 0;
+		if (bWriteFastPng)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			std::string error;
+			if (!WritePng(fastPngName, drawPage.GetImageBuffer(), bitmapInfo, pngOptions, error))
+			{
+				std::cout << error.c_str() << std::endl;
+				ASRaise(genErrGeneral);
+			}
+			fastPngTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (!bPngBench)
+			{
+				PDPageRelease(pdPage);
+				if (outputProfile != nullptr)
+					ACUnReferenceProfile(outputProfile);
+				delete permCache;
+				E_RETURN(numDeriveFailed == 0 ? 0 : 1);
+			}
+		}
+
+		std::chrono::steady_clock::time_point exportStart = std::chrono::steady_clock::now();
+
 		DLPDEImageExportParams exportParams = DLPDEImageGetExportParams();
 		exportParams.ExportHorizontalDPI = exportParams.ExportVerticalDPI = parms.Resolution();
 
-		ASPathName outPath;
-		ASText textToCreatePath = NULL; // Text object to create ASPathName
-		// Determine size of wchar_t on system and get the ASText
-		if (sizeof(wchar_t) == 2)
-			textToCreatePath = ASTextFromUnicode(reinterpret_cast<const ASUTF16Val*>(csOutputFileName.c_str()), kUTF16HostEndian);
-		else
-			textToCreatePath = ASTextFromUnicode(reinterpret_cast<const ASUTF16Val*>(csOutputFileName.c_str()), kUTF32HostEndian);
-
-		outPath = ASFileSysCreatePathFromDIPathText(NULL, textToCreatePath, NULL);
+		ASPathName outPath = CreateOutputPath(csOutputFileName);
 
 		// The call to GetPDEImage synthesizes a PDEImage object from the rasterized PDF page
 		// created in the constructor, suitable for extracting to an image file.
@@ -355,19 +1039,68 @@ int main(int argc, char** argv)
 
 		DLExportPDEImage(pageImage, outPath, ExportType_PNG, exportParams);
 
+		if ((bPngBench && bWriteFastPng) || bJpegBench)
+		{
+			double exportTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - exportStart).count();
+			std::error_code err;
+			unsigned long long exportSize = std::filesystem::file_size(csOutputFileName, err);
+			std::cout << "DLExportPDEImage: " << exportTime << " s, " << exportSize << " bytes." << std::endl;
+			if (bJpegBench)
+			{
+				unsigned long long jpegSize = std::filesystem::file_size(jpegName, err);
+				std::cout << "JpegWriter (quality " << jpegOptions.quality << ", " << (jpegOptions.subsampling == kJpegSubsample444 ? "4:4:4"
+					: jpegOptions.subsampling == kJpegSubsample422 ? "4:2:2" : "4:2:0") << (jpegOptions.progressive ? ", progressive" : "")
+					<< "): " << jpegTime << " s, " << jpegSize << " bytes (" << (jpegTime > 0 ? exportTime / jpegTime : 0.0)
+					<< "x as fast, " << (exportSize > 0 ? 100.0 * jpegSize / exportSize : 0.0) << "% of the size)." << std::endl;
+			}
+			if (bPngBench && bWriteFastPng)
+			{
+				unsigned long long fastPngSize = std::filesystem::file_size(fastPngName, err);
+				std::cout << "PngWriter (level " << pngOptions.level << ", " << (pngOptions.numThreads > 0 ? pngOptions.numThreads
+					: static_cast<int>(std::thread::hardware_concurrency())) << " threads): " << fastPngTime << " s, " << fastPngSize
+					<< " bytes (" << (fastPngTime > 0 ? exportTime / fastPngTime : 0.0) << "x as fast, "
+					<< (exportSize > 0 ? 100.0 * fastPngSize / exportSize : 0.0) << "% of the size)." << std::endl;
+			}
+		}
+
 		// clean up 
 		PDPageRelease(pdPage);
-		ASTextDestroy(textToCreatePath);
 		ASFileSysReleasePath(NULL, outPath);
 		PDERelease(reinterpret_cast<PDEObject>(pageImage));
 
+		if (numDeriveFailed != 0)
+			errCode = 1;
+
 	HANDLER
 		errCode = ERRORCODE;
 	    libInit.displayError(errCode);
+		if (!sharedRaster.LastError().empty())
+			std::cout << sharedRaster.LastError().c_str() << std::endl;
+		if (!mappedRaster.LastError().empty())
+			std::cout << mappedRaster.LastError().c_str() << std::endl;
 	END_HANDLER
 
 		if (outputProfile != nullptr)
 			ACUnReferenceProfile(outputProfile);
+		delete permCache;
 
 	return errCode;
 }
+
+int main(int argc, char** argv)
+{
+	MemTrackStart("RenderPageToImage");
+
+	// Initialize the library
+	APDFLib libInit;
+
+	// If library in initialization failed.
+	if (libInit.isValid() == false)
+	{
+		ASErrorCode errCode = libInit.getInitError();
+		std::cout << "Initialization failed with code " << errCode << std::endl;
+		return libInit.getInitError();
+	}
+
+	return RunSampleJobs(argc, argv, [&libInit](int jobArgc, char** jobArgv) { return renderPageToImage(libInit, jobArgc, jobArgv); });
+}
@@ -0,0 +1,374 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Shared by the samples: allocation counts by stage. See MemTrack.h.
+//
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <crtdbg.h>
+#include <malloc.h>
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <new>
+
+#include "MemTrack.h"
+
+static const char* const sStageNames[kNumMemStages] =
+{
+	"other", "open", "size-query", "draw", "repack", "export", "edit", "save"
+};
+
+struct StageCounters
+{
+	std::atomic<int64_t> numAllocs;
+	std::atomic<int64_t> bytes;
+	std::atomic<int64_t> peak;
+};
+
+// All of these are zero before any constructor runs, as malloc() can be called before then.
+static StageCounters sStages[kNumMemStages];
+static std::atomic<int64_t> sInUse;
+static std::atomic<int64_t> sPeak;
+static std::atomic<bool> sEnabled;
+static thread_local int tStage;
+
+static char sSampleName[64];
+static char sRecordFile[1024];
+
+static void raiseTo(std::atomic<int64_t>& peak, int64_t value)
+{
+	int64_t seen = peak.load(std::memory_order_relaxed);
+	while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+		;
+}
+
+static void noteAlloc(size_t size)
+{
+	StageCounters& stage = sStages[tStage];
+	stage.numAllocs.fetch_add(1, std::memory_order_relaxed);
+	stage.bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+	int64_t inUse = sInUse.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+	raiseTo(stage.peak, inUse);
+	raiseTo(sPeak, inUse);
+}
+
+static void noteFree(size_t size)
+{
+	sInUse.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+static bool tracking()
+{
+	return sEnabled.load(std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+
+// Replace the C allocator for the whole process, the library included, passing on to glibc's own.
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* block, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* block);
+
+	void* malloc(size_t size) noexcept
+	{
+		void* block = __libc_malloc(size);
+		if (block != NULL && tracking())
+			noteAlloc(malloc_usable_size(block));
+		return block;
+	}
+
+	void* calloc(size_t count, size_t size) noexcept
+	{
+		void* block = __libc_calloc(count, size);
+		if (block != NULL && tracking())
+			noteAlloc(malloc_usable_size(block));
+		return block;
+	}
+
+	void* realloc(void* block, size_t size) noexcept
+	{
+		size_t oldSize = (block != NULL && tracking()) ? malloc_usable_size(block) : 0;
+		void* newBlock = __libc_realloc(block, size);
+		if (tracking() && (newBlock != NULL || size == 0))
+		{
+			noteFree(oldSize);
+			if (newBlock != NULL)
+				noteAlloc(malloc_usable_size(newBlock));
+		}
+		return newBlock;
+	}
+
+	void* memalign(size_t alignment, size_t size) noexcept
+	{
+		void* block = __libc_memalign(alignment, size);
+		if (block != NULL && tracking())
+			noteAlloc(malloc_usable_size(block));
+		return block;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept
+	{
+		return memalign(alignment, size);
+	}
+
+	int posix_memalign(void** block, size_t alignment, size_t size) noexcept
+	{
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+			return EINVAL;
+		void* aligned = memalign(alignment, size);
+		if (aligned == NULL)
+			return ENOMEM;
+		*block = aligned;
+		return 0;
+	}
+
+	void* valloc(size_t size) noexcept
+	{
+		return memalign(sysconf(_SC_PAGESIZE), size);
+	}
+
+	void* pvalloc(size_t size) noexcept
+	{
+		size_t pageSize = sysconf(_SC_PAGESIZE);
+		size_t rounded = (size + pageSize - 1) & ~(pageSize - 1);
+		if (rounded < size)
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+		return memalign(pageSize, rounded != 0 ? rounded : pageSize);
+	}
+
+	// glibc's own goes straight to its realloc, and so would not be counted.
+	void* reallocarray(void* block, size_t count, size_t size) noexcept
+	{
+		size_t total = 0;
+		if (__builtin_mul_overflow(count, size, &total))
+		{
+			errno = ENOMEM;
+			return NULL;
+		}
+		return realloc(block, total);
+	}
+
+	void free(void* block) noexcept
+	{
+		if (block != NULL && tracking())
+			noteFree(malloc_usable_size(block));
+		__libc_free(block);
+	}
+}
+
+static const char* const sCoverage = "all allocations, the library's included";
+
+#elif defined(_WIN32) && defined(_DEBUG)
+
+// The debug CRT calls this for every block of its heap: what the sample allocates with
+// malloc() and new, and what any DLL built against the same CRT does. A hook must not
+// allocate. The CRT's own blocks are left out.
+static int __cdecl allocHook(int allocType, void* userData, size_t size, int blockType, long, const unsigned char*, int)
+{
+	if (!tracking() || blockType == _CRT_BLOCK)
+		return TRUE;
+	switch (allocType)
+	{
+	case _HOOK_ALLOC:
+		noteAlloc(size);
+		break;
+	case _HOOK_REALLOC:
+		if (userData != NULL)
+			noteFree(_msize_dbg(userData, blockType));
+		noteAlloc(size);
+		break;
+	case _HOOK_FREE:
+		if (userData != NULL)
+			noteFree(_msize_dbg(userData, blockType));
+		break;
+	}
+	return TRUE;
+}
+
+static void startCounting()
+{
+	_CrtSetAllocHook(allocHook);
+}
+
+static const char* const sCoverage = "the debug CRT heap; the library's own heaps are not counted";
+
+#else
+
+static size_t blockSize(void* block)
+{
+#if defined(_WIN32)
+	return _msize(block);
+#elif defined(__APPLE__)
+	return malloc_size(block);
+#else
+	return malloc_usable_size(block);
+#endif
+}
+
+static void* trackedNew(size_t size)
+{
+	void* block = malloc(size != 0 ? size : 1);
+	if (block == NULL)
+		throw std::bad_alloc();
+	if (tracking())
+		noteAlloc(blockSize(block));
+	return block;
+}
+
+static void trackedDelete(void* block) noexcept
+{
+	if (block == NULL)
+		return;
+	if (tracking())
+		noteFree(blockSize(block));
+	free(block);
+}
+
+void* operator new(size_t size) { return trackedNew(size); }
+void* operator new[](size_t size) { return trackedNew(size); }
+void operator delete(void* block) noexcept { trackedDelete(block); }
+void operator delete[](void* block) noexcept { trackedDelete(block); }
+void operator delete(void* block, size_t) noexcept { trackedDelete(block); }
+void operator delete[](void* block, size_t) noexcept { trackedDelete(block); }
+
+#if defined(_WIN32)
+static const char* const sCoverage = "C++ new and delete only: malloc() and the library are not counted";
+#else
+static const char* const sCoverage = "the sample's C++ allocations only";
+#endif
+
+#endif
+
+#if !defined(_WIN32) || !defined(_DEBUG)
+static void startCounting()
+{
+}
+#endif
+
+static double megabytes(int64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+static void reportAtExit()
+{
+	// What the report itself allocates is not counted.
+	sEnabled = false;
+
+	printf("\nMemory by stage for %s (%s):\n", sSampleName, sCoverage);
+	printf("  %-12s %12s %14s %14s\n", "stage", "allocations", "MB allocated", "MB peak in use");
+	int64_t totalAllocs = 0, totalBytes = 0;
+	for (int i = 0; i < kNumMemStages; i++)
+	{
+		int64_t numAllocs = sStages[i].numAllocs.load();
+		if (numAllocs == 0)
+			continue;
+		printf("  %-12s %12lld %14.2f %14.2f\n", sStageNames[i], static_cast<long long>(numAllocs),
+			megabytes(sStages[i].bytes.load()), megabytes(sStages[i].peak.load()));
+		totalAllocs += numAllocs;
+		totalBytes += sStages[i].bytes.load();
+	}
+	printf("  %-12s %12lld %14.2f %14.2f\n", "total", static_cast<long long>(totalAllocs),
+		megabytes(totalBytes), megabytes(sPeak.load()));
+
+	if (sRecordFile[0] == '\0')
+		return;
+	FILE* file = fopen(sRecordFile, "a");
+	if (file == NULL)
+	{
+		printf("Could not add to %s: %s\n", sRecordFile, strerror(errno));
+		return;
+	}
+	for (int i = 0; i < kNumMemStages; i++)
+	{
+		fprintf(file, "%s\t%s\t%lld\t%lld\t%lld\n", sSampleName, sStageNames[i],
+			static_cast<long long>(sStages[i].numAllocs.load()), static_cast<long long>(sStages[i].bytes.load()),
+			static_cast<long long>(sStages[i].peak.load()));
+	}
+	fprintf(file, "%s\ttotal\t%lld\t%lld\t%lld\n", sSampleName, static_cast<long long>(totalAllocs),
+		static_cast<long long>(totalBytes), static_cast<long long>(sPeak.load()));
+	fclose(file);
+}
+
+void MemTrackStart(const char* sampleName)
+{
+	const char* setting = getenv("DL_MEMTRACK");
+	if (setting == NULL || tracking())
+		return;
+
+	snprintf(sSampleName, sizeof(sSampleName), "%s", sampleName);
+	if (strcmp(setting, "") != 0 && strcmp(setting, "1") != 0)
+		snprintf(sRecordFile, sizeof(sRecordFile), "%s", setting);
+	atexit(reportAtExit);
+	startCounting();
+	sEnabled = true;
+}
+
+MemStage MemTrackStage(MemStage stage)
+{
+	MemStage previous = static_cast<MemStage>(tStage);
+	tStage = stage;
+	return previous;
+}
+
+void MemTrackResident(long& currentKB, long& peakKB)
+{
+	currentKB = peakKB = -1;
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		currentKB = static_cast<long>(counters.WorkingSetSize / 1024);
+		peakKB = static_cast<long>(counters.PeakWorkingSetSize / 1024);
+	}
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		// ru_maxrss is in kilobytes, except on macOS, where it is in bytes.
+#if defined(__APPLE__)
+		peakKB = static_cast<long>(usage.ru_maxrss / 1024);
+#else
+		peakKB = static_cast<long>(usage.ru_maxrss);
+#endif
+	}
+#if defined(__linux__)
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm != NULL)
+	{
+		long totalPages = 0, residentPages = 0;
+		if (fscanf(statm, "%ld %ld", &totalPages, &residentPages) == 2)
+			currentKB = residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+		fclose(statm);
+	}
+#endif
+#endif
+}
@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Shared by the samples: counting memory allocations by the stage of the work they were made in.
+//
+// The samples mark where each stage of their work begins (opening the document, asking how
+// big a bitmap is, drawing, repacking the bitmap, exporting an image, editing the document
+// and saving it) with MemTrackStage(). Every allocation is counted against the stage the
+// allocating thread is in at the time: the number of allocations, the bytes allocated, and
+// the most bytes in use at once, over all threads, while some thread was in that stage.
+//
+// With glibc, malloc(), calloc(), realloc(), reallocarray(), free(), valloc(), pvalloc() and
+// the aligned allocators are replaced, so what the library allocates for itself is counted
+// along with the sample's own buffers. The library's initialization does not let a sample
+// supply memory callbacks, so elsewhere less is counted, and the report says what:
+//
+//  - Windows debug builds hook the debug CRT heap (_CrtSetAllocHook), which has malloc() and
+//    new, but not the heaps of the library's DLLs, which have CRTs of their own.
+//  - Windows release builds, and other systems, replace only operator new and delete, so
+//    only the sample's C++ allocations are counted, not malloc() or ASmalloc().
+//
+// Nothing is counted unless the DL_MEMTRACK environment variable is set when the sample
+// calls MemTrackStart(). At exit, a table of the stages is written to stdout; if DL_MEMTRACK
+// names a file, one tab separated line per stage is also added to it:
+//
+//    <sample> <stage> <allocations> <bytes allocated> <peak bytes in use>
+//
+// so that runs of a benchmark can be compared with each other. Bytes in use are counted
+// from MemTrackStart(), so blocks allocated before it and freed after can make them lower
+// than what the process really holds.
+//
+// MemTrackResident() reports the resident size of the process, counted or not, for samples
+// that show how it changes as they work.
+//
+
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+enum MemStage
+{
+	kMemStageOther,
+	kMemStageOpen,
+	kMemStageSizeQuery,
+	kMemStageDraw,
+	kMemStageRepack,
+	kMemStageExport,
+	kMemStageEdit,
+	kMemStageSave,
+	kNumMemStages
+};
+
+// Call at the start of main(). Starts counting if DL_MEMTRACK is set.
+void MemTrackStart(const char* sampleName);
+
+// Count what this thread allocates from now on against stage. Returns the stage it was in.
+MemStage MemTrackStage(MemStage stage);
+
+// The process's resident size now and the most it has been, in kilobytes, or -1 where that
+// cannot be found.
+void MemTrackResident(long& currentKB, long& peakKB);
+
+#endif // MEMTRACK_H
@@ -0,0 +1,608 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Shared by the samples: a pool of worker processes forked from one initialization of the
+// library. See PreforkPool.h.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "ASCalls.h"
+#include "PDCalls.h"
+#include "AcroColorCalls.h"
+
+#include "PreforkPool.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The steady clock is CLOCK_MONOTONIC on Linux, so these are comparable between processes.
+static long long clockNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static ASBool countSysFont(PDSysFont sysFont, void* clientData)
+{
+	++*static_cast<int*>(clientData);
+	return true;
+}
+
+int WarmSystemFonts()
+{
+	int numFonts = 0;
+	DURING
+		PDEnumSysFonts(countSysFont, &numFonts);
+	HANDLER
+	END_HANDLER
+	return numFonts;
+}
+
+int WarmColorProfiles()
+{
+	// The profile lists ColorConvert looks through for its target.
+	AC_SelectorCode selCodes[] =
+	{
+		AC_Selector_CMYK_StandardOutput,
+		AC_Selector_CMYK_OtherOutputCapable,
+		AC_Selector_RGB_Standard,
+		AC_Selector_RGB_OtherOutputCapable,
+		AC_Selector_Gray_Standard,
+		AC_Selector_DotGain_Standard,
+		AC_Selector_DotGain_Other
+	};
+
+	int numProfiles = 0;
+	for (size_t curSel = 0; curSel < sizeof(selCodes) / sizeof(selCodes[0]); curSel++)
+	{
+		AC_ProfileList profList = NULL;
+		ASUns32 profCount = 0;
+		if (ACMakeProfileList(&profList, selCodes[curSel]) != 0)
+			continue;
+		ACProfileListCount(profList, &profCount);
+		for (ASUns32 candidate = 0; candidate < profCount; candidate++)
+		{
+			AC_String profACString = NULL;
+			AC_Profile profile = NULL;
+			if (ACProfileListItemDescription(profList, candidate, &profACString) != 0)
+				continue;
+			if (ACProfileFromDescription(&profile, profACString) == 0 && profile != NULL)
+			{
+				++numProfiles;
+				ACUnReferenceProfile(profile);
+			}
+			ACUnReferenceString(profACString);
+		}
+		ACUnReferenceProfileList(profList);
+	}
+	return numProfiles;
+}
+
+typedef std::vector<std::string> JobArgs;
+
+// Split a line of the job file into arguments: separated by spaces, grouped by double quotes.
+static JobArgs splitJobLine(const std::string& line)
+{
+	JobArgs args;
+	std::string arg;
+	bool inArg = false;
+	bool quoted = false;
+	for (size_t i = 0; i < line.size(); i++)
+	{
+		char c = line[i];
+		if (c == '"')
+		{
+			quoted = !quoted;
+			inArg = true;
+		}
+		else if (!quoted && (c == ' ' || c == '\t' || c == '\r'))
+		{
+			if (inArg)
+				args.push_back(arg);
+			arg.clear();
+			inArg = false;
+		}
+		else
+		{
+			arg += c;
+			inArg = true;
+		}
+	}
+	if (inArg)
+		args.push_back(arg);
+	return args;
+}
+
+static bool readJobs(const std::string& jobFile, const char* samplePath, std::vector<JobArgs>& jobs)
+{
+	std::ifstream file(jobFile.c_str());
+	if (!file.is_open())
+		return false;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		JobArgs args = splitJobLine(line);
+		if (args.empty() || args[0][0] == '#')
+			continue;
+		args.insert(args.begin(), samplePath);
+		jobs.push_back(args);
+	}
+	return true;
+}
+
+// argv for a job, pointing into args.
+static std::vector<char*> jobArgv(JobArgs& args)
+{
+	std::vector<char*> argv;
+	for (size_t i = 0; i < args.size(); i++)
+		argv.push_back(&args[i][0]);
+	argv.push_back(NULL);
+	return argv;
+}
+
+struct JobRecord
+{
+	double startLatency;        // Seconds from when the job could start to the sample starting on it.
+	double seconds;             // Seconds the sample took over it.
+	int status;                 // What the sample returned, or -1 if it never finished.
+	int worker;
+};
+
+struct MemoryUse
+{
+	long rssKB;
+	long pssKB;                 // Resident, with each shared page divided between the processes sharing it.
+	long sharedKB;
+	long privateKB;
+	long peakKB;
+};
+
+struct WorkerRecord
+{
+	double readySeconds;        // From the pool starting to the worker ready for its first job.
+	int numJobs;
+	MemoryUse memory;
+};
+
+// Lives in memory shared between the parent and the workers.
+struct PoolState
+{
+	std::atomic<int> nextJob;
+};
+
+// What a sample started by -coldbench sends back, through DL_PREFORK_REPORT_FD.
+struct ColdReport
+{
+	double startLatency;
+	double seconds;
+	int status;
+};
+
+static bool readMemoryUse(MemoryUse& use)
+{
+	memset(&use, 0, sizeof(use));
+	FILE* file = fopen("/proc/self/smaps_rollup", "r");
+	if (file == NULL)
+		return false;
+
+	char line[256];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		char key[64];
+		long value = 0;
+		if (sscanf(line, "%63[^:]: %ld", key, &value) != 2)
+			continue;
+		if (strcmp(key, "Rss") == 0)
+			use.rssKB = value;
+		else if (strcmp(key, "Pss") == 0)
+			use.pssKB = value;
+		else if (strcmp(key, "Shared_Clean") == 0 || strcmp(key, "Shared_Dirty") == 0)
+			use.sharedKB += value;
+		else if (strcmp(key, "Private_Clean") == 0 || strcmp(key, "Private_Dirty") == 0)
+			use.privateKB += value;
+	}
+	fclose(file);
+	return true;
+}
+
+static double megabytes(long kilobytes)
+{
+	return kilobytes / 1024.0;
+}
+
+static void reportLatency(const char* title, const std::vector<JobRecord>& records)
+{
+	double total = 0, longest = 0;
+	int numStarted = 0;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (records[i].startLatency < 0)
+			continue;
+		total += records[i].startLatency;
+		longest = std::max(longest, records[i].startLatency);
+		++numStarted;
+	}
+	std::cout << "  " << title << " start latency: mean " << (numStarted > 0 ? 1000.0 * total / numStarted : 0.0)
+		<< " ms, longest " << 1000.0 * longest << " ms." << std::endl;
+}
+
+static int countFailed(const std::vector<JobRecord>& records)
+{
+	int numFailed = 0;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (records[i].status != 0)
+			++numFailed;
+	}
+	return numFailed;
+}
+
+#ifndef _WIN32
+
+// ru_maxrss is in kilobytes, except on macOS, where it is in bytes.
+static long peakKilobytes(const struct rusage& usage)
+{
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+static void flushOutput()
+{
+	// Anything still buffered would otherwise be written again by each child.
+	std::cout.flush();
+	fflush(NULL);
+}
+
+static void runWorker(int worker, PoolState* pool, JobRecord* jobRecords, WorkerRecord* workerRecords,
+	std::vector<JobArgs>& jobs, Clock::time_point poolStart, const SampleJobProc& job)
+{
+	WorkerRecord& record = workerRecords[worker];
+	record.readySeconds = secondsSince(poolStart);
+
+	Clock::time_point available = poolStart;
+	for (;;)
+	{
+		int jobNum = pool->nextJob.fetch_add(1);
+		if (jobNum >= static_cast<int>(jobs.size()))
+			break;
+
+		JobRecord& jobRecord = jobRecords[jobNum];
+		std::vector<char*> argv = jobArgv(jobs[jobNum]);
+		Clock::time_point begin = Clock::now();
+		jobRecord.startLatency = std::chrono::duration<double>(begin - available).count();
+		jobRecord.worker = worker;
+
+		int status = -1;
+		DURING
+			status = job(static_cast<int>(argv.size()) - 1, &argv[0]);
+		HANDLER
+			status = ERRORCODE;
+		END_HANDLER
+
+		jobRecord.seconds = secondsSince(begin);
+		jobRecord.status = status;
+		++record.numJobs;
+		available = Clock::now();
+	}
+
+	readMemoryUse(record.memory);
+	flushOutput();
+
+	// The parent shuts the library down; the worker just goes.
+	_exit(0);
+}
+
+static int runPool(std::vector<JobArgs>& jobs, const PreforkOptions& options, const SampleJobProc& job,
+	std::vector<JobRecord>& jobResults, std::vector<WorkerRecord>& workerResults, double& wallSeconds)
+{
+	// The queue and the records go in anonymous shared memory, so the workers can take jobs
+	// from the queue and fill the records in for the parent.
+	size_t jobsOffset = 64;
+	size_t workersOffset = jobsOffset + jobs.size() * sizeof(JobRecord);
+	size_t mappingSize = workersOffset + options.numWorkers * sizeof(WorkerRecord);
+	void* mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Could not map the job queue: " << strerror(errno) << std::endl;
+		return static_cast<int>(jobs.size());
+	}
+
+	PoolState* pool = new (mapping) PoolState;
+	pool->nextJob = 0;
+	JobRecord* jobRecords = reinterpret_cast<JobRecord*>(static_cast<char*>(mapping) + jobsOffset);
+	WorkerRecord* workerRecords = reinterpret_cast<WorkerRecord*>(static_cast<char*>(mapping) + workersOffset);
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		jobRecords[i].startLatency = -1;
+		jobRecords[i].seconds = 0;
+		jobRecords[i].status = -1;
+		jobRecords[i].worker = -1;
+	}
+	memset(workerRecords, 0, options.numWorkers * sizeof(WorkerRecord));
+
+	flushOutput();
+	Clock::time_point poolStart = Clock::now();
+	std::vector<pid_t> workers;
+	for (int worker = 0; worker < options.numWorkers; worker++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+			runWorker(worker, pool, jobRecords, workerRecords, jobs, poolStart, job);
+		if (pid < 0)
+		{
+			std::cout << "Could not start worker " << worker << ": " << strerror(errno) << std::endl;
+			break;
+		}
+		workers.push_back(pid);
+	}
+
+	for (size_t worker = 0; worker < workers.size(); worker++)
+	{
+		int status = 0;
+		struct rusage usage;
+		memset(&usage, 0, sizeof(usage));
+		if (wait4(workers[worker], &status, 0, &usage) < 0)
+			continue;
+		workerRecords[worker].memory.peakKB = peakKilobytes(usage);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			std::cout << "Worker " << worker << " (pid " << workers[worker] << ") did not finish." << std::endl;
+	}
+	wallSeconds = secondsSince(poolStart);
+
+	jobResults.assign(jobRecords, jobRecords + jobs.size());
+	workerResults.assign(workerRecords, workerRecords + workers.size());
+	pool->~PoolState();
+	munmap(mapping, mappingSize);
+	return countFailed(jobResults);
+}
+
+// Run the jobs again, numWorkers at a time, each in a new process of the sample.
+static int runCold(const char* samplePath, std::vector<JobArgs>& jobs, const PreforkOptions& options,
+	std::vector<JobRecord>& jobResults, std::vector<long>& peakKB, double& wallSeconds)
+{
+	struct Launch
+	{
+		size_t jobNum;
+		int reportFd;
+	};
+
+	// Started the way a cold launch is, through exec, from the same executable.
+	std::string executable = samplePath;
+#ifdef __linux__
+	if (access("/proc/self/exe", X_OK) == 0)
+		executable = "/proc/self/exe";
+#endif
+
+	JobRecord notRun = { -1, 0, -1, -1 };
+	jobResults.assign(jobs.size(), notRun);
+	peakKB.assign(jobs.size(), 0);
+
+	std::map<pid_t, Launch> running;
+	size_t nextJob = 0;
+	Clock::time_point poolStart = Clock::now();
+	while (nextJob < jobs.size() || !running.empty())
+	{
+		while (nextJob < jobs.size() && static_cast<int>(running.size()) < options.numWorkers)
+		{
+			size_t jobNum = nextJob++;
+			int fds[2];
+			if (pipe(fds) != 0)
+			{
+				std::cout << "Could not start job " << jobNum << ": " << strerror(errno) << std::endl;
+				continue;
+			}
+
+			std::vector<char*> argv = jobArgv(jobs[jobNum]);
+			flushOutput();
+			long long launched = clockNanoseconds();
+			pid_t pid = fork();
+			if (pid == 0)
+			{
+				char value[32];
+				close(fds[0]);
+				snprintf(value, sizeof(value), "%lld", launched);
+				setenv("DL_PREFORK_LAUNCH", value, 1);
+				snprintf(value, sizeof(value), "%d", fds[1]);
+				setenv("DL_PREFORK_REPORT_FD", value, 1);
+				execv(executable.c_str(), &argv[0]);
+				_exit(127);
+			}
+			close(fds[1]);
+			if (pid < 0)
+			{
+				std::cout << "Could not start job " << jobNum << ": " << strerror(errno) << std::endl;
+				close(fds[0]);
+				continue;
+			}
+			Launch launch = { jobNum, fds[0] };
+			running[pid] = launch;
+		}
+
+		if (running.empty())
+			break;
+
+		int status = 0;
+		struct rusage usage;
+		memset(&usage, 0, sizeof(usage));
+		pid_t pid = wait4(-1, &status, 0, &usage);
+		if (pid < 0)
+			break;
+		std::map<pid_t, Launch>::iterator launch = running.find(pid);
+		if (launch == running.end())
+			continue;
+
+		ColdReport report;
+		JobRecord& record = jobResults[launch->second.jobNum];
+		if (read(launch->second.reportFd, &report, sizeof(report)) == sizeof(report))
+		{
+			record.startLatency = report.startLatency;
+			record.seconds = report.seconds;
+			record.status = report.status;
+		}
+		peakKB[launch->second.jobNum] = peakKilobytes(usage);
+		close(launch->second.reportFd);
+		running.erase(launch);
+	}
+	wallSeconds = secondsSince(poolStart);
+	return countFailed(jobResults);
+}
+
+static int runPrefork(const char* samplePath, const PreforkOptions& options, const SampleJobProc& job)
+{
+	std::vector<JobArgs> jobs;
+	if (!readJobs(options.jobFile, samplePath, jobs))
+	{
+		std::cout << "Could not read the jobs from " << options.jobFile << std::endl;
+		return 1;
+	}
+
+	// Whatever is loaded now is shared with every worker.
+	Clock::time_point warmStart = Clock::now();
+	int numFonts = options.warmFonts ? WarmSystemFonts() : 0;
+	int numProfiles = options.warmProfiles ? WarmColorProfiles() : 0;
+	double warmSeconds = secondsSince(warmStart);
+	MemoryUse parentMemory;
+	bool haveMemory = readMemoryUse(parentMemory);
+
+	std::vector<JobRecord> jobResults;
+	std::vector<WorkerRecord> workerResults;
+	double wallSeconds = 0;
+	int numFailed = runPool(jobs, options, job, jobResults, workerResults, wallSeconds);
+
+	std::cout << "Prefork pool: " << jobs.size() << " jobs on " << workerResults.size() << " workers in "
+		<< wallSeconds << " s, " << numFailed << " failed." << std::endl;
+	if (options.warmFonts || options.warmProfiles)
+		std::cout << "  Warmed " << numFonts << " fonts and " << numProfiles << " profiles in " << warmSeconds << " s." << std::endl;
+	if (haveMemory)
+		std::cout << "  Parent resident before forking: " << megabytes(parentMemory.rssKB) << " MB." << std::endl;
+	reportLatency("Prefork", jobResults);
+
+	long totalPrivateKB = 0;
+	for (size_t worker = 0; worker < workerResults.size(); worker++)
+	{
+		const WorkerRecord& record = workerResults[worker];
+		std::cout << "  worker " << worker << ": " << record.numJobs << " jobs, ready after "
+			<< 1000.0 * record.readySeconds << " ms, ";
+		if (record.memory.rssKB > 0)
+			std::cout << "resident " << megabytes(record.memory.rssKB) << " MB (" << megabytes(record.memory.sharedKB)
+				<< " MB shared, " << megabytes(record.memory.privateKB) << " MB own, proportional share "
+				<< megabytes(record.memory.pssKB) << " MB), ";
+		std::cout << "peak " << megabytes(record.memory.peakKB) << " MB." << std::endl;
+		totalPrivateKB += record.memory.privateKB;
+	}
+
+	// The counts were reported above; as an exit status they would be taken mod 256.
+	if (!options.coldBench)
+		return (numFailed == 0) ? 0 : 1;
+
+	std::vector<JobRecord> coldResults;
+	std::vector<long> coldPeakKB;
+	double coldSeconds = 0;
+	int numColdFailed = runCold(samplePath, jobs, options, coldResults, coldPeakKB, coldSeconds);
+
+	long totalColdPeakKB = 0;
+	for (size_t i = 0; i < coldPeakKB.size(); i++)
+		totalColdPeakKB += coldPeakKB[i];
+	std::cout << "Cold launches: " << jobs.size() << " jobs, " << options.numWorkers << " at a time, in "
+		<< coldSeconds << " s, " << numColdFailed << " failed." << std::endl;
+	reportLatency("Cold", coldResults);
+	if (!coldPeakKB.empty())
+		std::cout << "  Peak resident per process: mean " << megabytes(totalColdPeakKB) / coldPeakKB.size() << " MB." << std::endl;
+	if (!workerResults.empty())
+		std::cout << "  Prefork workers' own memory: mean " << megabytes(totalPrivateKB) / workerResults.size()
+			<< " MB each, the rest shared with the parent." << std::endl;
+	return (numFailed + numColdFailed == 0) ? 0 : 1;
+}
+
+#endif // _WIN32
+
+// A sample started by -coldbench: report when it got going, and how the job went.
+static int runReported(int argc, char** argv, const SampleJobProc& job)
+{
+#ifndef _WIN32
+	const char* launched = getenv("DL_PREFORK_LAUNCH");
+	const char* reportFd = getenv("DL_PREFORK_REPORT_FD");
+	if (launched != NULL && reportFd != NULL)
+	{
+		ColdReport report;
+		report.startLatency = (clockNanoseconds() - atoll(launched)) / 1e9;
+		Clock::time_point begin = Clock::now();
+		report.status = job(argc, argv);
+		report.seconds = secondsSince(begin);
+
+		int fd = atoi(reportFd);
+		if (write(fd, &report, sizeof(report)) != sizeof(report))
+			std::cout << "Could not report to the pool: " << strerror(errno) << std::endl;
+		close(fd);
+		return report.status;
+	}
+#endif
+	return job(argc, argv);
+}
+
+int RunSampleJobs(int argc, char** argv, const SampleJobProc& job)
+{
+	if (argc < 2 || strcmp(argv[1], "-prefork") != 0)
+		return runReported(argc, argv, job);
+
+	if (argc < 4)
+	{
+		std::cout << "Usage: " << argv[0] << " -prefork <workers> <jobfile> [-warmfonts] [-warmprofiles] [-coldbench]" << std::endl;
+		return 1;
+	}
+
+	PreforkOptions options;
+	options.numWorkers = atoi(argv[2]);
+	options.jobFile = argv[3];
+	for (int curArg = 4; curArg < argc; curArg++)
+	{
+		if (strcmp(argv[curArg], "-warmfonts") == 0)
+			options.warmFonts = true;
+		else if (strcmp(argv[curArg], "-warmprofiles") == 0)
+			options.warmProfiles = true;
+		else if (strcmp(argv[curArg], "-coldbench") == 0)
+			options.coldBench = true;
+		else
+			std::cout << "Ignoring unknown option " << argv[curArg] << std::endl;
+	}
+	if (options.numWorkers < 1)
+		options.numWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+#ifdef _WIN32
+	std::cout << "-prefork needs fork(), which is not available here." << std::endl;
+	return 1;
+#else
+	return runPrefork(argv[0], options, job);
+#endif
+}
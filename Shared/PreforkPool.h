@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// For complete copyright information, refer to:
+// http://dev.datalogics.com/adobe-pdf-library/license-for-downloaded-pdf-samples/
+//
+// Shared by the samples: running many jobs of a sample from one initialization of the library.
+//
+// Every run of a sample pays for initializing the library (fonts, CMaps, color profiles)
+// before it does any work. Run as
+//
+//    <sample> -prefork <n> <jobfile> [-warmfonts] [-warmprofiles] [-coldbench]
+//
+// the sample initializes the library once, optionally warms it further (-warmfonts scans
+// the system fonts, -warmprofiles makes every profile ColorConvert looks through for its
+// target), and then forks n worker processes. The workers share what the parent has loaded,
+// copy-on-write, and take the jobs in turn from a queue in memory shared with the parent.
+//
+// Each line of the job file is one job: the arguments the sample would be given on its
+// command line, separated by spaces, with double quotes around any argument that contains
+// them. Blank lines and lines starting with # are skipped.
+//
+// For each job, the time from when it could start (the pool starting, for a worker's first
+// job, or the worker finishing its last one) to the sample's code starting on it is reported
+// as its start latency. For each worker, its resident memory is reported, split into what it
+// still shares with the parent and other workers and what is its own, from
+// /proc/self/smaps_rollup (Linux only), along with its peak resident size.
+//
+// -coldbench then runs the same jobs again, n at a time, each in a new process of the sample
+// started from scratch, the way they would be without the pool, and reports the same times.
+// Those processes are told when they were launched through the DL_PREFORK_LAUNCH and
+// DL_PREFORK_REPORT_FD environment variables.
+//
+// Only the thread that calls fork() carries on in a worker, so nothing should be running on
+// other threads of the parent at that point. fork() is POSIX; elsewhere -prefork fails and
+// says so.
+//
+
+#ifndef PREFORKPOOL_H
+#define PREFORKPOOL_H
+
+#include <functional>
+#include <string>
+
+// One run of a sample, given the arguments it would have on its command line, argv[0] included.
+// Returns 0 on success, as the sample's main() would.
+typedef std::function<int(int argc, char** argv)> SampleJobProc;
+
+struct PreforkOptions
+{
+	int numWorkers;
+	std::string jobFile;
+	bool warmFonts;
+	bool warmProfiles;
+	bool coldBench;
+
+	PreforkOptions() : numWorkers(0), warmFonts(false), warmProfiles(false), coldBench(false) {}
+};
+
+// Call from main() once the library is initialized. With -prefork as the first argument,
+// runs the jobs of the job file in a pool of workers, reports how many failed, and returns 0
+// if none did and 1 otherwise; otherwise runs job(argc, argv) once and returns what it does.
+int RunSampleJobs(int argc, char** argv, const SampleJobProc& job);
+
+// Load what later jobs would otherwise load on first use. Returns the number of fonts and
+// profiles seen.
+int WarmSystemFonts();
+int WarmColorProfiles();
+
+#endif // PREFORKPOOL_H
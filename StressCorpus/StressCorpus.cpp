@@ -0,0 +1,385 @@
+//
+// Copyright (c) 2024, Datalogics, Inc. All rights reserved.
+//
+// The StressCorpus sample generates PDF documents for benchmarking the other samples. The
+// content is made from the same helpers CreateNestedLayers uses, and every property that
+// affects the cost of rendering, converting or resizing a document can be set from the
+// command line. The same options and seed always produce the same document, so benchmark
+// inputs can be made locally, at any size, rather than shipped.
+//
+// Command-line:  [options] <output-file>    (Optional; the default is StressCorpus-out.pdf)
+//
+//   -pages <n>          Number of pages (default 10).
+//   -runs <n>           Text runs on each page (default 100).
+//   -images <n>         Images on each page (default 2).
+//   -imagesize <n>      Width and height of each image, in pixels (default 256).
+//   -colorspace <cs>    Color space of the images: gray, rgb, cmyk, or mixed to cycle through
+//                       all three (default rgb).
+//   -depth <n>          Depth of the nested layers the content is spread over; 0 for no layers
+//                       (default 2).
+//   -transparency       Draw every other text run and image at 50% opacity, multiplied.
+//   -sizes <list>       Comma separated page sizes, used in turn: letter, legal, tabloid, a4,
+//                       a3, or <width>x<height> in points (default letter).
+//   -rotate             Rotate the pages by 0, 90, 180 and 270 degrees in turn.
+//   -seed <n>           Seed for the placement, colors and image data (default 1).
+//
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "InitializeLibrary.h"
+#include "APDFLDoc.h"
+
+#include "PSFCalls.h"
+#include "PERCalls.h"
+#include "PEWCalls.h"
+#include "PagePDECntCalls.h"
+#include "CosCalls.h"
+
+#include "ContentHelpers.h"
+#include "LayerTree.h"
+#include "ResourceCache.h"
+
+#define DEF_OUTPUT "StressCorpus-out.pdf"
+
+struct StressOptions
+{
+	int numPages;
+	int runsPerPage;
+	int imagesPerPage;
+	int imageSize;
+	std::string colorSpace;
+	int layerDepth;
+	bool transparency;
+	std::vector<std::pair<double, double> > pageSizes;
+	bool rotate;
+	unsigned int seed;
+};
+
+// A small generator whose sequence is the same on every platform, unlike the distributions
+// in <random>.
+class StressRandom
+{
+public:
+	StressRandom(unsigned int seed) : state(seed ? seed : 1) {}
+
+	unsigned int Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// A value from 0 up to, but not including, limit.
+	int Below(int limit) { return limit > 0 ? static_cast<int>(Next() % static_cast<unsigned int>(limit)) : 0; }
+	double Between(double low, double high) { return low + ((high - low) * (Next() & 0xFFFF) / 65536.0); }
+
+private:
+	unsigned int state;
+};
+
+static bool parsePageSizes(const char* list, std::vector<std::pair<double, double> >& sizes)
+{
+	static const struct { const char* name; double width, height; } kNamedSizes[] = {
+		{ "letter", 612, 792 }, { "legal", 612, 1008 }, { "tabloid", 792, 1224 }, { "a4", 595, 842 }, { "a3", 842, 1191 }
+	};
+
+	sizes.clear();
+	std::string remaining(list);
+	while (!remaining.empty())
+	{
+		size_t comma = remaining.find(',');
+		std::string size = remaining.substr(0, comma);
+		remaining = (comma == std::string::npos) ? std::string() : remaining.substr(comma + 1);
+
+		bool found = false;
+		for (size_t i = 0; i < sizeof(kNamedSizes) / sizeof(kNamedSizes[0]); i++)
+		{
+			if (size == kNamedSizes[i].name)
+			{
+				sizes.push_back(std::make_pair(kNamedSizes[i].width, kNamedSizes[i].height));
+				found = true;
+			}
+		}
+
+		double width, height;
+		if (!found && sscanf(size.c_str(), "%lfx%lf", &width, &height) == 2 && width >= 72 && height >= 72)
+		{
+			sizes.push_back(std::make_pair(width, height));
+			found = true;
+		}
+		if (!found)
+			return false;
+	}
+	return !sizes.empty();
+}
+
+// Make an image of the given color space with a gradient and some noise, so that it neither
+// compresses to nothing nor is the same as any other image in the document.
+static PDEImage makeStressImage(int size, const char* colorSpaceName, ResourceCache* cache, StressRandom& random, ASDoubleMatrix* matrix)
+{
+	int numComps = (strcmp(colorSpaceName, "DeviceGray") == 0) ? 1 : (strcmp(colorSpaceName, "DeviceCMYK") == 0) ? 4 : 3;
+	ASSize_t dataSize = static_cast<ASSize_t>(size) * size * numComps;
+	std::vector<ASUns8> data(dataSize);
+
+	int base[4];
+	for (int comp = 0; comp < numComps; comp++)
+		base[comp] = random.Below(256);
+	for (int row = 0; row < size; row++)
+	{
+		ASUns8* pixel = &data[static_cast<size_t>(row) * size * numComps];
+		for (int col = 0; col < size; col++)
+		{
+			int noise = static_cast<int>(random.Next() & 0x1F);
+			for (int comp = 0; comp < numComps; comp++)
+				*pixel++ = static_cast<ASUns8>(base[comp] + ((comp & 1) ? row : col) * 255 / size + noise);
+		}
+	}
+
+	PDEImageAttrs attrs;
+	memset(&attrs, 0, sizeof(PDEImageAttrs));
+	attrs.width = size;
+	attrs.height = size;
+	attrs.bitsPerComponent = 8;
+
+	PDEFilterArray filters;
+	memset(&filters, 0, sizeof(PDEFilterArray));
+	filters.numFilters = 1;
+	filters.spec[0].name = ASAtomFromString("FlateDecode");
+
+	PDEColorSpace colorSpace = cache->GetColorSpace(colorSpaceName);
+	PDEImage image = PDEImageCreateEx(&attrs, sizeof(attrs), matrix, 0, colorSpace, NULL, &filters, 0, &data[0], dataSize);
+	PDERelease(reinterpret_cast<PDEObject>(colorSpace));
+	return image;
+}
+
+// Add an element to a page's content, inside the container for its layer if there are layers.
+static void addToLayer(PDEContent pageContent, PDEElement elem, const LayerTree& layers, int layer)
+{
+	if (layers.NumNodes() == 0)
+	{
+		PDEContentAddElem(pageContent, kPDEAfterLast, elem);
+		return;
+	}
+
+	PDEContent layerContent = PDEContentCreate();
+	PDEContentAddElem(layerContent, kPDEAfterLast, elem);
+	PDEContainer container = makeOCMDContainer(layerContent, layers.GetNode(layer).ocmd);
+	PDEContentAddElem(pageContent, kPDEAfterLast, reinterpret_cast<PDEElement>(container));
+	PDERelease(reinterpret_cast<PDEObject>(container));
+	PDERelease(reinterpret_cast<PDEObject>(layerContent));
+}
+
+int main(int argc, char** argv)
+{
+	APDFLib libInit;
+	ASErrorCode errCode = 0;
+	if (libInit.isValid() == false)
+	{
+		errCode = libInit.getInitError();
+		std::cout << "Initialization failed with code " << errCode << std::endl;
+		return errCode;
+	}
+
+	StressOptions options;
+	options.numPages = 10;
+	options.runsPerPage = 100;
+	options.imagesPerPage = 2;
+	options.imageSize = 256;
+	options.colorSpace = "rgb";
+	options.layerDepth = 2;
+	options.transparency = false;
+	options.pageSizes.push_back(std::make_pair(612.0, 792.0));
+	options.rotate = false;
+	options.seed = 1;
+
+	int curArg = 1;
+	while (argc > curArg && argv[curArg][0] == '-')
+	{
+		bool hasValue = argc > curArg + 1;
+		if (strcmp(argv[curArg], "-pages") == 0 && hasValue)
+			options.numPages = atoi(argv[++curArg]);
+		else if (strcmp(argv[curArg], "-runs") == 0 && hasValue)
+			options.runsPerPage = atoi(argv[++curArg]);
+		else if (strcmp(argv[curArg], "-images") == 0 && hasValue)
+			options.imagesPerPage = atoi(argv[++curArg]);
+		else if (strcmp(argv[curArg], "-imagesize") == 0 && hasValue)
+			options.imageSize = atoi(argv[++curArg]);
+		else if (strcmp(argv[curArg], "-colorspace") == 0 && hasValue)
+			options.colorSpace = argv[++curArg];
+		else if (strcmp(argv[curArg], "-depth") == 0 && hasValue)
+			options.layerDepth = atoi(argv[++curArg]);
+		else if (strcmp(argv[curArg], "-transparency") == 0)
+			options.transparency = true;
+		else if (strcmp(argv[curArg], "-sizes") == 0 && hasValue)
+		{
+			if (!parsePageSizes(argv[++curArg], options.pageSizes))
+			{
+				std::cout << "Unrecognized page size in " << argv[curArg] << std::endl;
+				return -1;
+			}
+		}
+		else if (strcmp(argv[curArg], "-rotate") == 0)
+			options.rotate = true;
+		else if (strcmp(argv[curArg], "-seed") == 0 && hasValue)
+			options.seed = static_cast<unsigned int>(strtoul(argv[++curArg], NULL, 10));
+		else
+		{
+			std::cout << "Unrecognized option " << argv[curArg] << std::endl;
+			return -1;
+		}
+		++curArg;
+	}
+
+	const char* imageSpaces[3];
+	int numImageSpaces = 1;
+	if (options.colorSpace == "gray")
+		imageSpaces[0] = "DeviceGray";
+	else if (options.colorSpace == "rgb")
+		imageSpaces[0] = "DeviceRGB";
+	else if (options.colorSpace == "cmyk")
+		imageSpaces[0] = "DeviceCMYK";
+	else if (options.colorSpace == "mixed")
+	{
+		imageSpaces[0] = "DeviceGray";
+		imageSpaces[1] = "DeviceRGB";
+		imageSpaces[2] = "DeviceCMYK";
+		numImageSpaces = 3;
+	}
+	else
+	{
+		std::cout << "Unrecognized color space " << options.colorSpace.c_str() << std::endl;
+		return -1;
+	}
+
+	if (options.numPages < 1 || options.runsPerPage < 0 || options.imagesPerPage < 0 || options.imageSize < 1 || options.layerDepth < 0)
+	{
+		std::cout << "The page count and image size must be at least 1, and the other counts must not be negative" << std::endl;
+		return -1;
+	}
+
+	std::string csOutputFileName(argc > curArg ? argv[curArg] : DEF_OUTPUT);
+	std::cout << "Creating " << csOutputFileName.c_str() << ": " << options.numPages << " pages, " << options.runsPerPage
+		<< " text runs and " << options.imagesPerPage << " " << options.colorSpace.c_str() << " images of " << options.imageSize
+		<< " pixels square per page, " << options.layerDepth << " layer levels" << (options.transparency ? ", transparency" : "")
+		<< (options.rotate ? ", rotated" : "") << ", seed " << options.seed << std::endl;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+DURING
+
+	APDFLDoc doc;
+	ResourceCache* cache = new ResourceCache;
+	StressRandom random(options.seed);
+
+	// A chain of nested layers; content is spread over every level of it.
+	LayerTree layers;
+	if (options.layerDepth > 0)
+	{
+		layers.MakeSynthetic(options.layerDepth, 1);
+		layers.Build(doc.getPDDoc());
+	}
+
+	PDEExtGState transparentState = NULL;
+	if (options.transparency)
+	{
+		transparentState = PDEExtGStateCreateNew(PDDocGetCosDoc(doc.getPDDoc()));
+		PDEExtGStateSetOpacityFill(transparentState, FloatToASFixed(0.5));
+		PDEExtGStateSetOpacityStroke(transparentState, FloatToASFixed(0.5));
+		PDEExtGStateSetBlendMode(transparentState, ASAtomFromString("Multiply"));
+	}
+
+	PDEFont font = fontMaker("MyriadPro-Regular", "TrueType", kPDEFontCreateEmbedOpenType, cache);
+	PDETextState tState;
+	memset(&tState, 0x0, sizeof(PDETextState));
+
+	static const PDRotate kRotations[] = { pdRotate0, pdRotate90, pdRotate180, pdRotate270 };
+	long long numRuns = 0, numImages = 0;
+
+	// Each page is made and released before the next is started.
+	for (int pageNum = 0; pageNum < options.numPages; pageNum++)
+	{
+		const std::pair<double, double>& size = options.pageSizes[pageNum % options.pageSizes.size()];
+		doc.insertPage(ASFloatToFixed(size.first), ASFloatToFixed(size.second), pageNum - 1);
+		PDPage page = doc.getPage(pageNum);
+		if (options.rotate)
+			PDPageSetRotate(page, kRotations[pageNum % 4]);
+		PDEContent pageContent = PDPageAcquirePDEContent(page, NULL);
+
+		for (int imageNum = 0; imageNum < options.imagesPerPage; imageNum++)
+		{
+			double width = random.Between(72, size.first / 2);
+			double height = random.Between(72, size.second / 2);
+			ASDoubleMatrix imageMatrix = { width, 0, 0, height, random.Between(0, size.first - width), random.Between(0, size.second - height) };
+			PDEImage image = makeStressImage(options.imageSize, imageSpaces[(pageNum + imageNum) % numImageSpaces], cache, random, &imageMatrix);
+
+			if (transparentState != NULL && (imageNum % 2) == 1)
+			{
+				PDEGraphicState gState;
+				PDEDefaultGState(&gState, sizeof(PDEGraphicState));
+				gState.extGState = transparentState;
+				gState.wasSetFlags |= kPDEExtGStateWasSet;
+				PDEElementSetGState(reinterpret_cast<PDEElement>(image), &gState, sizeof(PDEGraphicState));
+				PDERelease(reinterpret_cast<PDEObject>(gState.fillColorSpec.space));
+				PDERelease(reinterpret_cast<PDEObject>(gState.strokeColorSpec.space));
+			}
+
+			addToLayer(pageContent, reinterpret_cast<PDEElement>(image), layers, imageNum % (options.layerDepth ? options.layerDepth : 1));
+			PDERelease(reinterpret_cast<PDEObject>(image));
+			++numImages;
+		}
+
+		PDEGraphicState gState;
+		PDEDefaultGState(&gState, sizeof(PDEGraphicState));
+		for (int runNum = 0; runNum < options.runsPerPage; runNum++)
+		{
+			double fontSize = random.Between(6, 24);
+			tState.fontSize = FloatToASFixed(fontSize);
+			setGstateRGBFillColor(&gState, static_cast<unsigned char>(random.Below(256)), static_cast<unsigned char>(random.Below(256)),
+				static_cast<unsigned char>(random.Below(256)), cache);
+			bool transparent = transparentState != NULL && (runNum % 2) == 1;
+			gState.extGState = transparent ? transparentState : NULL;
+			gState.wasSetFlags = transparent ? (gState.wasSetFlags | kPDEExtGStateWasSet) : (gState.wasSetFlags & ~kPDEExtGStateWasSet);
+
+			std::string text = "Page " + std::to_string(pageNum + 1) + " run " + std::to_string(runNum + 1) + " of the stress corpus";
+			ASDoubleMatrix textMatrix = { 1, 0, 0, 1, random.Between(0, size.first - 72), random.Between(fontSize, size.second - fontSize) };
+			PDEText textRun = textMakerEx(text, font, &textMatrix, &gState, &tState);
+			addToLayer(pageContent, reinterpret_cast<PDEElement>(textRun), layers, runNum % (options.layerDepth ? options.layerDepth : 1));
+			PDERelease(reinterpret_cast<PDEObject>(textRun));
+			++numRuns;
+		}
+		PDERelease(reinterpret_cast<PDEObject>(gState.fillColorSpec.space));
+
+		PDPageSetPDEContentCanRaise(page, NULL);
+		PDPageReleasePDEContent(page, NULL);
+		PDPageRelease(page);
+	}
+
+	std::chrono::steady_clock::time_point generated = std::chrono::steady_clock::now();
+
+	PDERelease(reinterpret_cast<PDEObject>(font));
+	if (transparentState != NULL)
+		PDERelease(reinterpret_cast<PDEObject>(transparentState));
+	delete cache;
+
+	doc.saveDoc(csOutputFileName.c_str(), PDSaveFull);
+
+	std::chrono::steady_clock::time_point saved = std::chrono::steady_clock::now();
+	std::cout << "Wrote " << options.numPages << " pages, " << numRuns << " text runs and " << numImages << " images: generate "
+		<< std::chrono::duration<double>(generated - start).count() << " s, save "
+		<< std::chrono::duration<double>(saved - generated).count() << " s" << std::endl;
+
+HANDLER
+	errCode = ERRORCODE;
+	libInit.displayError(errCode);
+END_HANDLER
+
+	return errCode;
+}